@@ -0,0 +1,15 @@
+#pragma once
+
+#include "core/Logger.hpp"
+
+namespace bench {
+
+// Logs a failed check. Benches and the results together and return 1 from main if any failed.
+inline bool expect(bool cond, const char* what) {
+  if (!cond) {
+    LERROR("check failed: {}", what);
+  }
+  return cond;
+}
+
+}  // namespace bench
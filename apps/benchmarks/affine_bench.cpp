@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/matrix.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AABB.hpp"
+#include "Affine.hpp"
+#include "core/Logger.hpp"
+
+// Compares the glm mat4 path against the Affine kernels for every isa the cpu supports.
+// usage: affine_bench [count]
+
+namespace {
+
+mat4 random_transform(std::mt19937& rng) {
+  std::uniform_real_distribution<float> dist{-1.f, 1.f};
+  const vec3 t{dist(rng), dist(rng), dist(rng)};
+  const quat r = glm::angleAxis(dist(rng) * 3.14f, glm::normalize(vec3{dist(rng), 1.f, .5f}));
+  const vec3 s{1.f + (.5f * dist(rng)), 1.f + (.5f * dist(rng)), 1.f + (.5f * dist(rng))};
+  return glm::translate(mat4{1}, t) * glm::mat4_cast(r) * glm::scale(mat4{1}, s);
+}
+
+// the pre-Affine implementation from VkRender2.cpp
+AABB transform_aabb_glm(const glm::mat4& model, const AABB& aabb) {
+  AABB result;
+  result.min = glm::vec3(model[3]);
+  result.max = result.min;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      float a = model[j][i] * aabb.min[j];
+      float b = model[j][i] * aabb.max[j];
+      result.min[i] += glm::min(a, b);
+      result.max[i] += glm::max(a, b);
+    }
+  }
+  return result;
+}
+
+template <typename F>
+double ns_per_op(size_t op_cnt, int reps, F&& f) {
+  f();  // warm up
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < reps; i++) {
+    f();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         static_cast<double>(op_cnt * reps);
+}
+
+float max_error(const mat4& a, const mat4& b) {
+  float err{};
+  for (int c = 0; c < 4; c++) {
+    for (int r = 0; r < 4; r++) {
+      err = std::max(err, std::abs(a[c][r] - b[c][r]));
+    }
+  }
+  return err;
+}
+
+// keeps results observable so the optimizer can't drop the loops
+volatile float g_sink;
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  size_t cnt = 1 << 16;
+  if (argc > 1) {
+    cnt = std::max(std::atoll(argv[1]), 64ll);
+  }
+  constexpr int reps = 20;
+  constexpr u32 fanout = 8;
+
+  std::mt19937 rng{42};
+  std::vector<mat4> mats_a(cnt), mats_b(cnt), mats_out(cnt);
+  std::vector<Affine> aff_a(cnt), aff_b(cnt), aff_out(cnt);
+  std::vector<AABB> aabbs(cnt), aabb_out(cnt);
+  std::vector<u32> nodes(cnt);
+  std::vector<i32> parents(cnt);
+  for (size_t i = 0; i < cnt; i++) {
+    mats_a[i] = random_transform(rng);
+    mats_b[i] = random_transform(rng);
+    aff_a[i] = Affine{mats_a[i]};
+    aff_b[i] = Affine{mats_b[i]};
+    aabbs[i] = AABB{.min = vec3{-1.f, -2.f, -.5f}, .max = vec3{1.f, .5f, 2.f}};
+    nodes[i] = static_cast<u32>(i);
+    parents[i] = i == 0 ? -1 : static_cast<i32>((i - 1) / fanout);
+  }
+
+  LINFO("count: {}, detected isa: {}", cnt, affine::isa_name(affine::detected_isa()));
+  LINFO("{:<22} {:>10}", "kernel", "ns/op");
+
+  const double glm_mul = ns_per_op(cnt, reps, [&]() {
+    for (size_t i = 0; i < cnt; i++) {
+      mats_out[i] = mats_a[i] * mats_b[i];
+    }
+    g_sink = mats_out[cnt / 2][3][0];
+  });
+  const double glm_propagate = ns_per_op(cnt, reps, [&]() {
+    mats_out[0] = mats_b[0];
+    for (size_t i = 1; i < cnt; i++) {
+      mats_out[i] = mats_out[parents[i]] * mats_b[i];
+    }
+    g_sink = mats_out[cnt - 1][3][0];
+  });
+  const double glm_inverse = ns_per_op(cnt, reps, [&]() {
+    for (size_t i = 0; i < cnt; i++) {
+      mats_out[i] = glm::inverse(mats_a[i]);
+    }
+    g_sink = mats_out[cnt / 2][3][0];
+  });
+  const double glm_aabb = ns_per_op(cnt, reps, [&]() {
+    for (size_t i = 0; i < cnt; i++) {
+      aabb_out[i] = transform_aabb_glm(mats_a[i], aabbs[i]);
+    }
+    g_sink = aabb_out[cnt / 2].min.x;
+  });
+  LINFO("{:<22} {:>10.2f}", "glm mul", glm_mul);
+  LINFO("{:<22} {:>10.2f}", "glm propagate", glm_propagate);
+  LINFO("{:<22} {:>10.2f}", "glm inverse", glm_inverse);
+  LINFO("{:<22} {:>10.2f}", "glm transform_aabb", glm_aabb);
+
+  // reference results for the error column
+  std::vector<mat4> ref_mul(cnt), ref_propagate(cnt);
+  for (size_t i = 0; i < cnt; i++) {
+    ref_mul[i] = mats_a[i] * mats_b[i];
+    ref_propagate[i] = i == 0 ? mats_b[0] : ref_propagate[parents[i]] * mats_b[i];
+  }
+
+  for (auto isa : {affine::Isa::Scalar, affine::Isa::SSE, affine::Isa::AVX2}) {
+    if (static_cast<u8>(isa) > static_cast<u8>(affine::detected_isa())) continue;
+    affine::set_isa(isa);
+    const char* name = affine::isa_name(isa);
+    const double mul = ns_per_op(cnt, reps, [&]() {
+      for (size_t i = 0; i < cnt; i++) {
+        aff_out[i] = aff_a[i] * aff_b[i];
+      }
+      g_sink = aff_out[cnt / 2].rows[0].w;
+    });
+    float mul_err{};
+    for (size_t i = 0; i < cnt; i++) {
+      mul_err = std::max(mul_err, max_error(aff_out[i].to_mat4(), ref_mul[i]));
+    }
+
+    const double propagate = ns_per_op(cnt, reps, [&]() {
+      affine::propagate(aff_out.data(), aff_b.data(), nodes, parents);
+      g_sink = aff_out[cnt - 1].rows[0].w;
+    });
+    float propagate_err{};
+    for (size_t i = 0; i < cnt; i++) {
+      propagate_err =
+          std::max(propagate_err, max_error(aff_out[i].to_mat4(), ref_propagate[i]));
+    }
+
+    const double inverse = ns_per_op(cnt, reps, [&]() {
+      for (size_t i = 0; i < cnt; i++) {
+        aff_out[i] = affine::inverse(aff_a[i]);
+      }
+      g_sink = aff_out[cnt / 2].rows[0].w;
+    });
+    float inverse_err{};
+    for (size_t i = 0; i < cnt; i++) {
+      inverse_err = std::max(inverse_err, max_error((aff_a[i] * aff_out[i]).to_mat4(), mat4{1}));
+    }
+
+    const double aabb = ns_per_op(cnt, reps, [&]() {
+      for (size_t i = 0; i < cnt; i++) {
+        aabb_out[i] = affine::transform_aabb(aff_a[i], aabbs[i]);
+      }
+      g_sink = aabb_out[cnt / 2].min.x;
+    });
+    float aabb_err{};
+    for (size_t i = 0; i < cnt; i++) {
+      const AABB ref = transform_aabb_glm(mats_a[i], aabbs[i]);
+      aabb_err = std::max({aabb_err, glm::length(ref.min - aabb_out[i].min),
+                           glm::length(ref.max - aabb_out[i].max)});
+    }
+
+    auto report = [name](const char* kernel, double ns, double glm_ns, float err) {
+      LINFO("{:<22} {:>10.2f}  x{:.2f} vs glm, max err {:.2e}", std::string{name} + " " + kernel,
+            ns, glm_ns / ns, err);
+    };
+    report("mul", mul, glm_mul, mul_err);
+    report("propagate", propagate, glm_propagate, propagate_err);
+    report("inverse", inverse, glm_inverse, inverse_err);
+    report("transform_aabb", aabb, glm_aabb, aabb_err);
+  }
+  affine::set_isa(affine::detected_isa());
+  return 0;
+}
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+#include "util/IndexAllocator.hpp"
+#include "util/TLSFAllocator.hpp"
+
+// Replays the same randomized alloc/free trace against FreeListAllocator, FreeListAllocator2 and
+// TLSFAllocator, then checks the TLSF allocator for overlaps, leaks and coalescing.
+// usage: allocator_bench [ops] [target_live_allocs]
+
+namespace {
+
+constexpr u32 alignment = 64;
+
+struct Op {
+  bool alloc;
+  // size in bytes for allocs, index into the live slots for frees
+  u32 value;
+};
+
+std::vector<Op> make_trace(u32 op_cnt, u32 target_live, std::mt19937& rng) {
+  std::vector<Op> ops;
+  ops.reserve(op_cnt);
+  // mostly small allocations with a long tail, roughly what instance and draw data look like
+  std::geometric_distribution<u32> elements{.05};
+  u32 live{};
+  for (u32 i = 0; i < op_cnt; i++) {
+    // drift toward the target live count so the heap reaches a steady state
+    const double alloc_chance = live < target_live ? .75 : .25;
+    if (live == 0 || std::uniform_real_distribution<double>{}(rng) < alloc_chance) {
+      ops.emplace_back(Op{.alloc = true, .value = (1 + std::min(elements(rng), 1024u)) * alignment});
+      live++;
+    } else {
+      ops.emplace_back(Op{.alloc = false, .value = std::uniform_int_distribution<u32>{0, live - 1}(rng)});
+      live--;
+    }
+  }
+  return ops;
+}
+
+template <typename AllocatorT>
+typename AllocatorT::Slot allocate(AllocatorT& allocator, u32 size) {
+  return allocator.allocate(size);
+}
+
+// the free lists grow by exactly what's missing, so grow the TLSF allocator the same way
+util::TLSFAllocator::Slot allocate(util::TLSFAllocator& allocator, u32 size) {
+  return allocator.allocate(size, [](u32 required) { return required; });
+}
+
+template <typename AllocatorT>
+double replay(AllocatorT& allocator, std::span<const Op> ops,
+              std::vector<typename AllocatorT::Slot>& live) {
+  live.clear();
+  Timer timer;
+  for (const auto& op : ops) {
+    if (op.alloc) {
+      live.emplace_back(allocate(allocator, op.value));
+    } else {
+      allocator.free(live[op.value]);
+      live[op.value] = live.back();
+      live.pop_back();
+    }
+  }
+  return timer.elapsed_micro() * 1000. / static_cast<double>(ops.size());
+}
+
+bool check_live(const util::TLSFAllocator& allocator,
+                std::vector<util::TLSFAllocator::Slot> live) {
+  std::ranges::sort(live, {}, &util::TLSFAllocator::Slot::get_offset);
+  u32 used{};
+  for (size_t i = 0; i < live.size(); i++) {
+    used += live[i].get_size();
+    if (i > 0 && live[i - 1].get_off_plus_size() > live[i].get_offset()) {
+      LERROR("overlapping slots at {} and {}", live[i - 1].get_offset(), live[i].get_offset());
+      return false;
+    }
+    if (live[i].get_offset() % alignment != 0) {
+      LERROR("misaligned slot at {}", live[i].get_offset());
+      return false;
+    }
+  }
+  const auto stats = allocator.get_stats();
+  if (!live.empty() && live.back().get_off_plus_size() > stats.capacity) {
+    LERROR("slot past capacity {}", stats.capacity);
+    return false;
+  }
+  if (used != stats.used_bytes || stats.used_bytes + stats.free_bytes != stats.capacity) {
+    LERROR("used bytes mismatch: live {} allocator {}", used, stats.used_bytes);
+    return false;
+  }
+  return true;
+}
+
+bool check_fully_coalesced(const util::TLSFAllocator& allocator) {
+  const auto stats = allocator.get_stats();
+  if (stats.num_active_allocs != 0 || stats.free_block_cnt != 1 ||
+      stats.largest_free_block != stats.capacity) {
+    LERROR("free space didn't coalesce: {} free blocks, largest {} of {}", stats.free_block_cnt,
+           stats.largest_free_block, stats.capacity);
+    return false;
+  }
+  return true;
+}
+
+bool check_growth() {
+  util::TLSFAllocator allocator;
+  allocator.init(alignment * 4, alignment);
+  const auto kept = allocator.allocate(alignment);
+  if (allocator.allocate(alignment * 40).valid() || allocator.capacity() != alignment * 4) {
+    LERROR("allocate grew without a grow callback");
+    return false;
+  }
+  u32 requested{};
+  const auto slot = allocator.allocate(alignment * 40, [&](u32 required) {
+    requested = required;
+    return required;
+  });
+  if (!slot.valid() || !kept.valid() || allocator.capacity() != requested ||
+      slot.get_off_plus_size() > requested) {
+    LERROR("grow callback asked for {} bytes, capacity is {}", requested, allocator.capacity());
+    return false;
+  }
+  return true;
+}
+
+bool run_correctness(std::span<const Op> ops, u32 initial_capacity, std::mt19937& rng) {
+  if (!check_growth()) {
+    return false;
+  }
+  util::TLSFAllocator allocator;
+  allocator.init(initial_capacity, alignment);
+  std::vector<util::TLSFAllocator::Slot> live;
+  for (size_t i = 0; i < ops.size(); i++) {
+    const auto& op = ops[i];
+    if (op.alloc) {
+      live.emplace_back(allocate(allocator, op.value));
+    } else {
+      allocator.free(live[op.value]);
+      live[op.value] = live.back();
+      live.pop_back();
+    }
+    if (i % 1024 == 0 && !check_live(allocator, live)) {
+      return false;
+    }
+  }
+  if (!check_live(allocator, live)) {
+    return false;
+  }
+
+  // split allocations must free independently and still coalesce
+  std::vector<util::TLSFAllocator::Slot> pieces(16);
+  for (int i = 0; i < 64; i++) {
+    allocator.split(allocate(allocator, static_cast<u32>(pieces.size()) * alignment * 3), pieces);
+    live.insert(live.end(), pieces.begin(), pieces.end());
+  }
+  if (!check_live(allocator, live)) {
+    return false;
+  }
+
+  std::ranges::shuffle(live, rng);
+  for (auto& slot : live) {
+    allocator.free(slot);
+  }
+  live.clear();
+  return check_live(allocator, live) && check_fully_coalesced(allocator);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  u32 op_cnt = 50'000;
+  u32 target_live = 4'000;
+  if (argc > 1) {
+    op_cnt = std::max(std::atoi(argv[1]), 1);
+  }
+  if (argc > 2) {
+    target_live = std::max(std::atoi(argv[2]), 1);
+  }
+  std::mt19937 rng{42};
+  const auto ops = make_trace(op_cnt, target_live, rng);
+  // start small so every allocator has to grow
+  const u32 initial_capacity = alignment * 1024;
+
+  LINFO("ops: {}, target live allocs: {}", op_cnt, target_live);
+  LINFO("{:<20} {:>10} {:>14}", "allocator", "ns/op", "capacity KB");
+  {
+    util::FreeListAllocator allocator;
+    allocator.init(initial_capacity, alignment);
+    std::vector<util::FreeListAllocator::Slot> live;
+    const double ns = replay(allocator, ops, live);
+    LINFO("{:<20} {:>10.1f} {:>14}", "FreeListAllocator", ns, allocator.capacity() / 1024);
+  }
+  {
+    util::FreeListAllocator2 allocator;
+    allocator.init(initial_capacity, alignment);
+    std::vector<util::FreeListAllocator2::Slot> live;
+    const double ns = replay(allocator, ops, live);
+    LINFO("{:<20} {:>10.1f} {:>14}", "FreeListAllocator2", ns, allocator.capacity() / 1024);
+  }
+  {
+    util::TLSFAllocator allocator;
+    allocator.init(initial_capacity, alignment);
+    std::vector<util::TLSFAllocator::Slot> live;
+    const double ns = replay(allocator, ops, live);
+    const auto stats = allocator.get_stats();
+    LINFO("{:<20} {:>10.1f} {:>14}", "TLSFAllocator", ns, stats.capacity / 1024);
+    LINFO("tlsf: {} live allocs, {} free blocks, largest free {} KB, fragmentation {:.3f}",
+          stats.num_active_allocs, stats.free_block_cnt, stats.largest_free_block / 1024,
+          stats.fragmentation());
+  }
+
+  if (!run_correctness(ops, initial_capacity, rng)) {
+    LERROR("TLSFAllocator correctness check failed");
+    return 1;
+  }
+  LINFO("TLSFAllocator correctness check passed");
+  return 0;
+}
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "BenchCheck.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+#include "util/DefragPlanner.hpp"
+#include "util/TLSFAllocator.hpp"
+
+// Checks util::plan_defrag_moves on fixed layouts, then fragments a TLSFAllocator and compacts it
+// frame by frame the way VkRender2 does, copying bytes in a shadow buffer to catch clobbered data.
+// usage: defrag_bench [allocs] [budget_kb]
+
+namespace {
+
+constexpr u32 alignment = 16;
+// sources are reused this many frames after a move, like the renderer's frames in flight
+constexpr u32 retire_frames = 2;
+
+using bench::expect;
+
+bool run_fixed_cases() {
+  using util::DefragRange;
+  bool ok = true;
+  {
+    // the last range drops into the hole
+    const DefragRange ranges[] = {{0, 10, 0}, {30, 10, 1}};
+    const auto moves = util::plan_defrag_moves(ranges, 40, 1024);
+    ok &= expect(moves.size() == 1 && moves[0].id == 1 && moves[0].dst_offset == 10,
+                 "move into hole");
+  }
+  {
+    // pinned ranges stay, smaller ranges behind them still move
+    const DefragRange ranges[] = {{0, 10, 0}, {20, 10}, {40, 10, 2}};
+    const auto moves = util::plan_defrag_moves(ranges, 50, 1024);
+    ok &= expect(moves.size() == 1 && moves[0].id == 2 && moves[0].dst_offset == 10,
+                 "pinned range");
+  }
+  {
+    // too big for the hole, and the hole is above the other range
+    const DefragRange ranges[] = {{0, 10, 0}, {15, 10, 1}};
+    ok &= expect(util::plan_defrag_moves(ranges, 25, 1024).empty(), "no move that fits");
+  }
+  {
+    // budget stops after the first move, and a range larger than the budget stays put
+    const DefragRange ranges[] = {{0, 8, 0}, {40, 8, 1}, {48, 8, 2}, {56, 8, 3}};
+    ok &= expect(util::plan_defrag_moves(ranges, 64, 8).size() == 1, "budget");
+    ok &= expect(util::plan_defrag_moves(ranges, 64, 1).empty(), "range larger than budget");
+  }
+  {
+    // the large range at the top is skipped, the small one below it still fits the budget
+    const DefragRange ranges[] = {{0, 8, 0}, {40, 4, 1}, {44, 20, 2}};
+    const auto moves = util::plan_defrag_moves(ranges, 64, 8);
+    ok &= expect(moves.size() == 1 && moves[0].id == 1 && moves[0].dst_offset == 8,
+                 "progress under budget");
+  }
+  {
+    const DefragRange ranges[] = {{10, 10, 0}, {40, 5, 1}};
+    const auto stats = util::compute_defrag_stats(ranges, 50);
+    ok &= expect(stats.free_bytes == 35 && stats.largest_gap == 20 && stats.gap_cnt == 3 &&
+                     stats.used_extent == 45,
+                 "stats");
+  }
+  return ok;
+}
+
+struct Retired {
+  u32 frame;
+  util::TLSFAllocator::Slot slot;
+};
+
+struct Sim {
+  util::TLSFAllocator allocator;
+  std::vector<util::TLSFAllocator::Slot> live;
+  std::vector<Retired> retired;
+  // each live allocation is filled with its index so clobbered or misplaced bytes show up
+  std::vector<u8> shadow;
+
+  void fill(u32 id) {
+    const auto& slot = live[id];
+    std::memset(shadow.data() + slot.get_offset(), static_cast<int>(id % 251), slot.get_size());
+  }
+  [[nodiscard]] bool contents_ok() const {
+    for (u32 id = 0; id < live.size(); id++) {
+      const auto& slot = live[id];
+      if (!slot.valid()) continue;
+      for (u32 i = slot.get_offset(); i < slot.get_off_plus_size(); i++) {
+        if (shadow[i] != id % 251) {
+          LERROR("allocation {} clobbered at {}", id, i);
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+  [[nodiscard]] std::vector<util::DefragRange> ranges() const {
+    std::vector<util::DefragRange> result;
+    for (u32 id = 0; id < live.size(); id++) {
+      if (live[id].valid()) {
+        result.emplace_back(util::DefragRange{live[id].get_offset(), live[id].get_size(), id});
+      }
+    }
+    for (const auto& r : retired) {
+      result.emplace_back(util::DefragRange{r.slot.get_offset(), r.slot.get_size()});
+    }
+    return result;
+  }
+};
+
+void fragment(Sim& sim, u32 alloc_cnt, std::mt19937& rng) {
+  std::uniform_int_distribution<u32> size_dist{1, 64};
+  sim.allocator.init(alignment * 1024, alignment);
+  for (u32 i = 0; i < alloc_cnt; i++) {
+    sim.live.emplace_back(
+        sim.allocator.allocate(size_dist(rng) * alignment, [](u32 required) { return required; }));
+  }
+  sim.shadow.resize(sim.allocator.capacity());
+  for (u32 id = 0; id < sim.live.size(); id++) {
+    sim.fill(id);
+  }
+  // free a random half, leaving holes everywhere
+  for (auto& slot : sim.live) {
+    if (rng() % 2) {
+      sim.allocator.free(slot);
+      slot = {};
+    }
+  }
+}
+
+bool run_simulation(u32 alloc_cnt, u32 budget_bytes, std::mt19937& rng) {
+  Sim sim;
+  fragment(sim, alloc_cnt, rng);
+  const u32 capacity = sim.allocator.capacity();
+  const auto before = util::compute_defrag_stats(sim.ranges(), capacity);
+
+  Timer timer;
+  double plan_us{};
+  u32 frame{};
+  u32 move_cnt{};
+  u64 bytes_moved{};
+  for (;; frame++) {
+    std::erase_if(sim.retired, [&](const Retired& r) {
+      if (r.frame + retire_frames > frame) return false;
+      sim.allocator.free(r.slot);
+      return true;
+    });
+
+    const auto ranges = sim.ranges();
+    timer.reset();
+    const auto moves = util::plan_defrag_moves(ranges, capacity, budget_bytes);
+    plan_us += timer.elapsed_micro();
+    if (moves.empty() && sim.retired.empty()) break;
+
+    u32 frame_bytes{};
+    for (const auto& move : moves) {
+      frame_bytes += move.size;
+      if (!expect(move.dst_offset + move.size <= move.src_offset, "moves go down") ||
+          !expect(move.src_offset == sim.live[move.id].get_offset(), "move source")) {
+        return false;
+      }
+      auto new_slot = sim.allocator.allocate_at(move.dst_offset, move.size);
+      if (!expect(new_slot.valid() && new_slot.get_size() == move.size,
+                  "destination was free in the allocator")) {
+        return false;
+      }
+      std::memcpy(sim.shadow.data() + move.dst_offset, sim.shadow.data() + move.src_offset,
+                  move.size);
+      sim.retired.emplace_back(Retired{frame, sim.live[move.id]});
+      sim.live[move.id] = new_slot;
+    }
+    if (!expect(frame_bytes <= budget_bytes, "budget respected")) {
+      return false;
+    }
+    move_cnt += moves.size();
+    bytes_moved += frame_bytes;
+    // stale data at the retired sources must not have been needed
+    for (const auto& r : sim.retired) {
+      std::memset(sim.shadow.data() + r.slot.get_offset(), 0xff, r.slot.get_size());
+    }
+    if (!sim.contents_ok()) {
+      return false;
+    }
+  }
+
+  const auto after = util::compute_defrag_stats(sim.ranges(), capacity);
+  const auto alloc_stats = sim.allocator.get_stats();
+  LINFO("{} allocs: {} frames, {} moves, {} KB moved, {:.1f} us planning per frame", alloc_cnt,
+        frame, move_cnt, bytes_moved / 1024, plan_us / std::max(frame, 1u));
+  LINFO("  used extent {} KB -> {} KB, gaps {} -> {}, largest gap {} KB -> {} KB",
+        before.used_extent / 1024, after.used_extent / 1024, before.gap_cnt, after.gap_cnt,
+        before.largest_gap / 1024, after.largest_gap / 1024);
+  return expect(after.used_extent <= before.used_extent, "used extent shrank") &&
+         expect(after.free_bytes == alloc_stats.free_bytes, "allocator agrees on free bytes") &&
+         sim.contents_ok();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  u32 alloc_cnt = 20'000;
+  u32 budget_kb = 256;
+  if (argc > 1) {
+    alloc_cnt = std::max(std::atoi(argv[1]), 1);
+  }
+  if (argc > 2) {
+    budget_kb = std::max(std::atoi(argv[2]), 1);
+  }
+  std::mt19937 rng{7};
+  if (!run_fixed_cases()) {
+    return 1;
+  }
+  for (u32 cnt : {alloc_cnt / 10, alloc_cnt}) {
+    if (!run_simulation(std::max(cnt, 1u), budget_kb * 1024, rng)) {
+      LERROR("defrag simulation failed");
+      return 1;
+    }
+  }
+  LINFO("defrag checks passed");
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BenchCheck.hpp"
+#include "FrameProfiler.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+
+// Checks the Chrome trace JSON written for hand made frames and the FrameProfiler's frame
+// history, then times PROFILE_SCOPE, which every instrumented scope pays whether or not a trace
+// is ever dumped. Runs without a device, so only cpu scopes are recorded.
+// usage: frame_profiler_bench [scopes per frame]
+
+namespace {
+
+using gfx::FrameProfiler;
+using gfx::ProfiledFrame;
+using gfx::ProfiledScope;
+
+using bench::expect;
+
+size_t count(const std::string& str, std::string_view what) {
+  size_t cnt{};
+  for (size_t pos = str.find(what); pos != std::string::npos; pos = str.find(what, pos + 1)) {
+    cnt++;
+  }
+  return cnt;
+}
+
+bool run_checks() {
+  bool ok = true;
+  {
+    std::vector<ProfiledFrame> frames(2);
+    frames[0].frame_num = 7;
+    frames[0].cpu_scopes.emplace_back(ProfiledScope{"draw", 1'000, 5'500, 0});
+    frames[0].cpu_scopes.emplace_back(ProfiledScope{"say \"hi\"\\", 2'000, 3'000, 1});
+    frames[0].gpu_scopes.emplace_back(ProfiledScope{"gbuffer", 6'000, 8'250, 0});
+    frames[1].frame_num = 8;
+    frames[1].gpu_scopes.emplace_back(ProfiledScope{"ssao", 9'000, 9'500, 1});
+    std::ostringstream out;
+    gfx::write_chrome_trace(frames, out);
+    const std::string json = out.str();
+    ok &= expect(json.starts_with("{\"traceEvents\":[") && json.ends_with("]}\n"), "trace array");
+    ok &= expect(count(json, "{") == count(json, "}"), "balanced braces");
+    ok &= expect(count(json, R"("ph":"X")") == 4, "one event per scope");
+    ok &= expect(json.contains(R"("name":"say \"hi\"\\")"), "escaped names");
+    ok &= expect(json.contains(R"("name":"gbuffer","ph":"X","pid":1,"tid":0,"ts":6.000,)"
+                               R"("dur":2.250,"args":{"frame":7}})"),
+                 "gpu scope in microseconds");
+    ok &= expect(json.contains(R"("pid":1,"tid":1,"ts":9.000,"dur":0.500,"args":{"frame":8})"),
+                 "queue track");
+  }
+  {
+    FrameProfiler profiler;
+    ok &= expect(FrameProfiler::get() == &profiler, "active profiler");
+    // scopes outside a frame are dropped
+    profiler.add_cpu_scope("early", 0, 1);
+    for (u32 frame = 0; frame < FrameProfiler::max_frames + 10; frame++) {
+      profiler.begin_frame(frame, frame % gfx::frames_in_flight);
+      profiler.add_cpu_scope("scope", frame, frame + 1);
+      profiler.end_frame();
+    }
+    const auto history = profiler.get_history();
+    ok &= expect(history.size() == FrameProfiler::max_frames - 1, "history is a ring");
+    ok &= expect(history.back().frame_num == FrameProfiler::max_frames + 8 &&
+                     history.front().frame_num == 10,
+                 "history oldest first");
+    ok &= expect(std::ranges::all_of(history,
+                                     [](const ProfiledFrame& f) {
+                                       return f.cpu_scopes.size() == 1 &&
+                                              f.cpu_scopes[0].begin_ns == f.frame_num;
+                                     }),
+                 "scopes in their frame");
+    profiler.set_enabled(false);
+    ok &= expect(FrameProfiler::get() == nullptr, "disabled profiler");
+  }
+  ok &= expect(FrameProfiler::get() == nullptr, "destroyed profiler");
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  u32 scopes = 10'000;
+  if (argc > 1) scopes = std::max(std::atoi(argv[1]), 1);
+  if (!run_checks()) {
+    LERROR("frame profiler checks failed");
+    return 1;
+  }
+
+  FrameProfiler profiler;
+  LINFO("{:>10} {:>14}", "profiler", "ns per scope");
+  for (bool enabled : {false, true}) {
+    profiler.set_enabled(enabled);
+    double best_ns = 1e30;
+    for (u32 frame = 0; frame < 8; frame++) {
+      profiler.begin_frame(frame, frame % gfx::frames_in_flight);
+      Timer timer;
+      for (u32 i = 0; i < scopes; i++) {
+        PROFILE_SCOPE("bench scope");
+      }
+      best_ns = std::min(best_ns, timer.elapsed_micro() * 1000.0 / scopes);
+      profiler.end_frame();
+    }
+    LINFO("{:>10} {:>14.1f}", enabled ? "on" : "off", best_ns);
+  }
+  return 0;
+}
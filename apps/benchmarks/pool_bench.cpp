@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "BenchCheck.hpp"
+#include "Types.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+#include "vk2/Pool.hpp"
+
+// Measures Pool::get throughput with many reader threads against a copy of the old shared_mutex
+// pool, with and without a thread churning alloc/destroy, then checks concurrent alloc/destroy for
+// duplicate handles, lost objects and stale handles that still resolve.
+// usage: pool_bench [gets_per_thread] [max_threads]
+
+namespace {
+
+struct BenchObject {
+  u64 value{};
+};
+
+using BenchHandle = GenerationalHandle<BenchObject>;
+using LockFreePool = Pool<BenchHandle, BenchObject>;
+
+// the previous Pool: a vector of entries behind a shared_mutex
+struct LockedPool {
+  struct Entry {
+    BenchObject object;
+    u32 gen{1};
+  };
+
+  std::pair<u32, u32> alloc(u64 value) {
+    std::unique_lock lock(mtx);
+    u32 idx;
+    if (!free_list.empty()) {
+      idx = free_list.back();
+      free_list.pop_back();
+    } else {
+      idx = entries.size();
+      entries.emplace_back();
+    }
+    entries[idx].object.value = value;
+    return {idx, entries[idx].gen};
+  }
+
+  void destroy(u32 idx, u32 gen) {
+    std::unique_lock lock(mtx);
+    if (idx >= entries.size() || entries[idx].gen != gen) return;
+    entries[idx].gen++;
+    entries[idx].object = {};
+    free_list.emplace_back(idx);
+  }
+
+  BenchObject* get(u32 idx, u32 gen) {
+    std::shared_lock lock(mtx);
+    if (idx >= entries.size() || entries[idx].gen != gen) return nullptr;
+    return &entries[idx].object;
+  }
+
+  std::shared_mutex mtx;
+  std::vector<Entry> entries;
+  std::vector<u32> free_list;
+};
+
+constexpr u32 prefill_cnt = 4096;
+
+using bench::expect;
+
+// runs thread_cnt readers over random live handles, returns million gets per second
+template <typename GetFn, typename ChurnFn>
+double run_readers(u32 thread_cnt, u32 gets_per_thread, GetFn&& get, ChurnFn&& churn) {
+  std::atomic<bool> go{false};
+  std::atomic<bool> done{false};
+  std::atomic<u64> sink{};
+  std::vector<std::thread> threads;
+  threads.reserve(thread_cnt + 1);
+  for (u32 t = 0; t < thread_cnt; t++) {
+    threads.emplace_back([&, t] {
+      std::minstd_rand rng{t + 1};
+      u64 sum{};
+      while (!go.load(std::memory_order_acquire)) {
+      }
+      for (u32 i = 0; i < gets_per_thread; i++) {
+        sum += get(rng() % prefill_cnt);
+      }
+      sink.fetch_add(sum, std::memory_order_relaxed);
+    });
+  }
+  std::thread churn_thread{[&] {
+    while (!go.load(std::memory_order_acquire)) {
+    }
+    while (!done.load(std::memory_order_acquire)) {
+      churn();
+    }
+  }};
+  Timer timer;
+  go.store(true, std::memory_order_release);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const double seconds = timer.elapsed_seconds();
+  done.store(true, std::memory_order_release);
+  churn_thread.join();
+  return static_cast<double>(thread_cnt) * gets_per_thread / std::max(seconds, 1e-6) / 1e6;
+}
+
+void run_contention(u32 gets_per_thread, u32 max_threads) {
+  LockFreePool pool;
+  LockedPool locked;
+  std::vector<BenchHandle> handles;
+  std::vector<std::pair<u32, u32>> locked_handles;
+  for (u32 i = 0; i < prefill_cnt; i++) {
+    handles.emplace_back(pool.alloc(BenchObject{i}));
+    locked_handles.emplace_back(locked.alloc(i));
+  }
+  auto lock_free_get = [&](u32 i) { return pool.get(handles[i])->value; };
+  auto locked_get = [&](u32 i) {
+    return locked.get(locked_handles[i].first, locked_handles[i].second)->value;
+  };
+  // churn never touches the prefilled handles, only pushes the pools through alloc/destroy
+  auto lock_free_churn = [&] { pool.destroy(pool.alloc(BenchObject{1})); };
+  auto locked_churn = [&] {
+    const auto [idx, gen] = locked.alloc(1);
+    locked.destroy(idx, gen);
+  };
+  auto no_churn = [] { std::this_thread::yield(); };
+
+  LINFO("{:>8} {:>16} {:>16} {:>20} {:>20}", "threads", "locked Mget/s", "lock-free Mget/s",
+        "locked+churn Mget/s", "lock-free+churn Mget/s");
+  for (u32 threads = 1; threads <= max_threads; threads *= 2) {
+    const double locked_rate = run_readers(threads, gets_per_thread, locked_get, no_churn);
+    const double lock_free_rate = run_readers(threads, gets_per_thread, lock_free_get, no_churn);
+    const double locked_churn_rate =
+        run_readers(threads, gets_per_thread, locked_get, locked_churn);
+    const double lock_free_churn_rate =
+        run_readers(threads, gets_per_thread, lock_free_get, lock_free_churn);
+    LINFO("{:>8} {:>16.1f} {:>16.1f} {:>20.1f} {:>20.1f}", threads, locked_rate, lock_free_rate,
+          locked_churn_rate, lock_free_churn_rate);
+  }
+}
+
+bool run_correctness(u32 thread_cnt) {
+  constexpr u32 rounds = 200;
+  constexpr u32 allocs_per_round = 64;
+  LockFreePool pool;
+  std::atomic<bool> ok{true};
+  std::vector<std::vector<BenchHandle>> kept(thread_cnt);
+  std::vector<std::thread> threads;
+  for (u32 t = 0; t < thread_cnt; t++) {
+    threads.emplace_back([&, t] {
+      std::minstd_rand rng{t + 100};
+      std::vector<BenchHandle> live;
+      std::vector<BenchHandle> stale;
+      for (u32 round = 0; round < rounds; round++) {
+        for (u32 i = 0; i < allocs_per_round; i++) {
+          const u64 value = (u64{t} << 32) | ((round * allocs_per_round) + i);
+          live.emplace_back(pool.alloc(BenchObject{value}));
+        }
+        // another thread handing out the same entry would have overwritten the value
+        for (const auto& handle : live) {
+          const auto* object = pool.get(handle);
+          if (!object || (object->value >> 32) != t) {
+            ok = false;
+            return;
+          }
+        }
+        std::ranges::shuffle(live, rng);
+        const size_t keep = live.size() / 2;
+        for (size_t i = keep; i < live.size(); i++) {
+          pool.destroy(live[i]);
+          // a second destroy of the same handle must do nothing
+          pool.destroy(live[i]);
+          stale.emplace_back(live[i]);
+        }
+        live.resize(keep);
+        for (const auto& handle : stale) {
+          if (pool.get(handle)) {
+            ok = false;
+            return;
+          }
+        }
+        stale.clear();
+      }
+      kept[t] = std::move(live);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (!expect(ok, "concurrent alloc/destroy")) {
+    return false;
+  }
+
+  size_t kept_cnt{};
+  std::vector<u32> indices;
+  for (const auto& handles : kept) {
+    kept_cnt += handles.size();
+    for (const auto& handle : handles) {
+      indices.emplace_back(handle.get_idx());
+    }
+  }
+  std::ranges::sort(indices);
+  bool result = expect(std::ranges::adjacent_find(indices) == indices.end(), "unique indices");
+  result &= expect(pool.size() == kept_cnt, "size matches live handles");
+  result &= expect(pool.get_num_created() - pool.get_num_destroyed() == kept_cnt,
+                   "created minus destroyed");
+
+  size_t iterated{};
+  for ([[maybe_unused]] auto& entry : pool.get_entries()) {
+    iterated++;
+  }
+  result &= expect(iterated == kept_cnt, "get_entries visits exactly the live entries");
+
+  // destroying the last entry must not hide earlier live ones from iteration
+  LockFreePool small;
+  const auto a = small.alloc(BenchObject{1});
+  const auto b = small.alloc(BenchObject{2});
+  small.destroy(a);
+  iterated = 0;
+  for (auto& entry : small.get_entries()) {
+    iterated++;
+    result &= expect(entry.object.value == 2, "remaining entry");
+  }
+  result &= expect(iterated == 1, "liveness after destroy");
+  small.destroy(b);
+  result &= expect(small.empty() && small.get_entries().begin() == small.get_entries().end(),
+                   "empty after destroying all");
+  const auto c = small.alloc(BenchObject{3});
+  result &= expect(small.get(a) == nullptr && small.get(c)->value == 3, "reuse bumps generation");
+
+  // pointers must survive the pool growing into new chunks
+  const auto* first = small.get(c);
+  std::vector<BenchHandle> grow;
+  for (u32 i = 0; i < 10'000; i++) {
+    grow.emplace_back(small.alloc(BenchObject{i}));
+  }
+  result &= expect(small.get(c) == first, "stable pointers");
+  small.clear();
+  result &= expect(small.empty() && small.get(c) == nullptr, "clear");
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  u32 gets_per_thread = 2'000'000;
+  u32 max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  if (argc > 1) {
+    gets_per_thread = std::max(std::atoi(argv[1]), 1);
+  }
+  if (argc > 2) {
+    max_threads = std::max(std::atoi(argv[2]), 1);
+  }
+  run_contention(gets_per_thread, max_threads);
+  if (!run_correctness(std::clamp(max_threads, 2u, 8u))) {
+    LERROR("pool correctness check failed");
+    return 1;
+  }
+  LINFO("pool correctness check passed");
+  return 0;
+}
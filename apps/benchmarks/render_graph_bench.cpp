@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BenchCheck.hpp"
+#include "RenderGraph.hpp"
+#include "RenderGraphCompiler.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+
+// Checks RenderGraphCompiler on small graphs with known answers, then declares and bakes
+// synthetic render graphs of 50, 500 and 5000 passes against a resource provider that needs no
+// device, checks the pass order against the declared reads and writes, and times declaration
+// and bake with the compile cache off and on. The compiler checks include queue assignment, the
+// cross queue waits of async compute passes and split barrier placement.
+// usage: render_graph_bench [iterations]
+
+namespace {
+
+using gfx::RGCompileInput;
+using gfx::RGCompileResult;
+using gfx::RGPassUsage;
+
+using bench::expect;
+
+struct MockResourceProvider final : gfx::RGResourceProvider {
+  [[nodiscard]] gfx::AttachmentInfo get_swapchain_info() const override {
+    return {.size_class = gfx::SizeClass::Absolute, .dims = {1920, 1080, 1}};
+  }
+  [[nodiscard]] u64 get_buffer_size(gfx::BufferHandle) const override { return 1024; }
+  [[nodiscard]] bool has_image(gfx::ImageHandle) const override { return true; }
+  [[nodiscard]] bool has_queue(gfx::QueueType) const override { return true; }
+};
+
+// passes given as lists of usages, in declaration order
+struct TestGraph {
+  std::vector<u32> usage_starts{0};
+  std::vector<RGPassUsage> usages;
+  std::vector<u8> queues;
+  u32 split_distance{};
+  void add_pass(std::initializer_list<RGPassUsage> pass_usages, u8 queue = 0) {
+    usages.insert(usages.end(), pass_usages);
+    usage_starts.emplace_back(usages.size());
+    queues.emplace_back(queue);
+  }
+  gfx::VoidResult compile(gfx::RenderGraphCompiler& compiler, u32 resource_cnt, u32 sink,
+                          RGCompileResult& result) const {
+    return compiler.compile(RGCompileInput{.resource_cnt = resource_cnt,
+                                           .usage_starts = usage_starts,
+                                           .usages = usages,
+                                           .sink_resource = sink,
+                                           .pass_queues = queues,
+                                           .min_split_distance = split_distance},
+                            result);
+  }
+};
+
+constexpr RGPassUsage read(u32 resource) { return {.resource = resource, .read = true}; }
+constexpr RGPassUsage write(u32 resource) { return {.resource = resource, .write = true}; }
+
+bool run_compiler_checks() {
+  bool ok = true;
+  gfx::RenderGraphCompiler compiler;
+  RGCompileResult result;
+  {
+    // independent passes keep declaration order, the unused one is culled
+    TestGraph graph;
+    graph.add_pass({write(0)});
+    graph.add_pass({write(1)});
+    graph.add_pass({write(4)});
+    graph.add_pass({write(2)});
+    graph.add_pass({read(2), read(1), read(0), write(3)});
+    ok &= expect(graph.compile(compiler, 5, 3, result).has_value(), "compiles");
+    ok &= expect(result.pass_order == std::vector<u32>{0, 1, 3, 4}, "declaration order");
+    ok &= expect(result.sink_pass == 4 && result.physical_cnt == 4 &&
+                     result.physical_indices[4] == RGCompileResult::unused &&
+                     result.physical_indices[0] == 0 && result.physical_indices[3] == 3,
+                 "physical indices in first use order");
+  }
+  {
+    // a read-modify-write pass depends on the other writers but not itself
+    TestGraph graph;
+    graph.add_pass({write(0)});
+    graph.add_pass({read(0), write(0)});
+    graph.add_pass({read(0), write(1)});
+    ok &= expect(graph.compile(compiler, 2, 1, result).has_value(), "compiles");
+    ok &= expect(result.pass_order == std::vector<u32>{0, 1, 2}, "read modify write");
+  }
+  {
+    TestGraph graph;
+    graph.add_pass({read(1), write(0)});
+    graph.add_pass({read(0), write(1)});
+    graph.add_pass({read(1), write(2)});
+    const auto res = graph.compile(compiler, 3, 2, result);
+    ok &= expect(!res && std::string(res.error()) == "cycle detected", "cycle");
+  }
+  {
+    TestGraph graph;
+    graph.add_pass({read(0), write(1)});
+    const auto res = graph.compile(compiler, 2, 1, result);
+    ok &= expect(!res && std::string(res.error()) == "no pass exists which writes to resource",
+                 "missing writer");
+  }
+  {
+    TestGraph graph;
+    graph.add_pass({write(0)});
+    ok &= expect(!graph.compile(compiler, 2, 1, result), "no sink writer");
+  }
+  using Waits = std::vector<gfx::RGQueueWait>;
+  {
+    // skinning and culling on queue 1 overlap the shadow pass, gbuffer waits for both through
+    // one wait, ssao overlaps the sky
+    TestGraph graph;
+    graph.add_pass({write(0)}, 1);           // 0 skinning
+    graph.add_pass({write(1)}, 1);           // 1 cull
+    graph.add_pass({write(2)});              // 2 shadow
+    graph.add_pass({read(0), read(1), write(3)});  // 3 gbuffer
+    graph.add_pass({read(3), write(4)}, 1);  // 4 ssao
+    graph.add_pass({write(5)});              // 5 sky
+    graph.add_pass({read(2), read(4), read(5), write(6)});  // 6 shade
+    ok &= expect(graph.compile(compiler, 7, 6, result).has_value(), "compiles");
+    ok &= expect(result.pass_order == std::vector<u32>{0, 1, 2, 3, 4, 5, 6}, "async order");
+    ok &= expect(result.queues == std::vector<u8>{1, 1, 0, 0, 1, 0, 0}, "queues");
+    ok &= expect(result.queue_waits == Waits{{3, 1}, {4, 3}, {6, 4}}, "async waits");
+  }
+  {
+    // the first pass using the sink joins the other queues and everything after stays on 0
+    TestGraph graph;
+    graph.add_pass({write(0)}, 1);
+    graph.add_pass({write(1)}, 1);
+    graph.add_pass({read(0), read(1), write(2)});
+    graph.add_pass({read(2), write(2)}, 1);
+    ok &= expect(graph.compile(compiler, 3, 2, result).has_value(), "compiles");
+    ok &= expect(result.queues == std::vector<u8>{1, 1, 0, 0}, "sink passes on queue 0");
+    ok &= expect(result.queue_waits == Waits{{2, 1}}, "join waits for the last pass");
+  }
+  {
+    // reading after another queue's read waits too, the barrier may change the layout
+    TestGraph graph;
+    graph.add_pass({write(0)});
+    graph.add_pass({read(0), write(1)}, 1);
+    graph.add_pass({read(0), write(2)});
+    graph.add_pass({read(1), read(2), write(3)});
+    ok &= expect(graph.compile(compiler, 4, 3, result).has_value(), "compiles");
+    ok &= expect(result.queue_waits == Waits{{1, 0}, {2, 1}}, "read after read waits");
+    // without queues everything runs on 0
+    graph.queues.clear();
+    ok &= expect(graph.compile(compiler, 4, 3, result).has_value(), "compiles");
+    ok &= expect(result.queues == std::vector<u8>(4, 0) && result.queue_waits.empty(),
+                 "single queue");
+  }
+  using Events = std::vector<gfx::RGSplitEvent>;
+  using SplitBarriers = std::vector<gfx::RGSplitBarrier>;
+  {
+    // writes at least two passes back are split, events are set in src order
+    TestGraph graph;
+    graph.split_distance = 2;
+    graph.add_pass({write(0)});
+    graph.add_pass({write(1)});
+    graph.add_pass({write(2)});
+    graph.add_pass({read(1), write(3)});
+    graph.add_pass({read(0), read(2), read(3), write(4)});
+    ok &= expect(graph.compile(compiler, 5, 4, result).has_value(), "compiles");
+    ok &= expect(result.split_events == Events{{1, 3}, {0, 4}, {2, 4}}, "split events");
+    ok &= expect(result.split_event_set_order == std::vector<u32>{1, 0, 2}, "event set order");
+    ok &= expect(result.split_barriers == SplitBarriers{{1, 0}, {0, 1}, {2, 2}}, "split barriers");
+    graph.split_distance = 0;
+    ok &= expect(graph.compile(compiler, 5, 4, result).has_value(), "compiles");
+    ok &= expect(result.split_events.empty() && result.split_barriers.empty(), "no splits");
+  }
+  {
+    // barriers on writes from the same pass share an event, a use in between or a write on
+    // another queue keeps the full barrier
+    TestGraph graph;
+    graph.split_distance = 2;
+    graph.add_pass({write(0), write(1), write(6)});
+    graph.add_pass({write(2)}, 1);
+    graph.add_pass({read(1), write(3)});
+    graph.add_pass({write(4)});
+    graph.add_pass({read(0), read(1), read(2), read(3), read(4), read(6), write(5)});
+    ok &= expect(graph.compile(compiler, 7, 5, result).has_value(), "compiles");
+    ok &= expect(result.split_events == Events{{0, 2}, {0, 4}, {2, 4}}, "shared events");
+    ok &= expect(result.split_barriers == SplitBarriers{{1, 0}, {0, 1}, {4, 2}, {2, 1}},
+                 "splits skip other uses and queues");
+  }
+  return ok;
+}
+
+struct SyntheticPass {
+  std::vector<u32> reads;
+  bool reads_buffer;
+};
+
+// a frame shaped like a deferred renderer repeated: each pass writes its own attachment and reads
+// a few recent ones, some also read a storage buffer the first pass fills. The last pass writes the
+// backbuffer.
+std::vector<SyntheticPass> make_synthetic_passes(u32 pass_cnt) {
+  std::mt19937 rng{pass_cnt};
+  std::vector<SyntheticPass> passes(pass_cnt);
+  for (u32 i = 1; i < pass_cnt; i++) {
+    const u32 read_cnt = 1 + (rng() % 3);
+    for (u32 r = 0; r < read_cnt; r++) {
+      const u32 back = 1 + (rng() % std::min(i, 16u));
+      passes[i].reads.emplace_back(i - back);
+    }
+    passes[i].reads_buffer = rng() % 8 == 0;
+  }
+  // the backbuffer pass reads every attachment nobody else reads, so nothing is culled
+  std::vector<bool> read(pass_cnt);
+  for (const auto& pass : passes) {
+    for (u32 r : pass.reads) read[r] = true;
+  }
+  for (u32 i = 0; i + 1 < pass_cnt; i++) {
+    if (!read[i]) passes.back().reads.emplace_back(i);
+  }
+  return passes;
+}
+
+void declare(gfx::RenderGraph& rg, std::span<const SyntheticPass> passes,
+             const std::vector<std::string>& names, gfx::BufferHandle buffer) {
+  const gfx::AttachmentInfo info{.format = gfx::Format::R8G8B8A8Unorm};
+  rg.set_backbuffer_img("final");
+  for (u32 i = 0; i < passes.size(); i++) {
+    auto& pass = rg.add_pass(names[i]);
+    for (u32 r : passes[i].reads) {
+      pass.add(names[r], info, gfx::Access::FragmentRead);
+    }
+    if (i == 0) {
+      pass.add(buffer, gfx::Access::ComputeWrite);
+    } else if (passes[i].reads_buffer) {
+      pass.add(buffer, gfx::Access::ComputeRead);
+    }
+    pass.add(i + 1 == passes.size() ? "final" : names[i], info, gfx::Access::ColorWrite);
+  }
+}
+
+// every pass runs once, after every other pass writing something it reads
+bool order_respects_dependencies(std::span<const u32> order,
+                                 std::span<const SyntheticPass> passes) {
+  std::vector<u32> position(passes.size(), UINT32_MAX);
+  for (u32 i = 0; i < order.size(); i++) {
+    if (position[order[i]] != UINT32_MAX) return false;
+    position[order[i]] = i;
+  }
+  for (u32 i = 0; i < passes.size(); i++) {
+    if (position[i] == UINT32_MAX) return false;
+    for (u32 r : passes[i].reads) {
+      if (position[r] >= position[i]) return false;
+    }
+    if (passes[i].reads_buffer && position[0] >= position[i]) return false;
+  }
+  return true;
+}
+
+// each split event waits at least the default distance back, for a pass in the pass order
+bool splits_are_placed(const gfx::RenderGraph& rg) {
+  const auto events = rg.get_split_events();
+  for (const auto& event : events) {
+    if (event.dst_pos >= rg.get_pass_order().size() || event.dst_pos < event.src_pos + 2) {
+      return false;
+    }
+  }
+  for (const auto& barrier : rg.get_split_barriers()) {
+    if (barrier.event >= events.size()) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  u32 iterations = 20;
+  if (argc > 1) iterations = std::max(std::atoi(argv[1]), 1);
+  if (!run_compiler_checks()) {
+    LERROR("render graph compiler checks failed");
+    return 1;
+  }
+
+  MockResourceProvider provider;
+  const gfx::BufferHandle buffer{1, 1};
+  bool ok = true;
+  LINFO("{:>6} {:>12} {:>12} {:>12}", "passes", "declare ms", "bake ms", "cached ms");
+  for (u32 pass_cnt : {50u, 500u, 5000u}) {
+    const auto passes = make_synthetic_passes(pass_cnt);
+    std::vector<std::string> names;
+    for (u32 i = 0; i < pass_cnt; i++) {
+      names.emplace_back(std::format("pass{}", i));
+    }
+    double declare_ms{};
+    double bake_ms[2]{};
+    for (bool cache : {false, true}) {
+      gfx::RenderGraph rg{"bench", &provider};
+      rg.set_compile_cache_enabled(cache);
+      // the first cached bake compiles, the rest are hits
+      for (u32 i = 0; i < iterations + cache; i++) {
+        rg.reset();
+        Timer timer;
+        declare(rg, passes, names, buffer);
+        const double ms = timer.elapsed_ms();
+        if (auto res = rg.bake(); !res) {
+          LERROR("bake failed: {}", res.error());
+          return 1;
+        }
+        if (cache && i == 0) continue;
+        declare_ms += ms;
+        bake_ms[cache] += rg.get_bake_stats().bake_ms;
+        ok &= expect(rg.get_bake_stats().cache_hit == cache, "cache hit when enabled");
+      }
+      ok &= expect(order_respects_dependencies(rg.get_pass_order(), passes),
+                   "pass order respects dependencies");
+      ok &= expect(splits_are_placed(rg), "split barriers are placed");
+    }
+    LINFO("{:>6} {:>12.3f} {:>12.3f} {:>12.3f}", pass_cnt, declare_ms / (iterations * 2.0),
+          bake_ms[0] / iterations, bake_ms[1] / iterations);
+  }
+  if (!ok) {
+    LERROR("render graph checks failed");
+    return 1;
+  }
+  LINFO("render graph checks passed");
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "BenchCheck.hpp"
+#include "TextureCache.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+
+// Round trips BC mip chains through the TextureCache and checks keys, misses and damaged files,
+// then times storing and loading a cached chain into a staging buffer. Cpu only.
+// usage: texture_cache_bench [extent] [iterations]
+
+using namespace gfx;
+
+namespace {
+
+using bench::expect;
+
+// bytes per 4x4 block: 16 for BC7 and BC5, 8 for BC4
+std::vector<std::vector<std::byte>> make_mip_chain(u32 extent, u32 block_bytes, u32 seed) {
+  std::mt19937 rng{seed};
+  std::vector<std::vector<std::byte>> levels;
+  for (u32 dim = extent;; dim = std::max(dim / 2, 1u)) {
+    const u32 blocks = (dim + 3) / 4;
+    auto& level = levels.emplace_back(static_cast<size_t>(blocks) * blocks * block_bytes);
+    for (auto& b : level) {
+      b = static_cast<std::byte>(rng());
+    }
+    if (dim == 1) break;
+  }
+  return levels;
+}
+
+std::vector<std::span<const std::byte>> as_spans(
+    const std::vector<std::vector<std::byte>>& levels) {
+  return {levels.begin(), levels.end()};
+}
+
+bool levels_equal(const TranscodedTexture& texture,
+                  const std::vector<std::vector<std::byte>>& levels) {
+  return std::ranges::equal(texture.levels, levels, [](auto a, const auto& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+  });
+}
+
+bool run_checks(const std::filesystem::path& dir) {
+  const TextureCache cache{dir};
+  bool result = true;
+  std::vector<std::byte> source(1000);
+  for (size_t i = 0; i < source.size(); i++) {
+    source[i] = static_cast<std::byte>(i * 7);
+  }
+  const u64 key = get_texture_cache_key(source, Format::Bc7SrgbBlock, 1);
+  result &= expect(key == get_texture_cache_key(source, Format::Bc7SrgbBlock, 1), "stable key");
+  result &= expect(key != get_texture_cache_key(source, Format::Bc7UnormBlock, 1),
+                   "format changes key");
+  result &= expect(key != get_texture_cache_key(source, Format::Bc7SrgbBlock, 0),
+                   "quality changes key");
+  source[500] ^= std::byte{1};
+  result &= expect(key != get_texture_cache_key(source, Format::Bc7SrgbBlock, 1),
+                   "content changes key");
+
+  result &= expect(!cache.load(key), "miss before store");
+  for (u32 block_bytes : {16u, 8u}) {
+    const auto levels = make_mip_chain(100, block_bytes, block_bytes);
+    const u64 k = key + block_bytes;
+    result &=
+        expect(cache.store(k, Format::Bc5UnormBlock, {100, 100}, as_spans(levels)), "store");
+    const auto loaded = cache.load(k);
+    result &= expect(loaded && loaded->format == Format::Bc5UnormBlock &&
+                         loaded->extent == uvec2{100, 100} && levels_equal(*loaded, levels),
+                     "round trip");
+    if (loaded) {
+      for (const auto& level : loaded->levels) {
+        result &= expect(reinterpret_cast<uintptr_t>(level.data()) % 16 == 0, "aligned levels");
+      }
+    }
+  }
+
+  // a file under the wrong name or cut short must miss rather than hand out garbage
+  const auto levels = make_mip_chain(64, 16, 3);
+  result &= expect(cache.store(key, Format::Bc7SrgbBlock, {64, 64}, as_spans(levels)), "store");
+  std::filesystem::copy_file(cache.get_path(key), cache.get_path(key + 1),
+                             std::filesystem::copy_options::overwrite_existing);
+  result &= expect(!cache.load(key + 1), "key mismatch");
+  const auto path = cache.get_path(key);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  result &= expect(!cache.load(key), "truncated file");
+  return result;
+}
+
+void run_bench(const std::filesystem::path& dir, u32 extent, u32 iterations) {
+  const TextureCache cache{dir};
+  const auto levels = make_mip_chain(extent, 16, 1);
+  size_t total_bytes{};
+  for (const auto& level : levels) {
+    total_bytes += level.size();
+  }
+  std::vector<std::byte> staging(total_bytes);
+  double store_ms{};
+  double load_ms{};
+  for (u32 i = 0; i < iterations; i++) {
+    Timer timer;
+    cache.store(i, Format::Bc7UnormBlock, {extent, extent}, as_spans(levels));
+    store_ms += timer.elapsed_ms();
+    timer.reset();
+    // what create_textures does with a hit: map, then copy every level into staging
+    const auto loaded = cache.load(i);
+    size_t offset{};
+    for (const auto& level : loaded->levels) {
+      std::memcpy(staging.data() + offset, level.data(), level.size());
+      offset += level.size();
+    }
+    load_ms += timer.elapsed_ms();
+  }
+  const double mb = static_cast<double>(total_bytes) / (1024.0 * 1024.0);
+  LINFO("{}x{} BC7 chain, {} levels, {:.1f} MB", extent, extent, levels.size(), mb);
+  LINFO("store: {:.2f} ms, load to staging: {:.2f} ms ({:.0f} MB/s)", store_ms / iterations,
+        load_ms / iterations, mb / std::max(load_ms / iterations / 1000.0, 1e-9));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  u32 extent = 4096;
+  u32 iterations = 8;
+  if (argc > 1) {
+    extent = std::max(std::atoi(argv[1]), 4);
+  }
+  if (argc > 2) {
+    iterations = std::max(std::atoi(argv[2]), 1);
+  }
+  const auto dir = std::filesystem::temp_directory_path() / "texture_cache_bench";
+  std::filesystem::remove_all(dir);
+  const bool ok = run_checks(dir);
+  if (ok) {
+    run_bench(dir, extent, iterations);
+  }
+  std::filesystem::remove_all(dir);
+  if (!ok) {
+    LERROR("texture cache checks failed");
+    return 1;
+  }
+  LINFO("texture cache checks passed");
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Scene.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+
+// Compares serial recalc_global_transforms against recalc_global_transforms_parallel.
+// usage: transform_bench [iterations]
+
+using namespace gfx;
+
+namespace {
+
+// builds a tree breadth first where every node gets up to `fanout` children
+void build_scene(Scene2& scene, u32 node_cnt, u32 fanout, std::mt19937& rng) {
+  std::uniform_real_distribution<float> dist{-1.f, 1.f};
+  auto shared = std::make_shared<SceneTemplate>();
+  auto& hierarchies = shared->hierarchies;
+  hierarchies.resize(node_cnt);
+  scene.local_transforms.resize(node_cnt);
+  scene.global_transforms.resize(node_cnt);
+  for (u32 i = 0; i < node_cnt; i++) {
+    auto& h = hierarchies[i];
+    if (i > 0) {
+      const auto parent = static_cast<i32>((i - 1) / fanout);
+      auto& ph = hierarchies[parent];
+      h.parent = parent;
+      h.level = ph.level + 1;
+      if (ph.first_child == -1) {
+        ph.first_child = static_cast<i32>(i);
+      } else {
+        // breadth first, so the previous node is the previous sibling
+        hierarchies[i - 1].next_sibling = static_cast<i32>(i);
+      }
+    }
+    const vec3 t{dist(rng), dist(rng), dist(rng)};
+    const quat r = glm::angleAxis(dist(rng) * 3.14f, glm::normalize(vec3{dist(rng), 1.f, .5f}));
+    scene.local_transforms[i] = Affine{glm::translate(mat4{1}, t) * glm::mat4_cast(r) *
+                                       glm::scale(mat4{1}, vec3{1.f + (.1f * dist(rng))})};
+  }
+  build_level_ranges(*shared);
+  scene.shared = std::move(shared);
+  reset_dirty_state(scene);
+}
+
+struct BenchScenes {
+  std::vector<Scene2> scenes;
+  std::vector<Scene2*> scene_ptrs;
+};
+
+BenchScenes make_scenes(u32 total_nodes, u32 scene_cnt) {
+  BenchScenes result;
+  result.scenes.resize(scene_cnt);
+  std::mt19937 rng{1234};
+  for (auto& scene : result.scenes) {
+    build_scene(scene, total_nodes / scene_cnt, 8, rng);
+    result.scene_ptrs.emplace_back(&scene);
+  }
+  return result;
+}
+
+void mark_all(BenchScenes& scenes) {
+  for (auto& scene : scenes.scenes) {
+    mark_changed(scene, 0);
+  }
+}
+
+struct Result {
+  double serial_ms;
+  double parallel_ms;
+  bool identical;
+};
+
+Result run(u32 total_nodes, u32 scene_cnt, int iterations) {
+  BenchScenes serial = make_scenes(total_nodes, scene_cnt);
+  BenchScenes parallel = make_scenes(total_nodes, scene_cnt);
+  Timer timer;
+  double serial_us{}, parallel_us{};
+  for (int it = 0; it < iterations; it++) {
+    mark_all(serial);
+    timer.reset();
+    for (auto& scene : serial.scenes) {
+      recalc_global_transforms(scene);
+    }
+    serial_us += timer.elapsed_micro();
+
+    mark_all(parallel);
+    timer.reset();
+    recalc_global_transforms_parallel(parallel.scene_ptrs);
+    parallel_us += timer.elapsed_micro();
+  }
+
+  bool identical = true;
+  for (u32 i = 0; i < scene_cnt && identical; i++) {
+    const auto& a = serial.scenes[i].global_transforms;
+    const auto& b = parallel.scenes[i].global_transforms;
+    identical = a.size() == b.size() &&
+                std::memcmp(a.data(), b.data(), a.size() * sizeof(Affine)) == 0;
+  }
+  return {.serial_ms = serial_us * .001 / iterations,
+          .parallel_ms = parallel_us * .001 / iterations,
+          .identical = identical};
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int iterations = 20;
+  if (argc > 1) {
+    iterations = std::max(std::atoi(argv[1]), 1);
+  }
+  bool all_identical = true;
+  LINFO("{:>9} {:>7} {:>11} {:>13} {:>8} {:>10}", "nodes", "scenes", "serial ms", "parallel ms",
+        "speedup", "identical");
+  for (u32 node_cnt : {10'000u, 100'000u, 1'000'000u}) {
+    for (u32 scene_cnt : {1u, 64u}) {
+      const Result r = run(node_cnt, scene_cnt, iterations);
+      all_identical &= r.identical;
+      LINFO("{:>9} {:>7} {:>11.3f} {:>13.3f} {:>8.2f} {:>10}", node_cnt, scene_cnt, r.serial_ms,
+            r.parallel_ms, r.serial_ms / r.parallel_ms, r.identical);
+    }
+  }
+  if (!all_identical) {
+    LERROR("parallel results differ from serial");
+    return 1;
+  }
+  return 0;
+}
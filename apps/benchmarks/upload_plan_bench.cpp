@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "BenchCheck.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+#include "util/UploadPlanner.hpp"
+
+// Checks util::plan_uploads against applying the copies one by one, including overlapping copies
+// that must land in order, then times planning a frame of dirty transforms the way UploadRing
+// does and compares command and barrier counts against one copy and barrier per buffer per copy.
+// usage: upload_plan_bench [copies] [iterations]
+
+namespace {
+
+constexpr u64 object_data_size = 96;
+
+using bench::expect;
+
+using Buffers = std::vector<std::vector<std::byte>>;
+
+void apply_in_order(std::span<const util::UploadCopy> copies, const std::vector<std::byte>& staging,
+                    Buffers& buffers) {
+  for (const auto& copy : copies) {
+    std::memcpy(buffers[copy.dst].data() + copy.dst_offset, staging.data() + copy.src_offset,
+                copy.size);
+  }
+}
+
+// replays a plan the way UploadRing::record does, generation by generation
+void apply_plan(const util::UploadPlan& plan, const std::vector<std::byte>& staging,
+                Buffers& buffers) {
+  for (const auto& batch : plan.batches) {
+    for (u32 i = batch.first_region; i < batch.first_region + batch.region_cnt; i++) {
+      const auto& region = plan.regions[i];
+      std::memcpy(buffers[batch.dst].data() + region.dst_offset,
+                  staging.data() + region.src_offset, region.size);
+    }
+  }
+}
+
+bool plan_matches(std::span<const util::UploadCopy> copies, const std::vector<std::byte>& staging,
+                  u32 buffer_cnt, u64 buffer_size) {
+  Buffers expected(buffer_cnt, std::vector<std::byte>(buffer_size));
+  Buffers actual = expected;
+  apply_in_order(copies, staging, expected);
+  const auto plan = util::plan_uploads(copies);
+  apply_plan(plan, staging, actual);
+  bool ok = expect(expected == actual, "plan writes what the copies write");
+
+  // batches in one generation must not overlap, or their order on the gpu is undefined
+  for (size_t g = 0; g < plan.generation_starts.size(); g++) {
+    const u32 end = g + 1 < plan.generation_starts.size() ? plan.generation_starts[g + 1]
+                                                          : plan.batches.size();
+    std::vector<std::pair<u64, u64>> written[8];
+    for (u32 b = plan.generation_starts[g]; b < end; b++) {
+      const auto& batch = plan.batches[b];
+      for (u32 i = batch.first_region; i < batch.first_region + batch.region_cnt; i++) {
+        written[batch.dst].emplace_back(plan.regions[i].dst_offset,
+                                        plan.regions[i].dst_offset + plan.regions[i].size);
+      }
+    }
+    for (auto& ranges : written) {
+      std::ranges::sort(ranges);
+      for (size_t i = 1; i < ranges.size(); i++) {
+        ok &= expect(ranges[i].first >= ranges[i - 1].second, "disjoint within a generation");
+      }
+    }
+  }
+
+  // barrier ranges cover every written byte, and exactly those while there are few of them
+  std::vector<std::vector<u8>> covered(buffer_cnt, std::vector<u8>(buffer_size));
+  for (const auto& range : plan.dst_ranges) {
+    std::fill_n(covered[range.dst].begin() + range.offset, range.size, 1);
+  }
+  std::vector<std::vector<u8>> touched(buffer_cnt, std::vector<u8>(buffer_size));
+  for (const auto& copy : copies) {
+    std::fill_n(touched[copy.dst].begin() + copy.dst_offset, copy.size, 1);
+  }
+  if (copies.size() <= util::max_dst_ranges) {
+    ok &= expect(covered == touched, "barrier ranges");
+  } else {
+    for (u32 b = 0; b < buffer_cnt; b++) {
+      for (u64 i = 0; i < buffer_size; i++) {
+        ok &= expect(covered[b][i] >= touched[b][i], "barrier ranges cover writes");
+        if (!ok) return ok;
+      }
+    }
+  }
+  return ok;
+}
+
+bool run_checks() {
+  bool ok = true;
+  std::vector<std::byte> staging(4096);
+  for (size_t i = 0; i < staging.size(); i++) {
+    staging[i] = static_cast<std::byte>(i * 31 + 7);
+  }
+  {
+    // back to back in staging and destination: one region
+    const util::UploadCopy copies[] = {{0, 0, 64, 32}, {0, 32, 96, 32}, {0, 64, 128, 16}};
+    const auto plan = util::plan_uploads(copies);
+    ok &= expect(plan.regions.size() == 1 && plan.regions[0].size == 80 &&
+                     plan.batches.size() == 1 && plan.generation_starts.size() == 1,
+                 "contiguous copies merge");
+    ok &= expect(plan.dst_ranges.size() == 1 && plan.dst_ranges[0].offset == 64 &&
+                     plan.dst_ranges[0].size == 80,
+                 "one barrier range");
+  }
+  {
+    // queued out of order but disjoint: one batch per buffer, no extra generations
+    const util::UploadCopy copies[] = {{1, 0, 512, 16}, {0, 16, 0, 16}, {1, 32, 0, 16}};
+    const auto plan = util::plan_uploads(copies);
+    ok &= expect(plan.batches.size() == 2 && plan.generation_starts.size() == 1,
+                 "one batch per buffer");
+  }
+  {
+    // the same bytes written twice, the second one wins
+    const util::UploadCopy copies[] = {{0, 0, 100, 50}, {0, 200, 120, 10}};
+    const auto plan = util::plan_uploads(copies);
+    ok &= expect(plan.generation_starts.size() == 2, "overlap adds a generation");
+    ok &= plan_matches(copies, staging, 1, 512);
+  }
+  {
+    std::mt19937 rng{3};
+    for (u32 iter = 0; iter < 200; iter++) {
+      std::vector<util::UploadCopy> copies;
+      const u32 cnt = 1 + (rng() % 200);
+      for (u32 i = 0; i < cnt; i++) {
+        const u64 size = 1 + (rng() % 64);
+        copies.emplace_back(util::UploadCopy{.dst = static_cast<u32>(rng() % 3),
+                                             .src_offset = rng() % (staging.size() - size),
+                                             .dst_offset = rng() % (4096 - size),
+                                             .size = size,
+                                             .dst_stage = 1ull << (rng() % 4),
+                                             .dst_access = 1});
+      }
+      ok &= plan_matches(copies, staging, 3, 4096);
+      if (!ok) break;
+    }
+  }
+  return ok;
+}
+
+// dirty nodes of several instances, each node one ObjectData, staged in node order like
+// VkRender2::update_transforms
+std::vector<util::UploadCopy> make_dirty_transforms(u32 cnt) {
+  std::mt19937 rng{1};
+  std::vector<util::UploadCopy> copies;
+  u64 staging_offset{};
+  u64 instance_base{};
+  while (copies.size() < cnt) {
+    const u32 nodes = 8 + (rng() % 120);
+    for (u32 node = 0; node < nodes && copies.size() < cnt; node++) {
+      // most of an animated model moves, a few nodes stay put
+      if (rng() % 8 == 0) continue;
+      copies.emplace_back(util::UploadCopy{.dst = 0,
+                                           .src_offset = staging_offset,
+                                           .dst_offset = instance_base + (node * object_data_size),
+                                           .size = object_data_size,
+                                           .dst_stage = 1,
+                                           .dst_access = 1});
+      staging_offset += object_data_size;
+    }
+    instance_base += nodes * object_data_size;
+  }
+  return copies;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  u32 copy_cnt = 10000;
+  u32 iterations = 50;
+  if (argc > 1) copy_cnt = std::max(std::atoi(argv[1]), 1);
+  if (argc > 2) iterations = std::max(std::atoi(argv[2]), 1);
+  if (!run_checks()) {
+    LERROR("upload plan checks failed");
+    return 1;
+  }
+
+  const auto copies = make_dirty_transforms(copy_cnt);
+  Timer timer;
+  util::UploadPlan plan;
+  for (u32 i = 0; i < iterations; i++) {
+    plan = util::plan_uploads(copies);
+  }
+  const double ms = timer.elapsed_ms() / iterations;
+  LINFO("{} dirty transforms: plan {:.3f} ms", copies.size(), ms);
+  LINFO("{:<24} {:>10} {:>10} {:>10}", "", "regions", "copy cmds", "barriers");
+  // the old path: regions as queued, one copy per destination buffer and one whole buffer barrier
+  // before and after
+  LINFO("{:<24} {:>10} {:>10} {:>10}", "per copy", copies.size(), 1, 2);
+  LINFO("{:<24} {:>10} {:>10} {:>10}", "planned", plan.regions.size(), plan.batches.size(),
+        plan.dst_ranges.size() * 2);
+  LINFO("upload plan checks passed");
+  return 0;
+}
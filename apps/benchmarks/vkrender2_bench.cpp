@@ -0,0 +1,621 @@
+#include <volk.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <map>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AnimationManager.hpp"
+#include "Camera.hpp"
+#include "CameraPath.hpp"
+#include "FrameProfiler.hpp"
+#include "ResourceManager.hpp"
+#include "Scene.hpp"
+#include "VkRender2.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+#include "vk2/Device.hpp"
+
+// Renders a scene list offscreen on a headless device (no window, surface or present) along a
+// camera spline for a fixed number of frames, then writes frame time percentiles and per pass gpu
+// and cpu timings, to catch performance regressions between commits. Runs on software ICDs, e.g.
+// VK_DRIVER_FILES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json vkrender2_bench scenes.txt
+// usage: vkrender2_bench <scene list> [--camera path | --replay recording] [--frames n]
+//        [--warmup n] [-w width] [-h height] [--csv out.csv] [--json out.json] [--resources dir]
+//        [--validation-layers]
+//        vkrender2_bench --spawn [--resources dir] [--validation-layers]
+// The scene list has one model per line, optionally followed by a translation and uniform scale
+// ("path x y z scale"), and "env <hdr path>" for the environment map. The camera path has one
+// control point per line, "x y z yaw pitch" in degrees, visited by a Catmull-Rom spline that loops
+// once over the measured frames. Without one the camera orbits the origin. Relative paths are
+// relative to the file they're in, lines starting with # are skipped. --replay plays a camera path
+// recorded in the demo app instead, one measured frame per recorded frame.
+// --spawn skips the scene list and measures spawning instead: see run_spawn_bench.
+
+#define CMP(arg, cmp) strcmp(arg, cmp) == 0
+
+using namespace gfx;
+
+namespace {
+
+struct SceneList {
+  struct Model {
+    std::filesystem::path path;
+    mat4 transform{1};
+  };
+  std::vector<Model> models;
+  std::filesystem::path env_map;
+};
+
+std::optional<SceneList> load_scene_list(const std::filesystem::path& path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    LERROR("failed to open scene list {}", path.string());
+    return std::nullopt;
+  }
+  SceneList list;
+  const auto dir = path.parent_path();
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream ss(line);
+    std::string first;
+    if (!(ss >> first) || first.starts_with('#')) continue;
+    if (first == "env") {
+      std::string env;
+      ss >> env;
+      list.env_map = dir / env;
+      continue;
+    }
+    vec3 translation{};
+    float scale{1};
+    ss >> translation.x >> translation.y >> translation.z >> scale;
+    auto& model = list.models.emplace_back(SceneList::Model{
+        .path = dir / first,
+        .transform = glm::scale(glm::translate(mat4{1}, translation), vec3{scale})});
+    if (!std::filesystem::exists(model.path)) {
+      LERROR("model {} not found", model.path.string());
+      return std::nullopt;
+    }
+  }
+  if (list.models.empty()) {
+    LERROR("scene list {} has no models", path.string());
+    return std::nullopt;
+  }
+  return list;
+}
+
+struct CameraKey {
+  vec3 pos;
+  vec3 front;
+};
+
+vec3 front_from_angles(float yaw, float pitch) {
+  Camera cam{.pitch = pitch, .yaw = yaw};
+  cam.update_vectors();
+  return cam.front;
+}
+
+std::vector<CameraKey> load_camera_keys(const std::filesystem::path& path) {
+  std::vector<CameraKey> keys;
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    LERROR("failed to open camera path {}", path.string());
+    return keys;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.starts_with('#')) continue;
+    std::istringstream ss(line);
+    vec3 pos;
+    float yaw, pitch;
+    if (ss >> pos.x >> pos.y >> pos.z >> yaw >> pitch) {
+      keys.emplace_back(CameraKey{pos, front_from_angles(yaw, pitch)});
+    }
+  }
+  return keys;
+}
+
+std::vector<CameraKey> make_orbit_path() {
+  constexpr u32 key_cnt = 8;
+  constexpr float radius = 10.f;
+  std::vector<CameraKey> keys;
+  for (u32 i = 0; i < key_cnt; i++) {
+    const float angle = glm::two_pi<float>() * static_cast<float>(i) / key_cnt;
+    const vec3 pos{std::cos(angle) * radius, 3.f, std::sin(angle) * radius};
+    keys.emplace_back(CameraKey{pos, glm::normalize(-pos)});
+  }
+  return keys;
+}
+
+// t in [0, 1) over the whole loop. Directions are interpolated rather than yaw/pitch so the
+// camera doesn't spin around when yaw wraps.
+Camera eval_camera_path(std::span<const CameraKey> keys, float t) {
+  const auto n = static_cast<u32>(keys.size());
+  const float seg = t * static_cast<float>(n);
+  const u32 i = static_cast<u32>(seg) % n;
+  const float f = seg - std::floor(seg);
+  const auto& k0 = keys[(i + n - 1) % n];
+  const auto& k1 = keys[i];
+  const auto& k2 = keys[(i + 1) % n];
+  const auto& k3 = keys[(i + 2) % n];
+  const auto catmull_rom = [f](vec3 p0, vec3 p1, vec3 p2, vec3 p3) {
+    return 0.5f * ((2.f * p1) + (-p0 + p2) * f + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * f * f +
+                   (-p0 + 3.f * p1 - 3.f * p2 + p3) * f * f * f);
+  };
+  const vec3 front =
+      glm::normalize(catmull_rom(k0.front, k1.front, k2.front, k3.front) + vec3{0, 0, 1e-6f});
+  Camera cam{.pos = catmull_rom(k0.pos, k1.pos, k2.pos, k3.pos)};
+  cam.pitch = glm::degrees(std::asin(glm::clamp(front.y, -1.f, 1.f)));
+  cam.yaw = glm::degrees(std::atan2(front.z, front.x));
+  cam.update_vectors();
+  return cam;
+}
+
+struct Stats {
+  size_t samples{};
+  double mean{}, min{}, p50{}, p90{}, p95{}, p99{}, max{};
+};
+
+Stats calc_stats(std::vector<double> values) {
+  Stats stats{.samples = values.size()};
+  if (values.empty()) return stats;
+  std::ranges::sort(values);
+  // nearest rank
+  const auto percentile = [&values](double p) {
+    const auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(values.size())));
+    return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+  };
+  double sum{};
+  for (double v : values) sum += v;
+  stats.mean = sum / static_cast<double>(values.size());
+  stats.min = values.front();
+  stats.max = values.back();
+  stats.p50 = percentile(.5);
+  stats.p90 = percentile(.9);
+  stats.p95 = percentile(.95);
+  stats.p99 = percentile(.99);
+  return stats;
+}
+
+struct Results {
+  std::string device_name;
+  uvec2 dims;
+  u32 frames;
+  u32 warmup;
+  double load_ms;
+  std::vector<double> frame_ms;
+  std::vector<double> cpu_draw_ms;
+  std::vector<double> gpu_frame_ms;
+  // per frame totals by scope name, frames without the scope are left out
+  std::map<std::string, std::vector<double>> gpu_pass_ms;
+  std::map<std::string, std::vector<double>> cpu_scope_ms;
+};
+
+void collect_frame(const ProfiledFrame& frame, Results& results) {
+  std::map<std::string, double> frame_totals;
+  for (const auto& scope : frame.cpu_scopes) {
+    frame_totals[scope.name] += static_cast<double>(scope.end_ns - scope.begin_ns) / 1e6;
+  }
+  for (const auto& [name, ms] : frame_totals) {
+    results.cpu_scope_ms[name].emplace_back(ms);
+  }
+  if (frame.gpu_scopes.empty()) return;
+  frame_totals.clear();
+  for (const auto& scope : frame.gpu_scopes) {
+    frame_totals[scope.name] += static_cast<double>(scope.end_ns - scope.begin_ns) / 1e6;
+  }
+  for (const auto& [name, ms] : frame_totals) {
+    results.gpu_pass_ms[name].emplace_back(ms);
+  }
+  results.gpu_frame_ms.emplace_back(get_gpu_frame_ms(frame));
+}
+
+std::string csv_row(std::string_view kind, std::string_view name, const Stats& s) {
+  std::string quoted;
+  for (char c : name) {
+    if (c == '"') quoted += '"';
+    quoted += c;
+  }
+  return std::format("{},\"{}\",{},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f}\n", kind,
+                     quoted, s.samples, s.mean, s.min, s.p50, s.p90, s.p95, s.p99, s.max);
+}
+
+bool write_csv(const std::filesystem::path& path, const Results& results) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    LERROR("failed to open {} for writing", path.string());
+    return false;
+  }
+  file << "kind,name,samples,mean_ms,min_ms,p50_ms,p90_ms,p95_ms,p99_ms,max_ms\n";
+  file << csv_row("frame", "frame", calc_stats(results.frame_ms));
+  file << csv_row("frame", "cpu_draw", calc_stats(results.cpu_draw_ms));
+  file << csv_row("frame", "gpu", calc_stats(results.gpu_frame_ms));
+  for (const auto& [name, ms] : results.gpu_pass_ms) {
+    file << csv_row("gpu_pass", name, calc_stats(ms));
+  }
+  for (const auto& [name, ms] : results.cpu_scope_ms) {
+    file << csv_row("cpu_scope", name, calc_stats(ms));
+  }
+  return true;
+}
+
+std::string json_string(std::string_view str) {
+  std::string out = "\"";
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) >= 0x20) {
+      out += c;
+    }
+  }
+  return out + '"';
+}
+
+std::string json_stats(const Stats& s) {
+  return std::format(
+      R"({{"samples":{},"mean_ms":{:.4f},"min_ms":{:.4f},"p50_ms":{:.4f},"p90_ms":{:.4f},)"
+      R"("p95_ms":{:.4f},"p99_ms":{:.4f},"max_ms":{:.4f}}})",
+      s.samples, s.mean, s.min, s.p50, s.p90, s.p95, s.p99, s.max);
+}
+
+bool write_json(const std::filesystem::path& path, const Results& results) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    LERROR("failed to open {} for writing", path.string());
+    return false;
+  }
+  file << "{\n";
+  file << "\"device\":" << json_string(results.device_name) << ",\n";
+  file << std::format(R"("width":{},"height":{},"frames":{},"warmup":{},"load_ms":{:.3f},)",
+                      results.dims.x, results.dims.y, results.frames, results.warmup,
+                      results.load_ms)
+       << "\n";
+  file << "\"frame\":" << json_stats(calc_stats(results.frame_ms)) << ",\n";
+  file << "\"cpu_draw\":" << json_stats(calc_stats(results.cpu_draw_ms)) << ",\n";
+  file << "\"gpu_frame\":" << json_stats(calc_stats(results.gpu_frame_ms)) << ",\n";
+  const auto write_map = [&file](const char* key,
+                                 const std::map<std::string, std::vector<double>>& values) {
+    file << '"' << key << "\":{";
+    bool first = true;
+    for (const auto& [name, ms] : values) {
+      file << (first ? "\n" : ",\n") << json_string(name) << ':' << json_stats(calc_stats(ms));
+      first = false;
+    }
+    file << "},\n";
+  };
+  write_map("gpu_passes", results.gpu_pass_ms);
+  write_map("cpu_scopes", results.cpu_scope_ms);
+  file << "\"frame_ms\":[";
+  for (size_t i = 0; i < results.frame_ms.size(); i++) {
+    file << (i ? "," : "") << std::format("{:.4f}", results.frame_ms[i]);
+  }
+  file << "]\n}\n";
+  return true;
+}
+
+std::optional<std::filesystem::path> get_resource_dir() {
+  auto curr_path = std::filesystem::current_path();
+  while (curr_path.has_parent_path()) {
+    auto resource_path = curr_path / "resources";
+    if (std::filesystem::exists(resource_path)) {
+      return resource_path;
+    }
+    if (curr_path == curr_path.parent_path()) break;
+    curr_path = curr_path.parent_path();
+  }
+  return std::nullopt;
+}
+
+// same as the demo app's serial transform update
+void update_instances(std::span<const InstanceHandle> instances, float dt) {
+  auto& renderer = VkRender2::get();
+  static std::vector<i32> changed_nodes;
+  for (auto handle : instances) {
+    auto* instance = ResourceManager::get().get_instance(handle);
+    if (!instance) continue;
+    renderer.update_animation(*instance, dt);
+    changed_nodes.clear();
+    if (recalc_global_transforms(instance->scene_graph_data, &changed_nodes)) {
+      renderer.update_transforms(*instance, changed_nodes);
+    }
+    renderer.update_skins(*instance);
+  }
+}
+
+// Spawns 1k, 10k and 100k instances of the model with load_model in a loop, then with one
+// load_models call, and prints the per instance cpu cost of queueing them and of adding them in
+// ResourceManager::update. Same runs as the demo app's spawn benchmark button, minus the window.
+bool run_spawn_bench(const std::filesystem::path& model_path,
+                     const std::function<void()>& render_frame) {
+  constexpr u32 counts[] = {1'000, 10'000, 100'000};
+  constexpr double timeout_ms = 5 * 60 * 1000;
+  auto& resource_manager = ResourceManager::get();
+  const auto wait_until = [&](const auto& done) {
+    Timer timer;
+    while (!done()) {
+      if (timer.elapsed_ms() > timeout_ms) {
+        LERROR("timed out spawning {}", model_path.string());
+        return false;
+      }
+      render_frame();
+    }
+    return true;
+  };
+
+  // keeps the model loaded so every run queues against a loaded model
+  const auto keep_loaded = resource_manager.load_model(model_path);
+  if (!wait_until([&]() { return resource_manager.get_instance(keep_loaded) != nullptr; })) {
+    return false;
+  }
+  LINFO("{:>7} {:>7} {:>14} {:>12} {:>12}", "count", "path", "queue us/inst", "add us/inst",
+        "total ms");
+  bool ok = true;
+  for (u32 count : counts) {
+    std::vector<mat4> transforms;
+    transforms.reserve(count);
+    const auto side = static_cast<u32>(std::ceil(std::sqrt(static_cast<float>(count))));
+    for (u32 i = 0; i < count; i++) {
+      const vec3 pos{static_cast<float>(i % side), 0.f, static_cast<float>(i / side)};
+      transforms.emplace_back(glm::translate(mat4{1}, pos * 3.f));
+    }
+    for (bool batched : {false, true}) {
+      std::vector<InstanceHandle> instances;
+      resource_manager.reset_spawn_stats();
+      Timer timer;
+      if (batched) {
+        instances = resource_manager.load_models(model_path, transforms);
+      } else {
+        instances.reserve(count);
+        for (const auto& transform : transforms) {
+          instances.emplace_back(resource_manager.load_model(model_path, transform));
+        }
+      }
+      const u64 queue_micros = timer.elapsed_micro();
+      // added in ResourceManager::update during the next frame
+      ok = wait_until([&]() { return resource_manager.get_spawn_stats().instance_cnt >= count; });
+      if (ok) {
+        const u64 add_micros = resource_manager.get_spawn_stats().micros;
+        LINFO("{:>7} {:>7} {:>14.3f} {:>12.3f} {:>12.3f}", count, batched ? "batch" : "single",
+              static_cast<double>(queue_micros) / count, static_cast<double>(add_micros) / count,
+              static_cast<double>(queue_micros + add_micros) * .001);
+      }
+      for (auto handle : instances) {
+        resource_manager.remove_model(handle);
+      }
+      render_frame();
+      if (!ok) return false;
+    }
+  }
+  resource_manager.remove_model(keep_loaded);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::filesystem::path scene_list_path, camera_path, replay_path, csv_path, json_path,
+      resource_dir;
+  u32 frames{600}, warmup{60};
+  uvec2 dims{1280, 720};
+  bool enable_validation_layers{}, spawn{};
+  for (int i = 1; i < argc; i++) {
+    char* arg = argv[i];
+    const bool has_value = i < argc - 1;
+    if (CMP(arg, "--camera") && has_value) {
+      camera_path = argv[++i];
+    } else if (CMP(arg, "--replay") && has_value) {
+      replay_path = argv[++i];
+    } else if (CMP(arg, "--frames") && has_value) {
+      frames = std::max(std::atoi(argv[++i]), 1);
+    } else if (CMP(arg, "--warmup") && has_value) {
+      warmup = std::max(std::atoi(argv[++i]), 0);
+    } else if (CMP(arg, "-w") && has_value) {
+      dims.x = std::clamp(std::atoi(argv[++i]), 16, 8192);
+    } else if (CMP(arg, "-h") && has_value) {
+      dims.y = std::clamp(std::atoi(argv[++i]), 16, 8192);
+    } else if (CMP(arg, "--csv") && has_value) {
+      csv_path = argv[++i];
+    } else if (CMP(arg, "--json") && has_value) {
+      json_path = argv[++i];
+    } else if (CMP(arg, "--resources") && has_value) {
+      resource_dir = argv[++i];
+    } else if (CMP(arg, "--validation-layers")) {
+      enable_validation_layers = true;
+    } else if (CMP(arg, "--spawn")) {
+      spawn = true;
+    } else {
+      scene_list_path = arg;
+    }
+  }
+  if (scene_list_path.empty() && !spawn) {
+    LERROR("usage: vkrender2_bench <scene list> [--camera path | --replay recording] "
+           "[--frames n] [--warmup n] [-w width] [-h height] [--csv out.csv] [--json out.json] "
+           "[--resources dir] [--validation-layers]\n"
+           "       vkrender2_bench --spawn [--resources dir] [--validation-layers]");
+    return 1;
+  }
+  std::optional<SceneList> scene_list;
+  if (!spawn) {
+    scene_list = load_scene_list(scene_list_path);
+    if (!scene_list) return 1;
+  }
+  const auto camera_keys = camera_path.empty() ? make_orbit_path() : load_camera_keys(camera_path);
+  if (camera_keys.empty()) {
+    LERROR("camera path {} has no control points", camera_path.string());
+    return 1;
+  }
+  std::vector<CameraPathFrame> recording;
+  if (!replay_path.empty()) {
+    auto loaded = load_camera_path(replay_path);
+    if (!loaded || loaded->empty()) {
+      LERROR("failed to load camera path recording {}", replay_path.string());
+      return 1;
+    }
+    recording = std::move(*loaded);
+    frames = static_cast<u32>(recording.size());
+  }
+  if (resource_dir.empty()) {
+    auto found = get_resource_dir();
+    if (!found) {
+      LERROR("failed to find resource directory, pass --resources");
+      return 1;
+    }
+    resource_dir = *found;
+  }
+
+  Device::init({.app_name = "vkrender2_bench",
+                .window = nullptr,
+                .enable_validation_layers = enable_validation_layers,
+                .headless_dims = dims});
+  bool success;
+  VkRender2::init(VkRender2::InitInfo{.window = nullptr,
+                                      .device = &Device::get(),
+                                      .resource_dir = resource_dir,
+                                      .name = "vkrender2_bench",
+                                      .vsync = false},
+                  success);
+  if (!success) {
+    LERROR("failed to initialize renderer");
+    return 1;
+  }
+  ResourceManager::init();
+  AnimationManager::init();
+  auto& renderer = VkRender2::get();
+  renderer.set_imgui_enabled(false);
+  renderer.get_profiler().set_enabled(true);
+
+  Results results{.dims = dims, .frames = frames, .warmup = warmup};
+  {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(Device::get().get_physical_device(), &props);
+    results.device_name = props.deviceName;
+  }
+
+  SceneDrawInfo info{.light_color = {1., 1., 1.}, .fov_degrees = 70.f};
+  info.light_dir = glm::normalize(vec3{2., -3.5, -2.});
+  std::vector<InstanceHandle> instances;
+  // frame is the measured frame the camera is at
+  const auto render_frame = [&](u32 frame) {
+    Camera cam;
+    if (recording.empty()) {
+      cam = eval_camera_path(camera_keys, static_cast<float>(frame) / static_cast<float>(frames));
+    } else {
+      const auto& rec = recording[std::min<size_t>(frame, recording.size() - 1)];
+      cam.pos = rec.pos;
+      cam.pitch = rec.pitch;
+      cam.yaw = rec.yaw;
+      cam.update_vectors();
+      info.light_dir = rec.light_dir;
+      info.light_color = rec.light_color;
+      info.ambient_intensity = rec.ambient_intensity;
+      info.fov_degrees = rec.fov_degrees;
+    }
+    info.view = cam.get_view();
+    info.view_pos = cam.pos;
+    renderer.new_frame();
+    // fixed dt so animations advance the same every run
+    update_instances(instances, camera_path_fixed_dt);
+    renderer.draw(info);
+  };
+
+  const auto shutdown = []() {
+    Device::get().wait_idle();
+    AnimationManager::shutdown();
+    ResourceManager::shutdown();
+    VkRender2::shutdown();
+    Device::destroy();
+  };
+  if (spawn) {
+    const bool ok = run_spawn_bench(resource_dir / "models/Cube/glTF/Cube.gltf",
+                                    [&]() { render_frame(0); });
+    shutdown();
+    return ok ? 0 : 1;
+  }
+
+  int ret = 0;
+  {
+    Timer load_timer;
+    for (const auto& model : scene_list->models) {
+      instances.emplace_back(ResourceManager::get().load_model(model.path, model.transform));
+    }
+    if (!scene_list->env_map.empty()) {
+      renderer.set_env_map(scene_list->env_map);
+    }
+    // instances are added by the renderer's frames once loaded
+    constexpr double load_timeout_ms = 5 * 60 * 1000;
+    while (!std::ranges::all_of(instances, [](InstanceHandle handle) {
+      return ResourceManager::get().get_instance(handle) != nullptr;
+    })) {
+      if (load_timer.elapsed_ms() > load_timeout_ms) {
+        LERROR("timed out loading the scene list");
+        ret = 1;
+        break;
+      }
+      render_frame(0);
+    }
+    results.load_ms = load_timer.elapsed_ms();
+  }
+
+  if (ret == 0) {
+    LINFO("loaded {} models in {:.1f} ms on {}", instances.size(), results.load_ms,
+          results.device_name);
+    // pipelines compile and textures stream in during warmup
+    for (u32 i = 0; i < warmup; i++) {
+      render_frame(0);
+    }
+    const u32 first_frame = Device::get().curr_frame_num();
+    const u32 end_frame = first_frame + frames;
+    u32 last_collected = UINT32_MAX;
+    const auto collect = [&]() {
+      const auto* frame = renderer.get_profiler().get_last_resolved_frame();
+      if (frame && frame->frame_num != last_collected && frame->frame_num >= first_frame &&
+          frame->frame_num < end_frame) {
+        last_collected = frame->frame_num;
+        collect_frame(*frame, results);
+      }
+    };
+    Timer frame_timer;
+    for (u32 i = 0; i < frames; i++) {
+      Timer draw_timer;
+      render_frame(i);
+      results.cpu_draw_ms.emplace_back(draw_timer.elapsed_ms());
+      results.frame_ms.emplace_back(frame_timer.elapsed_ms());
+      frame_timer.reset();
+      collect();
+    }
+    // the last frames' gpu timestamps are read back once their frames in flight come around
+    for (u32 i = 0; i < frames_in_flight; i++) {
+      render_frame(0);
+      collect();
+    }
+    if (results.gpu_frame_ms.empty()) {
+      LWARN("no gpu timestamps, only cpu timings are reported");
+    }
+
+    const Stats frame = calc_stats(results.frame_ms);
+    const Stats gpu = calc_stats(results.gpu_frame_ms);
+    LINFO("{:<10} {:>10} {:>10} {:>10} {:>10} {:>10}", "ms", "mean", "p50", "p95", "p99", "max");
+    LINFO("{:<10} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}", "frame", frame.mean,
+          frame.p50, frame.p95, frame.p99, frame.max);
+    LINFO("{:<10} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}", "gpu", gpu.mean, gpu.p50,
+          gpu.p95, gpu.p99, gpu.max);
+    if (!csv_path.empty() && !write_csv(csv_path, results)) ret = 1;
+    if (!json_path.empty() && !write_json(json_path, results)) ret = 1;
+  }
+
+  shutdown();
+  return ret;
+}
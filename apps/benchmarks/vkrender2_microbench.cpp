@@ -0,0 +1,668 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "AABB.hpp"
+#include "Affine.hpp"
+#include "AnimationManager.hpp"
+#include "BenchCheck.hpp"
+#include "ResourceManager.hpp"
+#include "Scene.hpp"
+#include "SceneLoader.hpp"
+#include "Types.hpp"
+#include "core/Logger.hpp"
+#include "util/IndexAllocator.hpp"
+#include "vk2/Pool.hpp"
+
+// CPU hot path microbenchmarks, no device needed. Every benchmark runs at a few input sizes and
+// reports ns per op at each, plus how the cost per op scales with size: the slope of
+// log(ns per op) over log(n), so 0 is a flat cost per op and 1 means it grows linearly with n.
+// The skeletons_* benchmarks compare the ways apply_clip finds keys on clips with uneven keys.
+// Results are written as JSON to track them over time.
+// usage: vkrender2_microbench [--json out.json] [--filter substring] [--batch-ms ms]
+
+#define CMP(arg, cmp) strcmp(arg, cmp) == 0
+
+using namespace gfx;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::chrono::nanoseconds batch_time{std::chrono::milliseconds{20}};
+// results are folded in here so the benchmarked work can't be optimized out
+volatile u64 sink;
+
+void consume(u64 value) { sink = sink + value; }
+void consume(float value) { consume(static_cast<u64>(std::bit_cast<u32>(value))); }
+
+// Best of 5 batches, each calling f until it has run for batch_time.
+template <typename F>
+double measure(u64 ops_per_call, F&& f) {
+  f();  // warm up
+  double best = std::numeric_limits<double>::max();
+  for (int batch = 0; batch < 5; batch++) {
+    u64 calls{};
+    const auto start = Clock::now();
+    Clock::duration elapsed{};
+    do {
+      f();
+      calls++;
+      elapsed = Clock::now() - start;
+    } while (elapsed < batch_time);
+    best = std::min(best, std::chrono::duration<double, std::nano>(elapsed).count() /
+                              static_cast<double>(calls * ops_per_call));
+  }
+  return best;
+}
+
+using bench::expect;
+
+std::vector<u32> shuffled_indices(u32 n, std::mt19937& rng) {
+  std::vector<u32> indices(n);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::ranges::shuffle(indices, rng);
+  return indices;
+}
+
+Affine random_affine(std::mt19937& rng) {
+  std::uniform_real_distribution<float> dist{-1.f, 1.f};
+  const vec3 t{dist(rng), dist(rng), dist(rng)};
+  const quat r = glm::angleAxis(dist(rng) * 3.14f, glm::normalize(vec3{dist(rng), 1.f, .5f}));
+  return Affine{glm::translate(mat4{1}, t) * glm::mat4_cast(r) *
+                glm::scale(mat4{1}, vec3{1.f + (.1f * dist(rng))})};
+}
+
+// breadth first tree where every node gets up to `fanout` children, like a skeleton or a
+// flattened scene
+Scene2 make_scene(u32 node_cnt, u32 fanout, std::mt19937& rng) {
+  Scene2 scene;
+  auto shared = std::make_shared<SceneTemplate>();
+  auto& hierarchies = shared->hierarchies;
+  hierarchies.resize(node_cnt);
+  scene.local_transforms.resize(node_cnt);
+  scene.node_transforms.resize(node_cnt);
+  scene.global_transforms.resize(node_cnt);
+  for (u32 i = 0; i < node_cnt; i++) {
+    auto& h = hierarchies[i];
+    if (i > 0) {
+      const auto parent = static_cast<i32>((i - 1) / fanout);
+      auto& ph = hierarchies[parent];
+      h.parent = parent;
+      h.level = ph.level + 1;
+      if (ph.first_child == -1) {
+        ph.first_child = static_cast<i32>(i);
+      } else {
+        hierarchies[i - 1].next_sibling = static_cast<i32>(i);
+      }
+    }
+    scene.local_transforms[i] = random_affine(rng);
+  }
+  build_level_ranges(*shared);
+  scene.shared = std::move(shared);
+  reset_dirty_state(scene);
+  return scene;
+}
+
+// one translation, rotation and scale channel per bone, keys over a second. Uneven keys are
+// jittered, like exported clips with their redundant keys stripped.
+Animation make_clip(u32 bone_cnt, u32 key_cnt, std::mt19937& rng, bool even_keys = true) {
+  std::uniform_real_distribution<float> dist{-1.f, 1.f};
+  Animation clip;
+  clip.duration = 1.f;
+  std::vector<float> inputs(key_cnt);
+  for (u32 k = 0; k < key_cnt; k++) {
+    const float jitter = even_keys || k == 0 || k == key_cnt - 1 ? 0.f : .4f * dist(rng);
+    inputs[k] = (static_cast<float>(k) + jitter) / static_cast<float>(key_cnt - 1);
+  }
+  for (u32 bone = 0; bone < bone_cnt; bone++) {
+    for (auto path : {AnimationPath::Translation, AnimationPath::Rotation, AnimationPath::Scale}) {
+      AnimSampler sampler;
+      sampler.inputs = inputs;
+      for (u32 k = 0; k < key_cnt; k++) {
+        if (path == AnimationPath::Rotation) {
+          const quat q = glm::normalize(quat{dist(rng), dist(rng), dist(rng), dist(rng)});
+          sampler.outputs_raw.insert(sampler.outputs_raw.end(), {q.x, q.y, q.z, q.w});
+        } else {
+          sampler.outputs_raw.insert(sampler.outputs_raw.end(), {dist(rng), dist(rng), dist(rng)});
+        }
+      }
+      clip.channels.nodes.emplace_back(static_cast<int>(bone));
+      clip.channels.sampler_indices.emplace_back(static_cast<u32>(clip.samplers.size()));
+      clip.channels.anim_paths.emplace_back(path);
+      clip.samplers.emplace_back(std::move(sampler));
+    }
+  }
+  prepare_animation(clip);
+  return clip;
+}
+
+enum class KeyLookup : u8 { BinarySearch, Cursor, Resampled };
+
+// n skeletons of 100 bones playing one clip with uneven keys, each at its own time
+double run_skeletons(u32 n, std::mt19937& rng, KeyLookup lookup) {
+  constexpr u32 bone_cnt = 100;
+  Animation clip = make_clip(bone_cnt, 60, rng, false);
+  if (lookup == KeyLookup::Resampled) {
+    prepare_animation(clip, 30.f);
+  }
+  struct Skeleton {
+    AnimationState state;
+    std::vector<NodeTransformAccumulator> accum;
+    std::vector<bool> dirty;
+    std::vector<u32> key_cursors;
+  };
+  std::vector<Skeleton> skeletons(n);
+  std::uniform_real_distribution<float> start_t{0.f, clip.duration};
+  for (auto& skeleton : skeletons) {
+    skeleton.state = AnimationState{.anim_id = 0, .curr_t = start_t(rng)};
+    skeleton.accum.resize(bone_cnt);
+    skeleton.dirty.resize(bone_cnt);
+    skeleton.key_cursors.assign(clip.samplers.size(), 0);
+  }
+  return measure(static_cast<u64>(n) * bone_cnt, [&] {
+    for (auto& skeleton : skeletons) {
+      std::ranges::fill(skeleton.accum, NodeTransformAccumulator{});
+      skeleton.state.curr_t = std::fmod(skeleton.state.curr_t + (1.f / 60.f), clip.duration);
+      AnimationManager::get().apply_clip(
+          clip, skeleton.state, 1.f, skeleton.accum, skeleton.dirty,
+          lookup == KeyLookup::Cursor ? std::span<u32>{skeleton.key_cursors} : std::span<u32>{});
+      consume(skeleton.accum.back().translation.x);
+    }
+  });
+}
+
+// a lerp between two clips, the shape the demo's blend trees have
+struct BlendSetup {
+  LoadedInstanceData instance;
+  InstanceAnimation animation;
+  std::vector<Animation> clips;
+  std::vector<NodeTransformAccumulator> accum;
+};
+
+std::unique_ptr<BlendSetup> make_blend_setup(u32 bone_cnt, std::mt19937& rng) {
+  auto setup = std::make_unique<BlendSetup>();
+  setup->instance.scene_graph_data = make_scene(bone_cnt, 3, rng);
+  setup->instance.transform_accumulators.resize(bone_cnt);
+  setup->instance.dirty_animation_node_bits.resize(bone_cnt);
+  setup->accum.resize(bone_cnt);
+  for (u32 i = 0; i < 2; i++) {
+    setup->clips.emplace_back(make_clip(bone_cnt, 30, rng));
+    setup->animation.key_cursors.emplace_back(setup->clips.back().samplers.size(), 0);
+    setup->animation.states.emplace_back(AnimationState{.anim_id = i, .curr_t = .3f * (i + 1)});
+  }
+  auto& tree = setup->animation.blend_tree;
+  for (u32 i = 0; i < 2; i++) {
+    BlendTreeNode clip_node{};
+    clip_node.type = BlendTreeNode::Type::Clip;
+    clip_node.animation_i = i;
+    tree.blend_tree_nodes.emplace_back(clip_node);
+  }
+  BlendTreeNode lerp_node{};
+  lerp_node.type = BlendTreeNode::Type::Lerp;
+  lerp_node.children = {0, 1};
+  lerp_node.weight_idx = 0;
+  tree.blend_tree_nodes.emplace_back(lerp_node);
+  tree.control_vars.emplace_back(.25f);
+  return setup;
+}
+
+// grid in the xz plane with uvs along x and z, so every tangent is +x
+struct Grid {
+  std::vector<Vertex> vertices;
+  std::vector<u32> indices;
+};
+
+Grid make_grid(u32 side) {
+  Grid grid;
+  for (u32 z = 0; z < side; z++) {
+    for (u32 x = 0; x < side; x++) {
+      const float u = static_cast<float>(x) / static_cast<float>(side - 1);
+      const float v = static_cast<float>(z) / static_cast<float>(side - 1);
+      grid.vertices.emplace_back(
+          Vertex{.pos = {u, 0.f, v}, .uv_x = u, .normal = {0.f, 1.f, 0.f}, .uv_y = v});
+    }
+  }
+  for (u32 z = 0; z + 1 < side; z++) {
+    for (u32 x = 0; x + 1 < side; x++) {
+      const u32 i = (z * side) + x;
+      grid.indices.insert(grid.indices.end(), {i, i + side, i + 1, i + 1, i + side, i + side + 1});
+    }
+  }
+  return grid;
+}
+
+CalcTangentsVertexInfo tangent_info(std::vector<Vertex>& vertices) {
+  const auto base_offset = [&vertices](u32 offset) {
+    return CalcTangentsVertexInfo::BaseOffset{
+        .base = vertices.data(), .offset = offset, .stride = sizeof(Vertex)};
+  };
+  return {.pos = base_offset(offsetof(Vertex, pos)),
+          .normal = base_offset(offsetof(Vertex, normal)),
+          .uv_x = base_offset(offsetof(Vertex, uv_x)),
+          .uv_y = base_offset(offsetof(Vertex, uv_y)),
+          .tangent = base_offset(offsetof(Vertex, tangent))};
+}
+
+struct BenchObject {
+  u64 value{};
+};
+using BenchHandle = GenerationalHandle<BenchObject>;
+
+struct Benchmark {
+  const char* name;
+  const char* op;
+  std::vector<u32> sizes;
+  // ns per op at input size n
+  std::function<double(u32 n, std::mt19937& rng)> run;
+};
+
+std::vector<Benchmark> make_benchmarks() {
+  std::vector<Benchmark> benches;
+  benches.emplace_back(
+      "index_allocator", "alloc + free", std::vector<u32>{1'000, 10'000, 100'000},
+      [](u32 n, std::mt19937& rng) {
+        util::IndexAllocator allocator{n};
+        std::vector<u32> indices(n);
+        const auto order = shuffled_indices(n, rng);
+        return measure(n, [&] {
+          for (auto& idx : indices) idx = allocator.alloc();
+          for (u32 i : order) allocator.free(indices[i]);
+          consume(static_cast<u64>(indices.back()));
+        });
+      });
+  benches.emplace_back(
+      "free_list_allocator", "allocate + free of 256 bytes", std::vector<u32>{256, 1'024, 4'096},
+      [](u32 n, std::mt19937& rng) {
+        std::vector<util::FreeListAllocator::Slot> slots(n);
+        const auto order = shuffled_indices(n, rng);
+        return measure(n, [&] {
+          util::FreeListAllocator allocator;
+          allocator.init(n * 256, 64, n);
+          for (auto& slot : slots) slot = allocator.allocate(256);
+          for (u32 i : order) allocator.free(slots[i]);
+          consume(static_cast<u64>(slots.back().get_offset()));
+        });
+      });
+  benches.emplace_back(
+      "free_list_allocator2", "allocate + free of 256 bytes", std::vector<u32>{256, 1'024, 4'096},
+      [](u32 n, std::mt19937& rng) {
+        std::vector<util::FreeListAllocator2::Slot> slots(n);
+        const auto order = shuffled_indices(n, rng);
+        return measure(n, [&] {
+          util::FreeListAllocator2 allocator;
+          allocator.init(n * 256, 64, n);
+          for (auto& slot : slots) slot = allocator.allocate(256);
+          for (u32 i : order) allocator.free(slots[i]);
+          consume(static_cast<u64>(slots.back().get_offset()));
+        });
+      });
+  benches.emplace_back(
+      "pool_alloc_destroy", "alloc + destroy", std::vector<u32>{1'000, 10'000, 100'000},
+      [](u32 n, std::mt19937& rng) {
+        Pool<BenchHandle, BenchObject> pool;
+        std::vector<BenchHandle> handles(n);
+        const auto order = shuffled_indices(n, rng);
+        return measure(n, [&] {
+          for (u32 i = 0; i < n; i++) handles[i] = pool.alloc(BenchObject{i});
+          for (u32 i : order) pool.destroy(handles[i]);
+          consume(static_cast<u64>(pool.size()));
+        });
+      });
+  benches.emplace_back("pool_get", "get", std::vector<u32>{1'000, 10'000, 100'000, 1'000'000},
+                       [](u32 n, std::mt19937& rng) {
+                         Pool<BenchHandle, BenchObject> pool;
+                         std::vector<BenchHandle> handles(n);
+                         for (u32 i = 0; i < n; i++) handles[i] = pool.alloc(BenchObject{i});
+                         const auto order = shuffled_indices(n, rng);
+                         return measure(n, [&] {
+                           u64 sum{};
+                           for (u32 i : order) sum += pool.get(handles[i])->value;
+                           consume(sum);
+                         });
+                       });
+  benches.emplace_back(
+      "recalc_global_transforms", "node, whole tree dirty",
+      std::vector<u32>{1'000, 10'000, 100'000, 1'000'000}, [](u32 n, std::mt19937& rng) {
+        Scene2 scene = make_scene(n, 8, rng);
+        return measure(n, [&] {
+          mark_changed(scene, 0);
+          recalc_global_transforms(scene);
+          consume(scene.global_transforms.back().rows[0].w);
+        });
+      });
+  benches.emplace_back(
+      "mark_changed", "call on a random node", std::vector<u32>{1'000, 10'000, 100'000},
+      [](u32 n, std::mt19937& rng) {
+        Scene2 scene = make_scene(n, 8, rng);
+        // an eighth of the nodes per frame, marked from a clean state
+        const auto nodes = shuffled_indices(n, rng);
+        const u32 mark_cnt = std::max(n / 8, 1u);
+        return measure(mark_cnt, [&] {
+          reset_dirty_state(scene);
+          for (u32 i = 0; i < mark_cnt; i++) mark_changed(scene, static_cast<int>(nodes[i]));
+          consume(scene.dirty_node_bits[0]);
+        });
+      });
+  benches.emplace_back(
+      "apply_clip", "channel, 30 keys", std::vector<u32>{16, 128, 1'024, 8'192},
+      [](u32 n, std::mt19937& rng) {
+        const Animation clip = make_clip(n, 30, rng);
+        std::vector<NodeTransformAccumulator> accum(n);
+        std::vector<bool> dirty(n);
+        AnimationState state{.anim_id = 0};
+        return measure(clip.channels.nodes.size(), [&] {
+          std::ranges::fill(accum, NodeTransformAccumulator{});
+          state.curr_t = std::fmod(state.curr_t + .0137f, clip.duration);
+          AnimationManager::get().apply_clip(clip, state, 1.f, accum, dirty);
+          consume(accum.back().translation.x);
+        });
+      });
+  for (auto [name, lookup] : {std::pair{"skeletons_binary_search", KeyLookup::BinarySearch},
+                              std::pair{"skeletons_key_cursor", KeyLookup::Cursor},
+                              std::pair{"skeletons_resampled", KeyLookup::Resampled}}) {
+    benches.emplace_back(
+        name, "bone, n skeletons of 100 bones", std::vector<u32>{1, 10, 100},
+        [lookup](u32 n, std::mt19937& rng) { return run_skeletons(n, rng, lookup); });
+  }
+  benches.emplace_back(
+      "evaluate_blend_tree", "bone, lerp of two clips", std::vector<u32>{16, 128, 1'024, 8'192},
+      [](u32 n, std::mt19937& rng) {
+        auto setup = make_blend_setup(n, rng);
+        auto& s = *setup;
+        return measure(n, [&] {
+          std::ranges::fill(s.accum, NodeTransformAccumulator{});
+          for (auto& state : s.animation.states) {
+            state.curr_t = std::fmod(state.curr_t + .0137f, 1.f);
+          }
+          AnimationManager::get().evaluate_blend_tree(s.instance, s.animation, s.clips, s.accum,
+                                                      1.f, *s.animation.blend_tree.get_root_node());
+          consume(s.accum.back().rotation.w);
+        });
+      });
+  benches.emplace_back(
+      "get_time_indices", "lookup, n keys", std::vector<u32>{4, 32, 256, 4'096},
+      [](u32 n, std::mt19937& rng) {
+        AnimSampler sampler;
+        for (u32 k = 0; k < n; k++) sampler.inputs.emplace_back(static_cast<float>(k));
+        std::uniform_real_distribution<float> dist{0.f, static_cast<float>(n)};
+        std::vector<float> times(1'024);
+        for (auto& t : times) t = dist(rng);
+        return measure(times.size(), [&] {
+          u64 sum{};
+          for (float t : times) sum += sampler.get_time_indices(t).x;
+          consume(sum);
+        });
+      });
+  benches.emplace_back(
+      "transform_aabb", "aabb", std::vector<u32>{1'000, 10'000, 100'000, 1'000'000},
+      [](u32 n, std::mt19937& rng) {
+        std::vector<Affine> transforms(n);
+        std::vector<AABB> aabbs(n);
+        std::vector<AABB> out(n);
+        for (u32 i = 0; i < n; i++) {
+          transforms[i] = random_affine(rng);
+          aabbs[i] = AABB{.min = vec3{-1.f}, .max = vec3{static_cast<float>(i % 7) + 1.f}};
+        }
+        return measure(n, [&] {
+          for (u32 i = 0; i < n; i++) out[i] = affine::transform_aabb(transforms[i], aabbs[i]);
+          consume(out.back().max.x);
+        });
+      });
+  benches.emplace_back(
+      "calc_aabb", "vertex", std::vector<u32>{1'000, 10'000, 100'000, 1'000'000},
+      [](u32 n, std::mt19937& rng) {
+        std::uniform_real_distribution<float> dist{-100.f, 100.f};
+        std::vector<Vertex> vertices(n);
+        for (auto& v : vertices) v.pos = {dist(rng), dist(rng), dist(rng)};
+        return measure(n, [&] {
+          AABB aabb;
+          calc_aabb(aabb, vertices.data(), vertices.size(), sizeof(Vertex),
+                    offsetof(Vertex, pos));
+          consume(aabb.max.x);
+        });
+      });
+  benches.emplace_back("calc_tangents", "vertex", std::vector<u32>{32, 128, 512},
+                       [](u32 n, std::mt19937&) {
+                         // n is the grid side, so n * n vertices
+                         Grid grid = make_grid(n);
+                         const auto info = tangent_info(grid.vertices);
+                         return measure(grid.vertices.size(), [&] {
+                           calc_tangents<u32>(info, std::span(grid.indices));
+                           consume(grid.vertices.back().tangent.x);
+                         });
+                       });
+  return benches;
+}
+
+bool run_checks() {
+  bool ok = true;
+  {
+    const std::vector<Vertex> vertices{Vertex{.pos = {1, -2, 3}}, Vertex{.pos = {-4, 5, 0}},
+                                       Vertex{.pos = {0, 0, -6}}};
+    AABB aabb;
+    calc_aabb(aabb, vertices.data(), vertices.size(), sizeof(Vertex), offsetof(Vertex, pos));
+    ok &= expect(aabb.min == vec3{-4, -2, -6} && aabb.max == vec3{1, 5, 3}, "calc_aabb bounds");
+  }
+  {
+    const AABB aabb{.min = {-1, -2, -3}, .max = {1, 2, 3}};
+    const AABB moved =
+        affine::transform_aabb(Affine{glm::translate(mat4{1}, vec3{10, 0, 0})}, aabb);
+    ok &= expect(moved.min == vec3{9, -2, -3} && moved.max == vec3{11, 2, 3},
+                 "transform_aabb translation");
+  }
+  {
+    AnimSampler sampler;
+    sampler.inputs = {0.f, 1.f, 2.f, 3.f};
+    ok &= expect(sampler.get_time_indices(0.f) == uvec2{0, 1} &&
+                     sampler.get_time_indices(1.5f) == uvec2{1, 2} &&
+                     sampler.get_time_indices(3.5f) == uvec2{3, 0},
+                 "get_time_indices brackets t");
+  }
+  {
+    std::mt19937 rng{7};
+    const Animation clip = make_clip(20, 8, rng);
+    std::vector<NodeTransformAccumulator> accum(20);
+    std::vector<bool> dirty(20);
+    AnimationManager::get().apply_clip(clip, AnimationState{.anim_id = 0, .curr_t = .4f}, 1.f,
+                                       accum, dirty);
+    ok &= expect(std::ranges::all_of(accum,
+                                     [](const NodeTransformAccumulator& a) {
+                                       return a.weights == vec3{1.f};
+                                     }) &&
+                     std::ranges::all_of(dirty, [](bool d) { return d; }),
+                 "apply_clip touches every channel");
+
+    // cursors find the same keys as the binary search, forward and across the loop
+    const Animation uneven = make_clip(20, 16, rng, false);
+    std::vector<NodeTransformAccumulator> searched(20);
+    std::vector<u32> key_cursors(uneven.samplers.size());
+    bool same = true;
+    for (float t = 0.f; t < 3.f; t += .007f) {
+      const AnimationState state{.anim_id = 0, .curr_t = std::fmod(t, uneven.duration)};
+      std::ranges::fill(accum, NodeTransformAccumulator{});
+      std::ranges::fill(searched, NodeTransformAccumulator{});
+      AnimationManager::get().apply_clip(uneven, state, 1.f, accum, dirty, key_cursors);
+      AnimationManager::get().apply_clip(uneven, state, 1.f, searched, dirty);
+      same &= std::memcmp(accum.data(), searched.data(),
+                          accum.size() * sizeof(NodeTransformAccumulator)) == 0;
+    }
+    ok &= expect(same, "key cursors match the binary search");
+  }
+  {
+    // linear in time, so resampling is exact up to rounding
+    Animation clip;
+    auto& sampler = clip.samplers.emplace_back();
+    sampler.inputs = {0.f, .1f, .15f, .6f, .61f, 1.f};
+    for (float t : sampler.inputs) {
+      sampler.outputs_raw.insert(sampler.outputs_raw.end(), {t, 2 * t, -t});
+    }
+    clip.channels.nodes = {0};
+    clip.channels.sampler_indices = {0};
+    clip.channels.anim_paths = {AnimationPath::Translation};
+    prepare_animation(clip);
+    const bool was_uniform = clip.samplers[0].uniform_inv_dt > 0.f;
+    prepare_animation(clip, 30.f);
+    std::vector<NodeTransformAccumulator> accum(1);
+    std::vector<bool> dirty(1);
+    bool close = true;
+    for (float t = 0.f; t < 1.f; t += .013f) {
+      accum[0] = {};
+      AnimationManager::get().apply_clip(clip, AnimationState{.anim_id = 0, .curr_t = t}, 1.f,
+                                         accum, dirty);
+      close &= glm::all(glm::lessThan(glm::abs(accum[0].translation - vec3{t, 2 * t, -t}),
+                                      vec3{1e-4f}));
+    }
+    ok &= expect(!was_uniform && clip.samplers[0].uniform_inv_dt > 0.f &&
+                     clip.samplers[0].inputs.size() == 31 && clip.translations.size() == 1,
+                 "resampled to uniform keys");
+    ok &= expect(close, "resampled values");
+  }
+  {
+    // a single key holds for the whole clip
+    Animation clip;
+    const quat q = glm::normalize(quat{.5f, .1f, -.3f, .8f});
+    clip.samplers.emplace_back(AnimSampler{.inputs = {.25f}, .outputs_raw = {1.f, 2.f, 3.f}});
+    clip.samplers.emplace_back(AnimSampler{.inputs = {.25f}, .outputs_raw = {q.x, q.y, q.z, q.w}});
+    clip.channels.nodes = {0, 0};
+    clip.channels.sampler_indices = {0, 1};
+    clip.channels.anim_paths = {AnimationPath::Translation, AnimationPath::Rotation};
+    prepare_animation(clip, 30.f);
+    std::vector<NodeTransformAccumulator> accum(1);
+    std::vector<bool> dirty(1);
+    std::vector<u32> key_cursors(clip.samplers.size());
+    bool constant = true;
+    for (float t : {0.f, .25f, .7f}) {
+      for (bool use_cursors : {false, true}) {
+        accum[0] = {};
+        AnimationManager::get().apply_clip(
+            clip, AnimationState{.anim_id = 0, .curr_t = t}, 1.f, accum, dirty,
+            use_cursors ? std::span<u32>{key_cursors} : std::span<u32>{});
+        constant &= accum[0].translation == vec3{1.f, 2.f, 3.f} && accum[0].rotation == q;
+      }
+    }
+    ok &= expect(constant, "single key clip");
+  }
+  {
+    Grid grid = make_grid(8);
+    calc_tangents<u32>(tangent_info(grid.vertices), std::span(grid.indices));
+    ok &= expect(std::ranges::all_of(grid.vertices,
+                                     [](const Vertex& v) {
+                                       return std::abs(std::abs(v.tangent.x) - 1.f) < 1e-3f;
+                                     }),
+                 "calc_tangents follows u");
+  }
+  {
+    util::IndexAllocator allocator;
+    const u32 a = allocator.alloc();
+    const u32 b = allocator.alloc();
+    allocator.free(a);
+    ok &= expect(a != b && allocator.alloc() == a, "index allocator reuses freed indices");
+  }
+  return ok;
+}
+
+struct Sample {
+  u32 n;
+  double ns_per_op;
+};
+
+struct Result {
+  const Benchmark* bench;
+  std::vector<Sample> samples;
+  double scaling;
+};
+
+bool write_json(const std::filesystem::path& path, std::span<const Result> results) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    LERROR("failed to open {} for writing", path.string());
+    return false;
+  }
+  file << std::format(R"({{"isa":"{}","batch_ms":{},"benchmarks":[)",
+                      affine::isa_name(affine::active_isa()),
+                      std::chrono::duration<double, std::milli>(batch_time).count());
+  for (size_t i = 0; i < results.size(); i++) {
+    const auto& r = results[i];
+    file << (i ? ",\n" : "\n")
+         << std::format(R"({{"name":"{}","op":"{}","scaling":{:.3f},"results":[)", r.bench->name,
+                        r.bench->op, r.scaling);
+    for (size_t j = 0; j < r.samples.size(); j++) {
+      file << (j ? "," : "")
+           << std::format(R"({{"n":{},"ns_per_op":{:.3f}}})", r.samples[j].n,
+                          r.samples[j].ns_per_op);
+    }
+    file << "]}";
+  }
+  file << "\n]}\n";
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::filesystem::path json_path{"microbench.json"};
+  std::string filter;
+  for (int i = 1; i < argc; i++) {
+    char* arg = argv[i];
+    const bool has_value = i < argc - 1;
+    if (CMP(arg, "--json") && has_value) {
+      json_path = argv[++i];
+    } else if (CMP(arg, "--filter") && has_value) {
+      filter = argv[++i];
+    } else if (CMP(arg, "--batch-ms") && has_value) {
+      batch_time = std::chrono::milliseconds{std::max(std::atoi(argv[++i]), 1)};
+    } else {
+      LERROR("usage: vkrender2_microbench [--json out.json] [--filter substring] [--batch-ms ms]");
+      return 1;
+    }
+  }
+
+  AnimationManager::init();
+  if (!run_checks()) {
+    LERROR("microbench checks failed");
+    return 1;
+  }
+
+  std::vector<Result> results;
+  LINFO("{:<26} {:>9} {:>12}", "benchmark", "n", "ns per op");
+  const auto benches = make_benchmarks();
+  for (const auto& bench : benches) {
+    if (!filter.empty() && !std::string_view{bench.name}.contains(filter)) continue;
+    Result result{.bench = &bench};
+    std::mt19937 rng{1234};
+    for (u32 n : bench.sizes) {
+      const double ns = bench.run(n, rng);
+      result.samples.emplace_back(Sample{n, ns});
+      LINFO("{:<26} {:>9} {:>12.2f}", bench.name, n, ns);
+    }
+    const auto& first = result.samples.front();
+    const auto& last = result.samples.back();
+    result.scaling = std::log(last.ns_per_op / first.ns_per_op) /
+                     std::log(static_cast<double>(last.n) / static_cast<double>(first.n));
+    LINFO("{:<26} {:>9} {:>12.2f}  ({})", bench.name, "scaling", result.scaling, bench.op);
+    results.emplace_back(std::move(result));
+  }
+  if (!write_json(json_path, results)) {
+    return 1;
+  }
+  LINFO("wrote {}", json_path.string());
+  return 0;
+}
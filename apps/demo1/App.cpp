@@ -2,6 +2,8 @@
 
 #include <nfd.h>
 
+#include <cmath>
+#include <format>
 #include <fstream>
 #include <iostream>
 #include <tracy/Tracy.hpp>
@@ -13,6 +15,7 @@
 #include "Scene.hpp"
 #include "VkRender2.hpp"
 #include "core/Logger.hpp"
+#include "core/Timer.hpp"
 
 // clang-format off
 #include "glm/gtc/quaternion.hpp"
@@ -102,8 +105,13 @@ App::App(const InitInfo& info) : cam(&cam_data, .1) {
 
 namespace {
 
+AutoCVarInt parallel_transforms{"scene.parallel_transforms", "Parallel Transform Propagation", 1,
+                                CVarFlags::EditCheckbox};
+
 std::filesystem::path cache_dir{"./.cache"};
 std::filesystem::path cam_data_path{cache_dir / "camera.bin"};
+std::filesystem::path camera_path_path{cache_dir / "camera_path.bin"};
+std::filesystem::path camera_path_histograms_path{cache_dir / "camera_path_histograms.csv"};
 
 void save_cam(const Camera& cam) {
   if (!std::filesystem::exists(cache_dir)) {
@@ -224,6 +232,7 @@ void App::run() {
   character_cam_.set_rotation(quat{1, 0, 0, 0});
   VkRender2::get().set_env_map(env_tex);
   while (running_ && !glfwWindowShouldClose(window)) {
+    camera_path_.cpu_timer.reset();
     {
       ZoneScopedN("poll events");
       glfwPollEvents();
@@ -232,6 +241,9 @@ void App::run() {
     float curr_t = glfwGetTime();
     dt = curr_t - last_time;
     last_time = curr_t;
+    if (camera_path_.mode == CameraPathState::Mode::Replaying) {
+      dt = camera_path_fixed_dt;
+    }
 
     renderer.new_frame();
     ImGuizmo::SetOrthographic(false);
@@ -242,22 +254,50 @@ void App::run() {
 
     {
       ZoneScopedN("update transforms overall");
-      static std::vector<i32> changed_nodes;
+      static std::vector<LoadedInstanceData*> loaded_instances;
+      static std::vector<Scene2*> scenes;
+      static std::vector<std::vector<i32>> changed_nodes;
+      static std::vector<std::vector<i32>*> changed_node_ptrs;
+      static std::vector<u8> dirty_transforms;
+      loaded_instances.clear();
+      scenes.clear();
       for (auto& instance_handle : instances_) {
         auto* instance = ResourceManager::get().get_instance(instance_handle);
         if (!instance || !instance->is_model_loaded()) continue;
         VkRender2::get().update_animation(*instance, dt);
-        changed_nodes.clear();
-        validate_hierarchy(instance->scene_graph_data);
-        bool dirty_transforms =
-            recalc_global_transforms(instance->scene_graph_data, &changed_nodes);
-        if (dirty_transforms) {
-          VkRender2::get().update_transforms(*instance, changed_nodes);
+        validate_hierarchy(*instance->scene_graph_data.shared);
+        loaded_instances.emplace_back(instance);
+        scenes.emplace_back(&instance->scene_graph_data);
+      }
+      if (changed_nodes.size() < scenes.size()) {
+        changed_nodes.resize(scenes.size());
+      }
+      changed_node_ptrs.clear();
+      for (size_t i = 0; i < scenes.size(); i++) {
+        changed_nodes[i].clear();
+        changed_node_ptrs.emplace_back(&changed_nodes[i]);
+      }
+      dirty_transforms.resize(scenes.size());
+      if (parallel_transforms.get()) {
+        recalc_global_transforms_parallel(scenes, changed_node_ptrs, dirty_transforms);
+      } else {
+        for (size_t i = 0; i < scenes.size(); i++) {
+          dirty_transforms[i] = recalc_global_transforms(*scenes[i], &changed_nodes[i]);
+        }
+      }
+      for (size_t i = 0; i < loaded_instances.size(); i++) {
+        if (dirty_transforms[i]) {
+          VkRender2::get().update_transforms(*loaded_instances[i], changed_nodes[i]);
         }
-        renderer.update_skins(*instance);
+        renderer.update_skins(*loaded_instances[i]);
       }
     }
+    update_camera_path();
     renderer.draw(info_);
+    end_camera_path_frame();
+  }
+  if (camera_path_.mode == CameraPathState::Mode::Recording) {
+    stop_camera_path_recording();
   }
   save_cam(cam_data);
   shutdown();
@@ -281,6 +321,7 @@ void App::shutdown() const {
 void App::update(float dt) {
   ZoneScoped;
   cam.update_pos(dt);
+  update_spawn_benchmark();
   // if (Input::key_down(GLFW_KEY_LEFT_CONTROL)) {
   // } else {
   // update_character(dt);
@@ -427,6 +468,10 @@ void App::on_imgui() {
       cam.on_imgui();
       ImGui::TreePop();
     }
+    if (ImGui::TreeNodeEx("Camera Path")) {
+      camera_path_imgui();
+      ImGui::TreePop();
+    }
 
     ImGui::DragFloat3("Sunlight Direction", &light_dir_.x, 0.01, -10.f, 10.f);
     ImGui::DragFloat("Light Speed", &light_speed_, .01);
@@ -459,10 +504,10 @@ void App::on_imgui() {
         if (ImGui::TreeNodeEx("Transform")) {
           auto& scene = instance->scene_graph_data;
           int node = selected_node_;
-          int parent = scene.hierarchies[node].parent;
+          int parent = scene.shared->hierarchies[node].parent;
 
           if (ImGui::DragFloat3("translation", &scene.node_transforms[node].translation.x)) {
-            scene.node_transforms[node].to_mat4(scene.local_transforms[node]);
+            scene.node_transforms[node].to_affine(scene.local_transforms[node]);
             mark_changed(scene, node);
           }
           int x, y;
@@ -470,7 +515,7 @@ void App::on_imgui() {
           ImGuizmo::SetRect(0, 0, x, y);
           auto aspect = aspect_ratio();
           mat4 proj = glm::perspective(glm::radians(info_.fov_degrees), aspect, .1f, 10000.f);
-          mat4 src_transform = scene.local_transforms[node];
+          mat4 src_transform = scene.local_transforms[node].to_mat4();
           mat4 delta_mat{1};
           ImGuizmo::PushID(node);
           ImGuizmo::OPERATION operations[] = {ImGuizmo::OPERATION::TRANSLATE,
@@ -480,17 +525,17 @@ void App::on_imgui() {
             if (ImGuizmo::Manipulate(&info_.view[0][0], &proj[0][0], operation,
                                      ImGuizmo::MODE::LOCAL, &src_transform[0][0],
                                      &delta_mat[0][0])) {
-              mat4 new_t = delta_mat * scene.local_transforms[node];
-              scene.local_transforms[node] = new_t;
+              mat4 new_t = delta_mat * scene.local_transforms[node].to_mat4();
+              scene.local_transforms[node] = Affine{new_t};
               // if (parent < 0) {
               //   // scene.local_transforms[node] = new_global;
               // } else {
               //   // mat4 parent_global = scene.global_transforms[parent];
               //   // scene.local_transforms[node] = glm::inverse(parent_global) * new_global;
               // }
-              decompose_matrix(
-                  scene.local_transforms[node], scene.node_transforms[node].translation,
-                  scene.node_transforms[node].rotation, scene.node_transforms[node].scale);
+              decompose_matrix(new_t, scene.node_transforms[node].translation,
+                               scene.node_transforms[node].rotation,
+                               scene.node_transforms[node].scale);
               mark_changed(scene, node);
             }
           }
@@ -508,6 +553,16 @@ void App::on_imgui() {
       ImGui::End();
     }
 
+    if (ImGui::TreeNodeEx("Resources")) {
+      ResourceManager::get().on_imgui();
+      if (ImGui::Button("Spawn Benchmark") && !spawn_bench_.running) {
+        spawn_bench_ = {.running = true};
+        LINFO("{:>7} {:>7} {:>14} {:>12} {:>12}", "count", "path", "queue us/inst",
+              "add us/inst", "total ms");
+      }
+      ImGui::TreePop();
+    }
+
     if (ImGui::TreeNodeEx("Scene")) {
       util::fixed_vector<u32, 8> to_delete;
       size_t i = 0;
@@ -584,21 +639,22 @@ void App::on_file_drop(int count, const char** paths) {
 
 void App::scene_node_imgui(gfx::Scene2& scene, int node, u32 obj_id) {
   assert(node != -1);
-  auto it = scene.node_to_node_name_idx.find(node);
+  const auto& shared = *scene.shared;
+  auto it = shared.node_to_node_name_idx.find(node);
   ImGui::PushID(node);
   if (ImGui::TreeNode("%s", "%s",
-                      it == scene.node_to_node_name_idx.end()
+                      it == shared.node_to_node_name_idx.end()
                           ? "Node"
-                          : scene.node_names[it->second].c_str())) {
+                          : shared.node_names[it->second].c_str())) {
     ImGui::Text("node %i", node);
     if (ImGui::Button("Edit")) {
       selected_node_ = node;
       selected_obj_ = obj_id;
     }
-    auto decomp = [&](const mat4& transform) {
+    auto decomp = [&](const Affine& transform) {
       vec3 pos, scale;
       quat rot;
-      decompose_matrix(transform, pos, rot, scale);
+      decompose_matrix(transform.to_mat4(), pos, rot, scale);
       ImGui::Text("Translation: %f %f %f", pos.x, pos.y, pos.z);
       ImGui::Text("rot: %f %f %f %f", rot.x, rot.y, rot.z, rot.w);
       ImGui::Text("scale: %f %f %f", scale.x, scale.y, scale.z);
@@ -612,8 +668,8 @@ void App::scene_node_imgui(gfx::Scene2& scene, int node, u32 obj_id) {
     decomp(scene.global_transforms[node]);
     ImGui::PopID();
 
-    for (int c = scene.hierarchies[node].first_child; c != -1;
-         c = scene.hierarchies[c].next_sibling) {
+    for (int c = shared.hierarchies[node].first_child; c != -1;
+         c = shared.hierarchies[c].next_sibling) {
       scene_node_imgui(scene, c, obj_id);
     }
     ImGui::TreePop();
@@ -621,6 +677,53 @@ void App::scene_node_imgui(gfx::Scene2& scene, int node, u32 obj_id) {
   ImGui::PopID();
 }
 
+void App::update_spawn_benchmark() {
+  constexpr u32 counts[] = {1'000, 10'000, 100'000};
+  auto& bench = spawn_bench_;
+  if (!bench.running) return;
+  auto& resource_manager = ResourceManager::get();
+  const u32 count = counts[bench.step / 2];
+  const bool batched = bench.step % 2;
+  const auto model_path = resource_dir / "models/Cube/glTF/Cube.gltf";
+
+  if (bench.instances.empty()) {
+    std::vector<mat4> transforms;
+    transforms.reserve(count);
+    const auto side = static_cast<u32>(std::ceil(std::sqrt(static_cast<float>(count))));
+    for (u32 i = 0; i < count; i++) {
+      const vec3 pos{static_cast<float>(i % side), 0.f, static_cast<float>(i / side)};
+      transforms.emplace_back(glm::translate(mat4{1}, pos * 3.f));
+    }
+    resource_manager.reset_spawn_stats();
+    Timer timer;
+    if (batched) {
+      bench.instances = resource_manager.load_models(model_path, transforms);
+    } else {
+      bench.instances.reserve(count);
+      for (const auto& transform : transforms) {
+        bench.instances.emplace_back(resource_manager.load_model(model_path, transform));
+      }
+    }
+    bench.issue_micros = timer.elapsed_micro();
+    return;
+  }
+
+  // added in ResourceManager::update, possibly a few frames later if the model is loading
+  const auto& stats = resource_manager.get_spawn_stats();
+  if (stats.instance_cnt < count) return;
+  LINFO("{:>7} {:>7} {:>14.3f} {:>12.3f} {:>12.3f}", count, batched ? "batch" : "single",
+        static_cast<double>(bench.issue_micros) / count,
+        static_cast<double>(stats.micros) / count,
+        static_cast<double>(bench.issue_micros + stats.micros) * .001);
+  for (auto handle : bench.instances) {
+    resource_manager.remove_model(handle);
+  }
+  bench.instances.clear();
+  if (++bench.step == 2 * COUNTOF(counts)) {
+    bench.running = false;
+  }
+}
+
 u32 App::add_instance(const std::filesystem::path& model, const mat4& transform) {
   u32 ret = instances_.size();
   instances_.emplace_back(ResourceManager::get().load_model(model, transform));
@@ -654,7 +757,7 @@ void App::update_character(float dt) {
     character_fsm_.update(dt, speed);
     auto desired_rot = glm::quatLookAt(last_look_dir_, character_cam_.up);
     nt.rotation = glm::slerp(nt.rotation, desired_rot, .1f);
-    instance->scene_graph_data.node_transforms[0].to_mat4(
+    instance->scene_graph_data.node_transforms[0].to_affine(
         instance->scene_graph_data.local_transforms[0]);
     mark_changed(instance->scene_graph_data, 0);
   }
@@ -690,3 +793,151 @@ void CharacterFSM::update([[maybe_unused]] float dt, float speed) {
   LINFO("{} prev", state_to_string(prev_state));
   LINFO("{} jump", jump_time_remaining);
 }
+
+void App::reset_animation_time() {
+  for (auto handle : instances_) {
+    auto* instance = ResourceManager::get().get_instance(handle);
+    if (!instance) continue;
+    auto* animation = AnimationManager::get().get_animation(instance->animation_id);
+    if (!animation) continue;
+    for (auto& state : animation->states) {
+      state.curr_t = 0.f;
+      state.active = true;
+    }
+  }
+}
+
+void App::start_camera_path_recording() {
+  camera_path_.frames.clear();
+  camera_path_.mode = CameraPathState::Mode::Recording;
+  reset_animation_time();
+}
+
+void App::stop_camera_path_recording() {
+  camera_path_.mode = CameraPathState::Mode::None;
+  if (!std::filesystem::exists(cache_dir)) {
+    std::filesystem::create_directory(cache_dir);
+  }
+  if (!save_camera_path(camera_path_path, camera_path_.frames)) {
+    LERROR("failed to save camera path to {}", camera_path_path.string());
+    return;
+  }
+  LINFO("saved {} camera path frames to {}", camera_path_.frames.size(),
+        camera_path_path.string());
+}
+
+void App::start_camera_path_replay() {
+  auto frames = load_camera_path(camera_path_path);
+  if (!frames || frames->empty()) {
+    LERROR("failed to load camera path from {}", camera_path_path.string());
+    return;
+  }
+  camera_path_.frames = std::move(*frames);
+  camera_path_.mode = CameraPathState::Mode::Replaying;
+  camera_path_.replay_frame = 0;
+  camera_path_.first_frame_num = Device::get().curr_frame_num();
+  camera_path_.last_gpu_frame_num = UINT32_MAX;
+  camera_path_.frame_ms.clear();
+  camera_path_.cpu_ms.clear();
+  camera_path_.gpu_ms.clear();
+  camera_path_.frame_timer.reset();
+  reset_animation_time();
+}
+
+void App::stop_camera_path_replay() {
+  camera_path_.mode = CameraPathState::Mode::None;
+  const auto log_histogram = [](const char* name, const util::Histogram& h) {
+    LINFO("{:<6} mean {:.3f} p50 {:.2f} p95 {:.2f} p99 {:.2f} max {:.3f} ms over {} frames", name,
+          h.get_mean(), h.get_percentile(.5), h.get_percentile(.95), h.get_percentile(.99),
+          h.get_max(), h.get_count());
+  };
+  log_histogram("frame", camera_path_.frame_ms);
+  log_histogram("cpu", camera_path_.cpu_ms);
+  log_histogram("gpu", camera_path_.gpu_ms);
+
+  std::ofstream file(camera_path_histograms_path);
+  if (!file.is_open()) {
+    LERROR("failed to write {}", camera_path_histograms_path.string());
+    return;
+  }
+  file << "bin_start_ms,frame,cpu,gpu\n";
+  const auto& frame_bins = camera_path_.frame_ms.get_bins();
+  for (size_t i = 0; i < frame_bins.size(); i++) {
+    file << std::format("{:.2f},{},{},{}\n",
+                        static_cast<double>(i) * camera_path_.frame_ms.get_bin_width(),
+                        frame_bins[i], camera_path_.cpu_ms.get_bins()[i],
+                        camera_path_.gpu_ms.get_bins()[i]);
+  }
+  LINFO("wrote camera path histograms to {}", camera_path_histograms_path.string());
+}
+
+void App::update_camera_path() {
+  auto& path = camera_path_;
+  if (path.mode == CameraPathState::Mode::Recording) {
+    path.frames.emplace_back(CameraPathFrame{.pos = cam_data.pos,
+                                             .pitch = cam_data.pitch,
+                                             .yaw = cam_data.yaw,
+                                             .light_dir = info_.light_dir,
+                                             .light_color = info_.light_color,
+                                             .ambient_intensity = info_.ambient_intensity,
+                                             .fov_degrees = info_.fov_degrees});
+  } else if (path.mode == CameraPathState::Mode::Replaying) {
+    const auto& frame = path.frames[path.replay_frame];
+    cam_data.pos = frame.pos;
+    cam_data.pitch = frame.pitch;
+    cam_data.yaw = frame.yaw;
+    cam_data.update_vectors();
+    info_.view = cam_data.get_view();
+    info_.view_pos = cam_data.pos;
+    info_.light_dir = frame.light_dir;
+    info_.light_color = frame.light_color;
+    info_.ambient_intensity = frame.ambient_intensity;
+    info_.fov_degrees = frame.fov_degrees;
+  }
+}
+
+void App::end_camera_path_frame() {
+  auto& path = camera_path_;
+  if (path.mode != CameraPathState::Mode::Replaying) return;
+  path.frame_ms.add(path.frame_timer.elapsed_ms());
+  path.frame_timer.reset();
+  path.cpu_ms.add(path.cpu_timer.elapsed_ms() - Device::get().get_last_fence_wait_ms());
+  // timestamps of frames from before the replay are still being read back at its start
+  const auto* gpu_frame = VkRender2::get().get_profiler().get_last_resolved_frame();
+  if (gpu_frame && gpu_frame->frame_num != path.last_gpu_frame_num &&
+      gpu_frame->frame_num >= path.first_frame_num && !gpu_frame->gpu_scopes.empty()) {
+    path.last_gpu_frame_num = gpu_frame->frame_num;
+    path.gpu_ms.add(get_gpu_frame_ms(*gpu_frame));
+  }
+  if (++path.replay_frame == path.frames.size()) {
+    stop_camera_path_replay();
+  }
+}
+
+void App::camera_path_imgui() {
+  auto& path = camera_path_;
+  switch (path.mode) {
+    case CameraPathState::Mode::None:
+      if (ImGui::Button("Record")) {
+        start_camera_path_recording();
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Replay")) {
+        start_camera_path_replay();
+      }
+      ImGui::Text("%s", camera_path_path.string().c_str());
+      break;
+    case CameraPathState::Mode::Recording:
+      if (ImGui::Button("Stop Recording")) {
+        stop_camera_path_recording();
+      }
+      ImGui::Text("Recorded %zu frames", path.frames.size());
+      break;
+    case CameraPathState::Mode::Replaying:
+      if (ImGui::Button("Stop Replay")) {
+        stop_camera_path_replay();
+      }
+      ImGui::Text("Frame %u / %zu", path.replay_frame, path.frames.size());
+      break;
+  }
+}
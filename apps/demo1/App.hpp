@@ -4,8 +4,11 @@
 
 #include "Animation.hpp"
 #include "Camera.hpp"
+#include "CameraPath.hpp"
 #include "Common.hpp"
 #include "VkRender2.hpp"
+#include "core/Timer.hpp"
+#include "util/Histogram.hpp"
 struct GLFWwindow;
 
 struct CharacterFSM {
@@ -102,4 +105,44 @@ struct App {
   LoadedInstanceData* get_instance(u32 instance);
   int selected_node_{-1};
   int selected_obj_{-1};
+
+  // Measures cpu spawn cost per instance with load_model vs load_models. Each step spawns a batch
+  // of cubes, waits for ResourceManager to add them, logs the timings and removes them.
+  struct SpawnBenchmark {
+    std::vector<InstanceHandle> instances;
+    u64 issue_micros{};
+    u32 step{};
+    bool running{};
+  } spawn_bench_;
+  void update_spawn_benchmark();
+
+  // Records the camera and draw info every frame, or replays a recording with a fixed dt while
+  // collecting frame, cpu and gpu time histograms, so fly-throughs can be compared across builds.
+  // Cpu time leaves out waiting on the frame fences. Gpu times lag frames_in_flight frames behind
+  // and the last ones of a replay are never read back.
+  struct CameraPathState {
+    enum class Mode : u8 { None, Recording, Replaying };
+    Mode mode{Mode::None};
+    std::vector<gfx::CameraPathFrame> frames;
+    u32 replay_frame{};
+    u32 first_frame_num{};
+    u32 last_gpu_frame_num{UINT32_MAX};
+    Timer frame_timer;
+    Timer cpu_timer;
+    // 0.25 ms bins up to 100 ms
+    util::Histogram frame_ms{.25, 400};
+    util::Histogram cpu_ms{.25, 400};
+    util::Histogram gpu_ms{.25, 400};
+  } camera_path_;
+  void start_camera_path_recording();
+  void stop_camera_path_recording();
+  void start_camera_path_replay();
+  void stop_camera_path_replay();
+  // before draw: appends the frame's camera and draw info, or applies the replayed frame's
+  void update_camera_path();
+  // after draw
+  void end_camera_path_frame();
+  void camera_path_imgui();
+  // so recordings and replays start their animations at the same time
+  void reset_animation_time();
 };
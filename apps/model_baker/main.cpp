@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ModelCache.hpp"
+#include "SceneLoader.hpp"
+#include "core/Logger.hpp"
+#include "core/Timer.hpp"
+
+// Writes the model cache for every .gltf/.glb under a directory, then reads each cache back and
+// compares it against the parse. Prints cold parse time against cache load time per model.
+// usage: model_baker <model directory or file>
+
+using namespace gfx;
+
+namespace {
+
+bool is_model(const std::filesystem::path& path) {
+  const auto ext = path.extension();
+  return ext == ".gltf" || ext == ".glb";
+}
+
+bool matches(const ModelCpuData& a, const ModelCpuData& b) {
+  const auto& sa = a.scene_graph_data;
+  const auto& sb = b.scene_graph_data;
+  return a.vertices.size() == b.vertices.size() && a.indices.size() == b.indices.size() &&
+         a.animated_vertices.size() == b.animated_vertices.size() &&
+         std::ranges::equal(a.indices, b.indices) &&
+         a.mesh_draw_infos.size() == b.mesh_draw_infos.size() &&
+         a.materials.size() == b.materials.size() && a.images.size() == b.images.size() &&
+         a.animations.size() == b.animations.size() && sa.node_count() == sb.node_count() &&
+         sa.shared->node_names == sb.shared->node_names &&
+         sa.shared->skins.size() == sb.shared->skins.size();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    LERROR("usage: model_baker <model directory or file>");
+    return 1;
+  }
+  const std::filesystem::path root = argv[1];
+  std::vector<std::filesystem::path> models;
+  if (std::filesystem::is_directory(root)) {
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+      if (entry.is_regular_file() && is_model(entry.path())) {
+        models.emplace_back(entry.path());
+      }
+    }
+  } else if (is_model(root)) {
+    models.emplace_back(root);
+  }
+  if (models.empty()) {
+    LERROR("no .gltf or .glb files found at {}", root.string());
+    return 1;
+  }
+  std::ranges::sort(models);
+
+  u32 failures{};
+  double total_parse_ms{};
+  double total_cache_ms{};
+  LINFO("{:<48} {:>12} {:>12} {:>12}", "model", "parse ms", "cache ms", "cache KB");
+  for (const auto& path : models) {
+    Timer timer;
+    auto parsed = parse_gltf(path);
+    const double parse_ms = timer.elapsed_ms();
+    if (!parsed) {
+      LERROR("failed to parse {}", path.string());
+      failures++;
+      continue;
+    }
+    if (!write_model_cache(path, *parsed)) {
+      LERROR("failed to write cache for {}", path.string());
+      failures++;
+      continue;
+    }
+    timer.reset();
+    auto cached = read_model_cache(path);
+    const double cache_ms = timer.elapsed_ms();
+    if (!cached || !matches(*parsed, *cached)) {
+      LERROR("cache for {} does not match the parsed model", path.string());
+      failures++;
+      continue;
+    }
+    total_parse_ms += parse_ms;
+    total_cache_ms += cache_ms;
+    const auto cache_kb = std::filesystem::file_size(get_model_cache_path(path)) / 1024;
+    LINFO("{:<48} {:>12.2f} {:>12.2f} {:>12}", path.filename().string(), parse_ms, cache_ms,
+          cache_kb);
+  }
+  LINFO("{:<48} {:>12.2f} {:>12.2f}", "total", total_parse_ms, total_cache_ms);
+  if (failures) {
+    LERROR("{} of {} models failed", failures, models.size());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,36 @@
+#version 460
+
+#extension GL_GOOGLE_include_directive : enable
+
+#include "resources.h.glsl"
+#include "./geometry_common.h.glsl"
+#include "./scatter_object_data_common.h.glsl"
+
+layout(local_size_x = 64) in;
+
+// matches gfx::ObjectDataScatter
+struct ObjectDataScatter {
+    ObjectData data;
+    uint dst_i;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(std430, buffer_reference) readonly buffer ObjectDataScatters {
+    ObjectDataScatter scatters[];
+};
+
+layout(std430, buffer_reference) writeonly buffer OutObjectDatas {
+    ObjectData datas[];
+};
+
+// destinations are unique, see gfx::sort_and_dedupe
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= cnt) {
+        return;
+    }
+    ObjectDataScatter scatter = ObjectDataScatters(scatter_buf).scatters[index];
+    OutObjectDatas(object_data_buf).datas[scatter.dst_i] = scatter.data;
+}
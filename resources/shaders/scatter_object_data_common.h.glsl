@@ -0,0 +1,10 @@
+#ifndef SCATTER_OBJECT_DATA_COMMON_H
+#define SCATTER_OBJECT_DATA_COMMON_H
+
+VK2_DECLARE_ARGUMENTS(ScatterObjectDataPushConstants){
+u64 scatter_buf;
+u64 object_data_buf;
+u32 cnt;
+} ;
+
+#endif
@@ -0,0 +1,418 @@
+#include "Affine.hpp"
+
+#include <cassert>
+#include <glm/common.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define AFFINE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define AFFINE_X86 0
+#endif
+
+#if AFFINE_X86 && (defined(__GNUC__) || defined(__clang__))
+#define AFFINE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define AFFINE_TARGET_AVX2
+#endif
+
+namespace affine {
+
+namespace {
+
+void mul_scalar(Affine& out, const Affine& a, const Affine& b) {
+  const vec4 w_only{0.f, 0.f, 0.f, 1.f};
+  for (int r = 0; r < 3; r++) {
+    const vec4& ar = a.rows[r];
+    out.rows[r] = (ar.x * b.rows[0]) + (ar.y * b.rows[1]) + (ar.z * b.rows[2]) + (ar.w * w_only);
+  }
+}
+
+Affine inverse_scalar(const Affine& m) {
+  const vec3 r0{m.rows[0]};
+  const vec3 r1{m.rows[1]};
+  const vec3 r2{m.rows[2]};
+  // columns of the inverse of the linear part
+  const vec3 c0 = glm::cross(r1, r2);
+  const vec3 c1 = glm::cross(r2, r0);
+  const vec3 c2 = glm::cross(r0, r1);
+  const float inv_det = 1.f / glm::dot(r0, c0);
+  const vec3 ic0 = c0 * inv_det;
+  const vec3 ic1 = c1 * inv_det;
+  const vec3 ic2 = c2 * inv_det;
+  const vec3 t = m.get_translation();
+  const vec3 it = -((ic0 * t.x) + (ic1 * t.y) + (ic2 * t.z));
+  Affine result;
+  result.rows[0] = {ic0.x, ic1.x, ic2.x, it.x};
+  result.rows[1] = {ic0.y, ic1.y, ic2.y, it.y};
+  result.rows[2] = {ic0.z, ic1.z, ic2.z, it.z};
+  return result;
+}
+
+// https://stackoverflow.com/questions/6053522/how-to-recalculate-axis-aligned-bounding-box-after-translate-rotate/58630206#58630206
+AABB transform_aabb_scalar(const Affine& m, const AABB& aabb) {
+  AABB result;
+  result.min = m.get_translation();
+  result.max = result.min;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      float a = m.rows[i][j] * aabb.min[j];
+      float b = m.rows[i][j] * aabb.max[j];
+      result.min[i] += glm::min(a, b);
+      result.max[i] += glm::max(a, b);
+    }
+  }
+  return result;
+}
+
+void propagate_scalar(Affine* globals, const Affine* locals, std::span<const u32> nodes,
+                      std::span<const i32> parents) {
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const u32 node = nodes[i];
+    if (parents[i] < 0) {
+      globals[node] = locals[node];
+    } else {
+      mul_scalar(globals[node], globals[parents[i]], locals[node]);
+    }
+  }
+}
+
+void mul_gather_to_mat4_scalar(mat4* out, const Affine* a, std::span<const u32> a_indices,
+                               const Affine* b) {
+  for (size_t i = 0; i < a_indices.size(); i++) {
+    Affine result;
+    mul_scalar(result, a[a_indices[i]], b[i]);
+    out[i] = result.to_mat4();
+  }
+}
+
+#if AFFINE_X86
+
+inline __m128 w_mask() { return _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0)); }
+
+inline __m128 splat(__m128 v, int lane) {
+  switch (lane) {
+    case 0:
+      return _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+    case 1:
+      return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+    default:
+      return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+  }
+}
+
+inline void mul_sse(Affine& out, const Affine& a, const Affine& b) {
+  const __m128 b0 = _mm_loadu_ps(&b.rows[0].x);
+  const __m128 b1 = _mm_loadu_ps(&b.rows[1].x);
+  const __m128 b2 = _mm_loadu_ps(&b.rows[2].x);
+  const __m128 mask = w_mask();
+  for (int r = 0; r < 3; r++) {
+    const __m128 ar = _mm_loadu_ps(&a.rows[r].x);
+    __m128 res = _mm_mul_ps(splat(ar, 0), b0);
+    res = _mm_add_ps(res, _mm_mul_ps(splat(ar, 1), b1));
+    res = _mm_add_ps(res, _mm_mul_ps(splat(ar, 2), b2));
+    res = _mm_add_ps(res, _mm_and_ps(ar, mask));
+    _mm_storeu_ps(&out.rows[r].x, res);
+  }
+}
+
+inline __m128 cross_sse(__m128 a, __m128 b) {
+  const __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+  const __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+  const __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+  return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+Affine inverse_sse(const Affine& m) {
+  const __m128 r0 = _mm_loadu_ps(&m.rows[0].x);
+  const __m128 r1 = _mm_loadu_ps(&m.rows[1].x);
+  const __m128 r2 = _mm_loadu_ps(&m.rows[2].x);
+  const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+  const __m128 l0 = _mm_and_ps(r0, xyz);
+  const __m128 l1 = _mm_and_ps(r1, xyz);
+  const __m128 l2 = _mm_and_ps(r2, xyz);
+  // columns of the inverse of the linear part, w = 0
+  __m128 c0 = cross_sse(l1, l2);
+  __m128 c1 = cross_sse(l2, l0);
+  __m128 c2 = cross_sse(l0, l1);
+  const __m128 det_v = _mm_mul_ps(l0, c0);
+  const float det = _mm_cvtss_f32(_mm_add_ss(
+      _mm_add_ss(det_v, _mm_shuffle_ps(det_v, det_v, 1)), _mm_movehl_ps(det_v, det_v)));
+  const __m128 inv_det = _mm_set1_ps(1.f / det);
+  c0 = _mm_mul_ps(c0, inv_det);
+  c1 = _mm_mul_ps(c1, inv_det);
+  c2 = _mm_mul_ps(c2, inv_det);
+  // translation (r0.w, r1.w, r2.w) broadcast per component
+  __m128 t = _mm_mul_ps(c0, _mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 3, 3, 3)));
+  t = _mm_add_ps(t, _mm_mul_ps(c1, _mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 3, 3, 3))));
+  t = _mm_add_ps(t, _mm_mul_ps(c2, _mm_shuffle_ps(r2, r2, _MM_SHUFFLE(3, 3, 3, 3))));
+  t = _mm_sub_ps(_mm_setzero_ps(), t);
+  // rows of [c0 c1 c2 t] are the rows of the result
+  _MM_TRANSPOSE4_PS(c0, c1, c2, t);
+  Affine result;
+  _mm_storeu_ps(&result.rows[0].x, c0);
+  _mm_storeu_ps(&result.rows[1].x, c1);
+  _mm_storeu_ps(&result.rows[2].x, c2);
+  return result;
+}
+
+inline AABB store_aabb(__m128 center, __m128 extent) {
+  alignas(16) float lo[4];
+  alignas(16) float hi[4];
+  _mm_store_ps(lo, _mm_sub_ps(center, extent));
+  _mm_store_ps(hi, _mm_add_ps(center, extent));
+  return AABB{.min = {lo[0], lo[1], lo[2]}, .max = {hi[0], hi[1], hi[2]}};
+}
+
+AABB transform_aabb_sse(const Affine& m, const AABB& aabb) {
+  __m128 c0 = _mm_loadu_ps(&m.rows[0].x);
+  __m128 c1 = _mm_loadu_ps(&m.rows[1].x);
+  __m128 c2 = _mm_loadu_ps(&m.rows[2].x);
+  __m128 c3 = _mm_setzero_ps();
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  const __m128 half = _mm_set1_ps(.5f);
+  const __m128 mn = _mm_setr_ps(aabb.min.x, aabb.min.y, aabb.min.z, 0.f);
+  const __m128 mx = _mm_setr_ps(aabb.max.x, aabb.max.y, aabb.max.z, 0.f);
+  const __m128 center = _mm_mul_ps(_mm_add_ps(mn, mx), half);
+  const __m128 extent = _mm_mul_ps(_mm_sub_ps(mx, mn), half);
+  __m128 new_center = _mm_add_ps(c3, _mm_mul_ps(c0, splat(center, 0)));
+  new_center = _mm_add_ps(new_center, _mm_mul_ps(c1, splat(center, 1)));
+  new_center = _mm_add_ps(new_center, _mm_mul_ps(c2, splat(center, 2)));
+  __m128 new_extent = _mm_mul_ps(_mm_and_ps(c0, abs_mask), splat(extent, 0));
+  new_extent = _mm_add_ps(new_extent, _mm_mul_ps(_mm_and_ps(c1, abs_mask), splat(extent, 1)));
+  new_extent = _mm_add_ps(new_extent, _mm_mul_ps(_mm_and_ps(c2, abs_mask), splat(extent, 2)));
+  return store_aabb(new_center, new_extent);
+}
+
+void propagate_sse(Affine* globals, const Affine* locals, std::span<const u32> nodes,
+                   std::span<const i32> parents) {
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const u32 node = nodes[i];
+    if (parents[i] < 0) {
+      globals[node] = locals[node];
+    } else {
+      mul_sse(globals[node], globals[parents[i]], locals[node]);
+    }
+  }
+}
+
+void mul_gather_to_mat4_sse(mat4* out, const Affine* a, std::span<const u32> a_indices,
+                            const Affine* b) {
+  const __m128 w_one = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+  for (size_t i = 0; i < a_indices.size(); i++) {
+    Affine result;
+    mul_sse(result, a[a_indices[i]], b[i]);
+    __m128 r0 = _mm_loadu_ps(&result.rows[0].x);
+    __m128 r1 = _mm_loadu_ps(&result.rows[1].x);
+    __m128 r2 = _mm_loadu_ps(&result.rows[2].x);
+    __m128 r3 = w_one;
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(&out[i][0].x, r0);
+    _mm_storeu_ps(&out[i][1].x, r1);
+    _mm_storeu_ps(&out[i][2].x, r2);
+    _mm_storeu_ps(&out[i][3].x, r3);
+  }
+}
+
+// Rows 0 and 1 are multiplied together in one 256 bit register, row 2 in a 128 bit one.
+AFFINE_TARGET_AVX2 inline void mul_avx2(Affine& out, const Affine& a, const Affine& b) {
+  const __m128 b0 = _mm_loadu_ps(&b.rows[0].x);
+  const __m128 b1 = _mm_loadu_ps(&b.rows[1].x);
+  const __m128 b2 = _mm_loadu_ps(&b.rows[2].x);
+  const __m256 bb0 = _mm256_set_m128(b0, b0);
+  const __m256 bb1 = _mm256_set_m128(b1, b1);
+  const __m256 bb2 = _mm256_set_m128(b2, b2);
+  const __m256 mask8 = _mm256_castsi256_ps(_mm256_set_epi32(-1, 0, 0, 0, -1, 0, 0, 0));
+  const __m256 a01 = _mm256_loadu_ps(&a.rows[0].x);
+  __m256 r01 = _mm256_and_ps(a01, mask8);
+  r01 = _mm256_fmadd_ps(_mm256_permute_ps(a01, _MM_SHUFFLE(0, 0, 0, 0)), bb0, r01);
+  r01 = _mm256_fmadd_ps(_mm256_permute_ps(a01, _MM_SHUFFLE(1, 1, 1, 1)), bb1, r01);
+  r01 = _mm256_fmadd_ps(_mm256_permute_ps(a01, _MM_SHUFFLE(2, 2, 2, 2)), bb2, r01);
+  _mm256_storeu_ps(&out.rows[0].x, r01);
+
+  const __m128 a2 = _mm_loadu_ps(&a.rows[2].x);
+  __m128 r2 = _mm_and_ps(a2, _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0)));
+  r2 = _mm_fmadd_ps(_mm_permute_ps(a2, _MM_SHUFFLE(0, 0, 0, 0)), b0, r2);
+  r2 = _mm_fmadd_ps(_mm_permute_ps(a2, _MM_SHUFFLE(1, 1, 1, 1)), b1, r2);
+  r2 = _mm_fmadd_ps(_mm_permute_ps(a2, _MM_SHUFFLE(2, 2, 2, 2)), b2, r2);
+  _mm_storeu_ps(&out.rows[2].x, r2);
+}
+
+AFFINE_TARGET_AVX2 AABB transform_aabb_avx2(const Affine& m, const AABB& aabb) {
+  __m128 c0 = _mm_loadu_ps(&m.rows[0].x);
+  __m128 c1 = _mm_loadu_ps(&m.rows[1].x);
+  __m128 c2 = _mm_loadu_ps(&m.rows[2].x);
+  __m128 c3 = _mm_setzero_ps();
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  const __m128 half = _mm_set1_ps(.5f);
+  const __m128 mn = _mm_setr_ps(aabb.min.x, aabb.min.y, aabb.min.z, 0.f);
+  const __m128 mx = _mm_setr_ps(aabb.max.x, aabb.max.y, aabb.max.z, 0.f);
+  const __m128 center = _mm_mul_ps(_mm_add_ps(mn, mx), half);
+  const __m128 extent = _mm_mul_ps(_mm_sub_ps(mx, mn), half);
+  __m128 new_center = _mm_fmadd_ps(c0, _mm_permute_ps(center, _MM_SHUFFLE(0, 0, 0, 0)), c3);
+  new_center = _mm_fmadd_ps(c1, _mm_permute_ps(center, _MM_SHUFFLE(1, 1, 1, 1)), new_center);
+  new_center = _mm_fmadd_ps(c2, _mm_permute_ps(center, _MM_SHUFFLE(2, 2, 2, 2)), new_center);
+  __m128 new_extent =
+      _mm_mul_ps(_mm_and_ps(c0, abs_mask), _mm_permute_ps(extent, _MM_SHUFFLE(0, 0, 0, 0)));
+  new_extent = _mm_fmadd_ps(_mm_and_ps(c1, abs_mask),
+                            _mm_permute_ps(extent, _MM_SHUFFLE(1, 1, 1, 1)), new_extent);
+  new_extent = _mm_fmadd_ps(_mm_and_ps(c2, abs_mask),
+                            _mm_permute_ps(extent, _MM_SHUFFLE(2, 2, 2, 2)), new_extent);
+  return store_aabb(new_center, new_extent);
+}
+
+AFFINE_TARGET_AVX2 void propagate_avx2(Affine* globals, const Affine* locals,
+                                       std::span<const u32> nodes, std::span<const i32> parents) {
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const u32 node = nodes[i];
+    if (parents[i] < 0) {
+      globals[node] = locals[node];
+    } else {
+      mul_avx2(globals[node], globals[parents[i]], locals[node]);
+    }
+  }
+}
+
+AFFINE_TARGET_AVX2 void mul_gather_to_mat4_avx2(mat4* out, const Affine* a,
+                                                std::span<const u32> a_indices, const Affine* b) {
+  const __m128 w_one = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+  for (size_t i = 0; i < a_indices.size(); i++) {
+    Affine result;
+    mul_avx2(result, a[a_indices[i]], b[i]);
+    __m128 r0 = _mm_loadu_ps(&result.rows[0].x);
+    __m128 r1 = _mm_loadu_ps(&result.rows[1].x);
+    __m128 r2 = _mm_loadu_ps(&result.rows[2].x);
+    __m128 r3 = w_one;
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(&out[i][0].x, r0);
+    _mm_storeu_ps(&out[i][1].x, r1);
+    _mm_storeu_ps(&out[i][2].x, r2);
+    _mm_storeu_ps(&out[i][3].x, r3);
+  }
+}
+
+bool cpu_supports_avx2() {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) return false;
+  __cpuid(info, 1);
+  const bool fma = info[2] & (1 << 12);
+  const bool osxsave = info[2] & (1 << 27);
+  if (!fma || !osxsave) return false;
+  // os saves ymm state
+  if ((_xgetbv(0) & 0x6) != 0x6) return false;
+  __cpuidex(info, 7, 0);
+  return info[1] & (1 << 5);
+#else
+  return false;
+#endif
+}
+
+#endif  // AFFINE_X86
+
+void mul_dispatch_scalar(Affine& out, const Affine& a, const Affine& b) { mul_scalar(out, a, b); }
+
+#if AFFINE_X86
+void mul_dispatch_sse(Affine& out, const Affine& a, const Affine& b) { mul_sse(out, a, b); }
+AFFINE_TARGET_AVX2 void mul_dispatch_avx2(Affine& out, const Affine& a, const Affine& b) {
+  mul_avx2(out, a, b);
+}
+#endif
+
+struct Kernels {
+  void (*mul)(Affine& out, const Affine& a, const Affine& b);
+  Affine (*inverse)(const Affine& m);
+  AABB (*transform_aabb)(const Affine& m, const AABB& aabb);
+  void (*propagate)(Affine* globals, const Affine* locals, std::span<const u32> nodes,
+                    std::span<const i32> parents);
+  void (*mul_gather_to_mat4)(mat4* out, const Affine* a, std::span<const u32> a_indices,
+                             const Affine* b);
+};
+
+Kernels get_kernels(Isa isa) {
+  switch (isa) {
+#if AFFINE_X86
+    case Isa::AVX2:
+      // inverse is latency bound on the dependent cross products, fma buys nothing there
+      return {mul_dispatch_avx2, inverse_sse, transform_aabb_avx2, propagate_avx2,
+              mul_gather_to_mat4_avx2};
+    case Isa::SSE:
+      return {mul_dispatch_sse, inverse_sse, transform_aabb_sse, propagate_sse,
+              mul_gather_to_mat4_sse};
+#endif
+    default:
+      return {mul_dispatch_scalar, inverse_scalar, transform_aabb_scalar, propagate_scalar,
+              mul_gather_to_mat4_scalar};
+  }
+}
+
+Isa detect_isa() {
+#if AFFINE_X86
+  // sse2 is baseline on x86-64
+  return cpu_supports_avx2() ? Isa::AVX2 : Isa::SSE;
+#else
+  return Isa::Scalar;
+#endif
+}
+
+const Isa g_detected_isa = detect_isa();
+Isa g_active_isa = g_detected_isa;
+Kernels g_kernels = get_kernels(g_detected_isa);
+
+}  // namespace
+
+Isa detected_isa() { return g_detected_isa; }
+
+Isa active_isa() { return g_active_isa; }
+
+const char* isa_name(Isa isa) {
+  switch (isa) {
+    case Isa::Scalar:
+      return "scalar";
+    case Isa::SSE:
+      return "sse";
+    case Isa::AVX2:
+      return "avx2";
+  }
+  return "";
+}
+
+void set_isa(Isa isa) {
+  if (static_cast<u8>(isa) > static_cast<u8>(g_detected_isa)) {
+    isa = g_detected_isa;
+  }
+  g_active_isa = isa;
+  g_kernels = get_kernels(isa);
+}
+
+Affine mul(const Affine& a, const Affine& b) {
+  Affine result;
+  g_kernels.mul(result, a, b);
+  return result;
+}
+
+Affine inverse(const Affine& m) { return g_kernels.inverse(m); }
+
+AABB transform_aabb(const Affine& m, const AABB& aabb) { return g_kernels.transform_aabb(m, aabb); }
+
+void propagate(Affine* globals, const Affine* locals, std::span<const u32> nodes,
+               std::span<const i32> parents) {
+  assert(nodes.size() == parents.size());
+  g_kernels.propagate(globals, locals, nodes, parents);
+}
+
+void mul_gather_to_mat4(mat4* out, const Affine* a, std::span<const u32> a_indices,
+                        const Affine* b) {
+  g_kernels.mul_gather_to_mat4(out, a, a_indices, b);
+}
+
+}  // namespace affine
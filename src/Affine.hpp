@@ -0,0 +1,60 @@
+#pragma once
+
+#include <span>
+
+#include "AABB.hpp"
+#include "Common.hpp"
+
+// Affine transform stored as the top three rows of a column-major mat4. The implicit fourth row is
+// (0, 0, 0, 1). 48 bytes instead of 64, and a multiply is 9 vector fmas instead of 16.
+struct Affine {
+  // rows[r] = (m[0][r], m[1][r], m[2][r], m[3][r])
+  vec4 rows[3]{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}};
+
+  Affine() = default;
+  explicit Affine(const mat4& m)
+      : rows{{m[0][0], m[1][0], m[2][0], m[3][0]},
+             {m[0][1], m[1][1], m[2][1], m[3][1]},
+             {m[0][2], m[1][2], m[2][2], m[3][2]}} {}
+
+  [[nodiscard]] mat4 to_mat4() const {
+    return mat4{vec4{rows[0].x, rows[1].x, rows[2].x, 0.f},
+                vec4{rows[0].y, rows[1].y, rows[2].y, 0.f},
+                vec4{rows[0].z, rows[1].z, rows[2].z, 0.f},
+                vec4{rows[0].w, rows[1].w, rows[2].w, 1.f}};
+  }
+  [[nodiscard]] vec3 get_translation() const { return {rows[0].w, rows[1].w, rows[2].w}; }
+  bool operator==(const Affine& other) const {
+    return rows[0] == other.rows[0] && rows[1] == other.rows[1] && rows[2] == other.rows[2];
+  }
+};
+
+static_assert(sizeof(Affine) == sizeof(float) * 12);
+
+namespace affine {
+
+enum class Isa : u8 { Scalar, SSE, AVX2 };
+
+// best instruction set supported by this cpu, detected once at startup
+[[nodiscard]] Isa detected_isa();
+[[nodiscard]] Isa active_isa();
+[[nodiscard]] const char* isa_name(Isa isa);
+// overrides runtime dispatch. falls back to the detected isa if the cpu doesn't support it.
+// not thread safe, intended for benchmarks.
+void set_isa(Isa isa);
+
+[[nodiscard]] Affine mul(const Affine& a, const Affine& b);
+[[nodiscard]] Affine inverse(const Affine& m);
+[[nodiscard]] AABB transform_aabb(const Affine& m, const AABB& aabb);
+
+// For each i, globals[nodes[i]] = globals[parents[i]] * locals[nodes[i]], or locals[nodes[i]]
+// when parents[i] < 0. Nodes are processed in order, so a parent may appear earlier in the batch.
+void propagate(Affine* globals, const Affine* locals, std::span<const u32> nodes,
+               std::span<const i32> parents);
+// out[i] = (a[a_indices[i]] * b[i]).to_mat4()
+void mul_gather_to_mat4(mat4* out, const Affine* a, std::span<const u32> a_indices,
+                        const Affine* b);
+
+}  // namespace affine
+
+inline Affine operator*(const Affine& a, const Affine& b) { return affine::mul(a, b); }
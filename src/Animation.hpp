@@ -63,6 +63,8 @@ struct BlendTree {
 
 struct InstanceAnimation {
   std::vector<gfx::AnimationState> states;
+  // per clip, one cursor per sampler: the key found last frame, see AnimSampler::get_time_indices
+  std::vector<std::vector<u32>> key_cursors;
   std::vector<bool> dirty_anim_nodes;
   std::unordered_map<std::string, u32> anim_name_to_idx;
   BlendTree blend_tree;
@@ -63,18 +63,20 @@ AnimationHandle AnimationManager::add_animation(LoadedInstanceData& instance,
   auto* animation = instance_animations_.get(handle);
   animation->blend_tree.animation_id = handle;
   auto& scene_graph_data = instance.scene_graph_data;
-  size_t num_nodes = scene_graph_data.hierarchies.size();
+  size_t num_nodes = scene_graph_data.node_count();
   animation->dirty_anim_nodes.resize(num_nodes);
   animation->states.resize(model.animations.size());
+  animation->key_cursors.resize(model.animations.size());
   for (size_t i = 0; i < model.animations.size(); i++) {
     animation->anim_name_to_idx.emplace(model.animations[i].name, i);
     animation->states[i].anim_id = i;
+    animation->key_cursors[i].assign(model.animations[i].samplers.size(), 0);
   }
 
   return handle;
 }
 void AnimationManager::evaluate_blend_tree(LoadedInstanceData& instance,
-                                           const InstanceAnimation& animation,
+                                           InstanceAnimation& animation,
                                            const std::vector<gfx::Animation>& animations,
                                            std::vector<gfx::NodeTransformAccumulator>& out_accum,
                                            float weight, const BlendTreeNode& node) {
@@ -82,7 +84,7 @@ void AnimationManager::evaluate_blend_tree(LoadedInstanceData& instance,
     assert(node.animation_i < animations.size());
     assert(node.children.empty());
     apply_clip(animations[node.animation_i], animation.states[node.animation_i], weight, out_accum,
-               instance.dirty_animation_node_bits);
+               instance.dirty_animation_node_bits, animation.key_cursors[node.animation_i]);
     return;
   }
 
@@ -140,70 +142,94 @@ float get_interpolation_value(float start_anim_t, float end_anim_t, float curr_t
   return (curr_t - start_anim_t) / (end_anim_t - start_anim_t);
 }
 
+struct SampledKeys {
+  u32 time_i;
+  u32 next_time_i;
+  float interpolation_val;
+};
+
+SampledKeys find_keys(const gfx::AnimSampler& sampler, u32 sampler_i, float curr_t,
+                      std::span<u32> key_cursors) {
+  // glTF allows a single key, which holds for the whole clip
+  if (sampler.inputs.size() < 2) {
+    return {0, 0, 0.f};
+  }
+  const uvec2 time_indices = key_cursors.empty()
+                                 ? sampler.get_time_indices(curr_t)
+                                 : sampler.get_time_indices(curr_t, key_cursors[sampler_i]);
+  return {time_indices.x, time_indices.y,
+          get_interpolation_value(sampler.inputs[time_indices.x], sampler.inputs[time_indices.y],
+                                  curr_t)};
+}
+
+vec3 sample_vec3(const gfx::AnimSampler& sampler, const SampledKeys& keys) {
+  assert(sampler.outputs_raw.size() == sampler.inputs.size() * 3);
+  const vec3* values = reinterpret_cast<const vec3*>(sampler.outputs_raw.data());
+  return glm::mix(values[keys.time_i], values[keys.next_time_i], keys.interpolation_val);
+}
+
 }  // namespace
 
 void AnimationManager::apply_clip(const gfx::Animation& animation, const gfx::AnimationState& state,
                                   float weight,
                                   std::span<gfx::NodeTransformAccumulator> transform_accumulators,
-                                  std::vector<bool>& dirty_node_bits) {
+                                  std::vector<bool>& dirty_node_bits, std::span<u32> key_cursors) {
   if (!state.active) {
     return;
   }
   assert(transform_accumulators.size() > 0);
-  for (size_t channel_i = 0; channel_i < animation.channels.nodes.size(); channel_i++) {
-    int channel_node_i = animation.get_channel_node(channel_i);
-    assert(channel_node_i >= 0);
-    u32 channel_sampler_i = animation.get_channel_sampler_i(channel_i);
-    assert(channel_sampler_i < animation.samplers.size());
-    gfx::AnimationPath channel_anim_path = animation.get_channel_anim_path(channel_i);
-    const gfx::AnimSampler& sampler = animation.samplers[channel_sampler_i];
-    uvec2 time_indices = sampler.get_time_indices(state.curr_t);
-    u32 time_i = time_indices.x, next_time_i = time_indices.y;
-    float interpolation_val = get_interpolation_value(sampler.inputs[time_indices.x],
-                                                      sampler.inputs[time_indices.y], state.curr_t);
-
-    assert(channel_node_i < (int)transform_accumulators.size());
-    auto& nt = transform_accumulators[channel_node_i];
-    dirty_node_bits[channel_node_i] = true;
-    assert(sampler.inputs.size() > 1);
-    if (channel_anim_path == gfx::AnimationPath::Translation) {
-      assert(sampler.outputs_raw.size() == sampler.inputs.size() * 3);
-      const vec3* translations = reinterpret_cast<const vec3*>(sampler.outputs_raw.data());
-      auto translation =
-          sampler.inputs.size() == 1
-              ? translations[0]
-              : glm::mix(translations[time_i], translations[next_time_i], interpolation_val);
-      nt.translation += translation * weight;
-      nt.weights.x += weight;
-    } else if (channel_anim_path == gfx::AnimationPath::Rotation) {
-      assert(sampler.outputs_raw.size() == sampler.inputs.size() * 4);
-      assert(time_i < sampler.inputs.size());
-      const quat* rotations = reinterpret_cast<const quat*>(sampler.outputs_raw.data());
-      quat rotation;
-      if (sampler.inputs.size() == 1) {
-        rotation = rotations[0];
-      } else {
-        quat q0 = rotations[time_i];
-        quat q1 = rotations[next_time_i];
-        if (glm::dot(q0, q1) < 0.0f) q1 = -q1;  // ensure shortest path
-        rotation = glm::slerp(q0, q1, interpolation_val);
-      }
+  assert(key_cursors.empty() || key_cursors.size() == animation.samplers.size());
+  assert(animation.translations.size() + animation.rotations.size() + animation.scales.size() <=
+         animation.channels.nodes.size());
+  const float t = state.curr_t;
 
-      if (nt.weights.y == 0.0f) {
-        nt.rotation = rotation;
-      } else {
-        nt.rotation = glm::slerp(nt.rotation, rotation, weight / (nt.weights.y + weight));
-      }
-      nt.weights.y += weight;
-    } else if (channel_anim_path == gfx::AnimationPath::Scale) {
-      assert(sampler.outputs_raw.size() == sampler.inputs.size() * 3);
-      const vec3* scales = reinterpret_cast<const vec3*>(sampler.outputs_raw.data());
-      auto scale = sampler.inputs.size() == 1
-                       ? scales[0]
-                       : glm::mix(scales[time_i], scales[next_time_i], interpolation_val);
-      nt.scale += weight * scale;
-      nt.weights.z += weight;
+  const auto& translations = animation.translations;
+  for (size_t i = 0; i < translations.size(); i++) {
+    const u32 sampler_i = translations.sampler_indices[i];
+    const auto& sampler = animation.samplers[sampler_i];
+    const auto translation = sample_vec3(sampler, find_keys(sampler, sampler_i, t, key_cursors));
+    const int node = translations.nodes[i];
+    assert(node >= 0 && node < (int)transform_accumulators.size());
+    auto& nt = transform_accumulators[node];
+    nt.translation += translation * weight;
+    nt.weights.x += weight;
+    dirty_node_bits[node] = true;
+  }
+
+  const auto& rotations = animation.rotations;
+  for (size_t i = 0; i < rotations.size(); i++) {
+    const u32 sampler_i = rotations.sampler_indices[i];
+    const auto& sampler = animation.samplers[sampler_i];
+    assert(sampler.outputs_raw.size() == sampler.inputs.size() * 4);
+    const SampledKeys keys = find_keys(sampler, sampler_i, t, key_cursors);
+    const quat* values = reinterpret_cast<const quat*>(sampler.outputs_raw.data());
+    quat q0 = values[keys.time_i];
+    quat q1 = values[keys.next_time_i];
+    if (glm::dot(q0, q1) < 0.0f) q1 = -q1;  // ensure shortest path
+    const quat rotation = glm::slerp(q0, q1, keys.interpolation_val);
+    const int node = rotations.nodes[i];
+    assert(node >= 0 && node < (int)transform_accumulators.size());
+    auto& nt = transform_accumulators[node];
+    if (nt.weights.y == 0.0f) {
+      nt.rotation = rotation;
+    } else {
+      nt.rotation = glm::slerp(nt.rotation, rotation, weight / (nt.weights.y + weight));
     }
+    nt.weights.y += weight;
+    dirty_node_bits[node] = true;
+  }
+
+  const auto& scales = animation.scales;
+  for (size_t i = 0; i < scales.size(); i++) {
+    const u32 sampler_i = scales.sampler_indices[i];
+    const auto& sampler = animation.samplers[sampler_i];
+    const auto scale = sample_vec3(sampler, find_keys(sampler, sampler_i, t, key_cursors));
+    const int node = scales.nodes[i];
+    assert(node >= 0 && node < (int)transform_accumulators.size());
+    auto& nt = transform_accumulators[node];
+    nt.scale += weight * scale;
+    nt.weights.z += weight;
+    dirty_node_bits[node] = true;
   }
 }
 
@@ -26,13 +26,15 @@ class AnimationManager {
   // TODO: don't actually destroy the object, just "reset it" so
   // new animations don't need to realloc memory
   void remove_animation(AnimationHandle handle) { instance_animations_.destroy(handle); }
-  void evaluate_blend_tree(LoadedInstanceData& instance, const InstanceAnimation& animation,
+  void evaluate_blend_tree(LoadedInstanceData& instance, InstanceAnimation& animation,
                            const std::vector<gfx::Animation>& animations,
                            std::vector<gfx::NodeTransformAccumulator>& out_accum, float weight,
                            const BlendTreeNode& node);
+  // The animation must have been through gfx::prepare_animation. key_cursors holds one cursor per
+  // sampler of the clip, or is empty to search for the keys from scratch.
   void apply_clip(const gfx::Animation& animation, const gfx::AnimationState& state, float weight,
                   std::span<gfx::NodeTransformAccumulator> transform_accumulators,
-                  std::vector<bool>& dirty_node_bits);
+                  std::vector<bool>& dirty_node_bits, std::span<u32> key_cursors = {});
 
  private:
   AnimationManager() = default;
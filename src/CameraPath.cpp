@@ -0,0 +1,66 @@
+#include "CameraPath.hpp"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <tracy/Tracy.hpp>
+
+#include "util/MappedFile.hpp"
+
+namespace gfx {
+
+namespace {
+
+constexpr std::array<char, 8> camera_path_magic{'V', 'K', 'R', 'C', 'A', 'M', '\0', '\0'};
+// Bump when CameraPathFrame changes.
+constexpr u32 camera_path_version = 1;
+
+struct CameraPathHeader {
+  std::array<char, 8> magic;
+  u32 version;
+  u32 frame_size;
+  u64 frame_cnt;
+};
+
+}  // namespace
+
+bool save_camera_path(const std::filesystem::path& path, std::span<const CameraPathFrame> frames) {
+  ZoneScoped;
+  const CameraPathHeader header{.magic = camera_path_magic,
+                                .version = camera_path_version,
+                                .frame_size = sizeof(CameraPathFrame),
+                                .frame_cnt = frames.size()};
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(frames.data()),
+             static_cast<std::streamsize>(frames.size_bytes()));
+  return static_cast<bool>(file);
+}
+
+std::optional<std::vector<CameraPathFrame>> load_camera_path(const std::filesystem::path& path) {
+  ZoneScoped;
+  util::MappedFile file;
+  if (!file.open(path)) {
+    return std::nullopt;
+  }
+  const auto bytes = file.bytes();
+  CameraPathHeader header;
+  if (bytes.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != camera_path_magic || header.version != camera_path_version ||
+      header.frame_size != sizeof(CameraPathFrame) ||
+      header.frame_cnt > (bytes.size() - sizeof(header)) / sizeof(CameraPathFrame)) {
+    return std::nullopt;
+  }
+  std::vector<CameraPathFrame> frames(header.frame_cnt);
+  std::memcpy(frames.data(), bytes.data() + sizeof(header),
+              frames.size() * sizeof(CameraPathFrame));
+  return frames;
+}
+
+}  // namespace gfx
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace gfx {
+
+// Everything a frame of a recorded fly-through needs besides the scene itself: the camera and the
+// SceneDrawInfo inputs that aren't derived from it. Written to disk as is.
+struct CameraPathFrame {
+  vec3 pos;
+  // degrees, as in Camera
+  float pitch;
+  float yaw;
+  vec3 light_dir;
+  vec3 light_color;
+  float ambient_intensity;
+  float fov_degrees;
+};
+static_assert(std::is_trivially_copyable_v<CameraPathFrame>);
+
+// Replays use this dt for everything that advances with time, animations included, so two runs
+// of a recording simulate the same frames no matter how fast they render.
+inline constexpr float camera_path_fixed_dt = 1.f / 60.f;
+
+bool save_camera_path(const std::filesystem::path& path, std::span<const CameraPathFrame> frames);
+// nullopt if the file is missing, truncated or from another version
+[[nodiscard]] std::optional<std::vector<CameraPathFrame>> load_camera_path(
+    const std::filesystem::path& path);
+
+}  // namespace gfx
@@ -73,6 +73,11 @@ void CmdEncoder::set_viewport_and_scissor(u32 width, u32 height) const {
   vkCmdSetScissor(get_cmd_buf(), 0, 1, &scissor);
 }
 
+void CmdEncoder::execute_commands(const CmdEncoder& secondary) const {
+  VkCommandBuffer cmd_buf = secondary.get_cmd_buf();
+  vkCmdExecuteCommands(get_cmd_buf(), 1, &cmd_buf);
+}
+
 void CmdEncoder::set_cull_mode(CullMode mode) const {
   vkCmdSetCullModeEXT(get_cmd_buf(), vk2::convert_cull_mode(mode));
 }
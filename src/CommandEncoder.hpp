@@ -70,6 +70,9 @@ struct CmdEncoder {
   void copy_buffer(const Buffer& src, const Buffer& dst, u64 src_offset, u64 dst_offset,
                    u64 size) const;
 
+  // secondary from Device::begin_secondary_command_list, ended
+  void execute_commands(const CmdEncoder& secondary) const;
+
   [[nodiscard]] VkCommandBuffer cmd() const { return get_cmd_buf(); }
 
   [[nodiscard]] VkCommandBuffer get_cmd_buf() const {
@@ -78,6 +81,7 @@ struct CmdEncoder {
   [[nodiscard]] VkCommandPool get_cmd_pool() const {
     return command_pools_[frame_in_flight_][(u32)queue_];
   }
+  [[nodiscard]] QueueType get_queue() const { return queue_; }
 
   void begin_swapchain_blit();
   void blit_img(ImageHandle src, ImageHandle dst, uvec3 extent, VkImageAspectFlags aspect);
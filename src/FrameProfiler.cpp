@@ -0,0 +1,285 @@
+#include "FrameProfiler.hpp"
+
+#include <volk.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <format>
+#include <fstream>
+
+#include "CommandEncoder.hpp"
+#include "core/Logger.hpp"
+#include "vk2/Device.hpp"
+#include "vk2/VkCommon.hpp"
+
+namespace gfx {
+
+namespace {
+
+FrameProfiler* active_profiler{};
+
+void write_json_string(std::ostream& out, std::string_view str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << std::format("\\u{:04x}", c);
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+const char* queue_track_name(u32 queue) {
+  switch (static_cast<QueueType>(queue)) {
+    case QueueType::Graphics:
+      return "graphics";
+    case QueueType::Compute:
+      return "compute";
+    case QueueType::Transfer:
+      return "transfer";
+    default:
+      return "queue";
+  }
+}
+
+}  // namespace
+
+double get_gpu_frame_ms(const ProfiledFrame& frame) {
+  if (frame.gpu_scopes.empty()) return 0.;
+  u64 begin_ns = UINT64_MAX;
+  u64 end_ns = 0;
+  for (const auto& scope : frame.gpu_scopes) {
+    begin_ns = std::min(begin_ns, scope.begin_ns);
+    end_ns = std::max(end_ns, scope.end_ns);
+  }
+  return static_cast<double>(end_ns - std::min(begin_ns, end_ns)) / 1'000'000.0;
+}
+
+void write_chrome_trace(std::span<const ProfiledFrame> frames, std::ostream& out) {
+  constexpr u32 cpu_pid = 0;
+  constexpr u32 gpu_pid = 1;
+  out << "{\"traceEvents\":[\n";
+  out << std::format(R"({{"name":"process_name","ph":"M","pid":{},"args":{{"name":"CPU"}}}})",
+                     cpu_pid);
+  out << std::format(
+      ",\n"
+      R"({{"name":"process_name","ph":"M","pid":{},"args":{{"name":"GPU"}}}})",
+      gpu_pid);
+  for (u32 queue = 0; queue < static_cast<u32>(QueueType::Count); queue++) {
+    out << std::format(
+        ",\n"
+        R"({{"name":"thread_name","ph":"M","pid":{},"tid":{},"args":{{"name":"{}"}}}})",
+        gpu_pid, queue, queue_track_name(queue));
+  }
+  // ts and dur are in microseconds
+  const auto write_scopes = [&out](const ProfiledFrame& frame,
+                                   std::span<const ProfiledScope> scopes, u32 pid) {
+    for (const auto& scope : scopes) {
+      out << ",\n{\"name\":";
+      write_json_string(out, scope.name);
+      out << std::format(
+          R"(,"ph":"X","pid":{},"tid":{},"ts":{:.3f},"dur":{:.3f},"args":{{"frame":{}}}}})", pid,
+          scope.track, scope.begin_ns / 1000.0,
+          (scope.end_ns - std::min(scope.begin_ns, scope.end_ns)) / 1000.0, frame.frame_num);
+    }
+  };
+  for (const auto& frame : frames) {
+    write_scopes(frame, frame.cpu_scopes, cpu_pid);
+    write_scopes(frame, frame.gpu_scopes, gpu_pid);
+  }
+  out << "\n]}\n";
+}
+
+FrameProfiler* FrameProfiler::get() {
+  return active_profiler && active_profiler->is_enabled() ? active_profiler : nullptr;
+}
+
+FrameProfiler::FrameProfiler() : history_(max_frames) { active_profiler = this; }
+
+FrameProfiler::~FrameProfiler() {
+  if (active_profiler == this) active_profiler = nullptr;
+  for (auto& queries : frame_queries_) {
+    if (queries.pool) vkDestroyQueryPool(get_device().device(), queries.pool, nullptr);
+  }
+}
+
+u64 FrameProfiler::now() {
+  static const auto epoch = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                              epoch)
+      .count();
+}
+
+void FrameProfiler::init_gpu_queries() {
+  ZoneScoped;
+  auto& device = get_device();
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(device.get_physical_device(), &props);
+  timestamp_period_ns_ = props.limits.timestampPeriod;
+  u32 family_cnt{};
+  vkGetPhysicalDeviceQueueFamilyProperties(device.get_physical_device(), &family_cnt, nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_cnt);
+  vkGetPhysicalDeviceQueueFamilyProperties(device.get_physical_device(), &family_cnt,
+                                           families.data());
+  for (u32 queue = 0; queue < static_cast<u32>(QueueType::Count); queue++) {
+    const auto& q = device.get_queue(static_cast<QueueType>(queue));
+    if (q.queue && q.family_idx < families.size()) {
+      timestamp_valid_bits_[queue] = families[q.family_idx].timestampValidBits;
+    }
+  }
+  if (!timestamp_valid_bits_[static_cast<u32>(QueueType::Graphics)]) {
+    LWARN("graphics queue has no timestamps, only cpu scopes are profiled");
+    return;
+  }
+  for (auto& queries : frame_queries_) {
+    VkQueryPoolCreateInfo info{.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                               .queryType = VK_QUERY_TYPE_TIMESTAMP,
+                               .queryCount = max_gpu_scopes * 2};
+    VK_CHECK(vkCreateQueryPool(device.device(), &info, nullptr, &queries.pool));
+  }
+  has_gpu_queries_ = true;
+}
+
+void FrameProfiler::begin_frame(u32 frame_num, u32 frame_in_flight) {
+  ZoneScoped;
+  assert(frame_in_flight < frames_in_flight);
+  std::scoped_lock lock(mtx_);
+  curr_frame_in_flight_ = frame_in_flight;
+  auto& queries = frame_queries_[frame_in_flight];
+  resolve_gpu_scopes(queries);
+
+  curr_history_idx_ = (curr_history_idx_ + in_frame_) % max_frames;
+  // the frame being overwritten may still have timestamps pending in another frame in flight
+  for (auto& other : frame_queries_) {
+    if (other.history_idx == curr_history_idx_) {
+      other.history_idx = invalid_scope;
+      other.scopes.clear();
+    }
+  }
+  if (last_resolved_idx_ == curr_history_idx_) last_resolved_idx_ = invalid_scope;
+  history_cnt_ = std::min(history_cnt_ + in_frame_, max_frames - 1);
+  auto& frame = curr_frame();
+  frame.frame_num = frame_num;
+  frame.cpu_scopes.clear();
+  frame.gpu_scopes.clear();
+  in_frame_ = true;
+  queries.history_idx = curr_history_idx_;
+}
+
+void FrameProfiler::end_frame() {
+  std::scoped_lock lock(mtx_);
+  frame_queries_[curr_frame_in_flight_].gpu_begin_ns = now();
+}
+
+void FrameProfiler::resolve_gpu_scopes(FrameQueries& queries) {
+  if (queries.history_idx == invalid_scope) return;
+  auto& frame = history_[queries.history_idx];
+  if (has_gpu_queries_ && !queries.scopes.empty()) {
+    // value and availability per query, the fence was waited on so nothing should be pending
+    struct Result {
+      u64 value;
+      u64 available;
+    };
+    std::vector<Result> results(queries.scopes.size() * 2);
+    const VkResult res = vkGetQueryPoolResults(
+        get_device().device(), queries.pool, 0, results.size(), results.size() * sizeof(Result),
+        results.data(), sizeof(Result),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (res == VK_SUCCESS || res == VK_NOT_READY) {
+      // gpu times start at the earliest timestamp of the frame
+      u64 first_ticks = UINT64_MAX;
+      for (const auto& result : results) {
+        if (result.available) first_ticks = std::min(first_ticks, result.value);
+      }
+      for (u32 i = 0; i < queries.scopes.size(); i++) {
+        const auto& begin = results[i * 2];
+        const auto& end = results[(i * 2) + 1];
+        if (!begin.available || !end.available) continue;
+        const auto to_ns = [&](u64 ticks) {
+          return queries.gpu_begin_ns +
+                 static_cast<u64>((ticks - first_ticks) * timestamp_period_ns_);
+        };
+        frame.gpu_scopes.emplace_back(ProfiledScope{.name = std::move(queries.scopes[i].name),
+                                                    .begin_ns = to_ns(begin.value),
+                                                    .end_ns = to_ns(end.value),
+                                                    .track = static_cast<u32>(
+                                                        queries.scopes[i].queue)});
+      }
+    }
+  }
+  last_resolved_idx_ = queries.history_idx;
+  queries.history_idx = invalid_scope;
+  queries.scopes.clear();
+}
+
+void FrameProfiler::reset_gpu_queries(CmdEncoder& cmd) {
+  if (!has_gpu_queries_ || !is_enabled()) return;
+  vkCmdResetQueryPool(cmd.cmd(), frame_queries_[curr_frame_in_flight_].pool, 0,
+                      max_gpu_scopes * 2);
+}
+
+u32 FrameProfiler::begin_gpu_scope(CmdEncoder& cmd, std::string_view name) {
+  if (!has_gpu_queries_ || !is_enabled() || !in_frame_) return invalid_scope;
+  auto& queries = frame_queries_[curr_frame_in_flight_];
+  const QueueType queue = cmd.get_queue();
+  if (queries.scopes.size() == max_gpu_scopes || !timestamp_valid_bits_[(u32)queue]) {
+    return invalid_scope;
+  }
+  const auto scope = static_cast<u32>(queries.scopes.size());
+  queries.scopes.emplace_back(GpuScope{.name = std::string(name), .queue = queue});
+  vkCmdWriteTimestamp2KHR(cmd.cmd(), VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, queries.pool,
+                          scope * 2);
+  return scope;
+}
+
+void FrameProfiler::end_gpu_scope(CmdEncoder& cmd, u32 scope) {
+  if (scope == invalid_scope) return;
+  vkCmdWriteTimestamp2KHR(cmd.cmd(), VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
+                          frame_queries_[curr_frame_in_flight_].pool, (scope * 2) + 1);
+}
+
+void FrameProfiler::add_cpu_scope(std::string_view name, u64 begin_ns, u64 end_ns) {
+  std::scoped_lock lock(mtx_);
+  if (!in_frame_) return;
+  const auto thread = std::this_thread::get_id();
+  auto it = std::ranges::find(threads_, thread);
+  if (it == threads_.end()) it = threads_.insert(threads_.end(), thread);
+  curr_frame().cpu_scopes.emplace_back(
+      ProfiledScope{.name = std::string(name),
+                    .begin_ns = begin_ns,
+                    .end_ns = end_ns,
+                    .track = static_cast<u32>(it - threads_.begin())});
+}
+
+std::vector<ProfiledFrame> FrameProfiler::get_history() const {
+  std::scoped_lock lock(mtx_);
+  std::vector<ProfiledFrame> frames;
+  frames.reserve(history_cnt_);
+  for (u32 i = 0; i < history_cnt_; i++) {
+    frames.emplace_back(history_[(curr_history_idx_ + max_frames - history_cnt_ + i) % max_frames]);
+  }
+  return frames;
+}
+
+const ProfiledFrame* FrameProfiler::get_last_resolved_frame() const {
+  std::scoped_lock lock(mtx_);
+  return last_resolved_idx_ == invalid_scope ? nullptr : &history_[last_resolved_idx_];
+}
+
+bool FrameProfiler::dump_chrome_trace(const std::filesystem::path& path) const {
+  ZoneScoped;
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    LERROR("failed to open {} for writing", path.string());
+    return false;
+  }
+  write_chrome_trace(get_history(), file);
+  LINFO("wrote frame trace to {}", path.string());
+  return true;
+}
+
+}  // namespace gfx
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tracy/Tracy.hpp>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace gfx {
+
+struct CmdEncoder;
+
+struct ProfiledScope {
+  std::string name;
+  // ns on the profiler's clock, see FrameProfiler::now
+  u64 begin_ns;
+  u64 end_ns;
+  // thread for cpu scopes, QueueType for gpu scopes
+  u32 track;
+};
+
+struct ProfiledFrame {
+  u32 frame_num;
+  std::vector<ProfiledScope> cpu_scopes;
+  std::vector<ProfiledScope> gpu_scopes;
+};
+
+// first gpu scope begin to last end, 0 without gpu scopes
+[[nodiscard]] double get_gpu_frame_ms(const ProfiledFrame& frame);
+
+// Chrome trace event JSON, loads in chrome://tracing and Perfetto. Cpu scopes go in one process
+// with a thread per track, gpu scopes in another with a thread per queue.
+void write_chrome_trace(std::span<const ProfiledFrame> frames, std::ostream& out);
+
+// Built in profiler that works without a Tracy client attached. Keeps the last max_frames
+// frames of cpu scopes and per pass gpu timestamps in memory, to be dumped as a Chrome trace on
+// demand. Gpu timestamps go to a query pool per frame in flight and are read back once the frame
+// in flight comes around again, when its fence has been waited on, so reading never stalls.
+class FrameProfiler {
+ public:
+  static constexpr u32 max_frames = 240;
+  static constexpr u32 max_gpu_scopes = 256;
+  static constexpr u32 invalid_scope = UINT32_MAX;
+
+  // the last constructed profiler if it is enabled, nullptr otherwise. PROFILE_SCOPE records
+  // into it.
+  static FrameProfiler* get();
+
+  FrameProfiler();
+  ~FrameProfiler();
+  FrameProfiler(const FrameProfiler&) = delete;
+  FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+  // Gpu scopes need the device, without it only cpu scopes are recorded.
+  void init_gpu_queries();
+  void set_enabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+  [[nodiscard]] bool is_enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  // Call once the frame in flight's fence was waited on. Reads back the timestamps it wrote
+  // last time into the history and starts a new frame.
+  void begin_frame(u32 frame_num, u32 frame_in_flight);
+  // Gpu scopes of the frame are placed on the cpu timeline starting here, right before submit.
+  // Their offsets from each other are measured, the offset to the cpu timeline is not.
+  void end_frame();
+
+  // Recorded before any gpu scope of the frame, in a command list all other queues wait on.
+  void reset_gpu_queries(CmdEncoder& cmd);
+  u32 begin_gpu_scope(CmdEncoder& cmd, std::string_view name);
+  void end_gpu_scope(CmdEncoder& cmd, u32 scope);
+
+  // thread safe
+  void add_cpu_scope(std::string_view name, u64 begin_ns, u64 end_ns);
+  // ns since the first call
+  [[nodiscard]] static u64 now();
+
+  // finished frames, oldest first. The last frames in flight have no gpu scopes yet.
+  [[nodiscard]] std::vector<ProfiledFrame> get_history() const;
+  // most recent frame with gpu timestamps read back, nullptr before there is one
+  [[nodiscard]] const ProfiledFrame* get_last_resolved_frame() const;
+  bool dump_chrome_trace(const std::filesystem::path& path) const;
+
+ private:
+  struct GpuScope {
+    std::string name;
+    QueueType queue;
+  };
+  struct FrameQueries {
+    VkQueryPool pool{};
+    std::vector<GpuScope> scopes;
+    // index in history_ of the frame the timestamps belong to
+    u32 history_idx{invalid_scope};
+    u64 gpu_begin_ns{};
+  };
+  ProfiledFrame& curr_frame() { return history_[curr_history_idx_]; }
+  void resolve_gpu_scopes(FrameQueries& queries);
+
+  FrameQueries frame_queries_[frames_in_flight];
+  u32 curr_frame_in_flight_{};
+  u32 timestamp_valid_bits_[(u32)QueueType::Count]{};
+  double timestamp_period_ns_{1.};
+  bool has_gpu_queries_{};
+  std::atomic<bool> enabled_{true};
+  bool in_frame_{};
+
+  mutable std::mutex mtx_;
+  // ring of max_frames, curr_history_idx_ is the frame being recorded
+  std::vector<ProfiledFrame> history_;
+  u32 curr_history_idx_{};
+  u32 history_cnt_{};
+  u32 last_resolved_idx_{invalid_scope};
+  // cpu scope tracks are indices in here
+  std::vector<std::thread::id> threads_;
+};
+
+// Adds the scope's cpu time to the active FrameProfiler, if any.
+class CpuProfileScope {
+ public:
+  explicit CpuProfileScope(const char* name)
+      : profiler_(FrameProfiler::get()),
+        name_(name),
+        begin_ns_(profiler_ ? FrameProfiler::now() : 0) {}
+  ~CpuProfileScope() {
+    if (profiler_) profiler_->add_cpu_scope(name_, begin_ns_, FrameProfiler::now());
+  }
+  CpuProfileScope(const CpuProfileScope&) = delete;
+  CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+ private:
+  FrameProfiler* profiler_;
+  const char* name_;
+  u64 begin_ns_;
+};
+
+}  // namespace gfx
+
+#define PROFILE_SCOPE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT_IMPL(a, b)
+// Tracy zone that is also recorded by the built in FrameProfiler
+#define PROFILE_SCOPE(name) \
+  ZoneScopedN(name);        \
+  gfx::CpuProfileScope PROFILE_SCOPE_CONCAT(cpu_profile_scope_, __LINE__) { name }
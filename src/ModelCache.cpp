@@ -0,0 +1,370 @@
+#include "ModelCache.hpp"
+
+#include <array>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <string_view>
+#include <thread>
+#include <tracy/Tracy.hpp>
+#include <type_traits>
+
+#include "core/Logger.hpp"
+#include "util/Hash.hpp"
+#include "util/MappedFile.hpp"
+
+namespace gfx {
+
+namespace {
+
+constexpr std::array<char, 8> cache_magic{'V', 'K', 'R', 'M', 'O', 'D', 'E', 'L'};
+// Bump when the file layout below changes.
+constexpr u32 cache_format_version = 1;
+// arrays start at this alignment relative to the file start, which the mapping keeps
+constexpr size_t cache_alignment = 16;
+
+struct CacheHeader {
+  std::array<char, 8> magic;
+  u32 format_version;
+  u32 loader_version;
+  u64 layout_key;
+  u64 source_hash;
+};
+
+// structs stored as raw bytes, a size change invalidates the cache like a version bump
+constexpr u64 layout_key() {
+  u64 key = 0;
+  for (u64 size : {sizeof(Vertex), sizeof(AnimatedVertex), sizeof(PrimitiveDrawInfo),
+                   sizeof(Material), sizeof(Hierarchy), sizeof(Affine), sizeof(NodeTransform),
+                   sizeof(MeshData)}) {
+    key = (key * 31) + size;
+  }
+  return key;
+}
+
+std::optional<u64> hash_model_sources(const std::filesystem::path& model_path,
+                                      std::span<const std::string> buffer_uris) {
+  util::MappedFile file;
+  if (!file.open(model_path)) {
+    return std::nullopt;
+  }
+  u64 hash = util::hash_bytes(file.bytes(), model_loader_version);
+  for (const auto& uri : buffer_uris) {
+    if (!file.open(model_path.parent_path() / uri)) {
+      return std::nullopt;
+    }
+    hash = util::hash_bytes(file.bytes(), hash);
+  }
+  return hash;
+}
+
+class CacheWriter {
+ public:
+  template <typename T>
+  void write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    append(&value, sizeof(T));
+  }
+  template <typename T>
+  void write_span(std::span<const T> values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    write<u64>(values.size());
+    data_.resize((data_.size() + cache_alignment - 1) & ~(cache_alignment - 1));
+    append(values.data(), values.size_bytes());
+  }
+  void write_string(std::string_view str) { write_span(std::span(str.data(), str.size())); }
+  [[nodiscard]] std::span<const std::byte> data() const { return data_; }
+
+ private:
+  void append(const void* src, size_t size) {
+    const auto* bytes = static_cast<const std::byte*>(src);
+    data_.insert(data_.end(), bytes, bytes + size);
+  }
+  std::vector<std::byte> data_;
+};
+
+// Every read is bounds checked. After the first failure reads return empty values and ok() is
+// false, so callers check once at the end.
+class CacheReader {
+ public:
+  explicit CacheReader(std::span<const std::byte> data) : data_(data) {}
+
+  template <typename T>
+  T read() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value{};
+    if (const std::byte* src = take(sizeof(T))) {
+      std::memcpy(&value, src, sizeof(T));
+    }
+    return value;
+  }
+  // view into the mapped file, no copy
+  template <typename T>
+  std::span<const T> read_span() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const u64 count = read<u64>();
+    pos_ = (pos_ + cache_alignment - 1) & ~(cache_alignment - 1);
+    if (!ok_ || pos_ > data_.size() || count > (data_.size() - pos_) / sizeof(T)) {
+      ok_ = false;
+      return {};
+    }
+    const auto* src = reinterpret_cast<const T*>(take(count * sizeof(T)));
+    return {src, count};
+  }
+  template <typename T>
+  std::vector<T> read_vector() {
+    auto values = read_span<T>();
+    return {values.begin(), values.end()};
+  }
+  std::string read_string() {
+    auto chars = read_span<char>();
+    return {chars.begin(), chars.end()};
+  }
+  [[nodiscard]] bool ok() const { return ok_; }
+
+ private:
+  const std::byte* take(size_t size) {
+    if (!ok_ || size > data_.size() - pos_) {
+      ok_ = false;
+      return nullptr;
+    }
+    const std::byte* result = data_.data() + pos_;
+    pos_ += size;
+    return result;
+  }
+  std::span<const std::byte> data_;
+  size_t pos_{};
+  bool ok_{true};
+};
+
+void write_scene(CacheWriter& writer, const Scene2& scene) {
+  const auto& shared = *scene.shared;
+  writer.write_span<Hierarchy>(shared.hierarchies);
+  writer.write<u64>(shared.node_names.size());
+  for (const auto& name : shared.node_names) {
+    writer.write_string(name);
+  }
+  std::vector<ivec2> node_name_indices;
+  node_name_indices.reserve(shared.node_to_node_name_idx.size());
+  for (auto [node, name_idx] : shared.node_to_node_name_idx) {
+    node_name_indices.emplace_back(node, name_idx);
+  }
+  writer.write_span<ivec2>(node_name_indices);
+  writer.write_span<i32>(shared.node_mesh_indices);
+  writer.write_span<u32>(shared.node_flags);
+  writer.write_span<MeshData>(shared.mesh_datas);
+  writer.write<u64>(shared.skins.size());
+  for (const auto& skin : shared.skins) {
+    writer.write_string(skin.name);
+    writer.write_span<u32>(skin.joint_node_indices);
+    writer.write_span<Affine>(skin.inverse_bind_matrices);
+    writer.write(skin.model_bone_mat_start_i);
+  }
+  writer.write_span<u32>(shared.level_offsets);
+  writer.write_span<Affine>(scene.local_transforms);
+  writer.write_span<NodeTransform>(scene.node_transforms);
+  writer.write_span<Affine>(scene.global_transforms);
+}
+
+void read_scene(CacheReader& reader, Scene2& scene) {
+  auto shared = std::make_shared<SceneTemplate>();
+  shared->hierarchies = reader.read_vector<Hierarchy>();
+  const u64 name_cnt = reader.read<u64>();
+  for (u64 i = 0; i < name_cnt && reader.ok(); i++) {
+    shared->node_names.emplace_back(reader.read_string());
+  }
+  for (const auto& node_name_idx : reader.read_span<ivec2>()) {
+    shared->node_to_node_name_idx.emplace(node_name_idx.x, node_name_idx.y);
+  }
+  shared->node_mesh_indices = reader.read_vector<i32>();
+  shared->node_flags = reader.read_vector<u32>();
+  shared->mesh_datas = reader.read_vector<MeshData>();
+  const u64 skin_cnt = reader.read<u64>();
+  for (u64 i = 0; i < skin_cnt && reader.ok(); i++) {
+    auto& skin = shared->skins.emplace_back();
+    skin.name = reader.read_string();
+    skin.joint_node_indices = reader.read_vector<u32>();
+    skin.inverse_bind_matrices = reader.read_vector<Affine>();
+    skin.model_bone_mat_start_i = reader.read<u32>();
+  }
+  shared->level_offsets = reader.read_vector<u32>();
+  scene.local_transforms = reader.read_vector<Affine>();
+  scene.node_transforms = reader.read_vector<NodeTransform>();
+  scene.global_transforms = reader.read_vector<Affine>();
+  scene.shared = std::move(shared);
+}
+
+void write_animations(CacheWriter& writer, std::span<const Animation> animations) {
+  writer.write<u64>(animations.size());
+  for (const auto& animation : animations) {
+    writer.write_string(animation.name);
+    writer.write(animation.ticks_per_second);
+    writer.write(animation.duration);
+    writer.write_span<int>(animation.channels.nodes);
+    writer.write_span<u32>(animation.channels.sampler_indices);
+    writer.write_span<AnimationPath>(animation.channels.anim_paths);
+    writer.write<u64>(animation.samplers.size());
+    for (const auto& sampler : animation.samplers) {
+      writer.write_span<float>(sampler.inputs);
+      writer.write_span<float>(sampler.outputs_raw);
+    }
+  }
+}
+
+void read_animations(CacheReader& reader, std::vector<Animation>& animations) {
+  const u64 animation_cnt = reader.read<u64>();
+  for (u64 i = 0; i < animation_cnt && reader.ok(); i++) {
+    auto& animation = animations.emplace_back();
+    animation.name = reader.read_string();
+    animation.ticks_per_second = reader.read<float>();
+    animation.duration = reader.read<float>();
+    animation.channels.nodes = reader.read_vector<int>();
+    animation.channels.sampler_indices = reader.read_vector<u32>();
+    animation.channels.anim_paths = reader.read_vector<AnimationPath>();
+    const u64 sampler_cnt = reader.read<u64>();
+    for (u64 j = 0; j < sampler_cnt && reader.ok(); j++) {
+      auto& sampler = animation.samplers.emplace_back();
+      sampler.inputs = reader.read_vector<float>();
+      sampler.outputs_raw = reader.read_vector<float>();
+    }
+  }
+}
+
+void write_images(CacheWriter& writer, std::span<const ModelImageSource> images) {
+  writer.write<u64>(images.size());
+  for (const auto& image : images) {
+    writer.write(image.encoding);
+    writer.write(image.srgb);
+    writer.write_string(image.uri);
+    writer.write_span<std::byte>(image.bytes);
+  }
+}
+
+void read_images(CacheReader& reader, std::vector<ModelImageSource>& images) {
+  const u64 image_cnt = reader.read<u64>();
+  for (u64 i = 0; i < image_cnt && reader.ok(); i++) {
+    auto& image = images.emplace_back();
+    image.encoding = reader.read<ImageEncoding>();
+    image.srgb = reader.read<bool>();
+    image.uri = reader.read_string();
+    image.bytes = reader.read_vector<std::byte>();
+  }
+}
+
+}  // namespace
+
+std::filesystem::path get_model_cache_path(const std::filesystem::path& model_path) {
+  auto result = model_path;
+  result += ".vkcache";
+  return result;
+}
+
+std::optional<ModelCpuData> read_model_cache(const std::filesystem::path& model_path) {
+  ZoneScoped;
+  const auto cache_path = get_model_cache_path(model_path);
+  if (!std::filesystem::exists(cache_path)) {
+    return std::nullopt;
+  }
+  auto file = std::make_shared<util::MappedFile>();
+  if (!file->open(cache_path)) {
+    LWARN("failed to map model cache {}", cache_path.string());
+    return std::nullopt;
+  }
+  CacheReader reader{file->bytes()};
+  const auto header = reader.read<CacheHeader>();
+  if (!reader.ok() || header.magic != cache_magic ||
+      header.format_version != cache_format_version ||
+      header.loader_version != model_loader_version || header.layout_key != layout_key()) {
+    LINFO("model cache {} is from another version, reparsing", cache_path.string());
+    return std::nullopt;
+  }
+
+  ModelCpuData result;
+  const u64 buffer_cnt = reader.read<u64>();
+  for (u64 i = 0; i < buffer_cnt && reader.ok(); i++) {
+    result.buffer_uris.emplace_back(reader.read_string());
+  }
+  if (!reader.ok()) {
+    LWARN("model cache {} is corrupt, reparsing", cache_path.string());
+    return std::nullopt;
+  }
+  const auto source_hash = hash_model_sources(model_path, result.buffer_uris);
+  if (!source_hash || *source_hash != header.source_hash) {
+    LINFO("model cache {} is stale, reparsing", cache_path.string());
+    return std::nullopt;
+  }
+
+  result.vertices = reader.read_span<Vertex>();
+  result.animated_vertices = reader.read_span<AnimatedVertex>();
+  result.indices = reader.read_span<u32>();
+  result.mesh_draw_infos = reader.read_vector<PrimitiveDrawInfo>();
+  result.materials = reader.read_vector<Material>();
+  read_images(reader, result.images);
+  read_scene(reader, result.scene_graph_data);
+  read_animations(reader, result.animations);
+  const auto& shared = *result.scene_graph_data.shared;
+  const auto& scene = result.scene_graph_data;
+  if (!reader.ok() || shared.node_mesh_indices.size() != shared.node_count() ||
+      scene.local_transforms.size() != shared.node_count() ||
+      scene.node_transforms.size() != shared.node_count() ||
+      scene.global_transforms.size() != shared.node_count()) {
+    LWARN("model cache {} is corrupt, reparsing", cache_path.string());
+    return std::nullopt;
+  }
+  // the cached global transforms are up to date, so nothing starts dirty
+  reset_dirty_state(result.scene_graph_data);
+  result.geometry_storage = std::move(file);
+  return result;
+}
+
+bool write_model_cache(const std::filesystem::path& model_path, const ModelCpuData& model) {
+  ZoneScoped;
+  const auto source_hash = hash_model_sources(model_path, model.buffer_uris);
+  if (!source_hash) {
+    return false;
+  }
+  CacheWriter writer;
+  writer.write(CacheHeader{.magic = cache_magic,
+                           .format_version = cache_format_version,
+                           .loader_version = model_loader_version,
+                           .layout_key = layout_key(),
+                           .source_hash = *source_hash});
+  writer.write<u64>(model.buffer_uris.size());
+  for (const auto& uri : model.buffer_uris) {
+    writer.write_string(uri);
+  }
+  writer.write_span(model.vertices);
+  writer.write_span(model.animated_vertices);
+  writer.write_span(model.indices);
+  writer.write_span<PrimitiveDrawInfo>(model.mesh_draw_infos);
+  writer.write_span<Material>(model.materials);
+  write_images(writer, model.images);
+  write_scene(writer, model.scene_graph_data);
+  write_animations(writer, model.animations);
+
+  const auto cache_path = get_model_cache_path(model_path);
+  // the same model can load on several threads at once, so tmp names must differ
+  auto tmp_path = cache_path;
+  tmp_path += std::format(".{:x}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    const auto data = writer.data();
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, cache_path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace gfx
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+
+#include "SceneLoader.hpp"
+
+namespace gfx {
+
+// Binary cache of parse_gltf's output, written next to the model after the first load. It's keyed
+// by the contents of the model file and its external buffers plus the loader version, and is
+// memory mapped on later loads so geometry goes straight from the file to the staging buffer.
+
+// Bump when parse_gltf's output changes so existing caches are rebuilt.
+inline constexpr u32 model_loader_version = 1;
+
+// <model file name>.vkcache in the model's directory
+[[nodiscard]] std::filesystem::path get_model_cache_path(const std::filesystem::path& model_path);
+
+// Returns the cached model if the cache exists, was written by this loader version and matches
+// the model's current contents. Geometry views point into the mapped file, which the result's
+// geometry_storage keeps alive.
+[[nodiscard]] std::optional<ModelCpuData> read_model_cache(const std::filesystem::path& model_path);
+
+// Writes through a per-thread temporary file, so a concurrent reader never sees a partial cache
+// and concurrent writers of one model don't interleave.
+bool write_model_cache(const std::filesystem::path& model_path, const ModelCpuData& model);
+
+}  // namespace gfx
@@ -0,0 +1,40 @@
+#include "ObjectDataScatter.hpp"
+
+#include <algorithm>
+#include <tracy/Tracy.hpp>
+
+namespace gfx {
+
+void sort_and_dedupe(std::vector<ObjectDataScatter>& scatters) {
+  ZoneScoped;
+  // dirty nodes are queued mostly in order already
+  std::ranges::stable_sort(scatters, {}, &ObjectDataScatter::dst_i);
+  // std::unique keeps the first of a run, the last write is the one wanted
+  size_t out{};
+  for (const auto& scatter : scatters) {
+    if (out > 0 && scatters[out - 1].dst_i == scatter.dst_i) {
+      scatters[out - 1] = scatter;
+    } else {
+      scatters[out++] = scatter;
+    }
+  }
+  scatters.resize(out);
+}
+
+u32 count_copy_regions(std::span<const ObjectDataScatter> scatters) {
+  u32 regions{};
+  for (size_t i = 0; i < scatters.size(); i++) {
+    if (i == 0 || scatters[i].dst_i != scatters[i - 1].dst_i + 1) {
+      regions++;
+    }
+  }
+  return regions;
+}
+
+void scatter_object_datas(std::span<const ObjectDataScatter> scatters, std::span<ObjectData> dst) {
+  for (const auto& scatter : scatters) {
+    dst[scatter.dst_i] = scatter.data;
+  }
+}
+
+}  // namespace gfx
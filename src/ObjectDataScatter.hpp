@@ -0,0 +1,36 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "SceneLoader.hpp"
+
+namespace gfx {
+
+// A dirty ObjectData and its slot in the object data buffer, laid out as scatter_object_data.comp
+// reads it from staging.
+struct ObjectDataScatter {
+  ObjectData data;
+  // in ObjectDatas, not bytes
+  u32 dst_i;
+  u32 pad_[3];
+};
+static_assert(sizeof(ObjectDataScatter) == sizeof(ObjectData) + 16);
+
+struct ObjectDataUploadStats {
+  u32 dirty;
+  // copy regions the dirty objects merge into
+  u32 regions;
+  bool scatter;
+  u64 staging_bytes;
+};
+
+// Sorts by destination and keeps the last write to each one, so the dispatch has no write races
+// and the copy path gets the longest contiguous runs.
+void sort_and_dedupe(std::vector<ObjectDataScatter>& scatters);
+// number of runs of consecutive destinations, scatters must be sorted
+[[nodiscard]] u32 count_copy_regions(std::span<const ObjectDataScatter> scatters);
+// cpu reference of scatter_object_data.comp
+void scatter_object_datas(std::span<const ObjectDataScatter> scatters, std::span<ObjectData> dst);
+
+}  // namespace gfx
@@ -7,17 +7,24 @@
 #include <algorithm>
 #include <cstdint>
 #include <expected>
+#include <format>
+#include <memory>
 #include <tracy/Tracy.hpp>
 #include <utility>
 
 #include "CommandEncoder.hpp"
+#include "FrameProfiler.hpp"
+#include "ThreadPool.hpp"
 #include "Types.hpp"
 #include "core/Logger.hpp"
+#include "core/Timer.hpp"
+#include "util/AliasPlanner.hpp"
 #include "util/BitOps.hpp"
 #include "vk2/Buffer.hpp"
 #include "vk2/Device.hpp"
 #include "vk2/Hash.hpp"
 #include "vk2/Texture.hpp"
+#include "vk2/VkCommon.hpp"
 #include "vk2/VkTypes.hpp"
 
 namespace gfx {
@@ -142,9 +149,9 @@ void RenderGraphPass::add(ImageHandle image, Access access) {
   RenderResource& res = *graph_.get_resource(resource_handle);
   res.access = static_cast<Access>(res.access | access);
 
-  auto* img = get_device().get_image(image);
-  assert(img);
-  if (!img) {
+  const bool exists = graph_.provider_->has_image(image);
+  assert(exists);
+  if (!exists) {
     return;
   }
   res.img_handle = image;
@@ -156,12 +163,12 @@ void RenderGraphPass::add(BufferHandle buf_handle, Access access) {
   RenderResource& res = *graph_.get_resource(resource_handle);
   res.access = static_cast<Access>(res.access | access);
 
-  auto* buf = get_device().get_buffer(buf_handle);
-  assert(buf);
-  if (!buf) {
+  const u64 size = graph_.provider_->get_buffer_size(buf_handle);
+  assert(size);
+  if (!size) {
     return;
   }
-  res.buffer_info = {buf_handle, buf->size()};
+  res.buffer_info = {buf_handle, size};
   init_usage_and_handle(access, resource_handle, res);
 }
 
@@ -194,10 +201,44 @@ RGResourceHandle RenderGraphPass::add_image_access(const std::string& name, Acce
   return handle;
 }
 
-RenderGraphPass::RenderGraphPass(std::string name, RenderGraph& graph, uint32_t idx, Type)
-    : name_(std::move(name)), graph_(graph), idx_(idx) {}
+RenderGraphPass::RenderGraphPass(std::string name, RenderGraph& graph, uint32_t idx, Type type)
+    : name_(std::move(name)), graph_(graph), idx_(idx), type_(type) {}
 
-RenderGraph::RenderGraph(std::string name) : name_(std::move(name)) { log_ = false; }
+namespace {
+
+struct DeviceResourceProvider final : RGResourceProvider {
+  [[nodiscard]] AttachmentInfo get_swapchain_info() const override {
+    return get_device().get_swapchain_info();
+  }
+  [[nodiscard]] u64 get_buffer_size(BufferHandle handle) const override {
+    const auto* buf = get_device().get_buffer(handle);
+    return buf ? buf->size() : 0;
+  }
+  [[nodiscard]] bool has_image(ImageHandle handle) const override {
+    return get_device().get_image(handle) != nullptr;
+  }
+  [[nodiscard]] bool has_queue(QueueType type) const override {
+    return get_device().get_queue(type).queue != VK_NULL_HANDLE;
+  }
+};
+
+DeviceResourceProvider device_resource_provider;
+
+}  // namespace
+
+RenderGraph::RenderGraph(std::string name, RGResourceProvider* provider)
+    : provider_(provider ? provider : &device_resource_provider), name_(std::move(name)) {
+  log_ = false;
+}
+
+RenderGraph::~RenderGraph() {
+  release_aliased_images();
+  for (auto& events : split_event_pool_) {
+    for (VkEvent event : events) {
+      vkDestroyEvent(get_device().device(), event, nullptr);
+    }
+  }
+}
 
 RenderGraphPass& RenderGraph::add_pass(const std::string& name, RenderGraphPass::Type type) {
   auto idx = passes_.size();
@@ -207,14 +248,107 @@ RenderGraphPass& RenderGraph::add_pass(const std::string& name, RenderGraphPass:
 
 VoidResult RenderGraph::validate() { return VoidResult{}; }
 
+bool RenderGraph::can_run_async(const RenderGraphPass& pass) const {
+  constexpr VkPipelineStageFlags2 compute_queue_stages =
+      VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT |
+      VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT;
+  if (pass.get_type() != RenderGraphPass::Type::Compute) return false;
+  return std::ranges::all_of(pass.get_resources(), [](const RenderGraphPass::UsageAndHandle& u) {
+    return (u.stages & ~compute_queue_stages) == 0;
+  });
+}
+
 VoidResult RenderGraph::bake() {
-  ZoneScoped;
-  swapchain_img_ = get_device().get_curr_swapchain_img();
-  desc_ = get_device().get_swapchain_info();
+  PROFILE_SCOPE("RenderGraph::bake");
+  Timer timer;
+  desc_ = provider_->get_swapchain_info();
   if (auto ok = validate(); !ok) {
     return ok;
   }
 
+  const u64 hash = hash_declarations();
+  reused_compiled_ = compile_cache_enabled_ && has_compiled_ && hash == compiled_hash_;
+  if (reused_compiled_) {
+    reuse_compiled();
+    bake_stats_.cache_hits++;
+  } else {
+    has_compiled_ = false;
+    if (auto ok = compile(); !ok) {
+      return ok;
+    }
+    has_compiled_ = true;
+    compiled_hash_ = hash;
+    compiled_physical_indices_.resize(resources_.size());
+    for (size_t i = 0; i < resources_.size(); i++) {
+      compiled_physical_indices_[i] = resources_[i].physical_idx;
+    }
+    bake_stats_.cache_misses++;
+  }
+  bake_stats_.cache_hit = reused_compiled_;
+  bake_stats_.bake_ms = timer.elapsed_ms();
+  return {};
+}
+
+u64 RenderGraph::hash_declarations() const {
+  ZoneScoped;
+  using vk2::detail::hashing::hash_combine;
+  // buffer and imported image handles are left out, they change with the frame in flight without
+  // changing the graph. Swapchain dims and render scale size the transient images.
+  size_t seed{};
+  hash_combine(seed, backbuffer_img_);
+  hash_combine(seed, render_scale_);
+  hash_combine(seed, aliasing_enabled_);
+  hash_combine(seed, async_compute_enabled_);
+  hash_combine(seed, split_barrier_distance_);
+  hash_combine(seed, desc_.dims.x);
+  hash_combine(seed, desc_.dims.y);
+  hash_combine(seed, resources_.size());
+  for (const auto& resource : resources_) {
+    hash_combine(seed, resource.get_type());
+    hash_combine(seed, resource.name);
+    hash_combine(seed, resource.access);
+    hash_combine(seed, resource.img_handle.is_valid());
+    hash_combine(seed, resource.info.size_class);
+    hash_combine(seed, resource.info.dims.x);
+    hash_combine(seed, resource.info.dims.y);
+    hash_combine(seed, resource.info.dims.z);
+    hash_combine(seed, resource.info.format);
+    hash_combine(seed, resource.info.layers);
+    hash_combine(seed, resource.info.levels);
+  }
+  hash_combine(seed, passes_.size());
+  for (const auto& pass : passes_) {
+    hash_combine(seed, pass.get_name());
+    hash_combine(seed, pass.get_type());
+    hash_combine(seed, pass.get_resources().size());
+    for (const auto& usage : pass.get_resources()) {
+      hash_combine(seed, usage.handle.idx);
+      hash_combine(seed, usage.access);
+    }
+  }
+  return seed;
+}
+
+void RenderGraph::reuse_compiled() {
+  ZoneScoped;
+  assert(compiled_physical_indices_.size() == resources_.size());
+  for (size_t i = 0; i < resources_.size(); i++) {
+    auto& resource = resources_[i];
+    resource.physical_idx = compiled_physical_indices_[i];
+    if (resource.physical_idx == RenderResource::unused) continue;
+    auto& dims = physical_resource_dims_[resource.physical_idx];
+    if (resource.get_type() == RenderResource::Type::Buffer) {
+      dims.buffer_info = resource.buffer_info;
+    } else if (resource.img_handle.is_valid()) {
+      dims.external_img_handle = resource.img_handle;
+    }
+  }
+}
+
+VoidResult RenderGraph::compile() {
+  ZoneScoped;
+  physical_image_attachments_.clear();
+  physical_buffers_.clear();
   if (log_) {
     for (const auto& resource : resources_) {
       for (const auto& b : resource.get_read_passes()) {
@@ -229,42 +363,43 @@ VoidResult RenderGraph::bake() {
   // TODO: validate that backbuffer img has color write
 
   {
-    ZoneScopedN("find sinks");
-    // find sinks
-    pass_stack_.clear();
-    swapchain_writer_passes_.clear();
-    pass_dependencies_.clear();
-    pass_dependencies_.resize(passes_.size());
-    bool done = false;
-    for (int pass_i = passes_.size() - 1; pass_i >= 0 && !done; pass_i--) {
-      auto& pass = passes_[pass_i];
+    ZoneScopedN("order passes");
+    compile_usage_starts_.clear();
+    compile_usages_.clear();
+    compile_pass_queues_.clear();
+    const bool async_compute = async_compute_enabled_ && provider_->has_queue(QueueType::Compute);
+    for (const auto& pass : passes_) {
+      compile_pass_queues_.emplace_back(static_cast<u8>(
+          async_compute && can_run_async(pass) ? QueueType::Compute : QueueType::Graphics));
+      compile_usage_starts_.emplace_back(compile_usages_.size());
       for (const auto& usage : pass.get_resources()) {
-        if (get_resource(usage.handle)->name == backbuffer_img_ && is_write_access(usage.access)) {
-          pass_stack_.emplace_back(pass_i);
-          swapchain_writer_passes_.emplace_back(pass_i);
-          // TODO: lol
-          done = true;
-          break;
-        }
+        compile_usages_.emplace_back(RGPassUsage{.resource = usage.handle.idx,
+                                                 .read = is_read_access(usage.access),
+                                                 .write = is_write_access(usage.access)});
       }
     }
-  }
-  auto sink_cnt = pass_stack_.size();
-  if (sink_cnt == 0) {
-    return std::unexpected("no backbuffer writes found");
-  }
-
-  {
-    ZoneScopedN("topo sort passes");
-    // starting from the sinks, traverse the dependencies
-    for (uint32_t i = 0; i < sink_cnt; i++) {
-      assert(pass_stack_[i] < passes_.size());
-      if (auto res = traverse_dependencies_recursive(pass_stack_[i], 0); !res) {
-        return res;
-      }
+    compile_usage_starts_.emplace_back(compile_usages_.size());
+    auto backbuffer_it = resource_to_idx_map_.find(backbuffer_img_);
+    const RGCompileInput input{
+        .resource_cnt = static_cast<u32>(resources_.size()),
+        .usage_starts = compile_usage_starts_,
+        .usages = compile_usages_,
+        .sink_resource = backbuffer_it != resource_to_idx_map_.end() ? backbuffer_it->second.idx
+                                                                     : RGCompileResult::unused,
+        .pass_queues = compile_pass_queues_,
+        .min_split_distance = split_barrier_distance_};
+    if (auto ok = compiler_.compile(input, compile_result_); !ok) {
+      return ok;
+    }
+    pass_stack_ = compile_result_.pass_order;
+    swapchain_writer_passes_.assign(1, compile_result_.sink_pass);
+    pass_queues_.assign(passes_.size(), QueueType::Graphics);
+    bake_stats_.async_compute_passes = 0;
+    for (u32 pos = 0; pos < pass_stack_.size(); pos++) {
+      pass_queues_[pass_stack_[pos]] = static_cast<QueueType>(compile_result_.queues[pos]);
+      bake_stats_.async_compute_passes += pass_queues_[pass_stack_[pos]] != QueueType::Graphics;
     }
-    std::ranges::reverse(pass_stack_);
-    prune_duplicates(pass_stack_);
+    bake_stats_.queue_waits = compile_result_.queue_waits.size();
 
     if (log_) {
       LINFO("pass order: ");
@@ -435,11 +570,45 @@ VoidResult RenderGraph::bake() {
     }
   }
 
+  build_physical_lifetimes();
   return {};
 }
 
-void RenderGraph::execute(CmdEncoder& cmd) {
+void RenderGraph::record_pass(u32 pos, CmdEncoder& cmd) {
+  auto& pass = passes_[pass_stack_[pos]];
+  const u64 begin_ns = FrameProfiler::now();
+  pass.execute_(cmd);
+  const u64 end_ns = FrameProfiler::now();
+  pass_record_ms_[pos] = static_cast<double>(end_ns - begin_ns) / 1'000'000.0;
+  if (auto* profiler = FrameProfiler::get()) {
+    profiler->add_cpu_scope(pass.get_name(), begin_ns, end_ns);
+  }
+}
+
+void RenderGraph::record_secondary_cmd(u32 slot, u32 pos) {
   ZoneScoped;
+  const QueueType queue = pass_queues_[pass_stack_[pos]];
+  CmdEncoder* secondary = get_device().begin_secondary_command_list(slot, queue);
+  // secondaries inherit no state from the primary
+  get_device().bind_bindless_descriptors(*secondary);
+  if (queue == QueueType::Graphics) {
+    secondary->set_cull_mode(CullMode::None);
+  }
+  record_pass(pos, *secondary);
+  get_device().end_secondary_command_list(*secondary);
+  pass_secondary_cmds_[pos] = secondary;
+}
+
+void RenderGraph::record_secondary_cmds() {
+  ZoneScoped;
+  // each worker records into its own slot, so its command pools are only used by one thread
+  threads::parallel_for(static_cast<u32>(pass_stack_.size()), Device::max_secondary_cmd_slots,
+                        [this](u32 slot, u32 pos) { record_secondary_cmd(slot, pos); });
+}
+
+void RenderGraph::execute(CmdEncoder& cmd) {
+  PROFILE_SCOPE("RenderGraph::execute");
+  swapchain_img_ = get_device().get_curr_swapchain_img();
   if (desc_.dims.x == 0 || desc_.dims.y == 0) {
     LERROR("invalid swapchain info");
     return;
@@ -450,13 +619,25 @@ void RenderGraph::execute(CmdEncoder& cmd) {
     for (auto& p : pass_submission_state_) {
       p.reset();
     }
-    ZoneScopedN("setup barriers");
-    for (auto pass_i : pass_stack_) {
-      physical_pass_setup_barriers(pass_i);
+    split_event_states_.resize(compile_result_.split_events.size());
+    for (auto& e : split_event_states_) {
+      e.barriers.reset();
     }
+    PROFILE_SCOPE("setup barriers");
+    const auto& split_barriers = compile_result_.split_barriers;
+    const auto& split_events = compile_result_.split_events;
+    auto split_it = split_barriers.begin();
+    for (u32 pos = 0; pos < pass_stack_.size(); pos++) {
+      const auto split_begin = split_it;
+      while (split_it != split_barriers.end() && split_events[split_it->event].dst_pos == pos) {
+        ++split_it;
+      }
+      physical_pass_setup_barriers(pass_stack_[pos], std::span(split_begin, split_it));
+    }
+    setup_split_events();
   }
 
-  {
+  const auto record_swapchain_acquire = [this](CmdEncoder& swapchain_cmd) {
     VkImageMemoryBarrier2 img_barriers[] = {
         VkImageMemoryBarrier2{
             .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
@@ -475,14 +656,104 @@ void RenderGraph::execute(CmdEncoder& cmd) {
     VkDependencyInfo info{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
                           .imageMemoryBarrierCount = COUNTOF(img_barriers),
                           .pImageMemoryBarriers = img_barriers};
-    vkCmdPipelineBarrier2KHR(cmd.cmd(), &info);
+    vkCmdPipelineBarrier2KHR(swapchain_cmd.cmd(), &info);
+  };
+
+  // the swapchain image is acquired right before the first pass using the backbuffer, which
+  // always runs on graphics after everything on other queues, see RenderGraphCompiler
+  u32 backbuffer_pos = RenderResource::unused;
+  if (auto it = resource_to_idx_map_.find(backbuffer_img_); it != resource_to_idx_map_.end()) {
+    const u32 physical_idx = resources_[it->second.idx].physical_idx;
+    if (physical_idx != RenderResource::unused) {
+      backbuffer_pos = physical_lifetimes_[physical_idx].first_use;
+    }
+  }
+  Timer record_timer;
+  pass_record_ms_.assign(pass_stack_.size(), 0.);
+  pass_secondary_cmds_.assign(pass_stack_.size(), nullptr);
+  if (parallel_recording_enabled_) {
+    record_secondary_cmds();
+  }
+
+  if (backbuffer_pos == RenderResource::unused) {
+    record_swapchain_acquire(cmd);
   }
+  FrameProfiler* profiler = FrameProfiler::get();
+  if (profiler) profiler->reset_gpu_queries(cmd);
+
+  constexpr u32 queue_cnt = static_cast<u32>(QueueType::Count);
+  // open_cmds are still recording, a command list closes once another queue waits on it
+  CmdEncoder* open_cmds[queue_cnt]{&cmd};
+  CmdEncoder* last_cmds[queue_cnt]{&cmd};
+  pass_cmds_.assign(pass_stack_.size(), nullptr);
+  auto wait_it = compile_result_.queue_waits.begin();
+  const auto& split_events = compile_result_.split_events;
+  size_t wait_event_it{};
+  size_t set_event_it{};
   {
-    ZoneScopedN("Record commands");
-    for (u32 pass_i : pass_stack_) {
+    PROFILE_SCOPE("Record commands");
+    for (u32 pos = 0; pos < pass_stack_.size(); pos++) {
       ZoneScopedN("Record command");
+      const u32 pass_i = pass_stack_[pos];
       auto& pass = passes_[pass_i];
       auto& submission_state = pass_submission_state_[pass_i];
+      const QueueType queue = pass_queues_[pass_i];
+      const u32 queue_i = static_cast<u32>(queue);
+
+      CmdEncoder* wait_fors[queue_cnt]{};
+      u32 wait_for_cnt{};
+      const auto add_wait_for = [&](CmdEncoder* wait_for) {
+        if (std::ranges::find(wait_fors, wait_fors + wait_for_cnt, wait_for) ==
+            wait_fors + wait_for_cnt) {
+          wait_fors[wait_for_cnt++] = wait_for;
+        }
+      };
+      for (; wait_it != compile_result_.queue_waits.end() && wait_it->pos == pos; ++wait_it) {
+        add_wait_for(pass_cmds_[wait_it->wait_pos]);
+      }
+      if (!last_cmds[queue_i]) {
+        // first pass on another queue, it may read what cmd uploaded before the graph
+        add_wait_for(last_cmds[static_cast<u32>(QueueType::Graphics)]);
+      }
+      for (CmdEncoder* wait_for : std::span(wait_fors, wait_for_cnt)) {
+        for (auto& open_cmd : open_cmds) {
+          if (open_cmd == wait_for) open_cmd = nullptr;
+        }
+      }
+      if (wait_for_cnt || !open_cmds[queue_i]) {
+        CmdEncoder* new_cmd = get_device().begin_command_list(queue);
+        get_device().bind_bindless_descriptors(*new_cmd);
+        for (CmdEncoder* wait_for : std::span(wait_fors, wait_for_cnt)) {
+          get_device().cmd_list_wait(new_cmd, wait_for);
+        }
+        open_cmds[queue_i] = new_cmd;
+        last_cmds[queue_i] = new_cmd;
+      }
+      CmdEncoder& pass_cmd = *open_cmds[queue_i];
+      pass_cmds_[pos] = &pass_cmd;
+      if (pos == backbuffer_pos) {
+        assert(queue == QueueType::Graphics);
+        record_swapchain_acquire(pass_cmd);
+      }
+
+      // the pass's gpu time includes waiting on its barriers
+      const u32 gpu_scope = profiler ? profiler->begin_gpu_scope(pass_cmd, pass.get_name())
+                                     : FrameProfiler::invalid_scope;
+
+      // events are on the same queue, set in this or an earlier command list
+      wait_events_.clear();
+      wait_event_infos_.clear();
+      for (; wait_event_it != split_events.size() && split_events[wait_event_it].dst_pos == pos;
+           wait_event_it++) {
+        const auto& event = split_event_states_[wait_event_it];
+        if (!event.event) continue;
+        wait_events_.emplace_back(event.event);
+        wait_event_infos_.emplace_back(event.dependency_info);
+      }
+      if (!wait_events_.empty()) {
+        vkCmdWaitEvents2KHR(pass_cmd.cmd(), wait_events_.size(), wait_events_.data(),
+                            wait_event_infos_.data());
+      }
 
       VkDependencyInfo info{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
       info.bufferMemoryBarrierCount = submission_state.buffer_barriers.size();
@@ -519,11 +790,33 @@ void RenderGraph::execute(CmdEncoder& cmd) {
         LINFO("");
       }
 
-      vkCmdPipelineBarrier2KHR(cmd.cmd(), &info);
+      vkCmdPipelineBarrier2KHR(pass_cmd.cmd(), &info);
 
-      pass.execute_(cmd);
+      if (CmdEncoder* secondary = pass_secondary_cmds_[pos]) {
+        pass_cmd.execute_commands(*secondary);
+      } else {
+        record_pass(pos, pass_cmd);
+      }
+      if (profiler) profiler->end_gpu_scope(pass_cmd, gpu_scope);
+
+      const auto& set_order = compile_result_.split_event_set_order;
+      for (; set_event_it != set_order.size() &&
+             split_events[set_order[set_event_it]].src_pos == pos;
+           set_event_it++) {
+        const auto& event = split_event_states_[set_order[set_event_it]];
+        if (event.event) vkCmdSetEvent2KHR(pass_cmd.cmd(), event.event, &event.dependency_info);
+      }
     }
   }
+  record_ms_ = record_timer.elapsed_ms();
+
+  // nothing runs on other queues after the first backbuffer pass, so the frame ends in the
+  // command list that acquired the swapchain
+  CmdEncoder& present_cmd = *last_cmds[static_cast<u32>(QueueType::Graphics)];
+  assert(backbuffer_pos == RenderResource::unused || pass_cmds_[backbuffer_pos] == &present_cmd);
+  if (&present_cmd != &cmd) {
+    get_device().cmd_list_move_swapchains(&cmd, &present_cmd);
+  }
 
   // blit to swapchain
   // {
@@ -591,7 +884,9 @@ void RenderGraph::execute(CmdEncoder& cmd) {
             .dstStageMask = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
             .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
             .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            // offscreen backbuffers are left ready to be read back
+            .newLayout = get_device().is_headless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
             .image = swapchain_img_,
             .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
                                  .levelCount = 1,
@@ -601,68 +896,11 @@ void RenderGraph::execute(CmdEncoder& cmd) {
     VkDependencyInfo info{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
                           .imageMemoryBarrierCount = COUNTOF(img_barriers),
                           .pImageMemoryBarriers = img_barriers};
-    vkCmdPipelineBarrier2KHR(cmd.cmd(), &info);
+    vkCmdPipelineBarrier2KHR(present_cmd.cmd(), &info);
   }
   // }
 }
 
-// TODO: not recursive
-VoidResult RenderGraph::traverse_dependencies_recursive(uint32_t pass_i, uint32_t stack_size) {
-  if (stack_size > passes_.size() * 100) {
-    LERROR("cycle");
-    return std::unexpected("cycle detected");
-  }
-
-  auto& pass = passes_[pass_i];
-  for (const uint32_t& read_i : pass.resource_read_indices_) {
-    auto& resource_read = pass.resources_[read_i];
-    std::span<const uint16_t> passes_writing_to_resource{};
-    auto* input = get_resource(resource_read.handle);
-    assert(input);
-    passes_writing_to_resource = input->get_written_passes();
-
-    // find outputs that write to this input
-    if (passes_writing_to_resource.empty()) {
-      LINFO("resource: {}", resources_[read_i].name);
-      return std::unexpected("no pass exists which writes to resource");
-    }
-
-    if (stack_size > passes_.size() * 100) {
-      LERROR("cycle");
-      return std::unexpected("cycle detected");
-    }
-    stack_size++;
-    for (uint32_t pass_writing_to_resource : passes_writing_to_resource) {
-      if (pass_writing_to_resource == pass.get_idx()) {
-        // TODO: maybe bad!
-        continue;
-        return std::unexpected("pass depends on itself");
-      }
-      pass_stack_.push_back(pass_writing_to_resource);
-      pass_dependencies_[pass.get_idx()].insert(pass_writing_to_resource);
-      if (auto res = traverse_dependencies_recursive(pass_writing_to_resource, stack_size); !res) {
-        return res;
-      }
-    }
-  }
-  return {};
-}
-
-void RenderGraph::prune_duplicates(std::vector<uint32_t>& data) {
-  ZoneScoped;
-  dup_prune_set_.clear();
-  if (data.size() <= 1) return;
-  auto write_it = data.begin();
-  for (uint32_t el : data) {
-    if (!dup_prune_set_.contains(el)) {
-      *write_it = el;
-      dup_prune_set_.insert(el);
-      write_it++;
-    }
-  }
-  data.resize(std::distance(data.begin(), write_it));
-}
-
 RGResourceHandle RenderGraph::get_or_add_texture_resource(ImageHandle handle) {
   auto it = image_to_idx_map_.find(handle);
   if (it != image_to_idx_map_.end()) {
@@ -747,37 +985,21 @@ ResourceDimensions RenderGraph::get_resource_dims(const RenderResource& resource
 void RenderGraph::build_physical_resource_reqs() {
   ZoneScoped;
   physical_resource_dims_.clear();
-  physical_resource_dims_.reserve(resources_.size());
-  for (uint32_t pass_i : pass_stack_) {
-    auto& pass = passes_[pass_i];
-    for (const auto& r : pass.get_resources()) {
-      get_resource(r.handle)->physical_idx = RenderResource::unused;
-    }
-  }
-  // build physical resources
-  for (uint32_t pass_i : pass_stack_) {
-    auto& pass = passes_[pass_i];
-    for (const auto& resource_usage : pass.get_resources()) {
-      auto* res = get_resource(resource_usage.handle);
-      if (res->physical_idx == RenderResource::unused) {
-        assert(res);
-        res->physical_idx = physical_resource_dims_.size();
-        if (res->name == backbuffer_img_) {
-          res->access = static_cast<Access>(res->access | Access::TransferRead);
-        }
-        physical_resource_dims_.emplace_back(get_resource_dims(*res));
-      } else {
-        if (physical_resource_dims_[res->physical_idx].is_image()) {
-          physical_resource_dims_[res->physical_idx].access_usage = static_cast<Access>(
-              physical_resource_dims_[res->physical_idx].access_usage | res->access);
-        }
-      }
+  physical_resource_dims_.resize(compile_result_.physical_cnt);
+  for (u32 resource_i = 0; resource_i < resources_.size(); resource_i++) {
+    auto& res = resources_[resource_i];
+    res.physical_idx = compile_result_.physical_indices[resource_i];
+    if (res.physical_idx == RenderResource::unused) continue;
+    if (res.name == backbuffer_img_) {
+      res.access = static_cast<Access>(res.access | Access::TransferRead);
     }
+    physical_resource_dims_[res.physical_idx] = get_resource_dims(res);
   }
 }
 
 void RenderGraph::PhysicalPass::reset() {
   name.clear();
+  discard_resources.clear();
   invalidate_barriers.clear();
   flush_barriers.clear();
   physical_color_attachments.clear();
@@ -833,7 +1055,58 @@ VoidResult RenderGraph::output_graphvis(const std::filesystem::path&) {
   // return {};
 }
 
+namespace {
+
+BindFlag get_bind_flags(Access access) {
+  BindFlag flags{};
+  if (access & Access::DepthStencilRW) {
+    flags |= BindFlag::DepthStencilAttachment;
+  }
+  if (access & Access::ColorRW) {
+    flags |= BindFlag::ColorAttachment;
+  }
+  if (access & Access::ComputeRW) {
+    flags |= BindFlag::Storage;
+  }
+  if (access & Access::FragmentRead || access & Access::ComputeSample) {
+    flags |= BindFlag::ShaderResource;
+  }
+  return flags;
+}
+
+ImageDesc get_image_desc(const ResourceDimensions& dims) {
+  return ImageDesc{
+      .type = ImageDesc::Type::TwoD,
+      .format = dims.format,
+      .dims = {dims.width, dims.height, dims.depth},
+      .mip_levels = dims.levels,
+      .array_layers = dims.layers,
+      .sample_count = dims.samples,
+      .bind_flags = get_bind_flags(dims.access_usage),
+      .usage = Usage::Default,
+  };
+}
+
+}  // namespace
+
 void RenderGraph::setup_attachments() {
+  PROFILE_SCOPE("RenderGraph::setup_attachments");
+  Timer timer;
+  if (reused_compiled_) {
+    // transient images from the compiled graph are still valid, only rebind the rest
+    for (size_t i = 0; i < physical_resource_dims_.size(); i++) {
+      const auto& dims = physical_resource_dims_[i];
+      if (!dims.is_image()) {
+        physical_buffers_[i] = dims.buffer_info.handle;
+      } else if (dims.external_img_handle.is_valid()) {
+        physical_image_attachments_[i] = dims.external_img_handle;
+      } else if (dims.is_swapchain) {
+        physical_image_attachments_[i] = get_device().get_swapchain_handle();
+      }
+    }
+    bake_stats_.setup_attachments_ms = timer.elapsed_ms();
+    return;
+  }
   // only make attachments if they don't match prev frame
   // check if buffer/img in each slot works, otherwise make a new one
   physical_image_attachments_.resize(physical_resource_dims_.size());
@@ -842,36 +1115,17 @@ void RenderGraph::setup_attachments() {
     img_cache_.emplace(key, std::move(val));
   }
   img_cache_used_.clear();
-  auto get_bind_flags = [](Access access) -> BindFlag {
-    BindFlag flags{};
-    if (access & Access::DepthStencilRW) {
-      flags |= BindFlag::DepthStencilAttachment;
-    }
-    if (access & Access::ColorRW) {
-      flags |= BindFlag::ColorAttachment;
-    }
-    if (access & Access::ComputeRW) {
-      flags |= BindFlag::Storage;
-    }
-    if (access & Access::FragmentRead || access & Access::ComputeSample) {
-      flags |= BindFlag::ShaderResource;
-    }
-    return flags;
-  };
 
+  alias_candidates_.clear();
   for (size_t i = 0; i < physical_resource_dims_.size(); i++) {
     auto& dims = physical_resource_dims_[i];
     if (dims.is_image() && !dims.external_img_handle.is_valid()) {
-      ImageDesc desc{
-          .type = ImageDesc::Type::TwoD,
-          .format = dims.format,
-          .dims = {dims.width, dims.height, dims.depth},
-          .mip_levels = dims.levels,
-          .array_layers = dims.layers,
-          .sample_count = dims.samples,
-          .bind_flags = get_bind_flags(dims.access_usage),
-          .usage = Usage::Default,
-      };
+      const auto& lifetime = physical_lifetimes_[i];
+      if (!dims.is_swapchain && lifetime.discards && !lifetime.async) {
+        alias_candidates_.emplace_back(i);
+        if (aliasing_enabled_) continue;
+      }
+      const ImageDesc desc = get_image_desc(dims);
       assert(i < physical_image_attachments_.size());
       {
         auto it = img_cache_.find(dims);
@@ -931,9 +1185,147 @@ void RenderGraph::setup_attachments() {
       physical_buffers_[i] = dims.buffer_info.handle;
     }
   }
+  setup_aliased_images();
+  if (aliasing_enabled_) {
+    // keeping unused images around for later graphs would undo what aliasing saves
+    img_cache_.clear();
+  }
+  bake_stats_.setup_attachments_ms = timer.elapsed_ms();
+}
+
+void RenderGraph::setup_aliased_images() {
+  ZoneScoped;
+  using vk2::detail::hashing::hash_combine;
+  alias_barriers_.assign(physical_resource_dims_.size(), AliasBarrier{});
+  transient_memory_stats_ = {};
+  if (alias_candidates_.empty()) {
+    release_aliased_images();
+    return;
+  }
+
+  std::vector<ImageDesc> descs;
+  std::vector<util::AliasResource> alias_resources;
+  for (u32 physical_idx : alias_candidates_) {
+    const auto& desc = descs.emplace_back(get_image_desc(physical_resource_dims_[physical_idx]));
+    const auto reqs = get_device().get_image_memory_requirements(desc);
+    const auto& lifetime = physical_lifetimes_[physical_idx];
+    alias_resources.emplace_back(util::AliasResource{.size = reqs.size,
+                                                     .alignment = reqs.alignment,
+                                                     .memory_type_bits = reqs.memoryTypeBits,
+                                                     .first_use = lifetime.first_use,
+                                                     .last_use = lifetime.last_use});
+  }
+  const auto plan = util::plan_aliases(alias_resources);
+  transient_memory_stats_ = {.images = static_cast<u32>(alias_candidates_.size()),
+                             .heaps = static_cast<u32>(plan.heaps.size()),
+                             .unaliased_bytes = plan.unaliased_bytes,
+                             .aliased_bytes = plan.aliased_bytes,
+                             .peak_live_bytes = plan.peak_live_bytes};
+  if (!aliasing_enabled_) {
+    release_aliased_images();
+    return;
+  }
+
+  size_t key{};
+  for (size_t i = 0; i < descs.size(); i++) {
+    const auto& desc = descs[i];
+    hash_combine(key, desc.format);
+    hash_combine(key, desc.dims.x);
+    hash_combine(key, desc.dims.y);
+    hash_combine(key, desc.dims.z);
+    hash_combine(key, desc.mip_levels);
+    hash_combine(key, desc.array_layers);
+    hash_combine(key, desc.sample_count);
+    hash_combine(key, desc.bind_flags);
+    hash_combine(key, plan.placements[i].heap);
+    hash_combine(key, plan.placements[i].offset);
+  }
+  for (const auto& heap : plan.heaps) {
+    hash_combine(key, heap.size);
+    hash_combine(key, heap.memory_type_bits);
+  }
+  if (aliased_images_.empty() || key != aliased_images_key_) {
+    release_aliased_images();
+    for (const auto& heap : plan.heaps) {
+      alias_heaps_.emplace_back(get_device().allocate_memory(
+          VkMemoryRequirements{.size = heap.size,
+                               .alignment = heap.alignment,
+                               .memoryTypeBits = heap.memory_type_bits}));
+    }
+    for (size_t i = 0; i < descs.size(); i++) {
+      const auto& placement = plan.placements[i];
+      aliased_images_.emplace_back(get_device().create_placed_image(
+          descs[i], alias_heaps_[placement.heap], placement.offset));
+    }
+    aliased_images_key_ = key;
+    LINFO("placed {} transient images into {} heaps", descs.size(), plan.heaps.size());
+  }
+  for (size_t i = 0; i < alias_candidates_.size(); i++) {
+    physical_image_attachments_[alias_candidates_[i]] = aliased_images_[i].handle;
+  }
+
+  for (const auto& [a, b] : plan.aliases) {
+    const u32 a_idx = alias_candidates_[a];
+    const u32 b_idx = alias_candidates_[b];
+    for (auto [dst, src] : {std::pair{a_idx, b_idx}, std::pair{b_idx, a_idx}}) {
+      auto& barrier = alias_barriers_[dst];
+      barrier.first_pass = pass_stack_[physical_lifetimes_[dst].first_use];
+      barrier.src_stages |= physical_lifetimes_[src].stages;
+      barrier.src_access |= physical_lifetimes_[src].write_access;
+    }
+  }
+}
+
+void RenderGraph::release_aliased_images() {
+  for (const auto& image : aliased_images_) {
+    image_pipeline_states_.erase(image.handle);
+  }
+  aliased_images_.clear();
+  for (VmaAllocation heap : alias_heaps_) {
+    get_device().free_memory(heap);
+  }
+  alias_heaps_.clear();
+  aliased_images_key_ = 0;
+}
+
+void RenderGraph::build_physical_lifetimes() {
+  ZoneScoped;
+  physical_lifetimes_.assign(physical_resource_dims_.size(), PhysicalLifetime{});
+  for (u32 pos = 0; pos < pass_stack_.size(); pos++) {
+    const u32 pass_i = pass_stack_[pos];
+    for (const auto& usage : passes_[pass_i].get_resources()) {
+      const u32 physical_idx = get_resource(usage.handle)->physical_idx;
+      if (physical_idx == RenderResource::unused) continue;
+      auto& lifetime = physical_lifetimes_[physical_idx];
+      if (lifetime.first_use == RenderResource::unused) {
+        const auto& discards = physical_passes_[pass_i].discard_resources;
+        lifetime.first_use = pos;
+        lifetime.discards = std::ranges::find(discards, physical_idx) != discards.end();
+      }
+      lifetime.last_use = pos;
+      lifetime.async |= pass_queues_[pass_i] != QueueType::Graphics;
+      lifetime.stages |= usage.stages;
+      if (is_write_access(usage.access)) {
+        lifetime.write_access |= usage.access_flags;
+      }
+    }
+  }
 }
 
 namespace {
+const char* queue_type_name(QueueType type) {
+  switch (type) {
+    case QueueType::Graphics:
+      return "graphics";
+    case QueueType::Compute:
+      return "compute";
+    case QueueType::Transfer:
+      return "transfer";
+    default:
+      return "unknown";
+  }
+}
+
 VkImageLayout get_image_layout(Access access) {
   if (access & Access::ColorRW) {
     return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -1006,7 +1398,6 @@ void RenderGraph::build_barrier_infos() {
   //           string_VkPipelineStageFlags2(barrier.stages));
   //   }
   // }
-  // TODO: aliasing to reuse images
 }
 
 void RenderGraph::PassSubmissionState::reset() {
@@ -1028,14 +1419,21 @@ bool RenderGraph::needs_invalidate(const Barrier& barrier, const ResourceState&
   return needs_invalidate;
 }
 
-void RenderGraph::physical_pass_setup_barriers(u32 pass_i) {
+void RenderGraph::physical_pass_setup_barriers(u32 pass_i,
+                                               std::span<const RGSplitBarrier> split_barriers) {
   ZoneScoped;
-  auto& state = pass_submission_state_[pass_i];
+  auto& pass_state = pass_submission_state_[pass_i];
   auto& pass = physical_passes_[pass_i];
+  const QueueType queue = pass_queues_[pass_i];
 
   // place barriers
   for (const auto& barrier : pass.invalidate_barriers) {
     bool layout_change = false;
+    // the resource was last written far enough back on this queue, see RGSplitEvent
+    auto split_it = std::ranges::find(split_barriers, barrier.resource_idx,
+                                      &RGSplitBarrier::physical_idx);
+    auto& state = split_it != split_barriers.end() ? split_event_states_[split_it->event].barriers
+                                                   : pass_state;
     assert(barrier.resource_idx < physical_resource_dims_.size());
     assert(barrier.resource_idx < physical_image_attachments_.size());
     assert(barrier.resource_idx < physical_buffers_.size());
@@ -1043,9 +1441,14 @@ void RenderGraph::physical_pass_setup_barriers(u32 pass_i) {
     auto* pstate = get_resource_pipeline_state(barrier.resource_idx);
     assert(pstate);
     auto& resource_state = *pstate;
+    // Last used on another queue: a semaphore already orders that use before this pass and makes
+    // its writes visible, and its stages may not exist on this queue. The barrier only has to
+    // chain after the semaphore wait. Resources are shared concurrently between queue families,
+    // so there is no ownership transfer.
+    const bool queue_change = resource_state.queue != queue;
+    resource_state.queue = queue;
 
     if (phys_dims.is_image()) {
-      // queue families ignored
       const auto* image = get_device().get_image(physical_image_attachments_[barrier.resource_idx]);
       assert(image);
       if (!image) {
@@ -1065,17 +1468,31 @@ void RenderGraph::physical_pass_setup_barriers(u32 pass_i) {
       b.subresourceRange.layerCount = image->get_desc().array_layers;
       b.subresourceRange.levelCount = image->get_desc().mip_levels;
 
+      // the bytes were last used by the images this one aliases, its contents are undefined
+      const auto& alias = alias_barriers_[barrier.resource_idx];
+      const bool acquires_alias = alias.first_pass == pass_i;
+      if (acquires_alias) {
+        b.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      }
+
       layout_change = b.oldLayout != b.newLayout;
-      bool needs_sync = layout_change || needs_invalidate(barrier, resource_state);
+      bool needs_sync = layout_change || queue_change || needs_invalidate(barrier, resource_state);
 
       if (needs_sync) {
-        if (resource_state.pipeline_barrier_src_stages) {
+        if (queue_change) {
+          b.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+          b.srcAccessMask = 0;
+        } else if (resource_state.pipeline_barrier_src_stages) {
           b.srcStageMask = resource_state.pipeline_barrier_src_stages;
         } else {
           b.srcStageMask = VK_PIPELINE_STAGE_NONE;
           b.srcAccessMask = 0;
           // assert(b.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
         }
+        if (acquires_alias) {
+          b.srcStageMask |= alias.src_stages;
+          b.srcAccessMask |= alias.src_access;
+        }
         state.image_barriers.push_back(b);
       }
 
@@ -1098,6 +1515,10 @@ void RenderGraph::physical_pass_setup_barriers(u32 pass_i) {
       b.srcAccessMask = resource_state.to_flush_access;
       b.dstAccessMask = barrier.access;
       b.srcStageMask = resource_state.pipeline_barrier_src_stages;
+      if (queue_change) {
+        b.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        b.srcAccessMask = 0;
+      }
       b.dstStageMask = barrier.stages;
       b.size = buffer->size();
       b.offset = 0;
@@ -1105,7 +1526,7 @@ void RenderGraph::physical_pass_setup_barriers(u32 pass_i) {
     }
 
     // if pending write or layout change, must invalidate caches
-    if (resource_state.to_flush_access || layout_change) {
+    if (resource_state.to_flush_access || layout_change || queue_change) {
       for (auto& e : resource_state.invalidated_in_stage) e = 0;
     }
   }
@@ -1146,6 +1567,43 @@ Image* RenderGraph::get_texture(RenderResource* resource) {
   return get_device().get_image(physical_image_attachments_[resource->physical_idx]);
 }
 
+void RenderGraph::setup_split_events() {
+  barrier_stats_ = {};
+  for (auto pass_i : pass_stack_) {
+    const auto& state = pass_submission_state_[pass_i];
+    barrier_stats_.full_barriers += state.image_barriers.size() + state.buffer_barriers.size();
+  }
+  const u32 frame = get_device().curr_frame_in_flight();
+  auto& pool = split_event_pool_[frame];
+  // the frame's fence was waited on, so the events it set last time are done
+  for (u32 i = 0; i < split_events_used_[frame]; i++) {
+    VK_CHECK(vkResetEvent(get_device().device(), pool[i]));
+  }
+  u32 used{};
+  for (auto& e : split_event_states_) {
+    const auto& image_barriers = e.barriers.image_barriers;
+    const auto& buffer_barriers = e.barriers.buffer_barriers;
+    e.event = VK_NULL_HANDLE;
+    // nothing to wait for, e.g. a read in a stage that already saw the write
+    if (image_barriers.empty() && buffer_barriers.empty()) continue;
+    if (used == pool.size()) {
+      VkEventCreateInfo info{.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO};
+      VK_CHECK(vkCreateEvent(get_device().device(), &info, nullptr, &pool.emplace_back()));
+    }
+    e.event = pool[used++];
+    e.dependency_info = VkDependencyInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                                         .bufferMemoryBarrierCount =
+                                             static_cast<u32>(buffer_barriers.size()),
+                                         .pBufferMemoryBarriers = buffer_barriers.data(),
+                                         .imageMemoryBarrierCount =
+                                             static_cast<u32>(image_barriers.size()),
+                                         .pImageMemoryBarriers = image_barriers.data()};
+    barrier_stats_.split_barriers += image_barriers.size() + buffer_barriers.size();
+  }
+  split_events_used_[frame] = used;
+  barrier_stats_.events = used;
+}
+
 void RenderGraph::print_barrier(const VkImageMemoryBarrier2& barrier) const {
   LINFO(
       "oldLayout: {}, newLayout: {}, aspect {}\nsrcAccess: {}, dstAccess: {}\nsrcStage: {}, "
@@ -1179,14 +1637,10 @@ void RenderGraph::reset() {
   passes_.clear();
   buffer_to_idx_map_.clear();
   image_to_idx_map_.clear();
-  physical_resource_dims_.clear();
   resources_.clear();
   resource_to_idx_map_.clear();
-  pass_dependencies_.clear();
   swapchain_writer_passes_.clear();
-  dup_prune_set_.clear();
-  physical_image_attachments_.clear();
-  physical_buffers_.clear();
+  // physical resources are kept for bake to reuse
 }
 
 std::size_t ResourceDimensionsHasher::operator()(const ResourceDimensions& dims) const {
@@ -1217,8 +1671,16 @@ RenderGraph::ResourceState* RenderGraph::get_resource_pipeline_state(u32 idx) {
 
 void RenderGraph::print_pass_order() {
   LINFO("passes: \n");
-  for (auto& pass : pass_stack_) {
-    LINFO("{}", passes_[pass].name_);
+  auto wait_it = compile_result_.queue_waits.begin();
+  for (u32 pos = 0; pos < pass_stack_.size(); pos++) {
+    const u32 pass_i = pass_stack_[pos];
+    std::string waits;
+    for (; wait_it != compile_result_.queue_waits.end() && wait_it->pos == pos; ++wait_it) {
+      const u32 wait_pass_i = pass_stack_[wait_it->wait_pos];
+      waits += std::format(" (waits for {} on {})", passes_[wait_pass_i].name_,
+                           queue_type_name(pass_queues_[wait_pass_i]));
+    }
+    LINFO("{} [{}]{}", passes_[pass_i].name_, queue_type_name(pass_queues_[pass_i]), waits);
   }
   LINFO("");
 }
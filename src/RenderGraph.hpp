@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 
 #include <expected>
@@ -7,18 +8,16 @@
 #include <functional>
 #include <span>
 #include <string>
-#include <unordered_set>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "RenderGraphCompiler.hpp"
 #include "Types.hpp"
-#include "core/FixedVector.hpp"
 #include "vk2/Pool.hpp"
 
 namespace gfx {
 
-using VoidResult = std::expected<void, const char*>;
-
 struct CmdEncoder;
 using ExecuteFn = std::function<void(CmdEncoder& cmd)>;
 
@@ -37,7 +36,6 @@ struct ResourceDimensions {
   bool is_swapchain{};
   Access access_usage{};
   // VkImageUsageFlags image_usage_flags{};
-  // TODO: queues
   [[nodiscard]] bool is_image() const;
   friend bool operator==(const ResourceDimensions& a, const ResourceDimensions& b) {
     bool valid_extent = false;
@@ -75,10 +73,10 @@ struct RenderResource {
   [[nodiscard]] uint32_t get_idx() const { return idx_; }
 
   void read_in_pass(uint32_t pass) { read_passes_.emplace_back(pass); }
-  [[nodiscard]] std::span<const uint16_t> get_read_passes() const { return read_passes_; }
+  [[nodiscard]] std::span<const uint32_t> get_read_passes() const { return read_passes_; }
 
   void written_in_pass(uint32_t pass) { written_passes_.emplace_back(pass); }
-  [[nodiscard]] std::span<const uint16_t> get_written_passes() const { return written_passes_; }
+  [[nodiscard]] std::span<const uint32_t> get_written_passes() const { return written_passes_; }
 
   std::string name;
   uint32_t physical_idx{unused};
@@ -91,9 +89,20 @@ struct RenderResource {
  private:
   Type type_;
   uint32_t idx_{unused};
-  // TODO: flat set
-  util::fixed_vector<uint16_t, 20> written_passes_;
-  util::fixed_vector<uint16_t, 20> read_passes_;
+  std::vector<uint32_t> written_passes_;
+  std::vector<uint32_t> read_passes_;
+};
+
+// What the graph needs from the device while declaring and baking, so graphs can be compiled
+// without one. Defaults to the global Device.
+struct RGResourceProvider {
+  virtual ~RGResourceProvider() = default;
+  [[nodiscard]] virtual AttachmentInfo get_swapchain_info() const = 0;
+  // 0 if the buffer doesn't exist
+  [[nodiscard]] virtual u64 get_buffer_size(BufferHandle handle) const = 0;
+  [[nodiscard]] virtual bool has_image(ImageHandle handle) const = 0;
+  // whether the device has a separate queue of the type, compute passes fall back to graphics
+  [[nodiscard]] virtual bool has_queue(QueueType type) const = 0;
 };
 
 // enum class ResourceUsage : uint8_t {
@@ -136,7 +145,8 @@ struct RenderGraphPass {
     execute_ = std::forward<F>(fn);
   }
 
-  // TODO: assign queue to the pass
+  // Compute passes may run on the async compute queue, see RenderGraph::get_pass_queue
+  [[nodiscard]] Type get_type() const { return type_; }
   [[nodiscard]] const std::string& get_name() const { return name_; }
   [[nodiscard]] uint32_t get_idx() const { return idx_; }
 
@@ -170,21 +180,31 @@ struct RenderGraphPass {
   ExecuteFn execute_;
   RenderGraph& graph_;
   const uint32_t idx_;
+  const Type type_;
 
   // [[nodiscard]] bool contains_input(const std::string& name) const;
 };
 
 struct RenderGraph {
-  explicit RenderGraph(std::string name = "RenderGraph");
+  explicit RenderGraph(std::string name = "RenderGraph", RGResourceProvider* provider = nullptr);
   RenderGraphPass& add_pass(const std::string& name,
                             RenderGraphPass::Type type = RenderGraphPass::Type::Graphics);
   void set_backbuffer_img(const std::string& name) { backbuffer_img_ = name; }
   void set_render_scale(float render_scale) { render_scale_ = render_scale; }
   [[nodiscard]] const std::string& get_backbuffer_img_name() const { return backbuffer_img_; }
   void reset();
+  // Compiles the declared passes. When passes, resources and accesses hash the same as last
+  // frame's, the pass order, physical resources and barrier lists are reused and only buffers
+  // and imported images are rebound.
   VoidResult bake();
   VoidResult output_graphvis(const std::filesystem::path& path);
   void setup_attachments();
+  // Records the passes into cmd. Passes on another queue go into their own command lists, which
+  // wait on cmd's commands recorded before this, and the passes after them that need their results
+  // go into new command lists waiting on them. The frame ends in the last graphics command list,
+  // which takes over cmd's swapchain. With parallel recording on, each pass is first recorded into
+  // a secondary command list on the thread pool, and the barriers computed here are recorded
+  // between them in pass order.
   void execute(CmdEncoder& cmd);
 
   RGResourceHandle get_or_add_buffer_resource(BufferHandle handle);
@@ -197,13 +217,82 @@ struct RenderGraph {
   ImageHandle get_texture_handle(RGResourceHandle resource);
 
   [[nodiscard]] const AttachmentInfo& get_swapchain_info() const { return desc_; }
+  // passes in execution order with their queue and the passes on other queues they wait for
   void print_pass_order();
+  // passes in execution order after bake, culled passes left out
+  [[nodiscard]] std::span<const uint32_t> get_pass_order() const { return pass_stack_; }
+  [[nodiscard]] const RenderGraphPass& get_pass(uint32_t pass_i) const { return passes_[pass_i]; }
+  // queue the pass runs on as of the last bake
+  [[nodiscard]] QueueType get_pass_queue(uint32_t pass_i) const { return pass_queues_[pass_i]; }
+  // cross queue waits of the last bake, positions in get_pass_order()
+  [[nodiscard]] std::span<const RGQueueWait> get_queue_waits() const {
+    return compile_result_.queue_waits;
+  }
+
+  struct BakeStats {
+    // last frame
+    double bake_ms;
+    double setup_attachments_ms;
+    bool cache_hit;
+    u64 cache_hits;
+    u64 cache_misses;
+    // as of the last compile
+    u32 async_compute_passes;
+    u32 queue_waits;
+  };
+  void set_compile_cache_enabled(bool enabled) { compile_cache_enabled_ = enabled; }
+  // Compute passes that only touch resources from compute and transfer stages run on the compute
+  // queue when the device has a separate one.
+  void set_async_compute_enabled(bool enabled) { async_compute_enabled_ = enabled; }
+  // Execute functions then run on worker threads, so they must only read shared renderer state.
+  void set_parallel_recording_enabled(bool enabled) { parallel_recording_enabled_ = enabled; }
+  // Barriers waiting for a write at least this many passes earlier on the same queue are split
+  // into an event set after the writer and waited on before the reader, 0 never splits.
+  void set_split_barrier_distance(u32 distance) { split_barrier_distance_ = distance; }
+  struct BarrierStats {
+    // last frame, image and buffer barriers
+    u32 full_barriers;
+    u32 split_barriers;
+    u32 events;
+  };
+  [[nodiscard]] const BarrierStats& get_barrier_stats() const { return barrier_stats_; }
+  // split barrier placement as of the last compile, positions in get_pass_order()
+  [[nodiscard]] std::span<const RGSplitEvent> get_split_events() const {
+    return compile_result_.split_events;
+  }
+  [[nodiscard]] std::span<const RGSplitBarrier> get_split_barriers() const {
+    return compile_result_.split_barriers;
+  }
+  [[nodiscard]] const BakeStats& get_bake_stats() const { return bake_stats_; }
+  // CPU time spent in each pass's execute function last frame, by position in get_pass_order()
+  [[nodiscard]] std::span<const double> get_pass_record_ms() const { return pass_record_ms_; }
+  // wall time of recording all passes last frame, including barriers and command list setup
+  [[nodiscard]] double get_record_ms() const { return record_ms_; }
+
+  // Transient images whose contents don't live past the frame, as of the last compile. With
+  // aliasing on they share memory heaps wherever their lifetimes in the pass order don't overlap.
+  struct TransientMemoryStats {
+    u32 images;
+    u32 heaps;
+    // each image in its own allocation
+    u64 unaliased_bytes;
+    // sum of the heaps, whether or not aliasing is on
+    u64 aliased_bytes;
+    // most bytes alive at any one pass
+    u64 peak_live_bytes;
+  };
+  void set_aliasing_enabled(bool enabled) { aliasing_enabled_ = enabled; }
+  [[nodiscard]] const TransientMemoryStats& get_transient_memory_stats() const {
+    return transient_memory_stats_;
+  }
+  ~RenderGraph();
 
  private:
   // TODO: integrate swapchain more closely?
   friend struct RenderGraphPass;
 
   VkImage swapchain_img_{};
+  RGResourceProvider* provider_;
   std::string name_;
   std::vector<RenderGraphPass> passes_;
   std::string backbuffer_img_;
@@ -221,6 +310,19 @@ struct RenderGraph {
     std::vector<VkBufferMemoryBarrier2> buffer_barriers;
   };
   std::vector<PassSubmissionState> pass_submission_state_;
+  // per RGCompileResult::split_events, the dependency info is shared by the set and the wait
+  struct SplitEventState {
+    PassSubmissionState barriers;
+    VkDependencyInfo dependency_info;
+    VkEvent event;
+  };
+  std::vector<SplitEventState> split_event_states_;
+  // events are reset on the host once the frame in flight using them is done
+  std::vector<VkEvent> split_event_pool_[frames_in_flight];
+  u32 split_events_used_[frames_in_flight]{};
+  std::vector<VkEvent> wait_events_;
+  std::vector<VkDependencyInfo> wait_event_infos_;
+  BarrierStats barrier_stats_{};
 
   struct PhysicalPass {
     std::string name;
@@ -237,13 +339,13 @@ struct RenderGraph {
     VkAccessFlags2 to_flush_access{};
     VkPipelineStageFlags2 pipeline_barrier_src_stages{};
     VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    // queue of the last use, possibly last frame
+    QueueType queue{QueueType::Graphics};
   };
 
   std::vector<PhysicalPass> physical_passes_;
   bool needs_invalidate(const Barrier& barrier, const ResourceState& state);
 
-  void prune_duplicates(std::vector<uint32_t>& data);
-
   // TODO: pool
   std::vector<RenderResource> resources_;
   std::vector<ResourceDimensions> physical_resource_dims_;
@@ -255,14 +357,20 @@ struct RenderGraph {
   std::unordered_map<BufferHandle, RGResourceHandle> buffer_to_idx_map_;
   std::unordered_map<ImageHandle, RGResourceHandle> image_to_idx_map_;
 
-  // TODO: bitset
-  std::vector<std::unordered_set<uint32_t>> pass_dependencies_;
+  RenderGraphCompiler compiler_;
+  std::vector<u32> compile_usage_starts_;
+  std::vector<RGPassUsage> compile_usages_;
+  std::vector<u8> compile_pass_queues_;
+  RGCompileResult compile_result_;
+  // per pass
+  std::vector<QueueType> pass_queues_;
+  // per position in pass_stack_ while recording
+  std::vector<CmdEncoder*> pass_cmds_;
+  std::vector<CmdEncoder*> pass_secondary_cmds_;
+  std::vector<double> pass_record_ms_;
+  double record_ms_{};
   std::vector<uint32_t> pass_stack_;
   std::vector<uint32_t> swapchain_writer_passes_;
-  VoidResult traverse_dependencies_recursive(uint32_t pass_i, uint32_t stack_size);
-  std::unordered_set<u32> visited_;
-
-  std::unordered_set<uint32_t> dup_prune_set_;
 
   std::unordered_multimap<ResourceDimensions, Holder<ImageHandle>, ResourceDimensionsHasher>
       img_cache_;
@@ -274,10 +382,61 @@ struct RenderGraph {
   void build_physical_resource_reqs();
   void build_barrier_infos();
   void build_resource_aliases();
-  void physical_pass_setup_barriers(u32 pass_i);
+  void physical_pass_setup_barriers(u32 pass_i, std::span<const RGSplitBarrier> split_barriers);
+  void setup_split_events();
   void print_barrier(const VkImageMemoryBarrier2& barrier) const;
   void print_barrier(const VkBufferMemoryBarrier2& barrier) const;
   VoidResult validate();
+  VoidResult compile();
+  [[nodiscard]] u64 hash_declarations() const;
+  void reuse_compiled();
+  void build_physical_lifetimes();
+  void setup_aliased_images();
+  void release_aliased_images();
+
+  [[nodiscard]] bool can_run_async(const RenderGraphPass& pass) const;
+  // runs the pass's execute function, timing it for get_pass_record_ms and the FrameProfiler
+  void record_pass(u32 pos, CmdEncoder& cmd);
+  void record_secondary_cmds();
+  void record_secondary_cmd(u32 slot, u32 pos);
+
+  bool compile_cache_enabled_{true};
+  bool async_compute_enabled_{true};
+  bool parallel_recording_enabled_{};
+  u32 split_barrier_distance_{2};
+  bool has_compiled_{};
+  bool reused_compiled_{};
+  u64 compiled_hash_{};
+  // physical_idx of each resource when compiled_hash_ was compiled
+  std::vector<u32> compiled_physical_indices_;
+  BakeStats bake_stats_{};
+
+  struct PhysicalLifetime {
+    // positions in pass_stack_
+    u32 first_use{RenderResource::unused};
+    u32 last_use{RenderResource::unused};
+    VkPipelineStageFlags2 stages{};
+    VkAccessFlags2 write_access{};
+    // the first use overwrites it, so its memory can hold something else before that
+    bool discards{};
+    // used outside the graphics queue, alias barriers don't cross queues
+    bool async{};
+  };
+  std::vector<PhysicalLifetime> physical_lifetimes_;
+  // what an aliased image's first use waits on: every use of the images sharing its bytes
+  struct AliasBarrier {
+    u32 first_pass{RenderResource::unused};
+    VkPipelineStageFlags2 src_stages{};
+    VkAccessFlags2 src_access{};
+  };
+  std::vector<AliasBarrier> alias_barriers_;
+  std::vector<u32> alias_candidates_;
+  std::vector<VmaAllocation> alias_heaps_;
+  std::vector<Holder<ImageHandle>> aliased_images_;
+  // descs and placements the aliased images were created with
+  u64 aliased_images_key_{};
+  bool aliasing_enabled_{true};
+  TransientMemoryStats transient_memory_stats_{};
 
   std::unordered_map<u64, BufferHandle> buffer_bindings_;
 
@@ -0,0 +1,225 @@
+#include "RenderGraphCompiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <span>
+#include <tracy/Tracy.hpp>
+
+namespace gfx {
+
+VoidResult RenderGraphCompiler::compile(const RGCompileInput& input, RGCompileResult& out) {
+  ZoneScoped;
+  assert(!input.usage_starts.empty());
+  const u32 pass_cnt = input.usage_starts.size() - 1;
+  out.pass_order.clear();
+  out.physical_indices.assign(input.resource_cnt, RGCompileResult::unused);
+  out.physical_cnt = 0;
+  out.sink_pass = RGCompileResult::unused;
+  auto usages_of = [&input](u32 pass) {
+    return input.usages.subspan(input.usage_starts[pass],
+                                input.usage_starts[pass + 1] - input.usage_starts[pass]);
+  };
+
+  {
+    ZoneScopedN("writers");
+    writer_starts_.assign(input.resource_cnt + 1, 0);
+    for (const auto& usage : input.usages) {
+      if (usage.write) writer_starts_[usage.resource + 1]++;
+    }
+    for (u32 i = 0; i < input.resource_cnt; i++) {
+      writer_starts_[i + 1] += writer_starts_[i];
+    }
+    writers_.resize(writer_starts_.back());
+    // reuse in_degrees_ as fill cursors
+    in_degrees_.assign(writer_starts_.begin(), writer_starts_.end() - 1);
+    for (u32 pass = 0; pass < pass_cnt; pass++) {
+      for (const auto& usage : usages_of(pass)) {
+        if (usage.write) writers_[in_degrees_[usage.resource]++] = pass;
+      }
+    }
+  }
+  auto writers_of = [this](u32 resource) {
+    return std::span(writers_).subspan(writer_starts_[resource],
+                                       writer_starts_[resource + 1] - writer_starts_[resource]);
+  };
+
+  if (input.sink_resource >= input.resource_cnt || writers_of(input.sink_resource).empty()) {
+    return std::unexpected("no backbuffer writes found");
+  }
+  out.sink_pass = writers_of(input.sink_resource).back();
+
+  {
+    ZoneScopedN("reach");
+    // only passes the sink depends on get a dependency row
+    if (dependencies_.size() < pass_cnt) dependencies_.resize(pass_cnt);
+    reached_.resize(pass_cnt);
+    edges_.clear();
+    stack_.clear();
+    stack_.emplace_back(out.sink_pass);
+    reached_.set(out.sink_pass);
+    while (!stack_.empty()) {
+      const u32 pass = stack_.back();
+      stack_.pop_back();
+      auto& deps = dependencies_[pass];
+      deps.resize(pass_cnt);
+      for (const auto& usage : usages_of(pass)) {
+        if (!usage.read) continue;
+        const auto writers = writers_of(usage.resource);
+        if (writers.empty()) {
+          return std::unexpected("no pass exists which writes to resource");
+        }
+        for (u32 writer : writers) {
+          if (writer == pass || !deps.test_and_set(writer)) continue;
+          edges_.emplace_back(writer, pass);
+          if (reached_.test_and_set(writer)) {
+            stack_.emplace_back(writer);
+          }
+        }
+      }
+    }
+  }
+
+  {
+    ZoneScopedN("topo sort");
+    in_degrees_.assign(pass_cnt, 0);
+    dependent_starts_.assign(pass_cnt + 1, 0);
+    for (const auto& [writer, reader] : edges_) {
+      in_degrees_[reader]++;
+      dependent_starts_[writer + 1]++;
+    }
+    for (u32 i = 0; i < pass_cnt; i++) {
+      dependent_starts_[i + 1] += dependent_starts_[i];
+    }
+    dependents_.resize(edges_.size());
+    // ready_ doubles as fill cursors until the sort starts
+    ready_.assign(dependent_starts_.begin(), dependent_starts_.end() - 1);
+    for (const auto& [writer, reader] : edges_) {
+      dependents_[ready_[writer]++] = reader;
+    }
+
+    // min heap on pass index keeps independent passes in declaration order
+    ready_.clear();
+    reached_.for_each_set([this](size_t pass) {
+      if (in_degrees_[pass] == 0) ready_.emplace_back(pass);
+    });
+    std::ranges::make_heap(ready_, std::greater{});
+    while (!ready_.empty()) {
+      std::ranges::pop_heap(ready_, std::greater{});
+      const u32 pass = ready_.back();
+      ready_.pop_back();
+      out.pass_order.emplace_back(pass);
+      for (u32 i = dependent_starts_[pass]; i < dependent_starts_[pass + 1]; i++) {
+        const u32 dependent = dependents_[i];
+        if (--in_degrees_[dependent] == 0) {
+          ready_.emplace_back(dependent);
+          std::ranges::push_heap(ready_, std::greater{});
+        }
+      }
+    }
+    if (out.pass_order.size() != reached_.count()) {
+      return std::unexpected("cycle detected");
+    }
+  }
+
+  for (u32 pass : out.pass_order) {
+    for (const auto& usage : usages_of(pass)) {
+      if (out.physical_indices[usage.resource] == RGCompileResult::unused) {
+        out.physical_indices[usage.resource] = out.physical_cnt++;
+      }
+    }
+  }
+
+  {
+    ZoneScopedN("schedule queues");
+    constexpr u32 unused = RGCompileResult::unused;
+    constexpr u32 max_queues = RGCompileResult::max_queues;
+    out.queues.clear();
+    out.queue_waits.clear();
+    out.split_events.clear();
+    out.split_barriers.clear();
+    u32 join_pos = out.pass_order.size();
+    for (u32 pos = 0; pos < out.pass_order.size() && join_pos == out.pass_order.size(); pos++) {
+      for (const auto& usage : usages_of(out.pass_order[pos])) {
+        if (usage.resource == input.sink_resource) join_pos = pos;
+      }
+    }
+    last_use_.assign(input.resource_cnt, unused);
+    last_write_.assign(input.resource_cnt, unused);
+    u32 last_pos[max_queues];
+    std::ranges::fill(last_pos, unused);
+    // waited[a][b]: latest position on queue b that queue a already waited for
+    u32 waited[max_queues][max_queues];
+    for (auto& row : waited) std::ranges::fill(row, unused);
+    for (u32 pos = 0; pos < out.pass_order.size(); pos++) {
+      const u32 pass = out.pass_order[pos];
+      const u8 queue = pos < join_pos && !input.pass_queues.empty() ? input.pass_queues[pass] : 0;
+      assert(queue < max_queues);
+      u32 wait_for[max_queues];
+      std::ranges::fill(wait_for, unused);
+      auto wait = [&](u32 other_pos) {
+        const u8 other_queue = out.queues[other_pos];
+        if (other_queue == queue) return;
+        if (wait_for[other_queue] == unused || other_pos > wait_for[other_queue]) {
+          wait_for[other_queue] = other_pos;
+        }
+      };
+      if (pos == join_pos) {
+        for (u32 other_pos : last_pos) {
+          if (other_pos != unused) wait(other_pos);
+        }
+      }
+      for (const auto& usage : usages_of(pass)) {
+        if (last_use_[usage.resource] != unused) wait(last_use_[usage.resource]);
+      }
+      for (u32 other_queue = 0; other_queue < max_queues; other_queue++) {
+        const u32 wait_pos = wait_for[other_queue];
+        u32& already = waited[queue][other_queue];
+        if (wait_pos == unused || (already != unused && wait_pos <= already)) continue;
+        out.queue_waits.emplace_back(RGQueueWait{.pos = pos, .wait_pos = wait_pos});
+        already = wait_pos;
+      }
+      if (input.min_split_distance) {
+        const u32 first_event = out.split_events.size();
+        const u32 first_barrier = out.split_barriers.size();
+        for (const auto& usage : usages_of(pass)) {
+          const u32 src_pos = last_use_[usage.resource];
+          // anything in between would need its own barrier on the resource
+          if (src_pos == unused || src_pos != last_write_[usage.resource] ||
+              out.queues[src_pos] != queue || pos - src_pos < input.min_split_distance) {
+            continue;
+          }
+          const u32 physical_idx = out.physical_indices[usage.resource];
+          const auto pass_barriers = std::span(out.split_barriers).subspan(first_barrier);
+          if (std::ranges::find(pass_barriers, physical_idx, &RGSplitBarrier::physical_idx) !=
+              pass_barriers.end()) {
+            continue;
+          }
+          u32 event = first_event;
+          while (event < out.split_events.size() && out.split_events[event].src_pos != src_pos) {
+            event++;
+          }
+          if (event == out.split_events.size()) {
+            out.split_events.emplace_back(RGSplitEvent{.src_pos = src_pos, .dst_pos = pos});
+          }
+          out.split_barriers.emplace_back(
+              RGSplitBarrier{.physical_idx = physical_idx, .event = event});
+        }
+      }
+      for (const auto& usage : usages_of(pass)) {
+        last_use_[usage.resource] = pos;
+        if (usage.write) last_write_[usage.resource] = pos;
+      }
+      out.queues.emplace_back(queue);
+      last_pos[queue] = pos;
+    }
+    out.split_event_set_order.resize(out.split_events.size());
+    for (u32 i = 0; i < out.split_events.size(); i++) out.split_event_set_order[i] = i;
+    std::ranges::stable_sort(out.split_event_set_order, {}, [&out](u32 event) {
+      return out.split_events[event].src_pos;
+    });
+  }
+  return {};
+}
+
+}  // namespace gfx
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <expected>
+#include <span>
+#include <vector>
+
+#include "Common.hpp"
+#include "util/DynamicBitset.hpp"
+
+namespace gfx {
+
+using VoidResult = std::expected<void, const char*>;
+
+// The part of RenderGraph::bake that decides which passes run, in what order, and which
+// resources they use. Works on dense pass and resource indices and knows nothing about Vulkan,
+// so it can be run and measured without a device.
+
+struct RGPassUsage {
+  u32 resource;
+  bool read;
+  bool write;
+};
+
+struct RGCompileInput {
+  u32 resource_cnt;
+  // usages of pass i are usages[usage_starts[i], usage_starts[i + 1]), in declaration order
+  std::span<const u32> usage_starts;
+  std::span<const RGPassUsage> usages;
+  // the frame ends with the last pass that writes it, e.g. the backbuffer
+  u32 sink_resource;
+  // queue each pass asks for, 0 is the queue the frame ends on. Empty runs everything on 0.
+  std::span<const u8> pass_queues;
+  // barriers at least this many positions after the pass they wait for are split, 0 never splits
+  u32 min_split_distance;
+};
+
+// the pass at pos waits for the pass at wait_pos, on another queue, to finish. Positions are in
+// pass_order.
+struct RGQueueWait {
+  u32 pos;
+  u32 wait_pos;
+  friend bool operator==(const RGQueueWait&, const RGQueueWait&) = default;
+};
+
+// Split barriers wait for a write at src_pos from the pass at dst_pos, both on the same queue, with
+// no other use of the resource in between. An event is set after the writer, so the passes in
+// between can overlap it. One event per pair of positions, positions are in pass_order.
+struct RGSplitEvent {
+  u32 src_pos;
+  u32 dst_pos;
+  friend bool operator==(const RGSplitEvent&, const RGSplitEvent&) = default;
+};
+
+struct RGSplitBarrier {
+  u32 physical_idx;
+  // index in RGCompileResult::split_events
+  u32 event;
+  friend bool operator==(const RGSplitBarrier&, const RGSplitBarrier&) = default;
+};
+
+struct RGCompileResult {
+  static constexpr u32 unused = UINT32_MAX;
+  // passes the sink depends on, dependencies first
+  std::vector<u32> pass_order;
+  // per resource, in order of first use in pass_order, unused if no pass in it touches it
+  std::vector<u32> physical_indices;
+  u32 physical_cnt;
+  u32 sink_pass;
+  static constexpr u32 max_queues = 4;
+  // per position in pass_order
+  std::vector<u8> queues;
+  // sorted by pos, at most one per other queue and only where an earlier wait doesn't cover it
+  std::vector<RGQueueWait> queue_waits;
+  // sorted by dst_pos
+  std::vector<RGSplitEvent> split_events;
+  // split_events indices sorted by src_pos
+  std::vector<u32> split_event_set_order;
+  // sorted by the dst_pos of their event
+  std::vector<RGSplitBarrier> split_barriers;
+};
+
+// Keeps its scratch memory between compiles.
+class RenderGraphCompiler {
+ public:
+  // A pass depends on every other pass writing a resource it reads. Passes run in declaration
+  // order unless a dependency says otherwise. A pass waits for the last pass on another queue
+  // that used any of its resources. The first pass using the sink resource and everything after
+  // it run on queue 0, and it waits for all other queues, so the frame ends on one queue.
+  // Barriers far enough from the write they wait for are split, see RGSplitEvent.
+  VoidResult compile(const RGCompileInput& input, RGCompileResult& out);
+
+ private:
+  // resources' writer passes, CSR over resources
+  std::vector<u32> writer_starts_;
+  std::vector<u32> writers_;
+  std::vector<util::DynamicBitset> dependencies_;
+  util::DynamicBitset reached_;
+  std::vector<u32> stack_;
+  std::vector<u32> in_degrees_;
+  // passes that depend on each pass, CSR over passes
+  std::vector<std::pair<u32, u32>> edges_;
+  std::vector<u32> dependent_starts_;
+  std::vector<u32> dependents_;
+  std::vector<u32> ready_;
+  // position of each resource's last use and write while scheduling queues
+  std::vector<u32> last_use_;
+  std::vector<u32> last_write_;
+};
+
+}  // namespace gfx
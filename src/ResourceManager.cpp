@@ -9,8 +9,26 @@
 #include "ThreadPool.hpp"
 #include "VkRender2.hpp"
 #include "core/Logger.hpp"
+#include "core/Timer.hpp"
+#include "imgui.h"
 #include "util/MathUtil.hpp"
 
+ModelHandle ResourceManager::get_or_alloc_model(const std::filesystem::path& path,
+                                                bool& need_to_load) {
+  std::scoped_lock lock(model_name_mtx_);
+  auto it = model_name_to_handle_.find(path);
+  if (it != model_name_to_handle_.end()) {
+    need_to_load = false;
+    return it->second;
+  }
+  auto model_handle = loaded_model_pool_.alloc();
+  model_name_to_handle_.emplace(path, model_handle);  // <-- prevent duplicates early
+  auto* d = loaded_model_pool_.get(model_handle);
+  d->path = path;
+  need_to_load = true;
+  return model_handle;
+}
+
 InstanceHandle ResourceManager::load_model(const std::filesystem::path& path,
                                            const mat4& transform) {
   ZoneScoped;
@@ -20,31 +38,19 @@ InstanceHandle ResourceManager::load_model(const std::filesystem::path& path,
   }
 
   auto instance_handle = instance_pool_.alloc();
-  ModelHandle model_handle;
   bool need_to_load = false;
-
-  {
-    std::scoped_lock lock(model_name_mtx_);
-    auto it = model_name_to_handle_.find(path);
-    if (it != model_name_to_handle_.end()) {
-      model_handle = it->second;
-    } else {
-      model_handle = loaded_model_pool_.alloc();
-      model_name_to_handle_.emplace(path, model_handle);  // <-- prevent duplicates early
-      auto* d = loaded_model_pool_.get(model_handle);
-      d->path = path;
-      need_to_load = true;
-    }
-  }
+  ModelHandle model_handle = get_or_alloc_model(path, need_to_load);
 
   if (need_to_load) {
     threads::pool.submit_task([this, path, transform, instance_handle, model_handle]() {
-      if (!gfx::VkRender2::get().load_model2(path, *loaded_model_pool_.get(model_handle))) {
+      auto staged = std::make_unique<gfx::StagedModel>();
+      if (!gfx::VkRender2::get().stage_model(path, *staged)) {
         assert(0 && "todo handle error");
         return;
       }
 
       std::scoped_lock lock(instance_load_req_mtx_);
+      model_upload_requests_.emplace_back(model_handle, std::move(staged));
       instance_load_requests_.emplace_back(transform, instance_handle, model_handle);
     });
   } else {
@@ -54,6 +60,42 @@ InstanceHandle ResourceManager::load_model(const std::filesystem::path& path,
   return instance_handle;
 }
 
+std::vector<InstanceHandle> ResourceManager::load_models(const std::filesystem::path& path,
+                                                         std::span<const mat4> transforms) {
+  ZoneScoped;
+  if (!std::filesystem::exists(path)) {
+    LERROR("load_models: path doesn't exist: {}", path.string());
+    return {};
+  }
+
+  InstanceBatchLoadRequest req{.transforms = {transforms.begin(), transforms.end()}};
+  req.instance_handles.reserve(transforms.size());
+  for (size_t i = 0; i < transforms.size(); i++) {
+    req.instance_handles.emplace_back(instance_pool_.alloc());
+  }
+  auto result = req.instance_handles;
+  bool need_to_load = false;
+  req.model_handle = get_or_alloc_model(path, need_to_load);
+
+  if (need_to_load) {
+    threads::pool.submit_task([this, path, req = std::move(req)]() mutable {
+      auto staged = std::make_unique<gfx::StagedModel>();
+      if (!gfx::VkRender2::get().stage_model(path, *staged)) {
+        assert(0 && "todo handle error");
+        return;
+      }
+
+      std::scoped_lock lock(instance_load_req_mtx_);
+      model_upload_requests_.emplace_back(req.model_handle, std::move(staged));
+      instance_batch_load_requests_.emplace_back(std::move(req));
+    });
+  } else {
+    std::scoped_lock lock(instance_load_req_mtx_);
+    instance_batch_load_requests_.emplace_back(std::move(req));
+  }
+  return result;
+}
+
 namespace {
 ResourceManager* instance{};
 }
@@ -82,16 +124,17 @@ bool ResourceManager::add_instance(ModelHandle model_handle, InstanceHandle inst
     return false;
   }
   auto* model = loaded_model_pool_.get(model_handle);
-  if (!model || model->scene_graph_data.hierarchies.empty()) {
+  if (!model || model->scene_graph_data.node_count() == 0) {
     return false;
   }
+  // copies the transforms and dirty state, the immutable scene data is shared with the model
   instance->scene_graph_data = model->scene_graph_data;
 
   if (!util::math::is_identity(transform)) {
     // set initial transform
     instance->scene_graph_data.local_transforms[0] =
-        transform * instance->scene_graph_data.local_transforms[0];
-    gfx::decompose_matrix(instance->scene_graph_data.local_transforms[0],
+        Affine{transform} * instance->scene_graph_data.local_transforms[0];
+    gfx::decompose_matrix(instance->scene_graph_data.local_transforms[0].to_mat4(),
                           instance->scene_graph_data.node_transforms[0].translation,
                           instance->scene_graph_data.node_transforms[0].rotation,
                           instance->scene_graph_data.node_transforms[0].scale);
@@ -103,19 +146,140 @@ bool ResourceManager::add_instance(ModelHandle model_handle, InstanceHandle inst
   }
 
   // TODO: move to animation
-  instance->transform_accumulators.resize(instance->scene_graph_data.hierarchies.size());
+  instance->transform_accumulators.resize(instance->scene_graph_data.node_count());
   instance->model_handle = model_handle;
   return true;
 };
 
+bool ResourceManager::add_instances(ModelHandle model_handle,
+                                    std::span<const InstanceHandle> instance_handles,
+                                    std::span<const mat4> transforms) {
+  ZoneScoped;
+  assert(instance_handles.size() == transforms.size());
+  auto* model = loaded_model_pool_.get(model_handle);
+  if (!model || model->scene_graph_data.node_count() == 0) {
+    return false;
+  }
+  const auto& model_scene = model->scene_graph_data;
+  if (!model_scene.shared->skins.empty()) {
+    // skinned instances each need their own vertex output and bone matrices
+    for (size_t i = 0; i < instance_handles.size(); i++) {
+      add_instance(model_handle, instance_handles[i], transforms[i]);
+    }
+    return true;
+  }
+
+  std::vector<LoadedInstanceData*> instances;
+  std::vector<const gfx::Scene2*> scenes;
+  instances.reserve(instance_handles.size());
+  scenes.reserve(instance_handles.size());
+  for (size_t i = 0; i < instance_handles.size(); i++) {
+    auto* instance = instance_pool_.get(instance_handles[i]);
+    if (!instance) continue;
+    auto& scene = instance->scene_graph_data;
+    scene = model_scene;
+    if (!util::math::is_identity(transforms[i])) {
+      // same result as add_instance's mark_changed(scene, 0), but the model's global transforms
+      // are up to date so node 0's subtree is transformed directly instead of recalculated
+      gfx::transform_subtree(scene, 0, Affine{transforms[i]});
+    }
+    instances.emplace_back(instance);
+    scenes.emplace_back(&scene);
+  }
+
+  std::vector<gfx::StaticModelInstanceResourcesHandle> resource_handles(instances.size());
+  gfx::VkRender2::get().add_instances(model_handle, scenes, resource_handles);
+  for (size_t i = 0; i < instances.size(); i++) {
+    auto* instance = instances[i];
+    instance->instance_resources_handle = resource_handles[i];
+    if (!model->animations.empty()) {
+      instance->animation_id = AnimationManager::get().add_animation(*instance, *model);
+    }
+    instance->transform_accumulators.resize(model_scene.node_count());
+    instance->model_handle = model_handle;
+  }
+  return true;
+}
+
+void ResourceManager::on_imgui() {
+  size_t model_cnt{}, shared_bytes{};
+  for (auto& entry : loaded_model_pool_.get_entries()) {
+    const auto& shared = entry.object.scene_graph_data.shared;
+    if (!shared) continue;
+    model_cnt++;
+    shared_bytes += gfx::memory_usage(*shared);
+  }
+  size_t instance_cnt{}, instance_bytes{}, deep_copy_bytes{};
+  for (auto& entry : instance_pool_.get_entries()) {
+    const auto& scene = entry.object.scene_graph_data;
+    if (!entry.object.is_model_loaded() || !scene.shared) continue;
+    instance_cnt++;
+    const size_t bytes = gfx::memory_usage(scene);
+    instance_bytes += bytes;
+    // what the instance would cost if it owned a copy of the template
+    deep_copy_bytes += bytes + gfx::memory_usage(*scene.shared);
+  }
+  constexpr double kb = 1024.;
+  ImGui::Text("Models: %zu, shared scene data: %.1f KB", model_cnt, shared_bytes / kb);
+  ImGui::Text("Instances: %zu", instance_cnt);
+  if (instance_cnt) {
+    ImGui::Text("Scene data per instance: %.1f KB (%.1f KB if deep copied)",
+                instance_bytes / kb / instance_cnt, deep_copy_bytes / kb / instance_cnt);
+    ImGui::Text("Total: %.1f KB (%.1f KB if deep copied)", (instance_bytes + shared_bytes) / kb,
+                deep_copy_bytes / kb);
+  }
+}
+
 void ResourceManager::update() {
   ZoneScoped;
-  std::scoped_lock lock(instance_load_req_mtx_);
-  auto new_end = std::ranges::remove_if(instance_load_requests_, [this](InstanceLoadRequest& req) {
+  // taken out of the queues so loader threads aren't blocked while the instances are added
+  std::vector<ModelUploadRequest> uploads;
+  std::vector<InstanceLoadRequest> requests;
+  std::vector<InstanceBatchLoadRequest> batch_requests;
+  {
+    std::scoped_lock lock(instance_load_req_mtx_);
+    uploads.swap(model_upload_requests_);
+    requests.swap(instance_load_requests_);
+    batch_requests.swap(instance_batch_load_requests_);
+  }
+  // geometry slots are only allocated here on the main thread, before this frame's defrag, so
+  // the defrag planner never misses a slot or races a buffer being replaced
+  for (auto& upload : uploads) {
+    gfx::VkRender2::get().upload_model(*upload.staged,
+                                       *loaded_model_pool_.get(upload.model_handle));
+  }
+  if (requests.empty() && batch_requests.empty()) {
+    return;
+  }
+
+  Timer timer;
+  u64 added_cnt{};
+  // requests for models that are still loading stay queued
+  std::erase_if(requests, [this, &added_cnt](const InstanceLoadRequest& req) {
     ZoneScoped;
-    return add_instance(req.model_handle, req.instance_handle, req.transform);
+    if (!add_instance(req.model_handle, req.instance_handle, req.transform)) return false;
+    added_cnt++;
+    return true;
   });
-  instance_load_requests_.erase(new_end.begin(), new_end.end());
+  std::erase_if(batch_requests, [this, &added_cnt](const InstanceBatchLoadRequest& req) {
+    if (!add_instances(req.model_handle, req.instance_handles, req.transforms)) return false;
+    added_cnt += req.instance_handles.size();
+    return true;
+  });
+  if (added_cnt) {
+    spawn_stats_.instance_cnt += added_cnt;
+    spawn_stats_.micros += timer.elapsed_micro();
+  }
+
+  if (requests.size() || batch_requests.size()) {
+    std::scoped_lock lock(instance_load_req_mtx_);
+    instance_load_requests_.insert(instance_load_requests_.begin(),
+                                   std::make_move_iterator(requests.begin()),
+                                   std::make_move_iterator(requests.end()));
+    instance_batch_load_requests_.insert(instance_batch_load_requests_.begin(),
+                                         std::make_move_iterator(batch_requests.begin()),
+                                         std::make_move_iterator(batch_requests.end()));
+  }
 }
 
 void ResourceManager::remove_model(InstanceHandle handle) {
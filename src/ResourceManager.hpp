@@ -1,10 +1,18 @@
 #pragma once
 
+#include <memory>
+#include <shared_mutex>
+#include <span>
+
 #include "Animation.hpp"
 #include "SceneLoader.hpp"
 #include "SceneResources.hpp"
 #include "Types.hpp"
 
+namespace gfx {
+struct StagedModel;
+}
+
 struct LoadedModelData {
   gfx::Scene2 scene_graph_data;
   std::vector<gfx::Animation> animations;
@@ -31,6 +39,10 @@ class ResourceManager {
   void on_imgui();
   void update();
   InstanceHandle load_model(const std::filesystem::path& path, const mat4& transform = mat4{1});
+  // Spawns one instance of the model per transform. The instances are added in a single batch
+  // once the model is loaded, which is much cheaper per instance than calling load_model in a loop.
+  std::vector<InstanceHandle> load_models(const std::filesystem::path& path,
+                                          std::span<const mat4> transforms);
   void remove_model(InstanceHandle handle);
   LoadedModelData* get_model(ModelHandle handle) { return loaded_model_pool_.get(handle); }
   LoadedInstanceData* get_instance(InstanceHandle handle) {
@@ -38,10 +50,23 @@ class ResourceManager {
     return instance && instance->is_model_loaded() ? instance : nullptr;
   }
 
+  // cpu time spent adding instances in update(), for measuring spawn cost
+  struct SpawnStats {
+    u64 instance_cnt;
+    u64 micros;
+  };
+  [[nodiscard]] const SpawnStats& get_spawn_stats() const { return spawn_stats_; }
+  void reset_spawn_stats() { spawn_stats_ = {}; }
+
  private:
   // returns true if added, false if model not found, undefined otherwise
   bool add_instance(ModelHandle model_handle, InstanceHandle instance_handle,
                     const mat4& transform);
+  // same as add_instance for every handle/transform pair
+  bool add_instances(ModelHandle model_handle, std::span<const InstanceHandle> instance_handles,
+                     std::span<const mat4> transforms);
+  // returns the model for path, allocating it if it isn't loaded or loading yet
+  ModelHandle get_or_alloc_model(const std::filesystem::path& path, bool& need_to_load);
   ResourceManager() = default;
   struct LoadSceneResult {
     std::filesystem::path path;
@@ -59,6 +84,19 @@ class ResourceManager {
     InstanceHandle instance_handle;
     ModelHandle model_handle;
   };
+  struct InstanceBatchLoadRequest {
+    std::vector<mat4> transforms;
+    std::vector<InstanceHandle> instance_handles;
+    ModelHandle model_handle;
+  };
+  // staged on a loader thread, uploaded in update
+  struct ModelUploadRequest {
+    ModelHandle model_handle;
+    std::unique_ptr<gfx::StagedModel> staged;
+  };
   std::mutex instance_load_req_mtx_;
+  std::vector<ModelUploadRequest> model_upload_requests_;
   std::vector<InstanceLoadRequest> instance_load_requests_;
+  std::vector<InstanceBatchLoadRequest> instance_batch_load_requests_;
+  SpawnStats spawn_stats_{};
 };
@@ -1,13 +1,121 @@
 #include "Scene.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
+#include <algorithm>
 #include <glm/gtx/matrix_decompose.hpp>
+#include <memory>
 #include <tracy/Tracy.hpp>
 
+#include "ThreadPool.hpp"
 #include "shaders/common.h.glsl"
+#include "util/BitOps.hpp"
 
 namespace gfx {
 
+namespace {
+
+// mask of the bits of `word` that fall in [begin, end)
+u64 word_range_mask(u32 word, u32 begin, u32 end) {
+  const u32 word_begin = word * 64;
+  const u32 lo = std::max(begin, word_begin) - word_begin;
+  const u32 hi = std::min(end, word_begin + 64) - word_begin;
+  const u64 hi_mask = hi == 64 ? ~0ull : ((1ull << hi) - 1);
+  return hi_mask & (~0ull << lo);
+}
+
+void set_bits(std::vector<u64>& bits, u32 begin, u32 end) {
+  for (u32 w = begin / 64; w < (end + 63) / 64; w++) {
+    bits[w] |= word_range_mask(w, begin, end);
+  }
+}
+
+template <typename F>
+void for_each_set_bit(const std::vector<u64>& bits, u32 begin, u32 end, const F& func) {
+  for (u32 w = begin / 64; w < (end + 63) / 64; w++) {
+    util::for_each_bit(bits[w] & word_range_mask(w, begin, end),
+                       [&](u32 bit) { func((w * 64) + bit); });
+  }
+}
+
+// Recomputes the dirty nodes in [begin, end) and clears their bits. Ranges processed
+// concurrently must not share a bit word.
+void recalc_range(Scene2& scene, u32 begin, u32 end, std::vector<i32>* changed_nodes) {
+  // gathered a word at a time so the simd kernel is dispatched once per 64 nodes
+  u32 nodes[64];
+  i32 parents[64];
+  const auto& hierarchies = scene.shared->hierarchies;
+  for (u32 w = begin / 64; w < (end + 63) / 64; w++) {
+    const u64 mask = word_range_mask(w, begin, end);
+    const u64 bits = scene.dirty_node_bits[w] & mask;
+    if (!bits) continue;
+    scene.dirty_node_bits[w] &= ~mask;
+    u32 cnt = 0;
+    util::for_each_bit(bits, [&](u32 bit) {
+      const u32 changed_node = (w * 64) + bit;
+      nodes[cnt] = changed_node;
+      parents[cnt] = hierarchies[changed_node].parent;
+      cnt++;
+      if (changed_nodes) {
+        changed_nodes->emplace_back(changed_node);
+      }
+    });
+    affine::propagate(scene.global_transforms.data(), scene.local_transforms.data(),
+                      std::span{nodes, cnt}, std::span{parents, cnt});
+  }
+}
+
+// one slice of a single scene's dirty range for a level
+struct TransformChunk {
+  Scene2* scene;
+  u32 begin;
+  u32 end;
+};
+
+// multiple of 64 so chunk boundaries never split a dirty bit word
+constexpr u32 transform_chunk_size{1024};
+// levels with fewer dirty nodes than this across all scenes are done inline
+constexpr size_t min_parallel_level_size{transform_chunk_size * 4};
+
+// Calls f(level, begin, end) for the node's subtree one level at a time. In breadth first order the
+// descendants on each level are contiguous, so every level is a single range.
+template <typename F>
+void for_each_subtree_level(const SceneTemplate& scene, u32 node, F&& f) {
+  const auto& hierarchies = scene.hierarchies;
+  u32 begin = node;
+  u32 end = node + 1;
+  for (u32 level = hierarchies[node].level; begin < end; level++) {
+    assert(level < scene.level_count());
+    f(level, begin, end);
+    u32 next_begin{}, next_end{};
+    for (u32 n = begin; n < end; n++) {
+      if (hierarchies[n].first_child != -1) {
+        next_begin = hierarchies[n].first_child;
+        break;
+      }
+    }
+    for (u32 n = end; n > begin; n--) {
+      if (hierarchies[n - 1].first_child != -1) {
+        next_end = hierarchies[hierarchies[n - 1].first_child].last_sibling + 1;
+        break;
+      }
+    }
+    begin = next_begin;
+    end = next_end;
+  }
+}
+
+template <typename T>
+size_t vector_bytes(const std::vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+// 0 when the string fits in the small string buffer
+size_t string_heap_bytes(const std::string& s) {
+  return s.capacity() > std::string{}.capacity() ? s.capacity() + 1 : 0;
+}
+
+}  // namespace
+
 PassFlags Material::get_pass_flags() const {
   PassFlags flags{};
   if (ids2.w & MATERIAL_ALPHA_MODE_MASK_BIT) {
@@ -22,58 +130,155 @@ PassFlags Material::get_pass_flags() const {
 
 bool Material::is_double_sided() const { return (ids2.w & MATERIAL_DOUBLE_SIDED_BIT); }
 
+void build_level_ranges(SceneTemplate& scene) {
+  ZoneScoped;
+  auto& hierarchies = scene.hierarchies;
+  const auto node_cnt = static_cast<u32>(hierarchies.size());
+  scene.level_offsets.clear();
+  for (u32 node = 0; node < node_cnt; node++) {
+    const auto& hier = hierarchies[node];
+    assert(hier.parent < static_cast<i32>(node));
+    assert(node == 0 || hier.level >= hierarchies[node - 1].level);
+    while (scene.level_offsets.size() <= static_cast<size_t>(hier.level)) {
+      scene.level_offsets.emplace_back(node);
+    }
+    // every child stores the parent's last child, mark_changed uses it to find the next level's
+    // range of descendants
+    if (hier.first_child != -1) {
+      i32 last = hier.first_child;
+      while (hierarchies[last].next_sibling != -1) {
+        last = hierarchies[last].next_sibling;
+      }
+      for (i32 c = hier.first_child; c != -1; c = hierarchies[c].next_sibling) {
+        hierarchies[c].last_sibling = last;
+      }
+    }
+  }
+  scene.level_offsets.emplace_back(node_cnt);
+}
+
+void reset_dirty_state(Scene2& scene) {
+  scene.dirty_node_bits.assign((scene.node_count() + 63) / 64, 0);
+  scene.dirty_level_ranges.assign(scene.level_count(), uvec2{});
+}
+
 void mark_changed(Scene2& scene, int node) {
-  const int level = scene.hierarchies[node].level;
-  assert(level >= 0 && level < Scene2::max_node_depth);
-  assert(node >= 0 && (size_t)node < scene.hierarchies.size());
-  scene.changed_this_frame[level].push_back(node);
-  for (int s = scene.hierarchies[node].first_child; s != -1;
-       s = scene.hierarchies[s].next_sibling) {
-    mark_changed(scene, s);
+  assert(node >= 0 && (u32)node < scene.node_count());
+  assert(scene.dirty_node_bits.size() * 64 >= scene.node_count());
+  // a mark always covers the whole subtree, so descendants of a dirty node are already dirty
+  if (scene.dirty_node_bits[node / 64] & (1ull << (node % 64))) {
+    return;
   }
+  for_each_subtree_level(*scene.shared, node, [&](u32 level, u32 begin, u32 end) {
+    set_bits(scene.dirty_node_bits, begin, end);
+    auto& range = scene.dirty_level_ranges[level];
+    if (range.x >= range.y) {
+      range = {begin, end};
+    } else {
+      range = {std::min(range.x, begin), std::max(range.y, end)};
+    }
+  });
 }
 
-void validate_hierarchy(Scene2& scene) {
+void transform_subtree(Scene2& scene, int node, const Affine& transform) {
+  assert(node >= 0 && (u32)node < scene.node_count());
+  scene.local_transforms[node] = transform * scene.local_transforms[node];
+  auto& node_transform = scene.node_transforms[node];
+  decompose_matrix(scene.local_transforms[node].to_mat4(), node_transform.translation,
+                   node_transform.rotation, node_transform.scale);
+  for_each_subtree_level(*scene.shared, node, [&](u32, u32 begin, u32 end) {
+    for (u32 n = begin; n < end; n++) {
+      scene.global_transforms[n] = transform * scene.global_transforms[n];
+    }
+  });
+}
+
+void validate_hierarchy(const SceneTemplate& scene) {
+  assert(scene.level_offsets.empty() || scene.level_offsets.back() == scene.hierarchies.size());
   for (size_t i = 0; i < scene.hierarchies.size(); i++) {
     const auto& hier = scene.hierarchies[i];
     if (hier.parent != -1) {
       // Check that parent's level is one less than child's level
       assert(scene.hierarchies[hier.parent].level == hier.level - 1);
+      // breadth first: parents come first
+      assert(hier.parent < (int)i);
     }
-    // Check children point back to correct parent
+    // Check children point back to correct parent and are contiguous
     for (int child = hier.first_child; child != -1; child = scene.hierarchies[child].next_sibling) {
       assert(scene.hierarchies[child].parent == (int)i);
+      assert(scene.hierarchies[child].next_sibling == -1 ||
+             scene.hierarchies[child].next_sibling == child + 1);
     }
   }
 }
 
 bool recalc_global_transforms(Scene2& scene, std::vector<i32>* changed_nodes) {
   ZoneScoped;
-  // root node
   bool dirty = false;
-  if (scene.changed_this_frame[0].size() > 0) {
-    const int changed_node = scene.changed_this_frame[0][0];
-    scene.global_transforms[changed_node] = scene.local_transforms[changed_node];
-    scene.changed_this_frame[0].clear();
-    if (changed_nodes) {
-      changed_nodes->emplace_back(changed_node);
-    }
+  for (auto& range : scene.dirty_level_ranges) {
+    if (range.x >= range.y) continue;
+    recalc_range(scene, range.x, range.y, changed_nodes);
+    range = {};
     dirty = true;
   }
+  return dirty;
+}
 
-  for (int level = 1; level < Scene2::max_node_depth; level++) {
-    for (auto changed_node : scene.changed_this_frame[level]) {
-      if (changed_nodes) {
-        changed_nodes->emplace_back(changed_node);
+void recalc_global_transforms_parallel(std::span<Scene2* const> scenes,
+                                       std::span<std::vector<i32>* const> changed_nodes,
+                                       std::span<u8> dirty) {
+  ZoneScoped;
+  assert(changed_nodes.empty() || changed_nodes.size() == scenes.size());
+  assert(dirty.empty() || dirty.size() == scenes.size());
+  std::ranges::fill(dirty, 0);
+
+  u32 max_level_count{};
+  for (const Scene2* scene : scenes) {
+    max_level_count = std::max(max_level_count, scene->level_count());
+  }
+
+  std::vector<TransformChunk> chunks;
+  for (u32 level = 0; level < max_level_count; level++) {
+    // each level only reads globals from the level above, which is complete at this point, so
+    // chunks within a level are independent. the same product is computed per node as in the
+    // serial path, so results are bit-identical regardless of chunking.
+    chunks.clear();
+    size_t level_node_cnt{};
+    for (size_t i = 0; i < scenes.size(); i++) {
+      Scene2& scene = *scenes[i];
+      if (level >= scene.level_count()) continue;
+      auto& range = scene.dirty_level_ranges[level];
+      if (range.x >= range.y) continue;
+      level_node_cnt += range.y - range.x;
+      for (u32 begin = range.x; begin < range.y;) {
+        const u32 end =
+            std::min(((begin / transform_chunk_size) + 1) * transform_chunk_size, range.y);
+        chunks.push_back({&scene, begin, end});
+        begin = end;
+      }
+      // collected up front so the output order matches the serial path
+      if (!changed_nodes.empty() && changed_nodes[i]) {
+        for_each_set_bit(scene.dirty_node_bits, range.x, range.y,
+                         [out = changed_nodes[i]](u32 node) { out->emplace_back(node); });
+      }
+      if (!dirty.empty()) dirty[i] = 1;
+      range = {};
+    }
+    if (chunks.empty()) continue;
+
+    if (level_node_cnt < min_parallel_level_size) {
+      for (const auto& chunk : chunks) {
+        recalc_range(*chunk.scene, chunk.begin, chunk.end, nullptr);
       }
-      int parent = scene.hierarchies[changed_node].parent;
-      scene.global_transforms[changed_node] =
-          scene.global_transforms[parent] * scene.local_transforms[changed_node];
-      dirty = true;
+    } else {
+      ZoneScopedN("parallel level");
+      threads::parallel_for(static_cast<u32>(chunks.size()), UINT32_MAX,
+                            [&chunks](u32, u32 i) {
+                              const auto& chunk = chunks[i];
+                              recalc_range(*chunk.scene, chunk.begin, chunk.end, nullptr);
+                            });
     }
-    scene.changed_this_frame[level].clear();
   }
-  return dirty;
 }
 
 bool decompose_matrix(const glm::mat4& m, glm::vec3& pos, glm::quat& rot, glm::vec3& scale) {
@@ -85,4 +290,37 @@ void NodeTransform::to_mat4(mat4& out) const {
   out = glm::translate(glm::mat4{1}, translation) * glm::mat4_cast(glm::normalize(rotation)) *
         glm::scale(glm::mat4{1}, scale);
 }
+
+void NodeTransform::to_affine(Affine& out) const {
+  mat4 m;
+  to_mat4(m);
+  out = Affine{m};
+}
+
+size_t memory_usage(const SceneTemplate& scene) {
+  size_t bytes = sizeof(SceneTemplate);
+  bytes += vector_bytes(scene.hierarchies) + vector_bytes(scene.node_names) +
+           vector_bytes(scene.node_mesh_indices) + vector_bytes(scene.node_flags) +
+           vector_bytes(scene.mesh_datas) + vector_bytes(scene.skins) +
+           vector_bytes(scene.level_offsets);
+  for (const auto& name : scene.node_names) {
+    bytes += string_heap_bytes(name);
+  }
+  // one heap node (pair, next pointer, cached hash) per element plus the bucket array
+  const auto& name_map = scene.node_to_node_name_idx;
+  bytes += (name_map.size() * (sizeof(std::pair<const i32, i32>) + (2 * sizeof(void*)))) +
+           (name_map.bucket_count() * sizeof(void*));
+  for (const auto& skin : scene.skins) {
+    bytes += string_heap_bytes(skin.name) + vector_bytes(skin.joint_node_indices) +
+             vector_bytes(skin.inverse_bind_matrices);
+  }
+  return bytes;
+}
+
+size_t memory_usage(const Scene2& scene) {
+  return sizeof(Scene2) + vector_bytes(scene.local_transforms) +
+         vector_bytes(scene.node_transforms) + vector_bytes(scene.global_transforms) +
+         vector_bytes(scene.dirty_node_bits) + vector_bytes(scene.dirty_level_ranges);
+}
+
 }  // namespace gfx
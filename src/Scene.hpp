@@ -1,7 +1,11 @@
 #pragma once
+#include <memory>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "Affine.hpp"
 #include "Common.hpp"
 
 namespace gfx {
@@ -39,6 +43,7 @@ struct NodeTransform {
   quat rotation{glm::identity<glm::quat>()};
   vec3 scale{1.f};
   void to_mat4(mat4& out) const;
+  void to_affine(Affine& out) const;
 };
 
 struct Material {
@@ -54,7 +59,7 @@ struct Material {
 struct SkinData {
   std::string name;
   std::vector<u32> joint_node_indices;
-  std::vector<mat4> inverse_bind_matrices;
+  std::vector<Affine> inverse_bind_matrices;
   u32 model_bone_mat_start_i{};
 };
 
@@ -65,10 +70,9 @@ struct NodeTransformAccumulator {
   vec3 weights{};
 };
 
-struct Scene2 {
-  std::vector<mat4> local_transforms;
-  std::vector<NodeTransform> node_transforms;
-  std::vector<mat4> global_transforms;
+// Immutable per-model scene data. Built once by the loader and shared by every instance of the
+// model through Scene2::shared.
+struct SceneTemplate {
   std::vector<Hierarchy> hierarchies;
   std::vector<std::string> node_names;
   // TODO: vector here
@@ -81,14 +85,54 @@ struct Scene2 {
 
   std::vector<u32> node_flags;
   std::vector<MeshData> mesh_datas;
-  static constexpr int max_node_depth{25};
-  std::vector<u32> changed_this_frame[max_node_depth];
   std::vector<SkinData> skins;
+
+  // Nodes are stored breadth first: level l is [level_offsets[l], level_offsets[l + 1]), parents
+  // precede their children and a node's children are contiguous. Built by build_level_ranges.
+  std::vector<u32> level_offsets;
+  [[nodiscard]] u32 level_count() const {
+    return level_offsets.empty() ? 0 : static_cast<u32>(level_offsets.size() - 1);
+  }
+  [[nodiscard]] u32 node_count() const { return static_cast<u32>(hierarchies.size()); }
+};
+
+// Per-instance scene state. Copying a Scene2 copies the transforms and dirty state and shares the
+// template.
+struct Scene2 {
+  std::shared_ptr<const SceneTemplate> shared;
+  std::vector<Affine> local_transforms;
+  std::vector<NodeTransform> node_transforms;
+  std::vector<Affine> global_transforms;
+  // one bit per node, set by mark_changed and cleared by recalc_global_transforms
+  std::vector<u64> dirty_node_bits;
+  // per level [x, y) bounds of the dirty bits, empty when x >= y
+  std::vector<uvec2> dirty_level_ranges;
+  [[nodiscard]] u32 level_count() const { return shared ? shared->level_count() : 0; }
+  [[nodiscard]] u32 node_count() const { return shared ? shared->node_count() : 0; }
 };
 
-void validate_hierarchy(Scene2& scene);
+// Computes level_offsets. Nodes must already be in breadth first order.
+void build_level_ranges(SceneTemplate& scene);
+// Sizes the dirty tracking state to match scene.shared and clears it.
+void reset_dirty_state(Scene2& scene);
+void validate_hierarchy(const SceneTemplate& scene);
 bool decompose_matrix(const glm::mat4& m, glm::vec3& pos, glm::quat& rot, glm::vec3& scale);
+// marks the node and its subtree dirty
 void mark_changed(Scene2& scene, int node);
+// Premultiplies the node's local transform and the global transforms of its subtree. Only valid
+// when the subtree's global transforms are up to date, it avoids marking and recalculating it.
+void transform_subtree(Scene2& scene, int node, const Affine& transform);
 bool recalc_global_transforms(Scene2& scene, std::vector<i32>* changed_nodes = nullptr);
+// Updates every scene at once. Each level's dirty range (across all scenes) is split into chunks
+// and run on threads::pool, with a barrier between levels. Results are identical to calling
+// recalc_global_transforms on each scene. changed_nodes/dirty are indexed like scenes, or empty.
+void recalc_global_transforms_parallel(std::span<Scene2* const> scenes,
+                                       std::span<std::vector<i32>* const> changed_nodes = {},
+                                       std::span<u8> dirty = {});
+
+// Approximate heap footprint, used for the instance memory stats.
+[[nodiscard]] size_t memory_usage(const SceneTemplate& scene);
+// Per-instance bytes only, the shared template is not counted.
+[[nodiscard]] size_t memory_usage(const Scene2& scene);
 
 }  // namespace gfx
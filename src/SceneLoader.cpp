@@ -7,9 +7,12 @@
 #include <vulkan/vulkan_core.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <deque>
 
 #include "Types.hpp"
 
@@ -25,12 +28,17 @@
 #include <optional>
 
 #include "BS_thread_pool.hpp"
+#include "ModelCache.hpp"
 #include "Scene.hpp"
 #include "StateTracker.hpp"
+#include "TextureCache.hpp"
 #include "ThreadPool.hpp"
 #include "core/Timer.hpp"
 #include "shaders/common.h.glsl"
+#include "util/CVar.hpp"
+#include "util/StagingRing.hpp"
 #include "vk2/Device.hpp"
+#include "vk2/Initializers.hpp"
 
 // #include "ThreadPool.hpp"
 
@@ -64,6 +72,18 @@ namespace gfx {
 
 namespace {
 
+AutoCVarInt model_cache_enabled{"loader.model_cache", "Model Cache", 1, CVarFlags::EditCheckbox};
+AutoCVarInt texture_cache_enabled{"loader.texture_cache", "Texture Cache", 1,
+                                  CVarFlags::EditCheckbox};
+// Fast transcoding is for iteration, it's noticeably worse quality. Cached per setting.
+AutoCVarInt ktx_high_quality_transcode{"loader.ktx_high_quality_transcode",
+                                       "High Quality KTX2 Transcode", 1, CVarFlags::EditCheckbox};
+AutoCVarInt texture_staging_mb{"loader.texture_staging_mb", "Texture Staging Ring MB", 128};
+// 0 keeps animation keys as authored
+AutoCVarInt anim_resample_hz{"loader.anim_resample_hz", "Animation Resample Hz", 0};
+
+}  // namespace
+
 void calc_aabb(AABB& aabb, const void* vertices, size_t len, size_t stride, size_t offset) {
   aabb.min = vec3{std::numeric_limits<float>::max()};
   aabb.max = vec3{std::numeric_limits<float>::lowest()};
@@ -75,6 +95,8 @@ void calc_aabb(AABB& aabb, const void* vertices, size_t len, size_t stride, size
   }
 }
 
+namespace {
+
 void load_tangents(const std::string& path, std::vector<Vertex>& vertices) {
   ZoneScoped;
   std::ifstream file(path, std::ios::binary);
@@ -108,18 +130,7 @@ void save_tangents(const std::string& path, const std::vector<Vertex>& vertices)
   file.write(reinterpret_cast<const char*>(tangents.data()), sizeof(glm::vec3) * tangents.size());
 }
 
-struct CalcTangentsVertexInfo {
-  struct BaseOffset {
-    void* base;
-    u32 offset;
-    u32 stride;
-  };
-  BaseOffset pos;
-  BaseOffset normal;
-  BaseOffset uv_x;
-  BaseOffset uv_y;
-  BaseOffset tangent;
-};
+}  // namespace
 
 template <typename IndexT>
 void calc_tangents(const CalcTangentsVertexInfo& info, std::span<IndexT> indices) {
@@ -204,6 +215,10 @@ void calc_tangents(const CalcTangentsVertexInfo& info, std::span<IndexT> indices
   genTangSpaceDefault(&ctx);
 }
 
+template void calc_tangents<u32>(const CalcTangentsVertexInfo& info, std::span<u32> indices);
+
+namespace {
+
 std::vector<uint8_t> read_file(const std::string& full_path) {
   std::ifstream file(full_path, std::ios::binary | std::ios::ate);
   if (!file) {
@@ -221,29 +236,37 @@ std::vector<uint8_t> read_file(const std::string& full_path) {
   return buffer;
 }
 
-void set_node_transform_from_gltf_node(mat4& local_transform, NodeTransform& transform_data,
+void set_node_transform_from_gltf_node(Affine& local_transform, NodeTransform& transform_data,
                                        const fastgltf::Node& gltf_node) {
   if (std::holds_alternative<fastgltf::math::fmat4x4>(gltf_node.transform)) {
     const auto& mat_data = std::get<fastgltf::math::fmat4x4>(gltf_node.transform);
-    local_transform = glm::make_mat4(mat_data.data());
-    decompose_matrix(local_transform, transform_data.translation, transform_data.rotation,
-                     transform_data.scale);
+    const mat4 m = glm::make_mat4(mat_data.data());
+    local_transform = Affine{m};
+    decompose_matrix(m, transform_data.translation, transform_data.rotation, transform_data.scale);
   } else {
     const auto& trs = std::get<fastgltf::TRS>(gltf_node.transform);
     transform_data.translation = glm::make_vec3(trs.translation.data());
     transform_data.rotation =
         glm::quat(trs.rotation[3], trs.rotation[0], trs.rotation[1], trs.rotation[2]);
     transform_data.scale = glm::make_vec3(trs.scale.data());
-    transform_data.to_mat4(local_transform);
+    transform_data.to_affine(local_transform);
   }
 }
 
 struct CpuImageData {
-  enum class Type : u8 { None, KTX2, JPEG, PNG, DDS };
+  using Type = ImageEncoding;
   u32 w, h, d, components;
   Format format{};
   Type type{};
   void* data{};  // points to type specific data (stb image, ktx_tex ptr, etc)
+  // KTX2 mip chain, in data's ktx texture or the texture cache file held by level_storage
+  std::vector<std::span<const std::byte>> levels;
+  std::shared_ptr<const void> level_storage;
+};
+
+struct TextureLoadSettings {
+  const TextureCache* cache{};
+  u32 transcode_flags{};
 };
 
 CpuImageData::Type convert_cpu_img_type(fastgltf::MimeType type) {
@@ -262,46 +285,84 @@ CpuImageData::Type convert_cpu_img_type(fastgltf::MimeType type) {
 }
 
 void load_image(CpuImageData& result, CpuImageData::Type type, const void* data, u64 size,
-                bool srgb) {
+                bool srgb, const TextureLoadSettings& settings) {
   result.type = type;
   switch (type) {
     case CpuImageData::Type::KTX2: {
+      // only the header, the image data is loaded on a cache miss
       ktxTexture2* ktx_tex{};
       if (auto result =
               ktxTexture2_CreateFromMemory(reinterpret_cast<const ktx_uint8_t*>(data), size,
-                                           KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx_tex);
+                                           KTX_TEXTURE_CREATE_NO_FLAGS, &ktx_tex);
           result != KTX_SUCCESS) {
         assert(0);
       }
-      assert(ktx_tex->pData && ktx_tex->dataSize);
 
       u32 components = ktxTexture2_GetNumComponents(ktx_tex);
       result.components = components;
       result.w = ktx_tex->baseWidth;
       result.h = ktx_tex->baseHeight;
       result.d = ktx_tex->baseDepth;
-      result.data = ktx_tex;
-      if (ktxTexture2_NeedsTranscoding(ktx_tex)) {
-        ktx_transcode_fmt_e ktx_transcode_format{};
-        if (components == 4 || components == 3) {
-          ktx_transcode_format = KTX_TTF_BC7_RGBA;
-          result.format = srgb ? Format::Bc7SrgbBlock : Format::Bc7UnormBlock;
-        } else if (components == 2) {
-          ktx_transcode_format = KTX_TTF_BC5_RG;
-          result.format = Format::Bc5UnormBlock;
-        } else if (components == 1) {
-          ktx_transcode_format = KTX_TTF_BC4_R;
-          result.format = Format::Bc4UnormBlock;
-        }
-        // determine target format
-        if (auto result =
-                ktxTexture2_TranscodeBasis(ktx_tex, ktx_transcode_format, KTX_TF_HIGH_QUALITY);
-            result != KTX_SUCCESS) {
-          assert(false);
+      if (!ktxTexture2_NeedsTranscoding(ktx_tex)) {
+        assert(0);
+        ktxTexture_Destroy(ktxTexture(ktx_tex));
+        break;
+      }
+      ktx_transcode_fmt_e ktx_transcode_format{};
+      if (components == 4 || components == 3) {
+        ktx_transcode_format = KTX_TTF_BC7_RGBA;
+        result.format = srgb ? Format::Bc7SrgbBlock : Format::Bc7UnormBlock;
+      } else if (components == 2) {
+        ktx_transcode_format = KTX_TTF_BC5_RG;
+        result.format = Format::Bc5UnormBlock;
+      } else if (components == 1) {
+        ktx_transcode_format = KTX_TTF_BC4_R;
+        result.format = Format::Bc4UnormBlock;
+      }
+
+      u64 cache_key{};
+      if (settings.cache) {
+        cache_key = get_texture_cache_key({static_cast<const std::byte*>(data), size},
+                                          result.format, settings.transcode_flags);
+        if (auto cached = settings.cache->load(cache_key);
+            cached && cached->format == result.format &&
+            cached->extent == uvec2{result.w, result.h}) {
+          ktxTexture_Destroy(ktxTexture(ktx_tex));
+          result.levels = std::move(cached->levels);
+          result.level_storage = std::move(cached->storage);
+          break;
         }
-      } else {
+      }
+
+      if (auto result = ktxTexture_LoadImageData(ktxTexture(ktx_tex), nullptr, 0);
+          result != KTX_SUCCESS) {
         assert(0);
       }
+      assert(ktx_tex->pData && ktx_tex->dataSize);
+      result.data = ktx_tex;
+      if (auto result = ktxTexture2_TranscodeBasis(ktx_tex, ktx_transcode_format,
+                                                   settings.transcode_flags);
+          result != KTX_SUCCESS) {
+        assert(false);
+      }
+      assert(ktx_tex->numLevels > 0);
+      u64 tot = 0;
+      for (u32 level = 0; level < ktx_tex->numLevels; level++) {
+        size_t level_offset;
+        ktxTexture_GetImageOffset(ktxTexture(ktx_tex), level, 0, 0, &level_offset);
+        u32 w = std::max(result.w >> level, 1u);
+        u32 h = std::max(result.h >> level, 1u);
+        size_t level_size = img_to_buffer_size(result.format, {w, h, 1});
+        result.levels.emplace_back(
+            reinterpret_cast<const std::byte*>(ktx_tex->pData + level_offset), level_size);
+        tot += level_size;
+      }
+      assert(tot == ktx_tex->dataSize);
+      (void)tot;
+      if (settings.cache &&
+          !settings.cache->store(cache_key, result.format, {result.w, result.h}, result.levels)) {
+        LWARN("failed to write texture cache {}", settings.cache->get_path(cache_key).string());
+      }
       break;
     }
     case CpuImageData::Type::JPEG:
@@ -327,52 +388,57 @@ void load_image(CpuImageData& result, CpuImageData::Type type, const void* data,
   }
 }
 
-void load_cpu_img_data(const fastgltf::Asset& asset, const fastgltf::Image& image,
-                       const std::filesystem::path& directory, CpuImageData& result,
-                       PBRImageUsage usage) {
-  ZoneScoped;
-  bool is_srgb_usage = usage == PBRImageUsage::BaseColor || usage == PBRImageUsage::Emissive;
+ImageEncoding encoding_from_extension(const std::filesystem::path& path) {
+  const auto& ext = path.extension().string();
+  return ext == ".ktx2"   ? ImageEncoding::KTX2
+         : ext == ".png"  ? ImageEncoding::PNG
+         : ext == ".jpeg" ? ImageEncoding::JPEG
+         : ext == ".jpg"  ? ImageEncoding::JPEG
+         : ext == ".dds"  ? ImageEncoding::DDS
+                          : ImageEncoding::None;
+}
+
+std::vector<std::byte> copy_bytes(const void* data, size_t size) {
+  const auto* bytes = static_cast<const std::byte*>(data);
+  return {bytes, bytes + size};
+}
+
+// embedded images are copied out of the asset so the sources outlive it
+ModelImageSource get_image_source(const fastgltf::Asset& asset, const fastgltf::Image& image,
+                                  PBRImageUsage usage) {
+  ModelImageSource result{.srgb = usage == PBRImageUsage::BaseColor ||
+                                  usage == PBRImageUsage::Emissive};
   std::visit(fastgltf::visitor{
                  [&](const fastgltf::sources::Array& arr) {
-                   load_image(result, convert_cpu_img_type(arr.mimeType), arr.bytes.data(),
-                              arr.bytes.size_bytes(), is_srgb_usage);
+                   result.encoding = convert_cpu_img_type(arr.mimeType);
+                   result.bytes = copy_bytes(arr.bytes.data(), arr.bytes.size_bytes());
                  },
                  [&](const fastgltf::sources::Vector& vector) {
-                   load_image(result, convert_cpu_img_type(vector.mimeType), vector.bytes.data(),
-                              vector.bytes.size() * sizeof(std::byte), is_srgb_usage);
+                   result.encoding = convert_cpu_img_type(vector.mimeType);
+                   result.bytes =
+                       copy_bytes(vector.bytes.data(), vector.bytes.size() * sizeof(std::byte));
                  },
                  [&](const fastgltf::sources::URI& file_path) {
                    assert(file_path.fileByteOffset == 0);
-                   const std::string path(file_path.uri.path().begin(), file_path.uri.path().end());
-                   auto full_path = directory / path;
-                   if (!std::filesystem::exists(full_path)) {
-                     LERROR("glTF Image load fail: path does not exist {}", full_path.string());
-                   }
-                   auto bytes = read_file(full_path);
-                   const auto& ext = full_path.extension().string();
-                   CpuImageData::Type type = ext == ".ktx2"   ? CpuImageData::Type::KTX2
-                                             : ext == ".png"  ? CpuImageData::Type::PNG
-                                             : ext == ".jpeg" ? CpuImageData::Type::JPEG
-                                             : ext == ".jpg"  ? CpuImageData::Type::JPEG
-                                             : ext == ".png"  ? CpuImageData::Type::PNG
-                                             : ext == ".dds"  ? CpuImageData::Type::DDS
-                                                              : CpuImageData::Type::None;
-                   load_image(result, type, bytes.data(), bytes.size(), is_srgb_usage);
+                   result.uri =
+                       std::string(file_path.uri.path().begin(), file_path.uri.path().end());
+                   result.encoding = encoding_from_extension(result.uri);
                  },
                  [&](const fastgltf::sources::BufferView& view) {
                    const auto& buffer_view = asset.bufferViews[view.bufferViewIndex];
                    const auto& buffer = asset.buffers[buffer_view.bufferIndex];
+                   result.encoding = convert_cpu_img_type(view.mimeType);
                    std::visit(fastgltf::visitor{
                                   [](auto&) {},
                                   [&](const fastgltf::sources::Array& arr) {
-                                    load_image(result, convert_cpu_img_type(view.mimeType),
-                                               arr.bytes.data() + buffer_view.byteOffset,
-                                               buffer_view.byteLength, is_srgb_usage);
+                                    result.bytes =
+                                        copy_bytes(arr.bytes.data() + buffer_view.byteOffset,
+                                                   buffer_view.byteLength);
                                   },
                                   [&](const fastgltf::sources::Vector& vector) {
-                                    load_image(result, convert_cpu_img_type(view.mimeType),
-                                               vector.bytes.data() + buffer_view.byteOffset,
-                                               buffer_view.byteLength, is_srgb_usage);
+                                    result.bytes =
+                                        copy_bytes(vector.bytes.data() + buffer_view.byteOffset,
+                                                   buffer_view.byteLength);
                                   },
                               },
                               buffer.data);
@@ -382,44 +448,61 @@ void load_cpu_img_data(const fastgltf::Asset& asset, const fastgltf::Image& imag
                    assert(0);
                  }},
              image.data);
+  return result;
+}
+
+void load_cpu_img_data(const ModelImageSource& source, const std::filesystem::path& directory,
+                       const TextureLoadSettings& settings, CpuImageData& result) {
+  ZoneScoped;
+  if (source.uri.empty()) {
+    load_image(result, source.encoding, source.bytes.data(), source.bytes.size(), source.srgb,
+               settings);
+    return;
+  }
+  auto full_path = directory / source.uri;
+  if (!std::filesystem::exists(full_path)) {
+    LERROR("glTF Image load fail: path does not exist {}", full_path.string());
+  }
+  auto bytes = read_file(full_path);
+  load_image(result, source.encoding, bytes.data(), bytes.size(), source.srgb, settings);
 }
 
-i32 add_node(Scene2& scene, i32 parent, i32 level) {
-  size_t node_i = scene.hierarchies.size();
-  scene.local_transforms.emplace_back(1);
-  scene.global_transforms.emplace_back(1);
-  scene.node_mesh_indices.emplace_back(-1);
+i32 add_node(Scene2& scene, SceneTemplate& shared, i32 parent, i32 level) {
+  size_t node_i = shared.hierarchies.size();
+  scene.local_transforms.emplace_back();
+  scene.global_transforms.emplace_back();
+  shared.node_mesh_indices.emplace_back(-1);
   scene.node_transforms.emplace_back();
-  scene.node_flags.emplace_back(0);
-  scene.hierarchies.push_back(Hierarchy{.parent = parent});
+  shared.node_flags.emplace_back(0);
+  shared.hierarchies.push_back(Hierarchy{.parent = parent});
   // if parent exists, update it
   if (parent > -1) {
-    i32 first_child = scene.hierarchies[parent].first_child;
+    i32 first_child = shared.hierarchies[parent].first_child;
     if (first_child == -1) {
       // no sibling, node is first child of parent and own last sibling
-      scene.hierarchies[parent].first_child = node_i;
-      scene.hierarchies[node_i].last_sibling = node_i;
+      shared.hierarchies[parent].first_child = node_i;
+      shared.hierarchies[node_i].last_sibling = node_i;
     } else {
       // sibling exists, traverse to find last sibling
-      i32 last = scene.hierarchies[first_child].last_sibling;
+      i32 last = shared.hierarchies[first_child].last_sibling;
       if (last <= -1) {
-        for (last = first_child; scene.hierarchies[last].next_sibling != -1;
-             last = scene.hierarchies[last].next_sibling);
+        for (last = first_child; shared.hierarchies[last].next_sibling != -1;
+             last = shared.hierarchies[last].next_sibling);
       }
-      scene.hierarchies[last].next_sibling = node_i;
-      scene.hierarchies[first_child].last_sibling = node_i;
+      shared.hierarchies[last].next_sibling = node_i;
+      shared.hierarchies[first_child].last_sibling = node_i;
     }
   }
-  scene.hierarchies[node_i].level = level;
-  scene.hierarchies[node_i].next_sibling = -1;
-  scene.hierarchies[node_i].first_child = -1;
-  scene.hierarchies[node_i].last_sibling = -1;
+  shared.hierarchies[node_i].level = level;
+  shared.hierarchies[node_i].next_sibling = -1;
+  shared.hierarchies[node_i].first_child = -1;
+  shared.hierarchies[node_i].last_sibling = -1;
   return node_i;
 }
 
-void traverse(Scene2& scene, fastgltf::Asset& gltf, const Material& default_material,
-              const std::vector<Material>& materials, LoadedSceneBaseData& result,
-              std::vector<int>& gltf_node_i_to_node_i,
+void traverse(Scene2& scene, SceneTemplate& shared, fastgltf::Asset& gltf,
+              const Material& default_material, const std::vector<Material>& materials,
+              ModelCpuData& result, std::vector<int>& gltf_node_i_to_node_i,
               const std::vector<u32>& prim_offsets_of_meshes) {
   struct NodeStackEntry {
     int gltf_node_i;
@@ -427,9 +510,9 @@ void traverse(Scene2& scene, fastgltf::Asset& gltf, const Material& default_mate
     int level;
   };
   std::vector<NodeStackEntry> to_add_node_stack;
-  int root_node = add_node(scene, -1, 0);
-  scene.node_to_node_name_idx.emplace(root_node, scene.node_names.size());
-  scene.node_names.emplace_back("Root node");
+  int root_node = add_node(scene, shared, -1, 0);
+  shared.node_to_node_name_idx.emplace(root_node, shared.node_names.size());
+  shared.node_names.emplace_back("Root node");
 
   auto& scene_node_indices = gltf.scenes[gltf.defaultScene.value_or(0)].nodeIndices;
   to_add_node_stack.reserve(scene_node_indices.size());
@@ -451,14 +534,14 @@ void traverse(Scene2& scene, fastgltf::Asset& gltf, const Material& default_mate
 
     assert((size_t)gltf_node_i < gltf_node_i_to_node_i.size());
     const auto& gltf_node = gltf.nodes[gltf_node_i];
-    i32 new_node = add_node(scene, parent_i, level);
+    i32 new_node = add_node(scene, shared, parent_i, level);
     assert(gltf_node_i_to_node_i[gltf_node_i] == -1);
     gltf_node_i_to_node_i[gltf_node_i] = new_node;
     set_node_transform_from_gltf_node(scene.local_transforms[new_node],
                                       scene.node_transforms[new_node], gltf.nodes[gltf_node_i]);
     if (gltf_node.name.size() > 0) {
-      scene.node_to_node_name_idx.emplace(new_node, scene.node_names.size());
-      scene.node_names.emplace_back(gltf_node.name);
+      shared.node_to_node_name_idx.emplace(new_node, shared.node_names.size());
+      shared.node_names.emplace_back(gltf_node.name);
     }
 
     if (gltf_node.meshIndex.has_value()) {
@@ -466,13 +549,13 @@ void traverse(Scene2& scene, fastgltf::Asset& gltf, const Material& default_mate
       const auto& mesh = gltf.meshes[gltf_mesh_i];
       u32 primitive_i = 0;
       for (const auto& primitive : mesh.primitives) {
-        i32 submesh_node = add_node(scene, new_node, level + 1);
+        i32 submesh_node = add_node(scene, shared, new_node, level + 1);
         // TODO: name only during editing/string allocation?
-        scene.node_to_node_name_idx[submesh_node] = scene.node_names.size();
-        scene.node_names.emplace_back(std::string(gltf_node.name) + "_mesh_" +
+        shared.node_to_node_name_idx[submesh_node] = shared.node_names.size();
+        shared.node_names.emplace_back(std::string(gltf_node.name) + "_mesh_" +
                                       std::to_string(primitive_i));
-        scene.node_mesh_indices[submesh_node] = scene.mesh_datas.size();
-        auto& mesh_data = scene.mesh_datas.emplace_back(MeshData{});
+        shared.node_mesh_indices[submesh_node] = shared.mesh_datas.size();
+        auto& mesh_data = shared.mesh_datas.emplace_back(MeshData{});
         mesh_data.mesh_idx = prim_offsets_of_meshes[gltf_mesh_i] + primitive_i;
         mesh_data.material_id = static_cast<u32>(primitive.materialIndex.value_or(UINT32_MAX));
         mesh_data.pass_flags = mesh_data.material_id != UINT32_MAX
@@ -576,7 +659,7 @@ void traverse(Scene2& scene, fastgltf::Asset& gltf, const Material& default_mate
     }
     result.animations.emplace_back(std::move(anim));
   }
-  auto& out_skins = result.scene_graph_data.skins;
+  auto& out_skins = shared.skins;
   u32 tot_matrices = 0;
   for (auto& gltf_skin : gltf.skins) {
     auto& new_skin = out_skins.emplace_back(SkinData{
@@ -601,17 +684,117 @@ void traverse(Scene2& scene, fastgltf::Asset& gltf, const Material& default_mate
     for (const auto& joint_node_index : gltf_skin.joints) {
       int node_i = gltf_node_i_to_node_i[joint_node_index];
       out_skins.back().joint_node_indices.emplace_back(node_i);
-      scene.node_flags[node_i] |= Scene2::NodeFlag_IsJointBit;
+      shared.node_flags[node_i] |= SceneTemplate::NodeFlag_IsJointBit;
     }
   }
 }
 
+// Reorders nodes breadth first so each level is a contiguous index range (see
+// SceneTemplate::level_offsets) and remaps everything that refers to nodes by index.
+void reorder_nodes_breadth_first(Scene2& scene, SceneTemplate& shared,
+                                 std::vector<Animation>& animations,
+                                 std::vector<int>& gltf_node_i_to_node_i) {
+  ZoneScoped;
+  auto& hierarchies = shared.hierarchies;
+  const auto node_cnt = hierarchies.size();
+  std::vector<i32> new_to_old;
+  new_to_old.reserve(node_cnt);
+  for (size_t node = 0; node < node_cnt; node++) {
+    if (hierarchies[node].parent == -1) {
+      new_to_old.emplace_back(node);
+    }
+  }
+  for (size_t head = 0; head < new_to_old.size(); head++) {
+    for (i32 c = hierarchies[new_to_old[head]].first_child; c != -1;
+         c = hierarchies[c].next_sibling) {
+      new_to_old.emplace_back(c);
+    }
+  }
+  assert(new_to_old.size() == node_cnt);
+
+  std::vector<i32> old_to_new(node_cnt);
+  for (size_t i = 0; i < node_cnt; i++) {
+    old_to_new[new_to_old[i]] = static_cast<i32>(i);
+  }
+  auto remap = [&old_to_new](i32 node) { return node < 0 ? node : old_to_new[node]; };
+  auto permute = [&new_to_old]<typename T>(std::vector<T>& v) {
+    assert(v.size() == new_to_old.size());
+    std::vector<T> result;
+    result.reserve(v.size());
+    for (i32 old_node : new_to_old) {
+      result.emplace_back(std::move(v[old_node]));
+    }
+    v = std::move(result);
+  };
+  permute(scene.local_transforms);
+  permute(scene.global_transforms);
+  permute(scene.node_transforms);
+  permute(shared.node_mesh_indices);
+  permute(shared.node_flags);
+  permute(hierarchies);
+  for (auto& hier : hierarchies) {
+    hier.parent = remap(hier.parent);
+    hier.first_child = remap(hier.first_child);
+    hier.next_sibling = remap(hier.next_sibling);
+    hier.last_sibling = remap(hier.last_sibling);
+  }
+
+  std::unordered_map<i32, i32> node_to_node_name_idx;
+  node_to_node_name_idx.reserve(shared.node_to_node_name_idx.size());
+  for (auto [node, name_idx] : shared.node_to_node_name_idx) {
+    node_to_node_name_idx.emplace(old_to_new[node], name_idx);
+  }
+  shared.node_to_node_name_idx = std::move(node_to_node_name_idx);
+
+  for (auto& skin : shared.skins) {
+    for (auto& joint_node : skin.joint_node_indices) {
+      joint_node = old_to_new[joint_node];
+    }
+  }
+  for (auto& animation : animations) {
+    for (auto& node : animation.channels.nodes) {
+      node = remap(node);
+    }
+  }
+  for (auto& node : gltf_node_i_to_node_i) {
+    node = remap(node);
+  }
+
+  build_level_ranges(shared);
+}
+
+struct ParsedGeometry {
+  std::vector<Vertex> vertices;
+  std::vector<AnimatedVertex> animated_vertices;
+  std::vector<u32> indices;
+};
+
+// LoadExternalBuffers replaces buffer uris with the loaded bytes, so the uris come from a second
+// parse that loads nothing. Only the json is parsed again.
+std::vector<std::string> get_buffer_uris(fastgltf::Parser& parser,
+                                         const std::filesystem::path& path) {
+  ZoneScoped;
+  std::vector<std::string> result;
+  auto gltf_file = fastgltf::GltfDataBuffer::FromPath(path);
+  auto load_ret = parser.loadGltf(
+      gltf_file.get(), path.parent_path(),
+      fastgltf::Options::DontRequireValidAssetMember | fastgltf::Options::AllowDouble);
+  if (!load_ret) {
+    return result;
+  }
+  for (const auto& buffer : load_ret.get().buffers) {
+    if (const auto* uri = std::get_if<fastgltf::sources::URI>(&buffer.data)) {
+      result.emplace_back(uri->uri.path().begin(), uri->uri.path().end());
+    }
+  }
+  return result;
+}
+
 }  // namespace
 
-std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& path,
-                                                  const DefaultMaterialData& default_mat) {
+std::optional<ModelCpuData> parse_gltf(const std::filesystem::path& path) {
   ZoneScoped;
-  std::optional<LoadedSceneBaseData> result = std::nullopt;
+  std::optional<ModelCpuData> result = std::nullopt;
   if (!std::filesystem::exists(path)) {
     LERROR("Failed to load glTF: directory {} does not exist", path.string());
     return result;
@@ -638,7 +821,11 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
   }
 
   fastgltf::Asset gltf = std::move(load_ret.get());
-  result = LoadedSceneBaseData{};
+  result = ModelCpuData{};
+  result->buffer_uris = get_buffer_uris(parser, path);
+  // the vertex and index vectors end up behind result's geometry views
+  auto geometry = std::make_shared<ParsedGeometry>();
+  auto& geo = *geometry;
 
   std::vector<PBRImageUsage> img_usages(gltf.images.size(), PBRImageUsage::BaseColor);
   {
@@ -681,231 +868,26 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
       }
     }
   }
-  std::vector<CpuImageData> images(gltf.images.size());
-  std::vector<std::future<void>> futures(images.size());
-  {
-    ZoneScopedN("load images");
-    for (u64 i = 0; i < images.size(); i++) {
-      futures[i] = threads::pool.submit_task([i, &gltf, &parent_path, &images, &img_usages]() {
-        load_cpu_img_data(gltf, gltf.images[i], parent_path, images[i], img_usages[i]);
-        // upload to gpu
-      });
-    }
-    for (auto& f : futures) {
-      f.get();
-    }
-    futures.clear();
-  }
-
-  struct ImgUploadInfo {
-    uvec3 extent{};
-    size_t size;
-    void* data;
-    size_t staging_offset;
-    u32 level;
-    u32 img_idx;
-  };
-  std::vector<ImgUploadInfo> img_upload_infos;
-  img_upload_infos.reserve(images.size());
-  result->textures.reserve(images.size());
-  size_t staging_offset{};
-  for (auto& img : images) {
-    // TODO: diff types, dds
-    if (img.type == CpuImageData::Type::KTX2) {
-      auto* ktx = (ktxTexture2*)img.data;
-      assert(ktx->numLevels > 0);
-      u64 tot = 0;
-      for (u32 level = 0; level < ktx->numLevels; level++) {
-        size_t level_offset;
-        ktxTexture_GetImageOffset(ktxTexture(ktx), level, 0, 0, &level_offset);
-        u32 w = std::max(img.w >> level, 1u);
-        u32 h = std::max(img.h >> level, 1u);
-        size_t size = img_to_buffer_size(img.format, {w, h, 1});
-        tot += size;
-        img_upload_infos.emplace_back(
-            ImgUploadInfo{.extent = {w, h, 1},
-                          .size = size,
-                          .data = ktx->pData + level_offset,
-                          .staging_offset = staging_offset,
-                          .level = level,
-                          .img_idx = static_cast<u32>(result->textures.size())});
-        staging_offset += size;
-      }
-      result->textures.emplace_back(
-          get_device().create_image(ImageDesc{.type = ImageDesc::Type::TwoD,
-                                              .format = img.format,
-                                              .dims = {img.w, img.h, 1},
-                                              .mip_levels = ktx->numLevels,
-                                              .bind_flags = BindFlag::ShaderResource}));
-      assert(tot == ktx->dataSize);
-      (void)tot;
-
-    } else {
-      // TODO: mip gen?
-      size_t size = img_to_buffer_size(img.format, {img.w, img.h, 1});
-      img_upload_infos.emplace_back(
-          ImgUploadInfo{.extent = {img.w, img.h, 1},
-                        .size = size,
-                        .data = img.data,
-                        .staging_offset = staging_offset,
-                        .level = 0,
-                        .img_idx = static_cast<u32>(result->textures.size())});
-      result->textures.emplace_back(
-          get_device().create_image(ImageDesc{.type = ImageDesc::Type::TwoD,
-                                              .format = img.format,
-                                              .dims = {img.w, img.h, 1},
-                                              .mip_levels = 1,
-                                              .bind_flags = BindFlag::ShaderResource}));
-      staging_offset += size;
-    }
-  }
 
-  assert(result->textures.size() == images.size());
-  if (staging_offset > 0) {
-    ZoneScopedN("upload images");
-    constexpr i32 max_batch_upload_size = 1024ull * 1024 * 1024;  // 1 GB
-    i32 batch_upload_size = std::min<i32>(max_batch_upload_size, staging_offset);
-    assert(batch_upload_size < max_batch_upload_size);
-    i32 bytes_remaining = staging_offset;
-    u64 img_i{};
-    u64 curr_staging_offset = 0;
-    u64 start_copy_idx{};
-    auto copy_cmd = get_device().transfer_copy_allocator_.allocate(batch_upload_size);
-    StateTracker state;
-    auto flush_uploads = [&]() {
-      for (u64 i = 0; i < img_i; i++) {
-        if (futures[i].valid()) {
-          futures[i].get();
-        } else {
-          break;
-        }
-      }
-      futures.clear();
-      auto end_copy_idx = img_i - 1;
-      {
-        state.reset(copy_cmd.transfer_cmd_buf);
-        for (u64 i = start_copy_idx; i <= end_copy_idx; i++) {
-          const auto& img_upload = img_upload_infos[i];
-          state.transition(get_device().get_image(result->textures[img_upload.img_idx])->image(),
-                           VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        }
-        state.flush_barriers();
-        for (u64 i = start_copy_idx; i <= end_copy_idx; i++) {
-          const auto& img_upload = img_upload_infos[i];
-          const auto& texture = *get_device().get_image(result->textures[img_upload.img_idx]);
-          VkBufferImageCopy2 img_copy{
-              .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
-              .bufferOffset = img_upload.staging_offset - curr_staging_offset,
-              // .bufferRowLength = (img_upload.extent.x + 3) & ~3,  // Align to BC7
-              // 4x4 blocks .bufferImageHeight = (img_upload.extent.y + 3) & ~3,
-              .bufferRowLength = 0,
-              .bufferImageHeight = 0,
-              .imageSubresource =
-                  {
-                      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                      .mipLevel = img_upload.level,
-                      .layerCount = 1,
-                  },
-              .imageExtent = VkExtent3D{img_upload.extent.x, img_upload.extent.y, 1}};
-          VkCopyBufferToImageInfo2 img_copy_info{
-              .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2_KHR,
-              .srcBuffer = get_device().get_buffer(copy_cmd.staging_buffer)->buffer(),
-              .dstImage = texture.image(),
-              .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-              .regionCount = 1,
-              .pRegions = &img_copy,
-          };
-          vkCmdCopyBufferToImage2KHR(copy_cmd.transfer_cmd_buf, &img_copy_info);
-        }
-        for (u64 i = start_copy_idx; i <= end_copy_idx; i++) {
-          state.transition(
-              get_device().get_image(result->textures[img_upload_infos[i].img_idx])->image(),
-              VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
-              VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-              VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
-        }
-        state.flush_barriers();
-        // TODO: thread safe
-        get_device().transfer_copy_allocator_.submit(copy_cmd);
-      }
-
-      curr_staging_offset += max_batch_upload_size;
-      start_copy_idx = img_i;
-    };
-    while (bytes_remaining > 0) {
-      // if (bytes_remaining - img_upload_infos[img_i].size < 0) {
-      //   LINFO("flush uploads");
-      //   flush_uploads();
-      // }
-
-      futures.emplace_back(
-          threads::pool.submit_task([img_i, &img_upload_infos, curr_staging_offset, &copy_cmd]() {
-            const auto& img_upload = img_upload_infos[img_i];
-            if (get_device().get_buffer(copy_cmd.staging_buffer)->size() <
-                img_upload.staging_offset + img_upload.size) {
-              assert(0);
-            } else {
-              memcpy((char*)get_device().get_buffer(copy_cmd.staging_buffer)->mapped_data() +
-                         img_upload.staging_offset - curr_staging_offset,
-                     img_upload.data, img_upload.size);
-            }
-          }));
-      bytes_remaining -= img_upload_infos[img_i].size;
-      img_i++;
-    }
-
-    flush_uploads();
-    // TODO: remove?
-    for (auto& f : futures) {
-      if (f.valid()) f.get();
-    }
-    futures.clear();
+  result->images.reserve(gltf.images.size());
+  for (size_t i = 0; i < gltf.images.size(); i++) {
+    result->images.emplace_back(get_image_source(gltf, gltf.images[i], img_usages[i]));
   }
 
-  {
-    ZoneScopedN("free imgs");
-    for (auto& image : images) {
-      futures.push_back(threads::pool.submit_task([&image]() {
-        switch (image.type) {
-          case CpuImageData::Type::KTX2:
-            ktxTexture_Destroy(ktxTexture(image.data));
-            break;
-          case CpuImageData::Type::JPEG:
-          case CpuImageData::Type::PNG:
-            stbi_image_free(image.data);
-            break;
-          default:
-            assert(0);
-        }
-      }));
-    }
-    for (u64 i = 0; i < images.size(); i++) {
-      futures[i].get();
-    }
-    futures.clear();
-  }
-  for (auto& f : futures) {
-    if (f.valid()) {
-      f.get();
-    }
-  }
-  futures.clear();
-
   {
     ZoneScopedN("load gltf materials");
     result->materials.reserve(gltf.materials.size());
     for (size_t i = 0; i < gltf.materials.size(); i++) {
       const auto& gltf_mat = gltf.materials[i];
-      auto get_idx = [&gltf, &default_mat, &result](const fastgltf::TextureInfo& info) -> u32 {
+      // image index + 1, resolved to a bindless index once the textures exist
+      auto get_idx = [&gltf](const fastgltf::TextureInfo& info) -> u32 {
         const auto& tex = gltf.textures[info.textureIndex];
         auto gltf_idx = tex.basisuImageIndex.value_or(tex.imageIndex.value_or(UINT32_MAX));
         if (gltf_idx != UINT32_MAX) {
-          return get_device().get_bindless_idx(result->textures[gltf_idx].handle,
-                                               SubresourceType::Shader);
+          return static_cast<u32>(gltf_idx) + 1;
         }
         LERROR("uh oh, no texture for gltf material");
-        return default_mat.white_img_handle;
+        return missing_texture_id;
       };
       Material mat{.ids1 = uvec4{0}, .ids2 = uvec4(0)};
       auto base_col = gltf_mat.pbrData.baseColorFactor;
@@ -952,6 +934,7 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
     }
   }
 
+  std::vector<std::future<void>> futures;
   std::vector<int> gltf_node_i_to_node_i(gltf.nodes.size(), -1);
   std::vector<u32> prim_offsets_of_meshes(gltf.meshes.size());
   {
@@ -961,8 +944,16 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
       offset += gltf.meshes[mesh_idx].primitives.size();
     }
   }
-  traverse(result->scene_graph_data, gltf, Material{}, result->materials, *result,
-           gltf_node_i_to_node_i, prim_offsets_of_meshes);
+  {
+    // built here, then shared read-only by every instance of the model
+    auto shared = std::make_shared<SceneTemplate>();
+    traverse(result->scene_graph_data, *shared, gltf, Material{}, result->materials, *result,
+             gltf_node_i_to_node_i, prim_offsets_of_meshes);
+    reorder_nodes_breadth_first(result->scene_graph_data, *shared, result->animations,
+                                gltf_node_i_to_node_i);
+    result->scene_graph_data.shared = std::move(shared);
+  }
+  reset_dirty_state(result->scene_graph_data);
   mark_changed(result->scene_graph_data, 0);
   recalc_global_transforms(result->scene_graph_data);
 
@@ -1011,9 +1002,9 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
         }
       };
     }
-    result->indices.resize(num_indices);
-    result->vertices.resize(num_vertices);
-    result->animated_vertices.resize(num_animated_vertices);
+    geo.indices.resize(num_indices);
+    geo.vertices.resize(num_vertices);
+    geo.animated_vertices.resize(num_animated_vertices);
 
     bool has_tangents = gltf.meshes[0].primitives[0].findAttribute("TANGENT") !=
                         gltf.meshes[0].primitives[0].attributes.end();
@@ -1023,7 +1014,7 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
     if (!has_tangents) {
       // load from disk
       if (std::filesystem::exists(tangents_path)) {
-        load_tangents(tangents_path, result->vertices);
+        load_tangents(tangents_path, geo.vertices);
         loaded_tangents_from_disk = true;
       }
     }
@@ -1046,15 +1037,15 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
            primitive_idx++) {
         auto mesh_draw_idx = prim_offsets_of_meshes[mesh_idx] + primitive_idx;
         futures.emplace_back(threads::pool.submit_task([&gltf, mesh_idx, primitive_idx, &result,
-                                                        mesh_draw_idx, loaded_tangents_from_disk,
-                                                        gltf_node_i]() {
+                                                        &geo, mesh_draw_idx,
+                                                        loaded_tangents_from_disk, gltf_node_i]() {
           ZoneScopedN("gltf process primitives");
           const auto& primitive = gltf.meshes[mesh_idx].primitives[primitive_idx];
           const auto& index_accessor = gltf.accessors[primitive.indicesAccessor.value()];
           auto& mesh_draw_info = result->mesh_draw_infos[mesh_draw_idx];
           u32 start_idx = mesh_draw_info.first_index;
           fastgltf::iterateAccessorWithIndex<u32>(gltf, index_accessor, [&](uint32_t index, u32 i) {
-            result->indices[start_idx + i] = index;
+            geo.indices[start_idx + i] = index;
           });
           const auto* pos_attrib = primitive.findAttribute("POSITION");
           if (pos_attrib == primitive.attributes.end()) {
@@ -1068,38 +1059,38 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
           u64 start_i_animated = mesh_draw_info.first_animated_vertex;
           u32 o = 0;
           if (gltf.nodes[gltf_node_i].skinIndex.has_value()) {
-            o = result->scene_graph_data.skins[gltf.nodes[gltf_node_i].skinIndex.value()]
-                    .model_bone_mat_start_i;
+            const auto& skins = result->scene_graph_data.shared->skins;
+            o = skins[gltf.nodes[gltf_node_i].skinIndex.value()].model_bone_mat_start_i;
           }
 
           if (animated) {
             fastgltf::iterateAccessorWithIndex<vec3>(
-                gltf, pos_accessor, [&result, start_i_animated](const vec3& pos, u32 i) {
-                  result->animated_vertices[start_i_animated + i].pos = pos;
+                gltf, pos_accessor, [&geo, start_i_animated](const vec3& pos, u32 i) {
+                  geo.animated_vertices[start_i_animated + i].pos = pos;
                 });
 
             assert(weights_attrib != primitive.attributes.end());
 
             fastgltf::iterateAccessorWithIndex<uvec4>(
                 gltf, gltf.accessors[joints_attrib->accessorIndex],
-                [&result, &start_i_animated, &o](const uvec4& joints, size_t i) {
+                [&geo, &start_i_animated, &o](const uvec4& joints, size_t i) {
                   for (u32 j = 0; j < 4; j++) {
-                    result->animated_vertices[start_i_animated + i].bone_id[j] = joints[j] + o;
+                    geo.animated_vertices[start_i_animated + i].bone_id[j] = joints[j] + o;
                   }
                 });
 
             fastgltf::iterateAccessorWithIndex<vec4>(
                 gltf, gltf.accessors[weights_attrib->accessorIndex],
-                [&result, start_i_animated](const vec4& weights, size_t i) {
+                [&geo, start_i_animated](const vec4& weights, size_t i) {
                   for (u32 j = 0; j < 4; j++) {
-                    result->animated_vertices[start_i_animated + i].weights[j] = weights[j];
+                    geo.animated_vertices[start_i_animated + i].weights[j] = weights[j];
                   }
                 });
 
           } else {
             fastgltf::iterateAccessorWithIndex<vec3>(
-                gltf, pos_accessor, [&result, start_i_static](const vec3& pos, u32 i) {
-                  result->vertices[start_i_static + i].pos = pos;
+                gltf, pos_accessor, [&geo, start_i_static](const vec3& pos, u32 i) {
+                  geo.vertices[start_i_static + i].pos = pos;
                 });
           }
 
@@ -1124,7 +1115,7 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
           } else {
             assert(0 && "why does this gltf not have bounds lmao noob");
             // calculate bounds from vertices if accessor min/max not set
-            calc_aabb(mesh_draw_info.aabb, &result->vertices[mesh_draw_info.first_vertex],
+            calc_aabb(mesh_draw_info.aabb, &geo.vertices[mesh_draw_info.first_vertex],
                       pos_accessor.count, sizeof(gfx::Vertex), offsetof(gfx::Vertex, pos));
           }
 
@@ -1136,12 +1127,12 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
             if (animated) {
               u64 i = start_i_animated;
               for (const glm::vec3& normal : range) {
-                result->animated_vertices[i++].normal = vec4{normal, 0.};
+                geo.animated_vertices[i++].normal = vec4{normal, 0.};
               }
             } else {
               u64 i = start_i_static;
               for (const glm::vec3& normal : range) {
-                result->vertices[i++].normal = normal;
+                geo.vertices[i++].normal = normal;
               }
             }
           }
@@ -1154,14 +1145,14 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
             if (animated) {
               u64 i = start_i_animated;
               for (const glm::vec2& uv : range) {
-                result->animated_vertices[i].uv_x = uv.x;
-                result->animated_vertices[i++].uv_y = uv.y;
+                geo.animated_vertices[i].uv_x = uv.x;
+                geo.animated_vertices[i++].uv_y = uv.y;
               }
             } else {
               u64 i = start_i_static;
               for (const glm::vec2& uv : range) {
-                result->vertices[i].uv_x = uv.x;
-                result->vertices[i++].uv_y = uv.y;
+                geo.vertices[i].uv_x = uv.x;
+                geo.vertices[i++].uv_y = uv.y;
               }
             }
           }
@@ -1174,12 +1165,12 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
               if (accessor.type == fastgltf::AccessorType::Vec3) {
                 auto range = fastgltf::iterateAccessor<glm::vec3>(gltf, accessor);
                 for (const glm::vec3& tangent : range) {
-                  result->animated_vertices[i++].tangent = vec4(tangent, 0.);
+                  geo.animated_vertices[i++].tangent = vec4(tangent, 0.);
                 }
               } else if (accessor.type == fastgltf::AccessorType::Vec4) {
                 auto range = fastgltf::iterateAccessor<glm::vec4>(gltf, accessor);
                 for (const glm::vec4& tangent : range) {
-                  result->animated_vertices[i++].tangent = tangent;
+                  geo.animated_vertices[i++].tangent = tangent;
                 }
               }
             } else {
@@ -1188,18 +1179,18 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
               if (accessor.type == fastgltf::AccessorType::Vec3) {
                 auto range = fastgltf::iterateAccessor<glm::vec3>(gltf, accessor);
                 for (const glm::vec3& tangent : range) {
-                  result->vertices[i++].tangent = vec4(tangent, 0.);
+                  geo.vertices[i++].tangent = vec4(tangent, 0.);
                 }
               } else if (accessor.type == fastgltf::AccessorType::Vec4) {
                 auto range = fastgltf::iterateAccessor<glm::vec4>(gltf, accessor);
                 for (const glm::vec4& tangent : range) {
-                  result->vertices[i++].tangent = tangent;
+                  geo.vertices[i++].tangent = tangent;
                 }
               }
             }
           } else if (!loaded_tangents_from_disk) {
             if (animated) {
-              auto& verts = result->animated_vertices;
+              auto& verts = geo.animated_vertices;
               CalcTangentsVertexInfo info{
                   .pos = {.base = verts.data() + (start_i_animated),
                           .offset = offsetof(AnimatedVertex, pos),
@@ -1218,27 +1209,27 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
                               .stride = sizeof(AnimatedVertex)},
               };
 
-              calc_tangents<u32>(info, std::span(result->indices.data() + (start_idx),
+              calc_tangents<u32>(info, std::span(geo.indices.data() + (start_idx),
                                                  mesh_draw_info.index_count));
             } else {
               CalcTangentsVertexInfo info{
-                  .pos = {.base = result->vertices.data() + (start_i_static),
+                  .pos = {.base = geo.vertices.data() + (start_i_static),
                           .offset = offsetof(Vertex, pos),
                           .stride = sizeof(Vertex)},
-                  .normal = {.base = result->vertices.data() + (start_i_static),
+                  .normal = {.base = geo.vertices.data() + (start_i_static),
                              .offset = offsetof(Vertex, normal),
                              .stride = sizeof(Vertex)},
-                  .uv_x = {.base = result->vertices.data() + (start_i_static),
+                  .uv_x = {.base = geo.vertices.data() + (start_i_static),
                            .offset = offsetof(Vertex, uv_x),
                            .stride = sizeof(Vertex)},
-                  .uv_y = {.base = result->vertices.data() + (start_i_static),
+                  .uv_y = {.base = geo.vertices.data() + (start_i_static),
                            .offset = offsetof(Vertex, uv_y),
                            .stride = sizeof(Vertex)},
-                  .tangent = {.base = result->vertices.data() + (start_i_static),
+                  .tangent = {.base = geo.vertices.data() + (start_i_static),
                               .offset = offsetof(Vertex, tangent),
                               .stride = sizeof(Vertex)},
               };
-              calc_tangents<u32>(info, std::span(result->indices.data() + (start_idx),
+              calc_tangents<u32>(info, std::span(geo.indices.data() + (start_idx),
                                                  mesh_draw_info.index_count));
             }
           }
@@ -1253,32 +1244,369 @@ std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& p
         }
       }
       if (!has_tangents && !loaded_tangents_from_disk) {
-        save_tangents(tangents_path, result->vertices);
+        save_tangents(tangents_path, geo.vertices);
       }
     }
   }
 
+  result->vertices = geo.vertices;
+  result->animated_vertices = geo.animated_vertices;
+  result->indices = geo.indices;
+  result->geometry_storage = std::move(geometry);
   return result;
 }
 
+namespace {
+
+void free_cpu_img_data(CpuImageData& image) {
+  switch (image.type) {
+    case CpuImageData::Type::KTX2:
+      // cache hits have no ktx texture, their mapping is released with level_storage
+      if (image.data) {
+        ktxTexture_Destroy(ktxTexture(image.data));
+      }
+      break;
+    case CpuImageData::Type::JPEG:
+    case CpuImageData::Type::PNG:
+      stbi_image_free(image.data);
+      break;
+    default:
+      assert(0);
+  }
+  image.data = nullptr;
+  image.levels.clear();
+  image.level_storage.reset();
+}
+
+// KTX2 images carry their mip chain, decoded images are a single level
+std::vector<std::span<const std::byte>> get_image_levels(const CpuImageData& image) {
+  if (image.type == CpuImageData::Type::KTX2) {
+    return image.levels;
+  }
+  // TODO: mip gen?
+  return {{static_cast<const std::byte*>(image.data),
+           img_to_buffer_size(image.format, {image.w, image.h, 1})}};
+}
+
+// Rows [y, y + extent.y) of one mip level in a staging slice. Carries the image description so
+// the submitting thread can create the image the first time it sees it.
+struct TextureUploadRegion {
+  u32 img_idx;
+  u32 level;
+  u32 y;
+  uvec2 extent;
+  u64 staging_offset;
+  u64 size;
+  Format format;
+  uvec2 img_extent;
+  u32 mip_levels;
+  u64 img_size;
+};
+
+using TextureStagingRing = util::StagingRing<TextureUploadRegion>;
+
+// Levels that don't fit in the open slice are split at multiples of this many texel rows, which
+// covers the transfer queue's image transfer granularity.
+constexpr u32 upload_split_rows = 64;
+
+void stream_image_levels(const CpuImageData& img, u32 img_idx, TextureStagingRing& ring,
+                         std::span<std::byte* const> slice_data) {
+  ZoneScoped;
+  const auto levels = get_image_levels(img);
+  u64 img_size{};
+  for (const auto& level : levels) {
+    img_size += level.size();
+  }
+  const u32 block_h = format_is_block_compreesed(img.format) ? 4 : 1;
+  for (u32 level = 0; level < levels.size(); level++) {
+    const u32 w = std::max(img.w >> level, 1u);
+    const u32 h = std::max(img.h >> level, 1u);
+    const u64 row_bytes = img_to_buffer_size(img.format, {w, block_h, 1});
+    const u32 row_cnt = (h + block_h - 1) / block_h;
+    assert(levels[level].size() == row_bytes * row_cnt);
+    for (u32 row = 0; row < row_cnt;) {
+      const u64 remaining = (row_cnt - row) * row_bytes;
+      const auto r = ring.reserve(
+          remaining, std::min<u64>(remaining, (upload_split_rows / block_h) * row_bytes));
+      const auto rows = static_cast<u32>(r.size / row_bytes);
+      const u32 y = row * block_h;
+      std::memcpy(slice_data[r.slice] + r.offset, levels[level].data() + (row * row_bytes),
+                  r.size);
+      ring.commit(r, TextureUploadRegion{.img_idx = img_idx,
+                                         .level = level,
+                                         .y = y,
+                                         .extent = {w, std::min(rows * block_h, h - y)},
+                                         .staging_offset = r.offset,
+                                         .size = r.size,
+                                         .format = img.format,
+                                         .img_extent = {img.w, img.h},
+                                         .mip_levels = static_cast<u32>(levels.size()),
+                                         .img_size = img_size});
+      row += rows;
+    }
+  }
+}
+
+struct TextureUploadState {
+  u64 uploaded_bytes{};
+  bool started{};
+};
+
+VkImageMemoryBarrier2 texture_upload_barrier(VkImage image, VkImageLayout old_layout,
+                                             VkImageLayout new_layout) {
+  const bool to_dst = new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  return {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+          .srcStageMask = to_dst ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_COPY_BIT,
+          .srcAccessMask = to_dst ? VK_ACCESS_2_NONE : VK_ACCESS_2_TRANSFER_WRITE_BIT,
+          .dstStageMask =
+              to_dst ? VK_PIPELINE_STAGE_2_COPY_BIT : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+          .dstAccessMask = to_dst ? VK_ACCESS_2_TRANSFER_WRITE_BIT
+                                  : VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+          .oldLayout = old_layout,
+          .newLayout = new_layout,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = image,
+          .subresourceRange = default_image_subresource_range};
+}
+
+// Images stay in transfer dst across slices and go to read only in the slice with their last
+// region. Submits are in order on one queue, so later slices are covered by earlier barriers.
+void record_texture_slice(VkCommandBuffer cmd, VkBuffer staging,
+                          std::span<const TextureUploadRegion> regions,
+                          std::span<Holder<ImageHandle>> textures,
+                          std::span<TextureUploadState> states,
+                          std::vector<VkImageMemoryBarrier2>& barriers) {
+  ZoneScoped;
+  auto flush_barriers = [&] {
+    if (barriers.empty()) return;
+    VkDependencyInfo info = vk2::init::dependency_info({}, barriers);
+    vkCmdPipelineBarrier2KHR(cmd, &info);
+    barriers.clear();
+  };
+  for (const auto& region : regions) {
+    auto& state = states[region.img_idx];
+    if (state.started) continue;
+    state.started = true;
+    textures[region.img_idx] = get_device().create_image_holder(
+        ImageDesc{.type = ImageDesc::Type::TwoD,
+                  .format = region.format,
+                  .dims = {region.img_extent.x, region.img_extent.y, 1},
+                  .mip_levels = region.mip_levels,
+                  .bind_flags = BindFlag::ShaderResource});
+    barriers.emplace_back(texture_upload_barrier(
+        get_device().get_image(textures[region.img_idx])->image(), VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+  }
+  flush_barriers();
+  for (const auto& region : regions) {
+    VkBufferImageCopy2 img_copy{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
+        .bufferOffset = region.staging_offset,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = region.level,
+                .layerCount = 1,
+            },
+        .imageOffset = {0, static_cast<i32>(region.y), 0},
+        .imageExtent = VkExtent3D{region.extent.x, region.extent.y, 1}};
+    VkCopyBufferToImageInfo2 img_copy_info{
+        .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2_KHR,
+        .srcBuffer = staging,
+        .dstImage = get_device().get_image(textures[region.img_idx])->image(),
+        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .regionCount = 1,
+        .pRegions = &img_copy,
+    };
+    vkCmdCopyBufferToImage2KHR(cmd, &img_copy_info);
+  }
+  for (const auto& region : regions) {
+    auto& state = states[region.img_idx];
+    state.uploaded_bytes += region.size;
+    if (state.uploaded_bytes == region.img_size) {
+      barriers.emplace_back(texture_upload_barrier(
+          get_device().get_image(textures[region.img_idx])->image(),
+          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL));
+    }
+  }
+  flush_barriers();
+}
+
+}  // namespace
+
+std::vector<Holder<ImageHandle>> create_textures(std::span<const ModelImageSource> sources,
+                                                 const std::filesystem::path& directory,
+                                                 Device::CopyAllocator::CopyTicket& ticket) {
+  ZoneScoped;
+  std::vector<Holder<ImageHandle>> textures(sources.size());
+  if (sources.empty()) {
+    return textures;
+  }
+  const TextureCache texture_cache{directory / ".texture_cache"};
+  const TextureLoadSettings settings{
+      .cache = texture_cache_enabled.get() ? &texture_cache : nullptr,
+      .transcode_flags =
+          ktx_high_quality_transcode.get() ? static_cast<u32>(KTX_TF_HIGH_QUALITY) : 0u};
+
+  // Decode workers write straight into a fixed set of staging slices, which this thread submits
+  // as they fill. Uploads overlap decoding and staging memory doesn't grow with the model.
+  constexpr u32 slice_cnt = 4;
+  const u64 slice_size = std::max(texture_staging_mb.get(), 32) * 1024ull * 1024 / slice_cnt;
+  auto& copy_allocator = get_device().transfer_copy_allocator_;
+  std::vector<Device::CopyAllocator::CopyCmd> slice_cmds(slice_cnt);
+  std::vector<std::byte*> slice_data(slice_cnt);
+  auto begin_slice = [&](u32 slice) {
+    slice_cmds[slice] = copy_allocator.allocate(slice_size);
+    slice_data[slice] = static_cast<std::byte*>(
+        get_device().get_buffer(slice_cmds[slice].staging_buffer)->mapped_data());
+  };
+  for (u32 slice = 0; slice < slice_cnt; slice++) {
+    begin_slice(slice);
+  }
+
+  TextureStagingRing ring{slice_cnt, slice_size};
+  std::atomic<u32> images_left{static_cast<u32>(sources.size())};
+  std::vector<std::future<void>> futures;
+  futures.reserve(sources.size());
+  for (u32 i = 0; i < sources.size(); i++) {
+    futures.emplace_back(threads::pool.submit_task(
+        [i, &sources, &directory, &settings, &ring, &slice_data, &images_left]() {
+          CpuImageData img{};
+          load_cpu_img_data(sources[i], directory, settings, img);
+          stream_image_levels(img, i, ring, slice_data);
+          free_cpu_img_data(img);
+          if (images_left.fetch_sub(1) == 1) {
+            ring.close();
+          }
+        }));
+  }
+
+  Timer timer;
+  double record_ms{};
+  double gpu_wait_ms{};
+  std::vector<TextureUploadState> states(sources.size());
+  std::vector<VkImageMemoryBarrier2> barriers;
+  // A submitted slice's memory goes back to the producers once the gpu passes its ticket. Textures
+  // aren't waited on here, the frame that publishes the model waits on the last ticket.
+  struct InFlightSlice {
+    u32 slice;
+    Device::CopyAllocator::CopyTicket ticket;
+  };
+  std::deque<InFlightSlice> in_flight;
+  auto recycle_oldest = [&]() {
+    const u32 slice = in_flight.front().slice;
+    in_flight.pop_front();
+    // the slice's memory must be valid again before producers can reserve from it
+    begin_slice(slice);
+    ring.release(slice);
+  };
+  while (true) {
+    while (!in_flight.empty() && copy_allocator.is_done(in_flight.front().ticket)) {
+      recycle_oldest();
+    }
+    // blocking is only safe when no slice is held by the gpu, else producers may be waiting on it
+    auto slice = in_flight.empty() ? ring.acquire() : ring.try_acquire();
+    if (!slice) {
+      if (ring.is_drained()) {
+        break;
+      }
+      ZoneScopedN("wait texture slice");
+      Timer wait_timer;
+      copy_allocator.wait(in_flight.front().ticket);
+      gpu_wait_ms += wait_timer.elapsed_ms();
+      continue;
+    }
+    ZoneScopedN("upload texture slice");
+    Timer record_timer;
+    auto& cmd = slice_cmds[*slice];
+    record_texture_slice(cmd.transfer_cmd_buf,
+                         get_device().get_buffer(cmd.staging_buffer)->buffer(),
+                         ring.get_regions(*slice), textures, states, barriers);
+    ticket = copy_allocator.submit(cmd);
+    in_flight.emplace_back(InFlightSlice{.slice = *slice, .ticket = ticket});
+    record_ms += record_timer.elapsed_ms();
+  }
+  for (auto& f : futures) {
+    f.get();
+  }
+  // in flight cmds belong to the allocator now, which recycles them itself
+  for (u32 slice = 0; slice < slice_cnt; slice++) {
+    if (std::ranges::none_of(in_flight, [&](const auto& s) { return s.slice == slice; })) {
+      copy_allocator.free(slice_cmds[slice]);
+    }
+  }
+  LINFO(
+      "uploaded {} textures, {:.1f} MB in {} slices: peak staging {:.1f} of {:.1f} MB, "
+      "record {:.1f} ms, {:.1f} ms waiting on the gpu, of {:.1f} ms, {} decode stalls",
+      sources.size(), ring.get_total_bytes() / (1024.0 * 1024.0), ring.get_slices_acquired(),
+      ring.get_peak_used_bytes() / (1024.0 * 1024.0),
+      (slice_size * slice_cnt) / (1024.0 * 1024.0), record_ms, gpu_wait_ms, timer.elapsed_ms(),
+      ring.get_producer_stalls());
+  return textures;
+}
+
+void resolve_material_textures(std::span<Material> materials,
+                               std::span<const Holder<ImageHandle>> textures,
+                               const DefaultMaterialData& default_mat) {
+  auto resolve = [&](u32& id) {
+    if (id == 0) return;
+    if (id == missing_texture_id || id > textures.size()) {
+      id = default_mat.white_img_handle;
+      return;
+    }
+    id = get_device().get_bindless_idx(textures[id - 1].handle, SubresourceType::Shader);
+  };
+  for (auto& mat : materials) {
+    for (int i = 0; i < 4; i++) {
+      resolve(mat.ids1[i]);
+    }
+    // ids2.w holds flags
+    resolve(mat.ids2.x);
+  }
+}
+
 std::optional<LoadedSceneData> load_gltf(const std::filesystem::path& path,
                                          const DefaultMaterialData& default_mat) {
   ZoneScoped;
-  PrintTimerMS t;
-  auto base_scene_data_ret = load_gltf_base(path, default_mat);
-  if (!base_scene_data_ret.has_value()) {
-    return {};
-  }
-
-  LoadedSceneBaseData& base_scene_data = base_scene_data_ret.value();
-  return LoadedSceneData{.scene_graph_data = std::move(base_scene_data.scene_graph_data),
-                         .materials = std::move(base_scene_data.materials),
-                         .textures = std::move(base_scene_data.textures),
-                         .mesh_draw_infos = std::move(base_scene_data.mesh_draw_infos),
-                         .vertices = std::move(base_scene_data.vertices),
-                         .animated_vertices = std::move(base_scene_data.animated_vertices),
-                         .indices = std::move(base_scene_data.indices),
-                         .animations = std::move(base_scene_data.animations)};
+  Timer timer;
+  const bool use_cache = model_cache_enabled.get();
+  std::optional<ModelCpuData> model;
+  if (use_cache) {
+    model = read_model_cache(path);
+  }
+  const bool from_cache = model.has_value();
+  if (!model) {
+    model = parse_gltf(path);
+    if (!model) {
+      return {};
+    }
+    if (use_cache && !write_model_cache(path, *model)) {
+      LWARN("failed to write model cache for {}", path.string());
+    }
+  }
+  for (auto& animation : model->animations) {
+    prepare_animation(animation, static_cast<float>(anim_resample_hz.get()));
+  }
+  const double cpu_ms = timer.elapsed_ms();
+
+  Device::CopyAllocator::CopyTicket textures_ticket;
+  auto textures = create_textures(model->images, path.parent_path(), textures_ticket);
+  resolve_material_textures(model->materials, textures, default_mat);
+  LINFO("loaded {} in {:.1f} ms, {} took {:.1f} ms", path.filename().string(), timer.elapsed_ms(),
+        from_cache ? "cache read" : "parse", cpu_ms);
+  return LoadedSceneData{.scene_graph_data = std::move(model->scene_graph_data),
+                         .materials = std::move(model->materials),
+                         .textures = std::move(textures),
+                         .textures_ticket = textures_ticket,
+                         .mesh_draw_infos = std::move(model->mesh_draw_infos),
+                         .vertices = model->vertices,
+                         .animated_vertices = model->animated_vertices,
+                         .indices = model->indices,
+                         .geometry_storage = std::move(model->geometry_storage),
+                         .animations = std::move(model->animations)};
 }
 
 namespace loader {
@@ -1313,6 +1641,10 @@ void free_hdr(CPUHDRImageData& img_data) {
 }  // namespace loader
 
 uvec2 AnimSampler::get_time_indices(float t) const {
+  if (uniform_inv_dt > 0.f) {
+    u32 cursor{};
+    return get_time_indices(t, cursor);
+  }
   auto it = std::ranges::lower_bound(inputs, t);
   size_t time_i = 0;
   if (it != inputs.begin()) {
@@ -1322,4 +1654,145 @@ uvec2 AnimSampler::get_time_indices(float t) const {
   return {time_i, next_time_i};
 }
 
+uvec2 AnimSampler::get_time_indices(float t, u32& cursor) const {
+  const auto key_cnt = static_cast<u32>(inputs.size());
+  u32 time_i;
+  if (key_cnt < 2 || t <= inputs.front()) {
+    time_i = 0;
+  } else if (t > inputs.back()) {
+    time_i = key_cnt - 1;
+  } else if (uniform_inv_dt > 0.f) {
+    time_i = std::min(static_cast<u32>((t - inputs.front()) * uniform_inv_dt), key_cnt - 2);
+  } else {
+    // the last key before t, as the binary search finds it: inputs[time_i] < t
+    time_i = std::min(cursor, key_cnt - 2);
+    if (inputs[time_i] >= t) {
+      // moved back, usually the clip looping
+      const auto it = std::lower_bound(inputs.begin(), inputs.begin() + time_i, t);
+      time_i = static_cast<u32>(std::distance(inputs.begin(), it)) - 1;
+    } else {
+      // t <= inputs.back(), so this stops before the last key
+      for (u32 steps = 0; inputs[time_i + 1] < t; steps++) {
+        if (steps == 4) {
+          const auto it = std::lower_bound(inputs.begin() + time_i + 1, inputs.end(), t);
+          time_i = static_cast<u32>(std::distance(inputs.begin(), it)) - 1;
+          break;
+        }
+        time_i++;
+      }
+    }
+  }
+  cursor = time_i;
+  return {time_i, key_cnt <= 1 ? 0 : (time_i + 1) % key_cnt};
+}
+
+namespace {
+
+bool evenly_spaced(std::span<const float> inputs) {
+  if (inputs.size() < 2) {
+    return false;
+  }
+  const float dt = (inputs.back() - inputs.front()) / static_cast<float>(inputs.size() - 1);
+  if (dt <= 0.f) {
+    return false;
+  }
+  for (size_t i = 1; i < inputs.size(); i++) {
+    const float expected = inputs.front() + (static_cast<float>(i) * dt);
+    if (std::abs(inputs[i] - expected) > dt * 1e-4f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Samples the sampler at evenly spaced times from its first to its last key, the same way
+// apply_clip does.
+void resample_uniform(AnimSampler& sampler, float hz, bool rotation) {
+  const auto old_key_cnt = static_cast<u32>(sampler.inputs.size());
+  const auto components = static_cast<u32>(sampler.outputs_raw.size() / old_key_cnt);
+  if (components == 0 || sampler.outputs_raw.size() % old_key_cnt != 0 ||
+      (rotation && components != 4)) {
+    return;
+  }
+  const float t0 = sampler.inputs.front();
+  const float t1 = sampler.inputs.back();
+  const u32 key_cnt = std::max(static_cast<u32>(std::ceil((t1 - t0) * hz)) + 1, 2u);
+  const float dt = (t1 - t0) / static_cast<float>(key_cnt - 1);
+  if (dt <= 0.f) {
+    return;
+  }
+  std::vector<float> inputs(key_cnt);
+  std::vector<float> outputs(static_cast<size_t>(key_cnt) * components);
+  u32 cursor{};
+  for (u32 k = 0; k < key_cnt; k++) {
+    const float t = k == key_cnt - 1 ? t1 : t0 + (static_cast<float>(k) * dt);
+    inputs[k] = t;
+    const uvec2 keys = sampler.get_time_indices(t, cursor);
+    const float key_t0 = sampler.inputs[keys.x];
+    const float key_t1 = sampler.inputs[keys.y];
+    const float alpha = key_t1 > key_t0 ? (t - key_t0) / (key_t1 - key_t0) : 0.f;
+    const float* a = &sampler.outputs_raw[static_cast<size_t>(keys.x) * components];
+    const float* b = &sampler.outputs_raw[static_cast<size_t>(keys.y) * components];
+    float* out = &outputs[static_cast<size_t>(k) * components];
+    if (rotation) {
+      quat q0, q1;
+      std::memcpy(&q0, a, sizeof(quat));
+      std::memcpy(&q1, b, sizeof(quat));
+      if (glm::dot(q0, q1) < 0.f) q1 = -q1;
+      const quat q = glm::slerp(q0, q1, alpha);
+      std::memcpy(out, &q, sizeof(quat));
+    } else {
+      for (u32 c = 0; c < components; c++) {
+        out[c] = glm::mix(a[c], b[c], alpha);
+      }
+    }
+  }
+  sampler.inputs = std::move(inputs);
+  sampler.outputs_raw = std::move(outputs);
+}
+
+}  // namespace
+
+void prepare_animation(Animation& animation, float resample_hz) {
+  ZoneScoped;
+  std::vector<bool> rotation_samplers(animation.samplers.size());
+  for (auto* group : {&animation.translations, &animation.rotations, &animation.scales}) {
+    *group = {};
+  }
+  for (size_t channel_i = 0; channel_i < animation.channels.nodes.size(); channel_i++) {
+    const int node = animation.channels.nodes[channel_i];
+    const u32 sampler_i = animation.channels.sampler_indices[channel_i];
+    assert(sampler_i < animation.samplers.size());
+    ChannelGroup* group{};
+    switch (animation.channels.anim_paths[channel_i]) {
+      case AnimationPath::Translation:
+        group = &animation.translations;
+        break;
+      case AnimationPath::Rotation:
+        group = &animation.rotations;
+        rotation_samplers[sampler_i] = true;
+        break;
+      case AnimationPath::Scale:
+        group = &animation.scales;
+        break;
+      default:
+        continue;
+    }
+    group->nodes.emplace_back(node);
+    group->sampler_indices.emplace_back(sampler_i);
+  }
+
+  for (size_t sampler_i = 0; sampler_i < animation.samplers.size(); sampler_i++) {
+    auto& sampler = animation.samplers[sampler_i];
+    if (resample_hz > 0.f && sampler.inputs.size() > 2 && !evenly_spaced(sampler.inputs)) {
+      resample_uniform(sampler, resample_hz, rotation_samplers[sampler_i]);
+    }
+    sampler.uniform_inv_dt =
+        evenly_spaced(sampler.inputs)
+            ? static_cast<float>(sampler.inputs.size() - 1) /
+                  (sampler.inputs.back() - sampler.inputs.front())
+            : 0.f;
+  }
+}
+
 }  // namespace gfx
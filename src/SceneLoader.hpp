@@ -1,13 +1,18 @@
 #pragma once
 
+#include <cstddef>
 #include <filesystem>
+#include <memory>
 #include <optional>
+#include <span>
+#include <string>
 #include <vector>
 
 #include "AABB.hpp"
 #include "Common.hpp"
 #include "Scene.hpp"
 #include "Types.hpp"
+#include "vk2/Device.hpp"
 #include "vk2/Pool.hpp"
 
 namespace gfx {
@@ -37,10 +42,38 @@ enum class AnimationPath : u8 {
   Weights = 4,
 };
 
+// Bounds of the vec3 at `offset` in each of `len` vertices `stride` bytes apart.
+void calc_aabb(AABB& aabb, const void* vertices, size_t len, size_t stride, size_t offset);
+
+// Strided views of the vertex attributes calc_tangents reads and the tangent it writes.
+struct CalcTangentsVertexInfo {
+  struct BaseOffset {
+    void* base;
+    u32 offset;
+    u32 stride;
+  };
+  BaseOffset pos;
+  BaseOffset normal;
+  BaseOffset uv_x;
+  BaseOffset uv_y;
+  BaseOffset tangent;
+};
+
+// MikkTSpace tangents for a triangle list. Instantiated for u32 indices.
+template <typename IndexT>
+void calc_tangents(const CalcTangentsVertexInfo& info, std::span<IndexT> indices);
+
 struct AnimSampler {
   std::vector<float> inputs;
   std::vector<float> outputs_raw;
+  // 1 / key spacing when the keys are evenly spaced, which makes finding them O(1), 0 otherwise.
+  // Set by prepare_animation.
+  float uniform_inv_dt{};
   [[nodiscard]] uvec2 get_time_indices(float t) const;
+  // Same keys as above. Unless the keys are evenly spaced, the search starts from cursor, the key
+  // found for this sampler last time, and stores the new one in it. Playback mostly moves forward
+  // by less than a key per frame, so that's a compare or two instead of a binary search.
+  [[nodiscard]] uvec2 get_time_indices(float t, u32& cursor) const;
 };
 
 struct Channels {
@@ -49,6 +82,13 @@ struct Channels {
   std::vector<AnimationPath> anim_paths;
 };
 
+// The channels of one AnimationPath, in channel order.
+struct ChannelGroup {
+  std::vector<int> nodes;
+  std::vector<u32> sampler_indices;
+  [[nodiscard]] size_t size() const { return nodes.size(); }
+};
+
 struct Animation {
   Channels channels;
   [[nodiscard]] int get_channel_node(u32 channel_i) const { return channels.nodes[channel_i]; }
@@ -62,8 +102,18 @@ struct Animation {
   std::string name{"Animation"};
   float ticks_per_second{1.f};
   float duration{0.};
+  // channels split by path, so each kind is sampled in its own loop. Built by prepare_animation,
+  // weights channels aren't applied and are left out.
+  ChannelGroup translations;
+  ChannelGroup rotations;
+  ChannelGroup scales;
 };
 
+// Builds the channel groups and flags samplers with evenly spaced keys. With resample_hz > 0,
+// samplers with unevenly spaced keys are first resampled at that rate, trading some accuracy for
+// O(1) key lookup. Runs on every load, the model cache stores the keys as authored.
+void prepare_animation(Animation& animation, float resample_hz = 0.f);
+
 inline constexpr u32 max_bones_per_vertex{4};
 
 struct AnimatedVertex {
@@ -87,36 +137,72 @@ struct PrimitiveDrawInfo {
   u32 first_animated_vertex;
 };
 
-struct LoadedSceneData {
+enum class ImageEncoding : u8 { None, KTX2, JPEG, PNG, DDS };
+
+// An image as referenced by the model, decoded when the model's textures are created.
+struct ModelImageSource {
+  // path relative to the model's directory, empty for images embedded in the model
+  std::string uri;
+  // encoded bytes of embedded images
+  std::vector<std::byte> bytes;
+  ImageEncoding encoding{};
+  bool srgb{};
+};
+
+// Material texture ids hold these until resolve_material_textures replaces them with bindless
+// indices: 0 for no texture, image index + 1, or missing_texture_id for a texture without an image.
+inline constexpr u32 missing_texture_id{UINT32_MAX};
+
+// Everything loading a model produces before touching the gpu. This is what the model cache
+// stores, see ModelCache.hpp.
+struct ModelCpuData {
   Scene2 scene_graph_data;
-  std::vector<Material> materials;
-  std::vector<Holder<ImageHandle>> textures;
   std::vector<PrimitiveDrawInfo> mesh_draw_infos;
-  std::vector<Vertex> vertices;
-  std::vector<AnimatedVertex> animated_vertices;
-  std::vector<u32> indices;
+  std::vector<Material> materials;
+  std::vector<ModelImageSource> images;
   std::vector<Animation> animations;
+  // geometry views, owned by geometry_storage: the parsed vectors or the mapped cache file
+  std::span<const Vertex> vertices;
+  std::span<const AnimatedVertex> animated_vertices;
+  std::span<const u32> indices;
+  std::shared_ptr<const void> geometry_storage;
+  // external buffer files the geometry was read from, relative to the model's directory
+  std::vector<std::string> buffer_uris;
 };
 
-struct LoadedSceneBaseData {
+struct LoadedSceneData {
   Scene2 scene_graph_data;
-  std::vector<PrimitiveDrawInfo> mesh_draw_infos;
-  std::vector<Vertex> vertices;
-  std::vector<AnimatedVertex> animated_vertices;
-  std::vector<u32> indices;
-  std::vector<Holder<ImageHandle>> textures;
   std::vector<Material> materials;
+  std::vector<Holder<ImageHandle>> textures;
+  // last texture copy, the frame the model is published in waits on it
+  Device::CopyAllocator::CopyTicket textures_ticket;
+  std::vector<PrimitiveDrawInfo> mesh_draw_infos;
+  // valid while geometry_storage is alive
+  std::span<const Vertex> vertices;
+  std::span<const AnimatedVertex> animated_vertices;
+  std::span<const u32> indices;
+  std::shared_ptr<const void> geometry_storage;
   std::vector<Animation> animations;
-  bool has_bones{};
 };
 
 struct DefaultMaterialData {
   u32 white_img_handle;
 };
 
-std::optional<LoadedSceneBaseData> load_gltf_base(const std::filesystem::path& path,
-                                                  const DefaultMaterialData& default_mat);
+// Parses a glTF into cpu data. Doesn't use the device, so it can run in offline tools.
+std::optional<ModelCpuData> parse_gltf(const std::filesystem::path& path);
+
+// Decodes and uploads the model's images, in the same order as images. The copies may still be
+// running when this returns, ticket is the last one.
+std::vector<Holder<ImageHandle>> create_textures(std::span<const ModelImageSource> images,
+                                                 const std::filesystem::path& directory,
+                                                 Device::CopyAllocator::CopyTicket& ticket);
+
+void resolve_material_textures(std::span<Material> materials,
+                               std::span<const Holder<ImageHandle>> textures,
+                               const DefaultMaterialData& default_mat);
 
+// Loads from the model cache when it matches the source, otherwise parses and writes the cache.
 std::optional<LoadedSceneData> load_gltf(const std::filesystem::path& path,
                                          const DefaultMaterialData& default_mat);
 struct CPUHDRImageData {
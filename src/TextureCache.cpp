@@ -0,0 +1,147 @@
+#include "TextureCache.hpp"
+
+#include <array>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <tracy/Tracy.hpp>
+
+#include "util/Hash.hpp"
+#include "util/MappedFile.hpp"
+
+namespace gfx {
+
+namespace {
+
+constexpr std::array<char, 8> texture_cache_magic{'V', 'K', 'R', 'T', 'E', 'X', '\0', '\0'};
+// Bump when the file layout below changes.
+constexpr u32 texture_cache_version = 1;
+constexpr u32 max_levels = 32;
+constexpr u64 level_alignment = 16;
+
+struct TextureCacheHeader {
+  std::array<char, 8> magic;
+  u32 version;
+  u32 format;
+  u32 width;
+  u32 height;
+  u32 level_cnt;
+  u32 padding;
+  u64 key;
+};
+
+struct LevelEntry {
+  u64 offset;
+  u64 size;
+};
+
+u64 align_level(u64 offset) { return (offset + level_alignment - 1) & ~(level_alignment - 1); }
+
+}  // namespace
+
+u64 get_texture_cache_key(std::span<const std::byte> source, Format target_format, u32 quality) {
+  const std::array<u32, 3> params{texture_cache_version, static_cast<u32>(target_format),
+                                  quality};
+  return util::hash_bytes(source, util::hash_bytes(std::as_bytes(std::span(params))));
+}
+
+std::filesystem::path TextureCache::get_path(u64 key) const {
+  return dir_ / std::format("{:016x}.vktex", key);
+}
+
+std::optional<TranscodedTexture> TextureCache::load(u64 key) const {
+  ZoneScoped;
+  auto file = std::make_shared<util::MappedFile>();
+  if (!file->open(get_path(key))) {
+    return std::nullopt;
+  }
+  const auto bytes = file->bytes();
+  TextureCacheHeader header;
+  if (bytes.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != texture_cache_magic || header.version != texture_cache_version ||
+      header.key != key || header.level_cnt == 0 || header.level_cnt > max_levels ||
+      bytes.size() < sizeof(header) + (header.level_cnt * sizeof(LevelEntry))) {
+    return std::nullopt;
+  }
+  TranscodedTexture result;
+  result.format = static_cast<Format>(header.format);
+  result.extent = {header.width, header.height};
+  result.levels.reserve(header.level_cnt);
+  for (u32 level = 0; level < header.level_cnt; level++) {
+    LevelEntry entry;
+    std::memcpy(&entry, bytes.data() + sizeof(header) + (level * sizeof(LevelEntry)),
+                sizeof(entry));
+    if (entry.offset > bytes.size() || entry.size > bytes.size() - entry.offset) {
+      return std::nullopt;
+    }
+    result.levels.emplace_back(bytes.subspan(entry.offset, entry.size));
+  }
+  result.storage = std::move(file);
+  return result;
+}
+
+bool TextureCache::store(u64 key, Format format, uvec2 extent,
+                         std::span<const std::span<const std::byte>> levels) const {
+  ZoneScoped;
+  if (levels.empty() || levels.size() > max_levels) {
+    return false;
+  }
+  const TextureCacheHeader header{.magic = texture_cache_magic,
+                                  .version = texture_cache_version,
+                                  .format = static_cast<u32>(format),
+                                  .width = extent.x,
+                                  .height = extent.y,
+                                  .level_cnt = static_cast<u32>(levels.size()),
+                                  .padding = 0,
+                                  .key = key};
+  std::vector<LevelEntry> entries;
+  entries.reserve(levels.size());
+  u64 offset = sizeof(header) + (levels.size() * sizeof(LevelEntry));
+  for (const auto& level : levels) {
+    offset = align_level(offset);
+    entries.emplace_back(LevelEntry{.offset = offset, .size = level.size()});
+    offset += level.size();
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  const auto path = get_path(key);
+  // identical images in one model transcode on different threads, so tmp names must differ
+  auto tmp_path = path;
+  tmp_path += std::format(".{:x}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  {
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               static_cast<std::streamsize>(entries.size() * sizeof(LevelEntry)));
+    constexpr std::array<char, level_alignment> zeros{};
+    u64 pos = sizeof(header) + (entries.size() * sizeof(LevelEntry));
+    for (size_t i = 0; i < levels.size(); i++) {
+      file.write(zeros.data(), static_cast<std::streamsize>(entries[i].offset - pos));
+      file.write(reinterpret_cast<const char*>(levels[i].data()),
+                 static_cast<std::streamsize>(levels[i].size()));
+      pos = entries[i].offset + entries[i].size;
+    }
+  }
+  if (!std::filesystem::exists(tmp_path, ec) ||
+      std::filesystem::file_size(tmp_path, ec) != offset) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace gfx
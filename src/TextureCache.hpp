@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace gfx {
+
+// Transcoded mip chain read back from the cache. Levels point into the mapped cache file, which
+// storage keeps alive, so they can be copied straight into staging memory.
+struct TranscodedTexture {
+  Format format{};
+  uvec2 extent{};
+  std::vector<std::span<const std::byte>> levels;
+  std::shared_ptr<const void> storage;
+};
+
+// Key for a source image transcoded to target_format. quality is whatever transcode settings
+// change the output.
+[[nodiscard]] u64 get_texture_cache_key(std::span<const std::byte> source, Format target_format,
+                                        u32 quality);
+
+// On-disk cache of block compressed mip chains, one file per key in dir. Only touches the cpu.
+class TextureCache {
+ public:
+  explicit TextureCache(std::filesystem::path dir) : dir_(std::move(dir)) {}
+
+  // nullopt on a miss or an unreadable file
+  [[nodiscard]] std::optional<TranscodedTexture> load(u64 key) const;
+  // Writes through a temporary file, safe to call for the same key from multiple threads.
+  bool store(u64 key, Format format, uvec2 extent,
+             std::span<const std::span<const std::byte>> levels) const;
+
+  [[nodiscard]] std::filesystem::path get_path(u64 key) const;
+
+ private:
+  std::filesystem::path dir_;
+};
+
+}  // namespace gfx
@@ -1,8 +1,50 @@
 #pragma once
 
 #include <BS_thread_pool.hpp>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "Common.hpp"
 
 namespace threads {
 extern BS::light_thread_pool pool;
 
+// Calls fn(worker_slot, i) for every i in [0, count) and returns once all calls are done. The
+// calling thread is worker slot 0 and up to max_workers - 1 pool tasks are slots 1 and up; each
+// takes the next index when it finishes one. The calling thread works too, so a pool busy with
+// long running tasks (model loads) can't stall it. Tasks that only start once everything is done
+// find no work and exit without calling fn, so fn may reference the caller's stack.
+template <typename F>
+void parallel_for(u32 count, u32 max_workers, F&& fn) {
+  if (count == 0) return;
+  struct Job {
+    explicit Job(F&& f) : fn(std::forward<F>(f)) {}
+    std::decay_t<F> fn;
+    std::atomic<u32> next{0};
+    std::atomic<u32> done{0};
+  };
+  auto job = std::make_shared<Job>(std::forward<F>(fn));
+  const auto run = [job, count](u32 slot) {
+    for (u32 i = job->next.fetch_add(1, std::memory_order_relaxed); i < count;
+         i = job->next.fetch_add(1, std::memory_order_relaxed)) {
+      job->fn(slot, i);
+      job->done.fetch_add(1, std::memory_order_release);
+    }
+  };
+  const u32 task_cnt =
+      std::min({static_cast<u32>(pool.get_thread_count()), std::max(max_workers, 1u) - 1,
+                count - 1});
+  for (u32 t = 0; t < task_cnt; t++) {
+    pool.detach_task([run, t]() { run(t + 1); });
+  }
+  run(0);
+  while (job->done.load(std::memory_order_acquire) < count) {
+    std::this_thread::yield();
+  }
+}
+
 }  // namespace threads
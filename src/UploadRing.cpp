@@ -0,0 +1,298 @@
+#include "UploadRing.hpp"
+
+#include <volk.h>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <tracy/Tracy.hpp>
+#include <unordered_map>
+
+#include "CommandEncoder.hpp"
+#include "core/Logger.hpp"
+#include "vk2/Device.hpp"
+#include "vk2/Initializers.hpp"
+
+namespace gfx {
+
+namespace {
+
+VkBufferMemoryBarrier2 range_barrier(VkBuffer buffer, u64 offset, u64 size,
+                                     VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+                                     VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access) {
+  return {.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+          .srcStageMask = src_stage,
+          .srcAccessMask = src_access,
+          .dstStageMask = dst_stage,
+          .dstAccessMask = dst_access,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .buffer = buffer,
+          .offset = offset,
+          .size = size};
+}
+
+void copy_regions(VkCommandBuffer cmd, VkBuffer src, VkBuffer dst,
+                  std::span<const util::UploadRegion> regions,
+                  std::vector<VkBufferCopy2KHR>& scratch, u64 src_base = 0) {
+  scratch.clear();
+  for (const auto& region : regions) {
+    scratch.emplace_back(VkBufferCopy2KHR{.sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2_KHR,
+                                          .srcOffset = region.src_offset - src_base,
+                                          .dstOffset = region.dst_offset,
+                                          .size = region.size});
+  }
+  VkCopyBufferInfo2KHR copy_info{.sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
+                                 .srcBuffer = src,
+                                 .dstBuffer = dst,
+                                 .regionCount = static_cast<u32>(scratch.size()),
+                                 .pRegions = scratch.data()};
+  vkCmdCopyBuffer2KHR(cmd, &copy_info);
+}
+
+}  // namespace
+
+void UploadRing::init(Device* device, u32 frames_in_flight, u64 capacity) {
+  device_ = device;
+  capacity_ = capacity;
+  overflows_.resize(frames_in_flight);
+  for (u32 i = 0; i < frames_in_flight; i++) {
+    // storage so compute passes can read staged data in place
+    buffers_.emplace_back(device_->create_buffer(
+        BufferCreateInfo{.size = capacity,
+                         .usage = BufferUsage_Storage,
+                         .flags = BufferCreateFlags_HostVisible,
+                         .debug_name = "upload ring"}));
+  }
+  begin_frame(0);
+}
+
+void UploadRing::begin_frame(u32 frame_in_flight) {
+  // every copy bumped offset_, including the ones that overflowed, so it's what the last frame
+  // needed in total
+  const u64 used = offset_.load(std::memory_order_relaxed);
+  if (used > capacity_) {
+    capacity_ = std::bit_ceil(used);
+    LWARN("upload ring grown to {} MB", capacity_ / (1024 * 1024));
+  }
+  frame_in_flight_ = frame_in_flight;
+  // the gpu is done with this frame's buffers, so they can be replaced
+  overflows_[frame_in_flight].clear();
+  auto& buffer = buffers_[frame_in_flight];
+  if (device_->get_buffer(buffer)->size() < capacity_) {
+    buffer = device_->create_buffer_holder(BufferCreateInfo{.size = capacity_,
+                                                            .usage = BufferUsage_Storage,
+                                                            .flags = BufferCreateFlags_HostVisible,
+                                                            .debug_name = "upload ring"});
+  }
+  frame_capacity_ = device_->get_buffer(buffer)->size();
+  overflow_end_ = frame_capacity_;
+  mapped_ = static_cast<std::byte*>(device_->get_buffer(buffer)->mapped_data());
+  offset_.store(0, std::memory_order_relaxed);
+}
+
+const UploadRing::Overflow& UploadRing::find_overflow(u64 offset) const {
+  const auto& overflows = overflows_[frame_in_flight_];
+  auto it = std::ranges::upper_bound(overflows, offset, {}, &Overflow::offset);
+  assert(it != overflows.begin());
+  --it;
+  assert(offset < it->offset + std::max(it->size, alignment));
+  return *it;
+}
+
+UploadRing::StagingSrc UploadRing::resolve(u64 offset) const {
+  if (offset < frame_capacity_) {
+    return {device_->get_buffer(buffers_[frame_in_flight_])->buffer(), 0};
+  }
+  const auto& overflow = find_overflow(offset);
+  return {device_->get_buffer(overflow.buffer)->buffer(), overflow.offset};
+}
+
+VkDeviceAddress UploadRing::get_staging_addr(u64 offset) const {
+  if (offset < frame_capacity_) {
+    return device_->get_buffer(buffers_[frame_in_flight_])->device_addr() + offset;
+  }
+  const auto& overflow = find_overflow(offset);
+  return device_->get_buffer(overflow.buffer)->device_addr() + (offset - overflow.offset);
+}
+
+u64 UploadRing::copy(const void* data, u64 size) {
+  const u64 offset =
+      offset_.fetch_add((size + alignment - 1) & ~(alignment - 1), std::memory_order_relaxed);
+  if (offset + size > frame_capacity_) {
+    return copy_overflow(data, size);
+  }
+  memcpy(mapped_ + offset, data, size);
+  return offset;
+}
+
+u64 UploadRing::copy_overflow(const void* data, u64 size) {
+  ZoneScoped;
+  std::scoped_lock lock(overflow_mtx_);
+  auto buffer = device_->create_buffer_holder(
+      BufferCreateInfo{.size = std::max(size, alignment),
+                       .usage = BufferUsage_Storage,
+                       .flags = BufferCreateFlags_HostVisible,
+                       .debug_name = "upload ring overflow"});
+  memcpy(device_->get_buffer(buffer)->mapped_data(), data, size);
+  const u64 offset = overflow_end_ + alignment;
+  overflow_end_ = offset + size;
+  overflows_[frame_in_flight_].emplace_back(
+      Overflow{.offset = offset, .size = size, .buffer = std::move(buffer)});
+  return offset;
+}
+
+void UploadRing::add_copy(Holder<BufferHandle>& dst, u64 src_offset, u64 dst_offset, u64 size,
+                          VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access) {
+  if (size == 0) return;
+  std::scoped_lock lock(copies_mtx_);
+  copies_.emplace_back(StagingCopy{.dst = &dst,
+                                   .src_offset = src_offset,
+                                   .dst_offset = dst_offset,
+                                   .size = size,
+                                   .dst_stage = dst_stage,
+                                   .dst_access = dst_access});
+}
+
+void UploadRing::add_buffer_copy(BufferHandle src, BufferHandle dst,
+                                 std::span<const util::UploadRegion> regions) {
+  if (regions.empty()) return;
+  std::scoped_lock lock(copies_mtx_);
+  buffer_copies_.emplace_back(BufferCopy{
+      .src = src, .dst = dst, .regions = {regions.begin(), regions.end()}});
+}
+
+void UploadRing::record(CmdEncoder& cmd) {
+  ZoneScoped;
+  std::vector<StagingCopy> copies;
+  std::vector<BufferCopy> buffer_copies;
+  {
+    std::scoped_lock lock(copies_mtx_);
+    copies.swap(copies_);
+    buffer_copies.swap(buffer_copies_);
+  }
+  stats_ = Stats{.copies = static_cast<u32>(copies.size()),
+                 .staging_bytes = offset_.load(std::memory_order_relaxed),
+                 .overflow_copies = static_cast<u32>(overflows_[frame_in_flight_].size())};
+  if (copies.empty() && buffer_copies.empty()) return;
+
+  // destinations are resolved now, after any of them were replaced
+  std::vector<VkBuffer> dst_buffers;
+  std::unordered_map<VkBuffer, u32> dst_ids;
+  std::vector<util::UploadCopy> plan_copies;
+  plan_copies.reserve(copies.size());
+  for (const auto& copy : copies) {
+    VkBuffer buffer = device_->get_buffer(*copy.dst)->buffer();
+    auto [it, inserted] = dst_ids.try_emplace(buffer, static_cast<u32>(dst_buffers.size()));
+    if (inserted) dst_buffers.emplace_back(buffer);
+    plan_copies.emplace_back(util::UploadCopy{.dst = it->second,
+                                              .src_offset = copy.src_offset,
+                                              .dst_offset = copy.dst_offset,
+                                              .size = copy.size,
+                                              .dst_stage = copy.dst_stage,
+                                              .dst_access = copy.dst_access});
+  }
+  const auto plan = util::plan_uploads(plan_copies);
+
+  std::vector<VkBufferMemoryBarrier2> barriers;
+  auto flush_barriers = [&]() {
+    if (barriers.empty()) return;
+    VkDependencyInfo info = vk2::init::dependency_info(barriers, {});
+    vkCmdPipelineBarrier2KHR(cmd.cmd(), &info);
+    stats_.barrier_cmds++;
+    stats_.buffer_barriers += barriers.size();
+    barriers.clear();
+  };
+  auto transfer_barrier = [&]() {
+    cmd.barrier(VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    stats_.barrier_cmds++;
+  };
+
+  // earlier frames may still be using the bytes about to be read or overwritten
+  constexpr VkAccessFlags2 transfer_rw = VK_ACCESS_2_TRANSFER_READ_BIT |
+                                         VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  for (const auto& copy : buffer_copies) {
+    VkBuffer src = device_->get_buffer(copy.src)->buffer();
+    VkBuffer dst = device_->get_buffer(copy.dst)->buffer();
+    for (const auto& region : copy.regions) {
+      barriers.emplace_back(range_barrier(src, region.src_offset, region.size,
+                                          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                          VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                          VK_PIPELINE_STAGE_2_TRANSFER_BIT, transfer_rw));
+      barriers.emplace_back(range_barrier(dst, region.dst_offset, region.size,
+                                          VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                          VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                          VK_PIPELINE_STAGE_2_TRANSFER_BIT, transfer_rw));
+    }
+  }
+  for (const auto& range : plan.dst_ranges) {
+    barriers.emplace_back(range_barrier(dst_buffers[range.dst], range.offset, range.size,
+                                        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                        VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                        VK_PIPELINE_STAGE_2_TRANSFER_BIT, transfer_rw));
+  }
+  flush_barriers();
+
+  std::vector<VkBufferCopy2KHR> scratch;
+  // a buffer copy that touches a buffer written since the last barrier has to wait for it
+  std::vector<BufferHandle> written;
+  for (const auto& copy : buffer_copies) {
+    if (std::ranges::contains(written, copy.src) || std::ranges::contains(written, copy.dst)) {
+      transfer_barrier();
+      written.clear();
+    }
+    copy_regions(cmd.cmd(), device_->get_buffer(copy.src)->buffer(),
+                 device_->get_buffer(copy.dst)->buffer(), copy.regions, scratch);
+    stats_.copy_cmds++;
+    written.emplace_back(copy.dst);
+  }
+
+  for (size_t generation = 0; generation < plan.generation_starts.size(); generation++) {
+    // staging copies may land in a buffer that was just grown
+    if (generation > 0 || !buffer_copies.empty()) {
+      transfer_barrier();
+    }
+    const u32 end = generation + 1 < plan.generation_starts.size()
+                        ? plan.generation_starts[generation + 1]
+                        : static_cast<u32>(plan.batches.size());
+    for (u32 i = plan.generation_starts[generation]; i < end; i++) {
+      const auto& batch = plan.batches[i];
+      const auto regions = std::span(plan.regions).subspan(batch.first_region, batch.region_cnt);
+      // one command per run of regions from the same staging buffer, so just one without overflow
+      for (size_t first = 0; first < regions.size();) {
+        const auto src = resolve(regions[first].src_offset);
+        size_t last = first + 1;
+        while (last < regions.size() && resolve(regions[last].src_offset).buffer == src.buffer) {
+          last++;
+        }
+        copy_regions(cmd.cmd(), src.buffer, dst_buffers[batch.dst],
+                     regions.subspan(first, last - first), scratch, src.base);
+        stats_.copy_cmds++;
+        first = last;
+      }
+    }
+  }
+  stats_.regions = static_cast<u32>(plan.regions.size());
+
+  for (const auto& copy : buffer_copies) {
+    VkBuffer dst = device_->get_buffer(copy.dst)->buffer();
+    for (const auto& region : copy.regions) {
+      barriers.emplace_back(range_barrier(dst, region.dst_offset, region.size,
+                                          VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                          VK_ACCESS_2_TRANSFER_WRITE_BIT, default_dst_stage,
+                                          default_dst_access));
+    }
+  }
+  for (const auto& range : plan.dst_ranges) {
+    barriers.emplace_back(range_barrier(dst_buffers[range.dst], range.offset, range.size,
+                                        VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                        VK_ACCESS_2_TRANSFER_WRITE_BIT, range.dst_stage,
+                                        range.dst_access));
+  }
+  flush_barriers();
+}
+
+}  // namespace gfx
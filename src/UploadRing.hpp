@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "Types.hpp"
+#include "util/UploadPlanner.hpp"
+#include "vk2/Pool.hpp"
+
+namespace gfx {
+
+class Device;
+struct CmdEncoder;
+
+// Persistently mapped staging memory for each frame in flight. Anything uploaded during a frame is
+// bump allocated from the frame's buffer and copied out by one transfer pass at the start of the
+// frame's graphics commands, with barriers on exactly the bytes written. Copies that don't fit get
+// a buffer of their own for the frame, and the ring grows to the frame's total when that frame
+// slot comes around again.
+class UploadRing {
+ public:
+  struct Stats {
+    // copies as queued, and regions left after merging contiguous ones
+    u32 copies;
+    u32 regions;
+    u32 copy_cmds;
+    u32 barrier_cmds;
+    u32 buffer_barriers;
+    u64 staging_bytes;
+    // copies that didn't fit in the ring
+    u32 overflow_copies;
+  };
+  static constexpr VkPipelineStageFlags2 default_dst_stage = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+  static constexpr VkAccessFlags2 default_dst_access =
+      VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+  void init(Device* device, u32 frames_in_flight, u64 capacity);
+  // The gpu must be done with the frame's previous copies.
+  void begin_frame(u32 frame_in_flight);
+
+  // Copies data into this frame's staging memory, returns its offset. Lock-free unless the ring is
+  // full, callable from any thread until record.
+  [[nodiscard]] u64 copy(const void* data, u64 size);
+  // device address of a staging offset returned by copy this frame
+  [[nodiscard]] VkDeviceAddress get_staging_addr(u64 offset) const;
+  // dst is read when the pass is recorded, so it may be replaced by a bigger buffer in between.
+  // dst_stage/dst_access are the first use after the copy.
+  void add_copy(Holder<BufferHandle>& dst, u64 src_offset, u64 dst_offset, u64 size,
+                VkPipelineStageFlags2 dst_stage = default_dst_stage,
+                VkAccessFlags2 dst_access = default_dst_access);
+  void upload(Holder<BufferHandle>& dst, const void* data, u64 size, u64 dst_offset,
+              VkPipelineStageFlags2 dst_stage = default_dst_stage,
+              VkAccessFlags2 dst_access = default_dst_access) {
+    add_copy(dst, copy(data, size), dst_offset, size, dst_stage, dst_access);
+  }
+  // Copy between buffers, e.g. to grow or compact one. These run in the order queued, before any
+  // staging copy. A copy's regions must not overlap each other.
+  void add_buffer_copy(BufferHandle src, BufferHandle dst,
+                       std::span<const util::UploadRegion> regions);
+
+  // Records every queued copy. Call once per frame before anything reads the destinations.
+  void record(CmdEncoder& cmd);
+  // counts from the last record
+  [[nodiscard]] const Stats& get_stats() const { return stats_; }
+
+ private:
+  struct StagingCopy {
+    Holder<BufferHandle>* dst;
+    u64 src_offset;
+    u64 dst_offset;
+    u64 size;
+    VkPipelineStageFlags2 dst_stage;
+    VkAccessFlags2 dst_access;
+  };
+  struct BufferCopy {
+    BufferHandle src;
+    BufferHandle dst;
+    std::vector<util::UploadRegion> regions;
+  };
+  // a copy that didn't fit in the ring. Offsets past the ring's capacity address these, with a gap
+  // between them so the planner never merges regions from different buffers.
+  struct Overflow {
+    u64 offset;
+    u64 size;
+    Holder<BufferHandle> buffer;
+  };
+  struct StagingSrc {
+    VkBuffer buffer;
+    // subtracted from staging offsets to get the buffer's own offsets
+    u64 base;
+  };
+  static constexpr u64 alignment = 16;
+
+  u64 copy_overflow(const void* data, u64 size);
+  [[nodiscard]] const Overflow& find_overflow(u64 offset) const;
+  [[nodiscard]] StagingSrc resolve(u64 offset) const;
+
+  Device* device_{};
+  std::vector<Holder<BufferHandle>> buffers_;
+  std::byte* mapped_{};
+  // size new and regrown ring buffers get, and the size of this frame's buffer
+  u64 capacity_{};
+  u64 frame_capacity_{};
+  std::atomic<u64> offset_{};
+  std::mutex overflow_mtx_;
+  // per frame in flight, sorted by offset
+  std::vector<std::vector<Overflow>> overflows_;
+  u64 overflow_end_{};
+  std::mutex copies_mtx_;
+  std::vector<StagingCopy> copies_;
+  std::vector<BufferCopy> buffer_copies_;
+  u32 frame_in_flight_{};
+  Stats stats_{};
+};
+
+}  // namespace gfx
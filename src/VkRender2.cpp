@@ -17,6 +17,7 @@
 #include <memory>
 #include <tracy/Tracy.hpp>
 #include <tracy/TracyVulkan.hpp>
+#include <unordered_map>
 #include <utility>
 
 #include "AnimationManager.hpp"
@@ -38,8 +39,10 @@
 #include "shaders/gbuffer/shade_common.h.glsl"
 #include "shaders/lines/draw_line_common.h.glsl"
 #include "shaders/oit/transparent_common.h.glsl"
+#include "shaders/scatter_object_data_common.h.glsl"
 #include "shaders/shadow_depth_common.h.glsl"
 #include "util/CVar.hpp"
+#include "util/DefragPlanner.hpp"
 #include "util/IndexAllocator.hpp"
 #include "vk2/Buffer.hpp"
 #include "vk2/Device.hpp"
@@ -64,6 +67,26 @@ AutoCVarInt tonemap_enabled{"renderer.tonemap_enabled", "Tonemapping Enabled", 1
 AutoCVarInt gammacorrect_enabled{"renderer.gammacorrect_enabled", "Gamma Correction Enabled", 1,
                                  CVarFlags::EditCheckbox};
 AutoCVarInt normal_map_enabled{"renderer.normal_map", "Normal Map", 1, CVarFlags::EditCheckbox};
+AutoCVarInt defrag_enabled{"renderer.defrag_enabled", "Defragment Static Buffers", 1,
+                           CVarFlags::EditCheckbox};
+AutoCVarInt defrag_budget_kb{"renderer.defrag_budget_kb", "Defrag Budget KB Per Frame", 256};
+AutoCVarInt rg_compile_cache_enabled{"renderer.rg_compile_cache", "Reuse Compiled Render Graph", 1,
+                                     CVarFlags::EditCheckbox};
+AutoCVarInt rg_aliasing_enabled{"renderer.rg_aliasing", "Alias Transient Render Graph Images", 1,
+                                CVarFlags::EditCheckbox};
+AutoCVarInt rg_async_compute_enabled{"renderer.rg_async_compute",
+                                     "Run Render Graph Compute Passes On Compute Queue", 1,
+                                     CVarFlags::EditCheckbox};
+AutoCVarInt rg_parallel_record_enabled{"renderer.rg_parallel_record",
+                                       "Record Render Graph Passes On Worker Threads", 0,
+                                       CVarFlags::EditCheckbox};
+AutoCVarInt rg_split_barrier_distance{"renderer.rg_split_barrier_distance",
+                                      "Min Passes Between Write And Split Barrier, 0 Disables", 2};
+AutoCVarInt frame_profiler_enabled{"renderer.frame_profiler",
+                                   "Record Pass GPU Timestamps And CPU Scopes", 1,
+                                   CVarFlags::EditCheckbox};
+AutoCVarInt object_scatter_min_regions{"renderer.object_scatter_min_regions",
+                                       "Dirty Object Copy Regions Before Compute Scatter", 64};
 
 // clang-format off
 gfx::Vertex cube_vertices[] = {
@@ -117,12 +140,12 @@ VkRender2::VkRender2(const InitInfo& info, bool& success)
     success = false;
     return;
   }
-  if (!info.window) {
-    LCRITICAL("cannot initialize renderer, window not provided");
+  if (!info.device) {
+    LCRITICAL("cannot initialize renderer, device not provided");
     success = false;
     return;
   }
-  if (!info.device) {
+  if (!info.window && !info.device->is_headless()) {
     LCRITICAL("cannot initialize renderer, window not provided");
     success = false;
     return;
@@ -141,14 +164,8 @@ VkRender2::VkRender2(const InitInfo& info, bool& success)
 
   device_->init_imgui();
 
-  // create per frame staging buffers
-  for (u32 i = 0; i < device_->get_frames_in_flight(); i++) {
-    // 64 MB
-    size_t capacity = 1024ul * 1024 * 64;
-    frame_staging_buffers_.emplace_back(device_->create_staging_buffer(capacity));
-    staging_buffer_copiers_.emplace_back(
-        device_->get_buffer(frame_staging_buffers_.back())->mapped_data(), capacity);
-  }
+  // 64 MB per frame in flight
+  upload_ring_.init(device_, device_->get_frames_in_flight(), 1024ul * 1024 * 64);
 
   PipelineManager::init(device_->device(), resource_dir_ / "shaders", true,
                         device_->default_pipeline_layout_);
@@ -190,7 +207,7 @@ VkRender2::VkRender2(const InitInfo& info, bool& success)
                       VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
                       VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
     state_.flush_barriers();
-    device_->graphics_copy_allocator_.submit(copy_cmd);
+    device_->wait_for_copy(device_->graphics_copy_allocator_.submit(copy_cmd));
   }
 
   nearest_sampler_ = device_->get_or_create_sampler({
@@ -333,7 +350,7 @@ VkRender2::VkRender2(const InitInfo& info, bool& success)
                         VK_ACCESS_2_TRANSFER_WRITE_BIT)
         .flush_barriers();
     copy_cmd.copy_buffer(device_, *device_->get_buffer(cube_vertex_buf_), 0, 0, vert_buf_size);
-    device_->graphics_copy_allocator_.submit(copy_cmd);
+    device_->wait_for_copy(device_->graphics_copy_allocator_.submit(copy_cmd));
   }
 
   shadow_sampler_ = device_->get_or_create_sampler(
@@ -424,6 +441,7 @@ VkRender2::VkRender2(const InitInfo& info, bool& success)
               .name = "transparent_oit"},
           &transparent_oit_pipeline_)
       .add_compute("animation/skinning.comp", &skinning_comp_pipeline_)
+      .add_compute("scatter_object_data.comp", &scatter_object_data_pipeline_)
       .add_compute("oit/oit.comp", &oit_comp_pipeline_);
 
   GraphicsPipelineCreateInfo gbuffer_info{
@@ -518,17 +536,20 @@ VkRender2::VkRender2(const InitInfo& info, bool& success)
   oit_atomic_counter_buf_ = device_->create_buffer_holder(
       BufferCreateInfo{.size = sizeof(u32), .usage = BufferUsage_Storage});
   init_ssao();
+  profiler_.init_gpu_queries();
 }
 
 void VkRender2::draw(const SceneDrawInfo& info) {
-  ZoneScoped;
+  profiler_.set_enabled(frame_profiler_enabled.get());
+  profiler_.begin_frame(device_->curr_frame_num(), device_->curr_frame_in_flight());
+  PROFILE_SCOPE("VkRender2::draw");
   {
     on_imgui();
     ImGui::Render();
   }
 
   {
-    ZoneScopedN("scene uniform buffer");
+    PROFILE_SCOPE("scene uniform buffer");
     auto& d = curr_frame();
     scene_uniform_cpu_data_.proj = glm::perspective(glm::radians(info.fov_degrees), aspect_ratio(),
                                                     near_far_z_.y, near_far_z_.x);
@@ -562,35 +583,6 @@ void VkRender2::draw(const SceneDrawInfo& info) {
            sizeof(SceneUniforms));
   }
 
-  staging_buffer_copiers_[device_->curr_frame_in_flight()].reset();
-
-  {
-    ZoneScopedN("copy dirty transforms");
-    if (object_datas_to_copy_.size()) {
-      auto copy_size = sizeof(ObjectData) * object_data_buffer_copier_.copies.size();
-      immediate_submit([this, copy_size](CmdEncoder& cmd) {
-        state_
-            .buffer_barrier(static_object_data_buf_.get_buffer()->buffer(),
-                            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT)
-            .flush_barriers();
-        staging_buffer_copiers_[device_->curr_frame_in_flight()].copy(object_datas_to_copy_.data(),
-                                                                      copy_size);
-        cmd.copy_buffer(
-            object_data_buffer_copier_,
-            *device_->get_buffer(frame_staging_buffers_[device_->curr_frame_in_flight()]),
-            *static_object_data_buf_.get_buffer());
-        state_
-            .buffer_barrier(
-                static_object_data_buf_.get_buffer()->buffer(),
-                VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
-                VK_ACCESS_2_SHADER_READ_BIT)
-            .flush_barriers();
-      });
-      object_datas_to_copy_.clear();
-      object_data_buffer_copier_.copies.clear();
-    }
-  }
-
   ResourceManager::get().update();
 
   // TODO: per instance data: need to get the right bone matrix offset for each model
@@ -607,97 +599,36 @@ void VkRender2::draw(const SceneDrawInfo& info) {
             BufferCreateInfo{.size = copy_size, .usage = BufferUsage_Storage});
         curr_mat_buf = device_->get_buffer(bone_matrix_bufs_[device_->curr_frame_in_flight()]);
       }
-      device_->copy_ops.emplace_back(Device::CopyOp{
-          .dst_buffer = &bone_matrix_bufs_[device_->curr_frame_in_flight()],
-          .src_offset = get_staging_copyer().copy(global_skin_matrices_.data(), copy_size),
-          .dst_offset = 0,
-          .size = copy_size});
-      device_->copy_barriers.emplace_back(bone_matrix_bufs_[device_->curr_frame_in_flight()].handle,
-                                          0, VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                                          VK_ACCESS_2_SHADER_READ_BIT,
-                                          VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+      upload_ring_.upload(bone_matrix_bufs_[device_->curr_frame_in_flight()],
+                          global_skin_matrices_.data(), copy_size, 0,
+                          VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
     }
   }
 
+  // before the copy flush so patched draws and instance data go out with it
+  // before defrag, which can move the slots the dirty objects point at
+  flush_dirty_object_datas();
+  defrag_static_buffers();
+
   if (draw_debug_aabbs_) {
     ZoneScopedN("debug aabbs");
     for (const auto& entry : static_model_instance_pool_.get_entries()) {
-      if (!entry.live_) continue;
       for (const auto& obj_data : entry.object.object_datas) {
         draw_box(mat4{1}, AABB{obj_data.aabb_min, obj_data.aabb_max});
       }
     }
   }
 
-  if (!device_->copy_ops.empty()) {
-    immediate_submit([this](CmdEncoder& cmd) {
-      struct CopyBatch {
-        std::vector<VkBufferCopy2KHR> copies;
-        Holder<BufferHandle>* dst;
-      };
-      std::vector<CopyBatch> batches;
-      for (const auto& copy : device_->copy_ops) {
-        CopyBatch* batch{};
-        for (auto& b : batches) {
-          if (b.dst->handle == copy.dst_buffer->handle) {
-            batch = &b;
-            break;
-          }
-        }
-        if (!batch) {
-          auto& new_batch = batches.emplace_back();
-          new_batch.dst = copy.dst_buffer;
-          batch = &new_batch;
-        }
-
-        batch->copies.emplace_back(VkBufferCopy2KHR{.sType = VK_STRUCTURE_TYPE_BUFFER_COPY_2_KHR,
-                                                    .srcOffset = copy.src_offset,
-                                                    .dstOffset = copy.dst_offset,
-                                                    .size = copy.size});
-      }
-
-      for (auto& batch : batches) {
-        VkCopyBufferInfo2KHR copy_info{
-            .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_INFO_2,
-            .srcBuffer =
-                device_->get_buffer(frame_staging_buffers_[device_->curr_frame_in_flight()])
-                    ->buffer(),
-            .dstBuffer = device_->get_buffer(*batch.dst)->buffer(),
-            .regionCount = static_cast<uint32_t>(batch.copies.size()),
-            .pRegions = batch.copies.data()};
-        vkCmdCopyBuffer2KHR(cmd.cmd(), &copy_info);
-      }
-
-      std::vector<VkBufferMemoryBarrier2> buffer_barriers;
-      buffer_barriers.reserve(device_->copy_barriers.size());
-      for (auto& barrier : device_->copy_barriers) {
-        buffer_barriers.emplace_back(VkBufferMemoryBarrier2{
-            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
-            .srcStageMask = barrier.src_stage,
-            .srcAccessMask = barrier.src_access,
-            .dstStageMask = barrier.dst_stage,
-            .dstAccessMask = barrier.dst_access,
-            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-            .buffer = device_->get_buffer(barrier.buffer)->buffer(),
-            .offset = 0,
-            .size = VK_WHOLE_SIZE,
-        });
-      }
-      VkDependencyInfo info = vk2::init::dependency_info(buffer_barriers, {});
-      vkCmdPipelineBarrier2KHR(cmd.cmd(), &info);
-      // TODO: move elsewhere
-      device_->copy_ops.clear();
-      device_->copy_barriers.clear();
-    });
-  }
-
   CmdEncoder* cmd = device_->begin_command_list(QueueType::Graphics);
   state_.reset(*cmd);
   device_->bind_bindless_descriptors(*cmd);
+  // every upload queued this frame, ahead of the render graph
+  upload_ring_.record(*cmd);
+  record_object_data_scatter(*cmd);
+  frame_cmd_list_cnt_ = frame_imm_submits_.size() + 1;
 
   {
-    ZoneScopedN("free static instances");
+    PROFILE_SCOPE("free static instances");
     for (auto& instance : to_delete_static_model_instances_) {
       free(*cmd, *static_model_instance_pool_.get(instance));
       static_model_instance_pool_.destroy(instance);
@@ -719,7 +650,7 @@ void VkRender2::draw(const SceneDrawInfo& info) {
   get_device().acquire_next_image(cmd);
 
   {
-    ZoneScopedN("oit setup");
+    PROFILE_SCOPE("oit setup");
     uvec3 draw_img_dims = uvec3{vec2{device_->get_swapchain_info().dims} * vec2{render_scale_}, 1};
     // OIT
     u32 max_oit_fragments = draw_img_dims.x * draw_img_dims.y * 4;
@@ -744,6 +675,11 @@ void VkRender2::draw(const SceneDrawInfo& info) {
   }
 
   rg_.set_render_scale(render_scale_);
+  rg_.set_compile_cache_enabled(rg_compile_cache_enabled.get());
+  rg_.set_aliasing_enabled(rg_aliasing_enabled.get());
+  rg_.set_async_compute_enabled(rg_async_compute_enabled.get());
+  rg_.set_parallel_recording_enabled(rg_parallel_record_enabled.get());
+  rg_.set_split_barrier_distance(std::max(rg_split_barrier_distance.get(), 0));
   add_rendering_passes(rg_);
   auto res = rg_.bake();
   if (!res) {
@@ -760,7 +696,11 @@ void VkRender2::draw(const SceneDrawInfo& info) {
   }
   frame_imm_submits_.clear();
 
+  profiler_.end_frame();
   device_->submit_commands();
+  // submit_commands waited for the next frame's fences, so its staging memory is free again and
+  // uploads queued before the next draw go to it
+  upload_ring_.begin_frame(device_->curr_frame_in_flight());
   line_draw_vertices_.clear();
 }
 
@@ -782,6 +722,83 @@ void VkRender2::on_imgui() {
         ImGui::Text("Textures: %u", draw_stats_.textures);
         ImGui::TreePop();
       }
+      if (ImGui::TreeNode("allocators")) {
+        auto allocator_stats = [](const char* name, const util::TLSFAllocator& allocator) {
+          const auto stats = allocator.get_stats();
+          ImGui::Text("%s: %u/%u KB, %u allocs, %u free blocks, largest %u KB, frag %.2f", name,
+                      stats.used_bytes / 1024, stats.capacity / 1024, stats.num_active_allocs,
+                      stats.free_block_cnt, stats.largest_free_block / 1024,
+                      stats.fragmentation());
+        };
+        allocator_stats("instance data", static_instance_data_buf_.allocator);
+        allocator_stats("object data", static_object_data_buf_.allocator);
+        allocator_stats("skin commands", skin_instance_datas_.allocator);
+        allocator_stats("skin matrices", global_skin_mat_allocator_);
+        allocator_stats("animated vertex output", animated_vertex_output_bufs_.allocator);
+        ImGui::Text("defrag: %u moves, %lu KB moved", defrag_stats_.moves,
+                    (size_t)defrag_stats_.bytes_moved / 1024);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("uploads")) {
+        const auto& stats = upload_ring_.get_stats();
+        ImGui::Text("graphics cmd lists: %u", frame_cmd_list_cnt_);
+        ImGui::Text("copies: %u, merged regions: %u, copy cmds: %u", stats.copies, stats.regions,
+                    stats.copy_cmds);
+        ImGui::Text("barrier cmds: %u, buffer barriers: %u", stats.barrier_cmds,
+                    stats.buffer_barriers);
+        ImGui::Text("staging: %lu KB, overflow copies: %u", (size_t)stats.staging_bytes / 1024,
+                    stats.overflow_copies);
+        const auto& objects = object_data_upload_stats_;
+        ImGui::Text("dirty objects: %u, copy regions: %u, path: %s", objects.dirty,
+                    objects.regions, objects.scatter ? "scatter" : "copy");
+        ImGui::Text("object staging: %lu KB", (size_t)objects.staging_bytes / 1024);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("render graph")) {
+        const auto& stats = rg_.get_bake_stats();
+        ImGui::Text("bake: %.3f ms (%s), setup attachments: %.3f ms", stats.bake_ms,
+                    stats.cache_hit ? "cached" : "compiled", stats.setup_attachments_ms);
+        ImGui::Text("cache hits: %lu, misses: %lu", (size_t)stats.cache_hits,
+                    (size_t)stats.cache_misses);
+        ImGui::Text("async compute passes: %u, queue waits: %u", stats.async_compute_passes,
+                    stats.queue_waits);
+        if (ImGui::Button("print pass order")) {
+          rg_.print_pass_order();
+        }
+        const auto& barriers = rg_.get_barrier_stats();
+        ImGui::Text("barriers: %u full, %u split over %u events", barriers.full_barriers,
+                    barriers.split_barriers, barriers.events);
+        ImGui::Text("record: %.3f ms", rg_.get_record_ms());
+        const auto pass_order = rg_.get_pass_order();
+        const auto pass_record_ms = rg_.get_pass_record_ms();
+        // last frame's timings, skipped on the frame the pass order changes
+        if (pass_record_ms.size() == pass_order.size() && ImGui::TreeNode("pass record ms")) {
+          for (size_t pos = 0; pos < pass_order.size(); pos++) {
+            ImGui::Text("%s: %.3f", rg_.get_pass(pass_order[pos]).get_name().c_str(),
+                        pass_record_ms[pos]);
+          }
+          ImGui::TreePop();
+        }
+        const auto& transient = rg_.get_transient_memory_stats();
+        constexpr double mb = 1024.0 * 1024.0;
+        ImGui::Text("transient images: %u, heaps: %u", transient.images, transient.heaps);
+        ImGui::Text("transient MB: %.1f aliased, %.1f unaliased, %.1f peak live",
+                    transient.aliased_bytes / mb, transient.unaliased_bytes / mb,
+                    transient.peak_live_bytes / mb);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("frame profiler")) {
+        if (ImGui::Button("dump chrome trace")) {
+          profiler_.dump_chrome_trace("frame_trace.json");
+        }
+        if (const auto* frame = profiler_.get_last_resolved_frame()) {
+          ImGui::Text("frame %u gpu ms", frame->frame_num);
+          for (const auto& scope : frame->gpu_scopes) {
+            ImGui::Text("%s: %.3f", scope.name.c_str(), (scope.end_ns - scope.begin_ns) / 1e6);
+          }
+        }
+        ImGui::TreePop();
+      }
       ImGui::TreePop();
     }
 
@@ -955,7 +972,7 @@ ImageHandle VkRender2::load_hdr_img(const std::filesystem::path& path, bool flip
       .regionCount = 1,
       .pRegions = &img_copy_info};
   vkCmdCopyBufferToImage2KHR(copy_cmd.transfer_cmd_buf, &copy_to_img_info);
-  device_->graphics_copy_allocator_.submit(copy_cmd);
+  device_->wait_for_copy(device_->graphics_copy_allocator_.submit(copy_cmd));
 
   std::swap(barrier.srcStageMask, barrier.dstStageMask);
   barrier.oldLayout = img->curr_layout;
@@ -1107,7 +1124,7 @@ void VkRender2::add_rendering_passes(RenderGraph& rg) {
   if (draw_stats_.animated_vertices > 0) {
     assert(global_skin_matrices_.size());
     assert(device_->get_buffer(bone_matrix_bufs_[device_->curr_frame_in_flight()]));
-    auto& skinning = rg.add_pass("skinning");
+    auto& skinning = rg.add_pass("skinning", RenderGraphPass::Type::Compute);
     skinning.add(animated_vertex_output_bufs_.buffers[device_->curr_frame_in_flight()].handle,
                  Access::ComputeWrite);
     skinning.set_execute_fn([this](CmdEncoder& cmd) {
@@ -1166,7 +1183,7 @@ void VkRender2::add_rendering_passes(RenderGraph& rg) {
   }
 
   {
-    auto& cull = rg.add_pass("cull");
+    auto& cull = rg.add_pass("cull", RenderGraphPass::Type::Compute);
     for (int animated = 0; animated < 2; animated++) {
       for (int i = 0; i < MeshPass_Count; i++) {
         auto& mgr = get_mgr((MeshPass)i, animated);
@@ -1329,7 +1346,7 @@ void VkRender2::add_rendering_passes(RenderGraph& rg) {
         });
     const char* ssao_final_output_name = "ssao_out";
     if (ssao_enabled_) {
-      auto& pass = rg.add_pass("ssao");
+      auto& pass = rg.add_pass("ssao", RenderGraphPass::Type::Compute);
       auto rg_depth_handle = pass.add_image_access("depth", Access::ComputeSample);
       auto rg_out_img_handle =
           pass.add(ssao_final_output_name, {.format = ssao_format_}, Access::ComputeWrite);
@@ -1368,7 +1385,7 @@ void VkRender2::add_rendering_passes(RenderGraph& rg) {
           });
     }
     if (ssao_enabled_ && ssao_blur_enabled_) {
-      auto& pass = rg.add_pass("ssao_blur");
+      auto& pass = rg.add_pass("ssao_blur", RenderGraphPass::Type::Compute);
       auto rg_ssao_handle = pass.add_image_access(ssao_final_output_name, Access::ComputeRead);
       ssao_final_output_name = "ssao_final_out";
       auto rg_ssao_blurred_handle =
@@ -1578,9 +1595,9 @@ void VkRender2::add_rendering_passes(RenderGraph& rg) {
     }
 
     {
-      auto& oit_pass = rg.add_pass("oit");
-      auto draw_img_handle = oit_pass.add("draw_out", {.format = draw_img_format_},
-                                          (Access)(Access::ColorRead | Access::ComputeRead));
+      auto& oit_pass = rg.add_pass("oit", RenderGraphPass::Type::Compute);
+      auto draw_img_handle =
+          oit_pass.add("draw_out", {.format = draw_img_format_}, Access::ComputeRead);
       auto oit_out_handle = oit_pass.add(post_process_input_img_name, {.format = draw_img_format_},
                                          Access::ComputeWrite);
       oit_pass.add(oit_heads_tex_.handle, Access::ComputeRead);
@@ -1798,18 +1815,32 @@ void VkRender2::StaticMeshDrawManager::remove_draws(StateTracker&, CmdEncoder& c
   free_alloc_indices_.emplace_back(handle);
 }
 
-u32 VkRender2::StaticMeshDrawManager::add_draws(StateTracker&, size_t size, size_t staging_offset) {
+u32 VkRender2::StaticMeshDrawManager::add_draws(StateTracker& state,
+                                                std::span<const GPUDrawInfo> draws,
+                                                size_t staging_offset) {
+  u32 handle;
+  add_draws(state, draws, staging_offset, std::span{&handle, 1});
+  return handle;
+}
+
+void VkRender2::StaticMeshDrawManager::add_draws(StateTracker&, std::span<const GPUDrawInfo> draws,
+                                                 size_t staging_offset,
+                                                 std::span<u32> out_handles) {
   ZoneScoped;
-  assert(size > 0);
+  assert(!draws.empty() && !out_handles.empty());
+  const size_t size = draws.size_bytes();
   Alloc a{};
-  a.draw_cmd_slot = draw_cmds_buf_.allocator.allocate(size);
+  a.draw_cmd_slot = VkRender2::get().allocate_in(draw_cmds_buf_, size, "draw cmds buf");
   u32 num_draws = (size / sizeof(GPUDrawInfo));
   num_draw_cmds_ += num_draws;
+  const u32 first_draw = a.draw_cmd_slot.get_offset() / sizeof(GPUDrawInfo);
+  if (cpu_draws_.size() < first_draw + num_draws) {
+    cpu_draws_.resize(first_draw + num_draws);
+  }
+  std::ranges::copy(draws, cpu_draws_.begin() + first_draw);
 
-  // resize draw cmd bufs
-  size_t curr_tot_draw_cmd_buf_size = device_->get_buffer(draw_cmds_buf_.buffer)->size();
-  size_t required_size = a.draw_cmd_slot.get_off_plus_size();
-  size_t new_size = required_size * 2;
+  // resize output draw cmd bufs to match the draw cmd buf
+  const size_t new_size = device_->get_buffer(draw_cmds_buf_.buffer)->size();
   for (auto& draw_pass : draw_passes_) {
     // resize output draw cmd buffers
     for (auto& handle : draw_pass.out_draw_cmds_bufs) {
@@ -1824,40 +1855,38 @@ u32 VkRender2::StaticMeshDrawManager::add_draws(StateTracker&, size_t size, size
     }
   }
 
-  if (a.draw_cmd_slot.get_offset() + a.draw_cmd_slot.get_size() >= curr_tot_draw_cmd_buf_size) {
-    // draw cmd buf resize and copy
-    auto new_buf = device_->create_buffer_holder(BufferCreateInfo{
-        .size = new_size,
-        .usage = BufferUsage_Storage,
-    });
-    VkRender2::get().immediate_submit(
-        [this, &new_buf, &curr_tot_draw_cmd_buf_size](CmdEncoder& cmd) {
-          cmd.copy_buffer(*device_->get_buffer(draw_cmds_buf_.buffer),
-                          *device_->get_buffer(new_buf), 0, 0, curr_tot_draw_cmd_buf_size);
-        });
-    draw_cmds_buf_.buffer = std::move(new_buf);
-  }
+  VkRender2::get().upload_ring_.add_copy(draw_cmds_buf_.buffer, staging_offset,
+                                         a.draw_cmd_slot.get_offset(), size);
 
-  if (a.draw_cmd_slot.get_offset() >= device_->get_buffer(draw_cmds_buf_.buffer)->size()) {
-    LINFO("unimplemented: need to resize Static mesh draw cmd buffer");
-    exit(1);
+  // one alloc per instance so each can be removed on its own
+  std::vector<util::TLSFAllocator::Slot> slots(out_handles.size());
+  draw_cmds_buf_.allocator.split(a.draw_cmd_slot, slots);
+  for (size_t i = 0; i < out_handles.size(); i++) {
+    if (free_alloc_indices_.size()) {
+      out_handles[i] = free_alloc_indices_.back();
+      free_alloc_indices_.pop_back();
+      allocs_[out_handles[i]] = Alloc{slots[i]};
+    } else {
+      out_handles[i] = allocs_.size();
+      allocs_.emplace_back(Alloc{slots[i]});
+    }
   }
-  device_->copy_ops.emplace_back(Device::CopyOp{
-      .dst_buffer = &draw_cmds_buf_.buffer,
-      .src_offset = staging_offset,
-      .dst_offset = a.draw_cmd_slot.get_offset(),
-      .size = size,
-  });
-  if (free_alloc_indices_.size()) {
-    auto h = free_alloc_indices_.back();
-    free_alloc_indices_.pop_back();
-    allocs_[h] = a;
-    return h;
+}
+
+std::span<VkRender2::GPUDrawInfo> VkRender2::StaticMeshDrawManager::get_draws(u32 handle) {
+  if (handle == null_handle) {
+    return {};
   }
+  const auto& slot = allocs_[handle].draw_cmd_slot;
+  return std::span{cpu_draws_}.subspan(slot.get_offset() / sizeof(GPUDrawInfo),
+                                       slot.get_size() / sizeof(GPUDrawInfo));
+}
 
-  auto h = allocs_.size();
-  allocs_.emplace_back(a);
-  return h;
+void VkRender2::StaticMeshDrawManager::upload_draws(u32 handle) {
+  const auto draws = get_draws(handle);
+  if (draws.empty()) return;
+  VkRender2::get().upload_ring_.upload(draw_cmds_buf_.buffer, draws.data(), draws.size_bytes(),
+                                       allocs_[handle].draw_cmd_slot.get_offset());
 }
 
 Buffer* VkRender2::StaticMeshDrawManager::get_draw_info_buf() const {
@@ -2032,6 +2061,9 @@ void VkRender2::free(CmdEncoder& cmd, StaticModelInstanceResources& instance) {
 }
 
 uvec2 VkRender2::window_dims() const {
+  if (!window_) {
+    return uvec2{device_->get_swapchain_info().dims};
+  }
   int x, y;
   glfwGetWindowSize(window_, &x, &y);
   return {x, y};
@@ -2072,136 +2104,151 @@ VkRender2::PerFrameData& VkRender2::curr_frame() {
 
 Buffer* FreeListBuffer::get_buffer() const { return get_device().get_buffer(buffer); }
 
-bool VkRender2::load_model2(const std::filesystem::path& path, LoadedModelData& result) {
+bool VkRender2::stage_model(const std::filesystem::path& path, StagedModel& result) {
+  ZoneScoped;
   auto load_result = gfx::load_gltf(path, gfx::DefaultMaterialData{});
-  if (load_result.has_value()) {
-    auto& res = *load_result;
-    result.animations = std::move(res.animations);
-    u64 material_data_size = res.materials.size() * sizeof(gfx::Material);
-    u64 vertices_size = res.vertices.size() * sizeof(gfx::Vertex);
-    u64 indices_size = res.indices.size() * sizeof(u32);
-    u64 animated_vertices_size = res.animated_vertices.size() * sizeof(gfx::AnimatedVertex);
-    util::FreeListAllocator::Slot animated_vertices_gpu_slot{};
-    if (animated_vertices_size) {
-      animated_vertices_gpu_slot = animated_vertex_buf_.allocator.allocate(animated_vertices_size);
-    }
-    // TODO: resizing here
-    auto vertices_gpu_slot = static_vertex_buf_.allocator.allocate(vertices_size);
-    auto indices_gpu_slot = static_index_buf_.allocator.allocate(indices_size);
-
-    size_t copy_buf_capacity =
-        material_data_size + vertices_size + animated_vertices_size + indices_size;
-    auto copy_cmd = device_->graphics_copy_allocator_.allocate(copy_buf_capacity);
-    auto staging = LinearCopyer{device_->get_buffer(copy_cmd.staging_buffer)->mapped_data(),
-                                copy_buf_capacity};
-    u64 material_data_staging_offset = staging.copy(res.materials.data(), material_data_size);
-    u64 vertices_staging_offset = staging.copy(res.vertices.data(), vertices_size);
-    // for (size_t i = 0; i < res.vertices.size(); i += 100) {
-    //   auto& v = res.vertices[i].pos;
-    //   LINFO("{} {} {}", v.x, v.y, v.z);
-    // }
-    u64 animated_vertices_staging_offset{};
+  if (!load_result.has_value()) {
+    return false;
+  }
+  auto& res = result.scene = std::move(*load_result);
+  u64 material_data_size = res.materials.size() * sizeof(gfx::Material);
+  u64 vertices_size = res.vertices.size() * sizeof(gfx::Vertex);
+  u64 indices_size = res.indices.size() * sizeof(u32);
+  u64 animated_vertices_size = res.animated_vertices.size() * sizeof(gfx::AnimatedVertex);
+  size_t copy_buf_capacity =
+      material_data_size + vertices_size + animated_vertices_size + indices_size;
+  // the copy cmd has its own pool, so it can be recorded on the main thread in upload_model
+  result.copy_cmd = device_->graphics_copy_allocator_.allocate(copy_buf_capacity);
+  auto staging = LinearCopyer{device_->get_buffer(result.copy_cmd.staging_buffer)->mapped_data(),
+                              copy_buf_capacity};
+  result.materials_staging_offset = staging.copy(res.materials.data(), material_data_size);
+  result.vertices_staging_offset = staging.copy(res.vertices.data(), vertices_size);
+  if (animated_vertices_size) {
+    result.animated_vertices_staging_offset =
+        staging.copy(res.animated_vertices.data(), animated_vertices_size);
+  }
+  result.indices_staging_offset = staging.copy(res.indices.data(), indices_size);
+  return true;
+}
+
+void VkRender2::upload_model(StagedModel& staged, LoadedModelData& result) {
+  ZoneScoped;
+  auto& res = staged.scene;
+  auto& copy_cmd = staged.copy_cmd;
+  result.animations = std::move(res.animations);
+  u64 material_data_size = res.materials.size() * sizeof(gfx::Material);
+  u64 vertices_size = res.vertices.size() * sizeof(gfx::Vertex);
+  u64 indices_size = res.indices.size() * sizeof(u32);
+  u64 animated_vertices_size = res.animated_vertices.size() * sizeof(gfx::AnimatedVertex);
+  util::FreeListAllocator::Slot animated_vertices_gpu_slot{};
+  if (animated_vertices_size) {
+    animated_vertices_gpu_slot = animated_vertex_buf_.allocator.allocate(animated_vertices_size);
+  }
+  // the buffers grow below if these land past the end
+  auto vertices_gpu_slot = static_vertex_buf_.allocator.allocate(vertices_size);
+  auto indices_gpu_slot = static_index_buf_.allocator.allocate(indices_size);
+
+  draw_stats_.vertices += res.vertices.size();
+  draw_stats_.indices += res.indices.size();
+  draw_stats_.textures += res.textures.size();
+  draw_stats_.materials += res.materials.size();
+  auto materials_gpu_slot = static_materials_buf_.allocator.allocate(material_data_size);
+  {
+    state_.reset(copy_cmd.transfer_cmd_buf);
+    state_
+        .buffer_barrier(static_vertex_buf_.get_buffer()->buffer(),
+                        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT)
+        .buffer_barrier(static_index_buf_.get_buffer()->buffer(), VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                        VK_ACCESS_2_TRANSFER_WRITE_BIT)
+        .buffer_barrier(static_materials_buf_.get_buffer()->buffer(),
+                        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
     if (animated_vertices_size) {
-      animated_vertices_staging_offset =
-          staging.copy(res.animated_vertices.data(), animated_vertices_size);
+      state_.buffer_barrier(animated_vertex_buf_.get_buffer()->buffer(),
+                            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
     }
-    u64 indices_staging_offset = staging.copy(res.indices.data(), indices_size);
+    state_.flush_barriers();
 
-    draw_stats_.vertices += res.vertices.size();
-    draw_stats_.indices += res.indices.size();
-    draw_stats_.textures += res.textures.size();
-    draw_stats_.materials += res.materials.size();
-    auto materials_gpu_slot = static_materials_buf_.allocator.allocate(material_data_size);
-    {
-      state_.reset(copy_cmd.transfer_cmd_buf);
-      state_
-          .buffer_barrier(static_vertex_buf_.get_buffer()->buffer(),
-                          VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT)
-          .buffer_barrier(static_index_buf_.get_buffer()->buffer(),
-                          VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT)
-          .buffer_barrier(static_materials_buf_.get_buffer()->buffer(),
-                          VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
-      if (animated_vertices_size) {
-        state_.buffer_barrier(animated_vertex_buf_.get_buffer()->buffer(),
-                              VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
-      }
-      state_.flush_barriers();
-
-      if (animated_vertices_size) {
-        auto old_size = animated_vertex_buf_.get_buffer()->size();
-        size_t required_size = animated_vertices_gpu_slot.get_off_plus_size();
-        if (required_size >= old_size) {
-          auto new_size = required_size * 2;
-          auto new_buf = device_->create_buffer_holder(
-              BufferCreateInfo{.size = new_size, .usage = BufferUsage_Storage});
-          copy_cmd.copy_buffer(device_, *animated_vertex_buf_.get_buffer(),
-                               *device_->get_buffer(new_buf), 0, 0, old_size);
-          VkBufferMemoryBarrier2KHR barrier{};
-          barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
-          barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-          barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-          barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-          barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-          barrier.buffer = device_->get_buffer(new_buf)->buffer();
-          barrier.size = VK_WHOLE_SIZE;
-          auto dependency_info = init::dependency_info(SPAN1(barrier), {});
-          vkCmdPipelineBarrier2KHR(copy_cmd.transfer_cmd_buf, &dependency_info);
-
-          animated_vertex_buf_.buffer = std::move(new_buf);
-        }
+    // Grows buf to twice the required size, keeping its contents. This runs before
+    // defrag_static_buffers in the frame and earlier frames' upload ring copies are already
+    // submitted, so no queued defrag copy still refers to the buffer replaced here.
+    auto ensure_size = [&, this](FreeListBuffer& buf, size_t required_size,
+                                 BufferUsageFlags usage, const char* debug_name) {
+      auto old_size = buf.get_buffer()->size();
+      if (required_size < old_size) return;
+      auto new_buf = device_->create_buffer_holder(BufferCreateInfo{
+          .size = required_size * 2, .usage = usage, .debug_name = debug_name});
+      copy_cmd.copy_buffer(device_, *buf.get_buffer(), *device_->get_buffer(new_buf), 0, 0,
+                           old_size);
+      VkBufferMemoryBarrier2KHR barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+      barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+      barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+      barrier.buffer = device_->get_buffer(new_buf)->buffer();
+      barrier.size = VK_WHOLE_SIZE;
+      auto dependency_info = init::dependency_info(SPAN1(barrier), {});
+      vkCmdPipelineBarrier2KHR(copy_cmd.transfer_cmd_buf, &dependency_info);
+      buf.buffer = std::move(new_buf);
+    };
+    ensure_size(static_vertex_buf_, vertices_gpu_slot.get_off_plus_size(), BufferUsage_Storage,
+                "static vertex buf");
+    ensure_size(static_index_buf_, indices_gpu_slot.get_off_plus_size(), BufferUsage_Index,
+                "static index buf");
 
-        copy_cmd.copy_buffer(device_, *device_->get_buffer(animated_vertex_buf_.buffer),
-                             animated_vertices_staging_offset,
-                             animated_vertices_gpu_slot.get_offset(), animated_vertices_size);
-      }
-      copy_cmd.copy_buffer(device_, *device_->get_buffer(static_materials_buf_.buffer),
-                           material_data_staging_offset, materials_gpu_slot.get_offset(),
-                           material_data_size);
-      copy_cmd.copy_buffer(device_, *static_vertex_buf_.get_buffer(), vertices_staging_offset,
-                           vertices_gpu_slot.get_offset(), vertices_size);
-      copy_cmd.copy_buffer(device_, *static_index_buf_.get_buffer(), indices_staging_offset,
-                           indices_gpu_slot.get_offset(), indices_size);
-
-      state_
-          .buffer_barrier(
-              static_vertex_buf_.get_buffer()->buffer(),
-              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT,
-              VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT)
-          .buffer_barrier(static_index_buf_.get_buffer()->buffer(),
-                          VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT)
-          .buffer_barrier(static_materials_buf_.get_buffer()->buffer(),
-                          VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
-      if (animated_vertices_size) {
-        state_.buffer_barrier(
-            animated_vertex_buf_.get_buffer()->buffer(),
+    if (animated_vertices_size) {
+      ensure_size(animated_vertex_buf_, animated_vertices_gpu_slot.get_off_plus_size(),
+                  BufferUsage_Storage, "animated vertex buf");
+      copy_cmd.copy_buffer(device_, *device_->get_buffer(animated_vertex_buf_.buffer),
+                           staged.animated_vertices_staging_offset,
+                           animated_vertices_gpu_slot.get_offset(), animated_vertices_size);
+    }
+    copy_cmd.copy_buffer(device_, *device_->get_buffer(static_materials_buf_.buffer),
+                         staged.materials_staging_offset, materials_gpu_slot.get_offset(),
+                         material_data_size);
+    copy_cmd.copy_buffer(device_, *static_vertex_buf_.get_buffer(), staged.vertices_staging_offset,
+                         vertices_gpu_slot.get_offset(), vertices_size);
+    copy_cmd.copy_buffer(device_, *static_index_buf_.get_buffer(), staged.indices_staging_offset,
+                         indices_gpu_slot.get_offset(), indices_size);
+
+    state_
+        .buffer_barrier(
+            static_vertex_buf_.get_buffer()->buffer(),
             VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT,
-            VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT);
-      }
-      state_.flush_barriers();
-
-      device_->graphics_copy_allocator_.submit(copy_cmd);
-    }
-
-    result.scene_graph_data = std::move(load_result.value().scene_graph_data);
-    // result.materials = std::move(load_result.value().materials);
-    result.gpu_resource_handle = model_gpu_resources_pool_.alloc();
-    auto* resources = model_gpu_resources_pool_.get(result.gpu_resource_handle);
-    resources->animated_vertices_gpu_slot = animated_vertices_gpu_slot;
-    resources->textures = std::move(res.textures);
-    resources->mesh_draw_infos = std::move(res.mesh_draw_infos);
-    resources->materials_slot = materials_gpu_slot;
-    resources->vertices_slot = vertices_gpu_slot;
-    resources->indices_slot = indices_gpu_slot;
-    resources->materials = std::move(res.materials);
-    resources->num_vertices = res.vertices.size();
-    resources->num_indices = res.indices.size();
-    resources->name = path;
-    resources->first_vertex = vertices_gpu_slot.get_offset() / sizeof(gfx::Vertex);
-    resources->first_index = indices_gpu_slot.get_offset() / sizeof(u32);
-    resources->ref_count = 0;
-    return true;
-  }
-  return false;
+            VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT)
+        .buffer_barrier(static_index_buf_.get_buffer()->buffer(),
+                        VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT)
+        .buffer_barrier(static_materials_buf_.get_buffer()->buffer(),
+                        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+    if (animated_vertices_size) {
+      state_.buffer_barrier(
+          animated_vertex_buf_.get_buffer()->buffer(),
+          VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT,
+          VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT);
+    }
+    state_.flush_barriers();
+
+    // the model is published this frame, so the frame waits for its geometry and textures
+    device_->wait_for_copy(device_->graphics_copy_allocator_.submit(copy_cmd));
+    device_->wait_for_copy(res.textures_ticket);
+  }
+
+  result.scene_graph_data = std::move(res.scene_graph_data);
+  result.gpu_resource_handle = model_gpu_resources_pool_.alloc();
+  auto* resources = model_gpu_resources_pool_.get(result.gpu_resource_handle);
+  resources->animated_vertices_gpu_slot = animated_vertices_gpu_slot;
+  resources->textures = std::move(res.textures);
+  resources->mesh_draw_infos = std::move(res.mesh_draw_infos);
+  resources->materials_slot = materials_gpu_slot;
+  resources->vertices_slot = vertices_gpu_slot;
+  resources->indices_slot = indices_gpu_slot;
+  resources->materials = std::move(res.materials);
+  resources->num_vertices = res.vertices.size();
+  resources->num_indices = res.indices.size();
+  resources->name = result.path;
+  resources->first_vertex = vertices_gpu_slot.get_offset() / sizeof(gfx::Vertex);
+  resources->first_index = indices_gpu_slot.get_offset() / sizeof(u32);
+  resources->ref_count = 0;
 }
 
 // TODO: thread safe
@@ -2222,14 +2269,15 @@ StaticModelInstanceResourcesHandle VkRender2::add_instance(ModelHandle model_han
   u32 pass_obj_counts[MeshPass_Count] = {};
 
   const auto& scene = model.scene_graph_data;
+  const auto& shared = *scene.shared;
 
-  assert(scene.hierarchies.size() == scene.node_mesh_indices.size());
+  assert(shared.hierarchies.size() == shared.node_mesh_indices.size());
   {
     ZoneScopedN("mesh_pass calcs");
-    for (size_t node_i = 0; node_i < scene.hierarchies.size(); node_i++) {
-      auto mesh_data_i = scene.node_mesh_indices[node_i];
+    for (size_t node_i = 0; node_i < shared.hierarchies.size(); node_i++) {
+      auto mesh_data_i = shared.node_mesh_indices[node_i];
       if (mesh_data_i == -1) continue;
-      const auto& mesh_indices = scene.mesh_datas[mesh_data_i];
+      const auto& mesh_indices = shared.mesh_datas[mesh_data_i];
       bool double_sided = resources->materials[mesh_indices.material_id].is_double_sided();
       MeshPass pass{MeshPass_Count};
       if (mesh_indices.pass_flags & PassFlags_Opaque) {
@@ -2256,17 +2304,17 @@ StaticModelInstanceResourcesHandle VkRender2::add_instance(ModelHandle model_han
   instance_resources->object_datas.reserve(num_objs_tot);
   instance_resources->instance_datas.reserve(num_objs_tot);
 
-  if (model.scene_graph_data.skins.size()) {
+  if (shared.skins.size()) {
     instance_resources->is_animated = true;
   }
   FreeListBuffer2& instance_data_buf = static_instance_data_buf_;
   FreeListBuffer2& object_data_buf = static_object_data_buf_;
 
   std::array<std::vector<GPUDrawInfo>, MeshPass_Count> pass_cmds;
-  instance_resources->instance_data_slot =
-      instance_data_buf.allocator.allocate(num_objs_tot * sizeof(GPUInstanceData));
+  instance_resources->instance_data_slot = allocate_in(
+      instance_data_buf, num_objs_tot * sizeof(GPUInstanceData), "static instance data buf");
   instance_resources->object_data_slot =
-      object_data_buf.allocator.allocate(num_objs_tot * sizeof(ObjectData));
+      allocate_in(object_data_buf, num_objs_tot * sizeof(ObjectData), "static object data buf");
   u32 base_instance_id =
       instance_resources->instance_data_slot.get_offset() / sizeof(GPUInstanceData);
   u32 base_object_data_id = instance_resources->object_data_slot.get_offset() / sizeof(ObjectData);
@@ -2276,32 +2324,32 @@ StaticModelInstanceResourcesHandle VkRender2::add_instance(ModelHandle model_han
   std::vector<SkinCommand> skin_cmds;
   if (instance_resources->is_animated) {
     ZoneScopedN("animation calcs");
-    instance_resources->animated_vertex_buf_slot =
-        animated_vertex_output_bufs_.allocator.allocate(resources->num_vertices * sizeof(Vertex));
+    // the output is rewritten by skinning every frame, so growing doesn't copy the old contents
+    instance_resources->animated_vertex_buf_slot = animated_vertex_output_bufs_.allocator.allocate(
+        resources->num_vertices * sizeof(Vertex), [this](u32 required_size) {
+          const size_t new_size = static_cast<size_t>(required_size) * 2;
+          for (auto& buffer : animated_vertex_output_bufs_.buffers) {
+            buffer = device_->create_buffer_holder(
+                BufferCreateInfo{.size = new_size,
+                                 .usage = BufferUsage_Storage,
+                                 .debug_name = "animated vertex output buf"});
+          }
+          return new_size;
+        });
 
     draw_stats_.animated_vertices += resources->num_vertices;
-    // resize animated vertex output bufs if needed
-    size_t old_size = device_->get_buffer(animated_vertex_output_bufs_.buffers[0])->size();
-    size_t required_size = instance_resources->animated_vertex_buf_slot.get_off_plus_size();
-    if (required_size >= old_size) {
-      size_t new_size = required_size * 2;
-      for (auto& buffer : animated_vertex_output_bufs_.buffers) {
-        buffer = device_->create_buffer_holder(
-            BufferCreateInfo{.size = new_size,
-                             .usage = BufferUsage_Storage,
-                             .debug_name = "animated vertex output buf"});
-      }
-    }
     first_vertex = instance_resources->animated_vertex_buf_slot.get_offset() / sizeof(Vertex);
 
     // update global bone matrices
     u32 num_new_skin_mats{};
-    for (const auto& skin : model.scene_graph_data.skins) {
+    for (const auto& skin : shared.skins) {
       num_new_skin_mats += skin.inverse_bind_matrices.size();
     }
     if (num_new_skin_mats > 0) {
-      instance_resources->global_bone_mat_slot =
-          global_skin_mat_allocator_.allocate(sizeof(mat4) * num_new_skin_mats);
+      // global_skin_matrices_ is resized to cover the slot below
+      instance_resources->global_bone_mat_slot = global_skin_mat_allocator_.allocate(
+          sizeof(mat4) * num_new_skin_mats,
+          [](u32 required_size) { return static_cast<u64>(required_size) * 2; });
       auto num_required_elements =
           instance_resources->global_bone_mat_slot.get_off_plus_size() / sizeof(mat4);
       if (global_skin_matrices_.size() < num_required_elements) {
@@ -2321,8 +2369,8 @@ StaticModelInstanceResourcesHandle VkRender2::add_instance(ModelHandle model_han
             .bone_mat_start_i = bone_mat_i,
         });
       }
-      instance_resources->skin_commands_slot =
-          skin_instance_datas_.allocator.allocate(skin_cmds.size() * sizeof(SkinCommand));
+      instance_resources->skin_commands_slot = allocate_in(
+          skin_instance_datas_, skin_cmds.size() * sizeof(SkinCommand), "skin instance data buf");
     }
   } else {
     first_vertex = resources->first_vertex;
@@ -2333,17 +2381,17 @@ StaticModelInstanceResourcesHandle VkRender2::add_instance(ModelHandle model_han
     vec3 scene_min = vec3{std::numeric_limits<float>::max()};
     vec3 scene_max = vec3{std::numeric_limits<float>::lowest()};
     bool is_animated = instance_resources->is_animated;
-    for (size_t node_i = 0; node_i < scene.hierarchies.size(); node_i++) {
+    for (size_t node_i = 0; node_i < shared.hierarchies.size(); node_i++) {
       // TODO: model wide?
       instance_resources->node_to_instance_and_obj.emplace_back(-1);
-      auto mesh_data_i = scene.node_mesh_indices[node_i];
+      auto mesh_data_i = shared.node_mesh_indices[node_i];
       if (mesh_data_i == -1) continue;
-      const auto& node_mesh_data = scene.mesh_datas[mesh_data_i];
+      const auto& node_mesh_data = shared.mesh_datas[mesh_data_i];
       // auto& node_mesh_data
       auto& mesh = resources->mesh_draw_infos[node_mesh_data.mesh_idx];
       // TODO: get rid
-      const mat4 model = scene.global_transforms[node_i];
-      AABB world_space_aabb = transform_aabb(model, mesh.aabb);
+      const mat4 model = scene.global_transforms[node_i].to_mat4();
+      AABB world_space_aabb = transform_aabb(scene.global_transforms[node_i], mesh.aabb);
       scene_min = glm::min(scene_min, world_space_aabb.min);
       scene_max = glm::max(scene_max, world_space_aabb.max);
       u32 instance_id = base_instance_id + instance_resources->instance_datas.size();
@@ -2402,32 +2450,22 @@ StaticModelInstanceResourcesHandle VkRender2::add_instance(ModelHandle model_han
     auto& cmds = pass_cmds[i];
     if (cmds.size()) {
       cmds_staging_offsets[i] =
-          get_staging_copyer().copy(cmds.data(), cmds.size() * sizeof(GPUDrawInfo));
+          upload_ring_.copy(cmds.data(), cmds.size() * sizeof(GPUDrawInfo));
     }
   }
 
   u64 obj_datas_size = instance_resources->object_datas.size() * sizeof(gfx::ObjectData);
   u64 instance_datas_size = instance_resources->instance_datas.size() * sizeof(GPUInstanceData);
   u64 obj_datas_staging_offset =
-      get_staging_copyer().copy(instance_resources->object_datas.data(), obj_datas_size);
+      upload_ring_.copy(instance_resources->object_datas.data(), obj_datas_size);
   u64 instance_datas_staging_offset =
-      get_staging_copyer().copy(instance_resources->instance_datas.data(), instance_datas_size);
+      upload_ring_.copy(instance_resources->instance_datas.data(), instance_datas_size);
   u64 skin_instance_datas_staging_offset{};
 
   u64 skin_cmd_copy_size = skin_cmds.size() * sizeof(SkinCommand);
   if (skin_cmds.size()) {
     skin_instance_datas_staging_offset =
-        get_staging_copyer().copy(skin_cmds.data(), skin_cmd_copy_size);
-  }
-
-  size_t required_size = instance_resources->instance_data_slot.get_off_plus_size();
-  if (required_size >= instance_data_buf.get_buffer()->size()) {
-    auto new_size = 2 * required_size;
-    auto new_buf = device_->create_buffer_holder(BufferCreateInfo{
-        .size = new_size, .usage = BufferUsage_Storage, .debug_name = "instance data buf"});
-    LINFO("resize needed lol");
-    instance_data_buf.buffer = std::move(new_buf);
-    exit(1);
+        upload_ring_.copy(skin_cmds.data(), skin_cmd_copy_size);
   }
 
   {
@@ -2438,59 +2476,19 @@ StaticModelInstanceResourcesHandle VkRender2::add_instance(ModelHandle model_han
       if (cmds.size()) {
         auto& mgr = get_mgr((MeshPass)i, instance_resources->is_animated);
         instance_resources->mesh_pass_draw_handles[i] =
-            mgr.add_draws(state_, cmds.size() * sizeof(GPUDrawInfo), cmds_staging_offsets[i]);
+            mgr.add_draws(state_, cmds, cmds_staging_offsets[i]);
       }
     }
-    device_->copy_ops.emplace_back(
-        Device::CopyOp{.dst_buffer = &object_data_buf.buffer,
-                       .src_offset = obj_datas_staging_offset,
-                       .dst_offset = instance_resources->object_data_slot.get_offset(),
-                       .size = obj_datas_size});
-    device_->copy_ops.emplace_back(
-        Device::CopyOp{.dst_buffer = &instance_data_buf.buffer,
-                       .src_offset = instance_datas_staging_offset,
-                       .dst_offset = instance_resources->instance_data_slot.get_offset(),
-                       .size = instance_datas_size});
+    upload_ring_.add_copy(object_data_buf.buffer, obj_datas_staging_offset,
+                          instance_resources->object_data_slot.get_offset(), obj_datas_size);
+    upload_ring_.add_copy(instance_data_buf.buffer, instance_datas_staging_offset,
+                          instance_resources->instance_data_slot.get_offset(),
+                          instance_datas_size);
     if (instance_resources->is_animated) {
       if (skin_cmds.size()) {
-        {
-          size_t required_size = instance_resources->skin_commands_slot.get_off_plus_size();
-          size_t old_size = skin_instance_datas_.get_buffer()->size();
-          if (required_size > old_size) {
-            size_t new_size = required_size * 2;
-            auto new_buf = device_->create_buffer_holder(
-                BufferCreateInfo{.size = new_size,
-                                 .usage = BufferUsage_Storage,
-                                 .debug_name = "skin instance datas"});
-            immediate_submit([&, this](CmdEncoder& cmd) {
-              cmd.copy_buffer(*skin_instance_datas_.get_buffer(), *device_->get_buffer(new_buf), 0,
-                              0, old_size);
-              VkBufferMemoryBarrier2KHR barrier{};
-              barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
-              barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
-              barrier.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
-              barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-              barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-              barrier.buffer = device_->get_buffer(new_buf)->buffer();
-              barrier.size = VK_WHOLE_SIZE;
-              auto dependency_info = init::dependency_info(SPAN1(barrier), {});
-              vkCmdPipelineBarrier2KHR(cmd.cmd(), &dependency_info);
-            });
-
-            skin_instance_datas_.buffer = std::move(new_buf);
-            device_->copy_ops.emplace_back(
-                Device::CopyOp{.dst_buffer = &skin_instance_datas_.buffer,
-                               .src_offset = skin_instance_datas_staging_offset,
-                               .dst_offset = instance_resources->skin_commands_slot.get_offset(),
-                               .size = skin_cmd_copy_size});
-          } else {
-            device_->copy_ops.emplace_back(
-                Device::CopyOp{.dst_buffer = &skin_instance_datas_.buffer,
-                               .src_offset = skin_instance_datas_staging_offset,
-                               .dst_offset = instance_resources->skin_commands_slot.get_offset(),
-                               .size = skin_cmd_copy_size});
-          }
-        }
+        upload_ring_.add_copy(skin_instance_datas_.buffer, skin_instance_datas_staging_offset,
+                              instance_resources->skin_commands_slot.get_offset(),
+                              skin_cmd_copy_size);
       }
     }
   }
@@ -2498,6 +2496,404 @@ StaticModelInstanceResourcesHandle VkRender2::add_instance(ModelHandle model_han
   return model_instance_resources_handle;
 }
 
+void VkRender2::add_instances(ModelHandle model_handle, std::span<const Scene2* const> scenes,
+                              std::span<StaticModelInstanceResourcesHandle> out_handles) {
+  ZoneScoped;
+  assert(scenes.size() == out_handles.size());
+  if (scenes.empty()) return;
+  auto* pmodel = ResourceManager::get().get_model(model_handle);
+  assert(pmodel);
+  auto& model = *pmodel;
+  auto* resources = model_gpu_resources_pool_.get(model.gpu_resource_handle);
+  assert(resources);
+  const auto& shared = *model.scene_graph_data.shared;
+  assert(shared.skins.empty() && "skinned instances are added with add_instance");
+  const auto instance_cnt = static_cast<u32>(scenes.size());
+  resources->ref_count += instance_cnt;
+  draw_stats_.total_vertices += static_cast<u64>(resources->num_vertices) * instance_cnt;
+  draw_stats_.total_indices += static_cast<u64>(resources->num_indices) * instance_cnt;
+
+  // the draws every instance gets, in node order. only instance_id differs between instances.
+  struct NodeDraw {
+    u32 node;
+    u32 material_id;
+    MeshPass pass;
+    GPUDrawInfo draw;
+    const AABB* aabb;
+  };
+  std::vector<NodeDraw> node_draws;
+  u32 pass_draw_cnts[MeshPass_Count] = {};
+  {
+    ZoneScopedN("node draws");
+    const auto base_material_id =
+        static_cast<u32>(resources->materials_slot.get_offset() / sizeof(Material));
+    for (u32 node_i = 0; node_i < shared.node_count(); node_i++) {
+      auto mesh_data_i = shared.node_mesh_indices[node_i];
+      if (mesh_data_i == -1) continue;
+      const auto& node_mesh_data = shared.mesh_datas[mesh_data_i];
+      const auto& mesh = resources->mesh_draw_infos[node_mesh_data.mesh_idx];
+      bool double_sided = resources->materials[node_mesh_data.material_id].is_double_sided();
+      MeshPass pass{MeshPass_Count};
+      if (node_mesh_data.pass_flags & PassFlags_Opaque) {
+        pass = MeshPass_Opaque;
+      } else if (node_mesh_data.pass_flags & PassFlags_OpaqueAlpha) {
+        pass = MeshPass_OpaqueAlphaMask;
+      } else if (node_mesh_data.pass_flags & PassFlags_Transparent) {
+        pass = MeshPass_Transparent;
+      }
+      if (double_sided) {
+        pass = get_double_sided_pass(pass);
+      }
+      if (pass != MeshPass_Count) {
+        pass_draw_cnts[pass]++;
+      }
+      node_draws.emplace_back(NodeDraw{
+          .node = node_i,
+          .material_id = node_mesh_data.material_id + base_material_id,
+          .pass = pass,
+          .draw = {.index_cnt = mesh.index_count,
+                   .first_index = static_cast<u32>(resources->first_index + mesh.first_index),
+                   .vertex_offset = resources->first_vertex + mesh.first_vertex,
+                   .instance_id = 0,
+                   .flags = double_sided ? GPUDrawInfoFlags_DoubleSided : 0u},
+          .aabb = &mesh.aabb,
+      });
+    }
+  }
+  const auto objs_per_instance = static_cast<u32>(node_draws.size());
+  const u32 obj_cnt = objs_per_instance * instance_cnt;
+
+  // one range for the whole batch, split so each instance can still be freed on its own. a model
+  // without meshes still gets its instances, with invalid slots and no draws.
+  FreeListBuffer2& instance_data_buf = static_instance_data_buf_;
+  FreeListBuffer2& object_data_buf = static_object_data_buf_;
+  util::TLSFAllocator::Slot instance_data_range;
+  util::TLSFAllocator::Slot object_data_range;
+  std::vector<util::TLSFAllocator::Slot> instance_data_slots(instance_cnt);
+  std::vector<util::TLSFAllocator::Slot> object_data_slots(instance_cnt);
+  if (obj_cnt) {
+    instance_data_range = allocate_in(instance_data_buf, obj_cnt * sizeof(GPUInstanceData),
+                                      "static instance data buf");
+    object_data_range =
+        allocate_in(object_data_buf, obj_cnt * sizeof(ObjectData), "static object data buf");
+    instance_data_buf.allocator.split(instance_data_range, instance_data_slots);
+    object_data_buf.allocator.split(object_data_range, object_data_slots);
+  }
+
+  std::vector<ObjectData> object_datas(obj_cnt);
+  std::vector<GPUInstanceData> instance_datas(obj_cnt);
+  std::array<std::vector<GPUDrawInfo>, MeshPass_Count> pass_cmds;
+  for (u32 pass = 0; pass < MeshPass_Count; pass++) {
+    pass_cmds[pass].reserve(static_cast<size_t>(pass_draw_cnts[pass]) * instance_cnt);
+  }
+  {
+    ZoneScopedN("instance data calc and model bounds");
+    vec3 scene_min = vec3{std::numeric_limits<float>::max()};
+    vec3 scene_max = vec3{std::numeric_limits<float>::lowest()};
+    const auto base_instance_id =
+        static_cast<u32>(instance_data_range.get_offset() / sizeof(GPUInstanceData));
+    const auto base_object_data_id =
+        static_cast<u32>(object_data_range.get_offset() / sizeof(ObjectData));
+    for (u32 instance_i = 0; instance_i < instance_cnt; instance_i++) {
+      const auto handle = static_model_instance_pool_.alloc();
+      out_handles[instance_i] = handle;
+      auto* instance_resources = static_model_instance_pool_.get(handle);
+      std::ranges::fill(instance_resources->mesh_pass_draw_handles,
+                        StaticMeshDrawManager::null_handle);
+      instance_resources->model_handle = model_handle;
+      instance_resources->name = resources->name.c_str();
+      instance_resources->instance_data_slot = instance_data_slots[instance_i];
+      instance_resources->object_data_slot = object_data_slots[instance_i];
+      instance_resources->node_to_instance_and_obj.assign(shared.node_count(), -1);
+
+      const auto& globals = scenes[instance_i]->global_transforms;
+      const u32 first_obj = instance_i * objs_per_instance;
+      for (u32 i = 0; i < objs_per_instance; i++) {
+        const auto& node_draw = node_draws[i];
+        const u32 obj = first_obj + i;
+        const AABB world_space_aabb = transform_aabb(globals[node_draw.node], *node_draw.aabb);
+        scene_min = glm::min(scene_min, world_space_aabb.min);
+        scene_max = glm::max(scene_max, world_space_aabb.max);
+        object_datas[obj] = ObjectData{
+            .model = globals[node_draw.node].to_mat4(),
+            .aabb_min = vec4(world_space_aabb.min, 0.),
+            .aabb_max = vec4(world_space_aabb.max, 0.),
+        };
+        instance_datas[obj] = GPUInstanceData{.material_id = node_draw.material_id,
+                                              .instance_id = base_object_data_id + obj,
+                                              .flags = 0};
+        instance_resources->node_to_instance_and_obj[node_draw.node] = static_cast<int>(i);
+        if (node_draw.pass != MeshPass_Count) {
+          auto& draw = pass_cmds[node_draw.pass].emplace_back(node_draw.draw);
+          draw.instance_id = base_instance_id + obj;
+        }
+      }
+      instance_resources->object_datas.assign(object_datas.begin() + first_obj,
+                                              object_datas.begin() + first_obj + objs_per_instance);
+      instance_resources->instance_datas.assign(
+          instance_datas.begin() + first_obj,
+          instance_datas.begin() + first_obj + objs_per_instance);
+    }
+    scene_aabb_.min = glm::min(scene_aabb_.min, scene_min);
+    scene_aabb_.max = glm::max(scene_aabb_.max, scene_max);
+  }
+
+  {
+    ZoneScopedN("copy data and add draws");
+    // instances are laid out back to back, so each buffer is a single staging copy
+    const u64 obj_datas_size = object_datas.size() * sizeof(ObjectData);
+    const u64 instance_datas_size = instance_datas.size() * sizeof(GPUInstanceData);
+    if (obj_cnt) {
+      upload_ring_.upload(object_data_buf.buffer, object_datas.data(), obj_datas_size,
+                          object_data_range.get_offset());
+      upload_ring_.upload(instance_data_buf.buffer, instance_datas.data(), instance_datas_size,
+                          instance_data_range.get_offset());
+    }
+
+    std::vector<u32> draw_handles(instance_cnt);
+    for (u32 pass = 0; pass < MeshPass_Count; pass++) {
+      const auto& cmds = pass_cmds[pass];
+      if (cmds.empty()) continue;
+      const u64 cmds_size = cmds.size() * sizeof(GPUDrawInfo);
+      get_mgr(static_cast<MeshPass>(pass), false)
+          .add_draws(state_, cmds, upload_ring_.copy(cmds.data(), cmds_size),
+                     draw_handles);
+      for (u32 instance_i = 0; instance_i < instance_cnt; instance_i++) {
+        static_model_instance_pool_.get(out_handles[instance_i])->mesh_pass_draw_handles[pass] =
+            draw_handles[instance_i];
+      }
+    }
+  }
+}
+
+void VkRender2::ensure_buffer_size(FreeListBuffer2& buf, size_t required_size,
+                                   const char* debug_name) {
+  const size_t old_size = buf.get_buffer()->size();
+  if (required_size <= old_size) return;
+  auto new_buf = device_->create_buffer_holder(BufferCreateInfo{
+      .size = required_size * 2, .usage = BufferUsage_Storage, .debug_name = debug_name});
+  const util::UploadRegion region{.size = old_size};
+  upload_ring_.add_buffer_copy(buf.buffer.handle, new_buf.handle, SPAN1(region));
+  buf.buffer = std::move(new_buf);
+}
+
+util::TLSFAllocator::Slot VkRender2::allocate_in(FreeListBuffer2& buf, u32 size_bytes,
+                                                 const char* debug_name) {
+  return buf.allocator.allocate(size_bytes, [&](u32 required_size) {
+    ensure_buffer_size(buf, required_size, debug_name);
+    return buf.get_buffer()->size();
+  });
+}
+
+void VkRender2::defrag_static_buffers() {
+  ZoneScoped;
+  const u64 frame = device_->curr_frame_num();
+  const u64 frames_in_flight = device_->get_frames_in_flight();
+  std::erase_if(retired_geometry_slots_, [&](const RetiredGeometrySlot& retired) {
+    if (retired.frame + frames_in_flight > frame) return false;
+    retired.buf->allocator.free(retired.slot);
+    return true;
+  });
+  std::erase_if(retired_instance_slots_, [&](const RetiredInstanceSlot& retired) {
+    if (retired.frame + frames_in_flight > frame) return false;
+    retired.buf->allocator.free(retired.slot);
+    return true;
+  });
+  if (!defrag_enabled.get()) return;
+
+  const u32 budget = std::max(defrag_budget_kb.get(), 1) * 1024;
+  u32 moved = defrag_geometry(static_vertex_buf_, false, budget);
+  if (moved < budget) {
+    moved += defrag_geometry(static_index_buf_, true, budget - moved);
+  }
+  // object data first since moving it rewrites instance data
+  if (moved < budget) {
+    moved += defrag_object_data(budget - moved);
+  }
+  if (moved < budget) {
+    moved += defrag_instance_data(budget - moved);
+  }
+  defrag_stats_.bytes_moved += moved;
+}
+
+u32 VkRender2::defrag_geometry(FreeListBuffer& buf, bool is_index_buf, u32 max_bytes) {
+  ZoneScoped;
+  std::vector<ModelGPUResources*> owners;
+  std::vector<util::DefragRange> ranges;
+  for (auto& entry : model_gpu_resources_pool_.get_entries()) {
+    const auto& slot = is_index_buf ? entry.object.indices_slot : entry.object.vertices_slot;
+    if (!slot.valid()) continue;
+    ranges.emplace_back(util::DefragRange{slot.get_offset(), slot.get_size(),
+                                          static_cast<u32>(owners.size())});
+    owners.emplace_back(&entry.object);
+  }
+  for (const auto& retired : retired_geometry_slots_) {
+    if (retired.buf == &buf) {
+      ranges.emplace_back(util::DefragRange{retired.slot.get_offset(), retired.slot.get_size()});
+    }
+  }
+  Buffer* buffer = buf.get_buffer();
+  const auto capacity =
+      static_cast<u32>(std::min<u64>(buf.allocator.capacity(), buffer->size()));
+  const auto moves = util::plan_defrag_moves(ranges, capacity, max_bytes);
+  if (moves.empty()) return 0;
+
+  // the planner keeps sources and destinations disjoint, so the moves go out as one copy
+  std::vector<util::UploadRegion> regions;
+  regions.reserve(moves.size());
+  for (const auto& move : moves) {
+    regions.emplace_back(util::UploadRegion{
+        .src_offset = move.src_offset, .dst_offset = move.dst_offset, .size = move.size});
+  }
+  upload_ring_.add_buffer_copy(buf.buffer.handle, buf.buffer.handle, regions);
+
+  std::unordered_map<const ModelGPUResources*, std::vector<StaticModelInstanceResources*>>
+      model_instances;
+  for (auto& entry : static_model_instance_pool_.get_entries()) {
+    auto& instance = entry.object;
+    if (!instance.instance_data_slot.valid()) continue;
+    auto* model = ResourceManager::get().get_model(instance.model_handle);
+    if (!model) continue;
+    model_instances[model_gpu_resources_pool_.get(model->gpu_resource_handle)].emplace_back(
+        &instance);
+  }
+
+  const u64 frame = device_->curr_frame_num();
+  u32 bytes_moved{};
+  for (const auto& move : moves) {
+    ModelGPUResources& resources = *owners[move.id];
+    auto& slot = is_index_buf ? resources.indices_slot : resources.vertices_slot;
+    retired_geometry_slots_.emplace_back(RetiredGeometrySlot{frame, &buf, slot});
+    slot = buf.allocator.allocate_at(move.dst_offset, move.size);
+    assert(slot.valid());
+    u64& first = is_index_buf ? resources.first_index : resources.first_vertex;
+    const auto old_first = static_cast<u32>(first);
+    first = slot.get_offset() / (is_index_buf ? sizeof(u32) : sizeof(Vertex));
+    const auto new_first = static_cast<u32>(first);
+    bytes_moved += move.size;
+    defrag_stats_.moves++;
+
+    auto it = model_instances.find(&resources);
+    if (it == model_instances.end()) continue;
+    for (auto* instance : it->second) {
+      // skinned draws read vertices from the animation output buffer
+      if (!is_index_buf && instance->is_animated) continue;
+      auto& mgrs = instance->is_animated ? animated_draw_mgrs_ : static_draw_mgrs_;
+      for (auto& mgr : mgrs) {
+        const u32 handle = instance->mesh_pass_draw_handles[mgr.get_mesh_pass()];
+        for (auto& draw : mgr.get_draws(handle)) {
+          u32& field = is_index_buf ? draw.first_index : draw.vertex_offset;
+          field = field - old_first + new_first;
+        }
+        mgr.upload_draws(handle);
+      }
+    }
+  }
+  return bytes_moved;
+}
+
+u32 VkRender2::defrag_instance_data(u32 max_bytes) {
+  ZoneScoped;
+  auto& buf = static_instance_data_buf_;
+  // a single free block can't be compacted any further
+  if (buf.allocator.get_stats().free_block_cnt <= 1) return 0;
+  std::vector<StaticModelInstanceResources*> owners;
+  std::vector<util::DefragRange> ranges;
+  for (auto& entry : static_model_instance_pool_.get_entries()) {
+    const auto& slot = entry.object.instance_data_slot;
+    if (!slot.valid()) continue;
+    ranges.emplace_back(util::DefragRange{slot.get_offset(), slot.get_size(),
+                                          static_cast<u32>(owners.size())});
+    owners.emplace_back(&entry.object);
+  }
+  for (const auto& retired : retired_instance_slots_) {
+    if (retired.buf == &buf) {
+      ranges.emplace_back(util::DefragRange{retired.slot.get_offset(), retired.slot.get_size()});
+    }
+  }
+  const auto capacity =
+      static_cast<u32>(std::min<u64>(buf.allocator.capacity(), buf.get_buffer()->size()));
+  const auto moves = util::plan_defrag_moves(ranges, capacity, max_bytes);
+
+  const u64 frame = device_->curr_frame_num();
+  u32 bytes_moved{};
+  for (const auto& move : moves) {
+    auto& instance = *owners[move.id];
+    retired_instance_slots_.emplace_back(
+        RetiredInstanceSlot{frame, &buf, instance.instance_data_slot});
+    const u32 old_base = instance.instance_data_slot.get_offset() / sizeof(GPUInstanceData);
+    instance.instance_data_slot = buf.allocator.allocate_at(move.dst_offset, move.size);
+    assert(instance.instance_data_slot.valid());
+    const u32 new_base = instance.instance_data_slot.get_offset() / sizeof(GPUInstanceData);
+    // the cpu copy is current, so upload it rather than copying on the gpu
+    upload_instance_data(instance);
+
+    auto& mgrs = instance.is_animated ? animated_draw_mgrs_ : static_draw_mgrs_;
+    for (auto& mgr : mgrs) {
+      const u32 handle = instance.mesh_pass_draw_handles[mgr.get_mesh_pass()];
+      for (auto& draw : mgr.get_draws(handle)) {
+        draw.instance_id = draw.instance_id - old_base + new_base;
+      }
+      mgr.upload_draws(handle);
+    }
+    bytes_moved += move.size;
+    defrag_stats_.moves++;
+  }
+  return bytes_moved;
+}
+
+u32 VkRender2::defrag_object_data(u32 max_bytes) {
+  ZoneScoped;
+  auto& buf = static_object_data_buf_;
+  if (buf.allocator.get_stats().free_block_cnt <= 1) return 0;
+  std::vector<StaticModelInstanceResources*> owners;
+  std::vector<util::DefragRange> ranges;
+  for (auto& entry : static_model_instance_pool_.get_entries()) {
+    const auto& slot = entry.object.object_data_slot;
+    if (!slot.valid()) continue;
+    ranges.emplace_back(util::DefragRange{slot.get_offset(), slot.get_size(),
+                                          static_cast<u32>(owners.size())});
+    owners.emplace_back(&entry.object);
+  }
+  for (const auto& retired : retired_instance_slots_) {
+    if (retired.buf == &buf) {
+      ranges.emplace_back(util::DefragRange{retired.slot.get_offset(), retired.slot.get_size()});
+    }
+  }
+  const auto capacity =
+      static_cast<u32>(std::min<u64>(buf.allocator.capacity(), buf.get_buffer()->size()));
+  const auto moves = util::plan_defrag_moves(ranges, capacity, max_bytes);
+
+  const u64 frame = device_->curr_frame_num();
+  u32 bytes_moved{};
+  for (const auto& move : moves) {
+    auto& instance = *owners[move.id];
+    retired_instance_slots_.emplace_back(
+        RetiredInstanceSlot{frame, &buf, instance.object_data_slot});
+    const u32 old_base = instance.object_data_slot.get_offset() / sizeof(ObjectData);
+    instance.object_data_slot = buf.allocator.allocate_at(move.dst_offset, move.size);
+    assert(instance.object_data_slot.valid());
+    const u32 new_base = instance.object_data_slot.get_offset() / sizeof(ObjectData);
+    const u64 object_datas_size = instance.object_datas.size() * sizeof(ObjectData);
+    upload_ring_.upload(buf.buffer, instance.object_datas.data(), object_datas_size,
+                        instance.object_data_slot.get_offset());
+    // instance data stores object data indices
+    for (auto& instance_data : instance.instance_datas) {
+      instance_data.instance_id = instance_data.instance_id - old_base + new_base;
+    }
+    upload_instance_data(instance);
+    bytes_moved += move.size;
+    defrag_stats_.moves++;
+  }
+  return bytes_moved;
+}
+
+void VkRender2::upload_instance_data(const StaticModelInstanceResources& instance) {
+  const u64 size = instance.instance_datas.size() * sizeof(GPUInstanceData);
+  upload_ring_.upload(static_instance_data_buf_.buffer, instance.instance_datas.data(), size,
+                      instance.instance_data_slot.get_offset());
+}
+
 std::string to_string(MeshPass p) {
   switch (p) {
     case MeshPass_Opaque:
@@ -2532,22 +2928,67 @@ void VkRender2::update_transforms(LoadedInstanceData& instance, std::vector<i32>
   assert(model);
   auto* model_resources = model_gpu_resources_pool_.get(model->gpu_resource_handle);
   auto& scene = instance.scene_graph_data;
+  const auto& shared = *scene.shared;
   for (auto node_i : changed_nodes) {
-    auto mesh_data_i = scene.node_mesh_indices[node_i];
+    auto mesh_data_i = shared.node_mesh_indices[node_i];
     if (mesh_data_i == -1) continue;
     const auto& mesh_info =
-        model_resources->mesh_draw_infos[scene.mesh_datas[mesh_data_i].mesh_idx];
+        model_resources->mesh_draw_infos[shared.mesh_datas[mesh_data_i].mesh_idx];
     auto instance_i = instance_resources->node_to_instance_and_obj[node_i];
-    object_data_buffer_copier_.add_copy(
-        object_datas_to_copy_.size() * sizeof(ObjectData),
-        (instance_i * sizeof(ObjectData)) + instance_resources->object_data_slot.get_offset(),
-        sizeof(ObjectData));
-
     AABB world_aabb = transform_aabb(scene.global_transforms[node_i], mesh_info.aabb);
-    object_datas_to_copy_.emplace_back(scene.global_transforms[node_i], vec4{world_aabb.min, 0.},
-                                       vec4{world_aabb.max, 0.});
-    instance_resources->object_datas[instance_i] = object_datas_to_copy_.back();
+    auto& object_data = instance_resources->object_datas[instance_i];
+    object_data = ObjectData{scene.global_transforms[node_i].to_mat4(), vec4{world_aabb.min, 0.},
+                             vec4{world_aabb.max, 0.}};
+    dirty_object_datas_.emplace_back(ObjectDataScatter{
+        .data = object_data,
+        .dst_i = static_cast<u32>(instance_i + (instance_resources->object_data_slot.get_offset() /
+                                                sizeof(ObjectData)))});
+  }
+}
+
+void VkRender2::flush_dirty_object_datas() {
+  ZoneScoped;
+  object_scatter_cnt_ = 0;
+  object_data_upload_stats_ = {};
+  if (dirty_object_datas_.empty()) return;
+  sort_and_dedupe(dirty_object_datas_);
+  const u32 regions = count_copy_regions(dirty_object_datas_);
+  object_data_upload_stats_.dirty = dirty_object_datas_.size();
+  object_data_upload_stats_.regions = regions;
+  // past a point the copy regions cost more than one dispatch reading the packed objects
+  if (regions >= static_cast<u32>(std::max(object_scatter_min_regions.get(), 1))) {
+    const u64 size = dirty_object_datas_.size() * sizeof(ObjectDataScatter);
+    object_scatter_staging_offset_ = upload_ring_.copy(dirty_object_datas_.data(), size);
+    object_scatter_cnt_ = dirty_object_datas_.size();
+    object_data_upload_stats_.scatter = true;
+    object_data_upload_stats_.staging_bytes = size;
+  } else {
+    // consecutive destinations land next to each other in staging and merge into one region
+    for (const auto& dirty : dirty_object_datas_) {
+      upload_ring_.upload(static_object_data_buf_.buffer, &dirty.data, sizeof(ObjectData),
+                          dirty.dst_i * sizeof(ObjectData));
+    }
+    object_data_upload_stats_.staging_bytes = dirty_object_datas_.size() * sizeof(ObjectData);
   }
+  dirty_object_datas_.clear();
+}
+
+void VkRender2::record_object_data_scatter(CmdEncoder& cmd) {
+  if (object_scatter_cnt_ == 0) return;
+  ZoneScoped;
+  // after the upload ring, so it wins over object data staged for the same slots this frame
+  cmd.barrier(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT);
+  cmd.bind_pipeline(PipelineBindPoint::Compute, scatter_object_data_pipeline_);
+  ScatterObjectDataPushConstants pc{
+      .scatter_buf = upload_ring_.get_staging_addr(object_scatter_staging_offset_),
+      .object_data_buf = static_object_data_buf_.get_buffer()->device_addr(),
+      .cnt = object_scatter_cnt_};
+  cmd.push_constants(sizeof(pc), &pc);
+  cmd.dispatch((object_scatter_cnt_ + 63) / 64, 1, 1);
+  cmd.barrier(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+              VK_ACCESS_2_SHADER_READ_BIT);
 }
 
 void VkRender2::mark_dirty(InstanceHandle handle) { dirty_instances_.emplace_back(handle); }
@@ -2562,10 +3003,10 @@ void VkRender2::update_animation(LoadedInstanceData& instance, float dt) {
   size_t anim_i = 0;
   auto* anim = AnimationManager::get().get_animation(instance.animation_id);
   instance.transform_accumulators.clear();
-  instance.transform_accumulators.resize(instance.scene_graph_data.hierarchies.size(),
+  instance.transform_accumulators.resize(instance.scene_graph_data.node_count(),
                                          NodeTransformAccumulator{});
   instance.dirty_animation_node_bits.clear();
-  instance.dirty_animation_node_bits.resize(instance.scene_graph_data.hierarchies.size(), false);
+  instance.dirty_animation_node_bits.resize(instance.scene_graph_data.node_count(), false);
   for (auto& animation : model->animations) {
     // assert(animation.duration > 0.f);
     AnimationState& anim_state = anim->states[anim_i];
@@ -2606,26 +3047,14 @@ void VkRender2::update_animation(LoadedInstanceData& instance, float dt) {
     mat4 s = glm::scale(mat4{1}, transform_accum.weights.z > 0.f
                                      ? transform_accum.scale / transform_accum.weights.z
                                      : vec3{1});
-    instance.scene_graph_data.local_transforms[node_i] = t * r * s;
+    instance.scene_graph_data.local_transforms[node_i] = Affine{t * r * s};
     mark_changed(instance.scene_graph_data, node_i);
   }
 }
 
-// https://stackoverflow.com/questions/6053522/how-to-recalculate-axis-aligned-bounding-box-after-translate-rotate/58630206#58630206
-AABB transform_aabb(const glm::mat4& model, const AABB& aabb) {
-  AABB result;
-  result.min = glm::vec3(model[3]);  // translation part
-  result.max = result.min;
-  for (int i = 0; i < 3; ++i) {    // for each row (x, y, z in result)
-    for (int j = 0; j < 3; ++j) {  // for each column (x, y, z in input aabb)
-      float a = model[j][i] * aabb.min[j];
-      float b = model[j][i] * aabb.max[j];
-      result.min[i] += glm::min(a, b);
-      result.max[i] += glm::max(a, b);
-    }
-  }
-  return result;
-};
+AABB transform_aabb(const Affine& model, const AABB& aabb) {
+  return affine::transform_aabb(model, aabb);
+}
 
 void VkRender2::draw_sphere(const glm::vec3& center, float radius, const glm::vec4& color,
                             int segments) {
@@ -2691,21 +3120,21 @@ MeshPass get_double_sided_pass(MeshPass pass) {
 
 bool VkRender2::update_skins(LoadedInstanceData& instance) {
   ZoneScoped;
-  const auto& skins = instance.scene_graph_data.skins;
+  const auto& skins = instance.scene_graph_data.shared->skins;
   auto* instance_resources = static_model_instance_pool_.get(instance.instance_resources_handle);
   assert(instance_resources);
   u32 instance_bone_mat_start_i =
       instance_resources->global_bone_mat_slot.get_offset() / sizeof(mat4);
   for (const auto& skin : skins) {
-    for (size_t joint_i = 0; joint_i < skin.joint_node_indices.size(); joint_i++) {
-      int joint_node = skin.joint_node_indices[joint_i];
-      const mat4& inv_bind_mat = skin.inverse_bind_matrices[joint_i];
-      const mat4& global_transform_mat = instance.scene_graph_data.global_transforms[joint_node];
-      assert(instance_bone_mat_start_i + skin.model_bone_mat_start_i + joint_i <
-             global_skin_matrices_.size());
-      global_skin_matrices_[instance_bone_mat_start_i + skin.model_bone_mat_start_i + joint_i] =
-          global_transform_mat * inv_bind_mat;
-    }
+    assert(skin.inverse_bind_matrices.size() == skin.joint_node_indices.size());
+    assert(instance_bone_mat_start_i + skin.model_bone_mat_start_i +
+               skin.joint_node_indices.size() <=
+           global_skin_matrices_.size());
+    // global_transforms[joint_node] * inverse_bind_matrices[joint], expanded to mat4 for the gpu
+    affine::mul_gather_to_mat4(
+        &global_skin_matrices_[instance_bone_mat_start_i + skin.model_bone_mat_start_i],
+        instance.scene_graph_data.global_transforms.data(), skin.joint_node_indices,
+        skin.inverse_bind_matrices.data());
   }
   return skins.size() > 0;
 }
@@ -2725,11 +3154,9 @@ u64 LinearCopyer::copy(const void* data, u64 size) {
 
 void VkRender2::draw_joints(LoadedInstanceData& instance) {
   auto& s = instance.scene_graph_data;
-  for (size_t i = 0; i < s.hierarchies.size(); i++) {
-    if (s.node_flags[i] & Scene2::NodeFlag_IsJointBit) {
-      auto& t = s.global_transforms[i];
-      vec3 c{t[0][3], t[1][3], t[2][3]};
-      draw_sphere(c, 5, vec4{1.f});
+  for (size_t i = 0; i < s.node_count(); i++) {
+    if (s.shared->node_flags[i] & SceneTemplate::NodeFlag_IsJointBit) {
+      draw_sphere(s.global_transforms[i].get_translation(), 5, vec4{1.f});
     }
   }
 }
@@ -2779,7 +3206,7 @@ void VkRender2::init_ssao() {
                          ssao_noise_copy_size);
     copy_cmd.copy_buffer(device_, *device_->get_buffer(ssao_kernel_buf_), ssao_noise_copy_size, 0,
                          ssao_kernel_copy_size);
-    device_->graphics_copy_allocator_.submit(copy_cmd);
+    device_->wait_for_copy(device_->graphics_copy_allocator_.submit(copy_cmd));
   }
 }
 
@@ -4,20 +4,25 @@
 
 #include <filesystem>
 #include <optional>
+#include <span>
 #include <vector>
 
 #include "AABB.hpp"
 #include "CommandEncoder.hpp"
+#include "FrameProfiler.hpp"
+#include "ObjectDataScatter.hpp"
 #include "RenderGraph.hpp"
 #include "Scene.hpp"
 #include "SceneLoader.hpp"
 #include "SceneResources.hpp"
 #include "StateTracker.hpp"
 #include "Types.hpp"
+#include "UploadRing.hpp"
 #include "shaders/common.h.glsl"
 #include "techniques/CSM.hpp"
 #include "techniques/IBL.hpp"
 #include "util/IndexAllocator.hpp"
+#include "util/TLSFAllocator.hpp"
 #include "vk2/Buffer.hpp"
 #include "vk2/Device.hpp"
 #include "vk2/PipelineManager.hpp"
@@ -52,6 +57,16 @@ struct ModelGPUResources {
   u32 ref_count;
 };
 
+// A model parsed and copied to staging memory on a loader thread, waiting for upload_model
+struct StagedModel {
+  LoadedSceneData scene;
+  Device::CopyAllocator::CopyCmd copy_cmd;
+  u64 materials_staging_offset{};
+  u64 vertices_staging_offset{};
+  u64 animated_vertices_staging_offset{};
+  u64 indices_staging_offset{};
+};
+
 enum MeshPass : u8 {
   MeshPass_Opaque,
   MeshPass_OpaqueDoubleSided,
@@ -77,11 +92,11 @@ struct StaticModelInstanceResources {
   std::vector<GPUInstanceData> instance_datas;
   std::vector<int> node_to_instance_and_obj;
   std::array<u32, MeshPass_Count> mesh_pass_draw_handles{UINT32_MAX};
-  util::FreeListAllocator2::Slot instance_data_slot;
-  util::FreeListAllocator2::Slot object_data_slot;
-  util::FreeListAllocator2::Slot animated_vertex_buf_slot;
-  util::FreeListAllocator2::Slot global_bone_mat_slot;
-  util::FreeListAllocator2::Slot skin_commands_slot;
+  util::TLSFAllocator::Slot instance_data_slot;
+  util::TLSFAllocator::Slot object_data_slot;
+  util::TLSFAllocator::Slot animated_vertex_buf_slot;
+  util::TLSFAllocator::Slot global_bone_mat_slot;
+  util::TLSFAllocator::Slot skin_commands_slot;
   ModelHandle model_handle;
   const char* name;  // owned by gpu resource
   bool is_animated{};
@@ -119,7 +134,7 @@ struct LinearStagingBuffer {
 
 struct FreeListBuffer2 {
   Holder<BufferHandle> buffer;
-  util::FreeListAllocator2 allocator;
+  util::TLSFAllocator allocator;
   [[nodiscard]] Buffer* get_buffer() const { return get_device().get_buffer(buffer); }
 };
 
@@ -132,7 +147,7 @@ struct FreeListBuffer {
 template <u32 N>
 struct FreeListNBuffers {
   std::array<Holder<BufferHandle>, N> buffers;
-  util::FreeListAllocator2 allocator;
+  util::TLSFAllocator allocator;
 };
 
 struct SceneDrawInfo {
@@ -145,11 +160,12 @@ struct SceneDrawInfo {
   float fov_degrees{70.f};
 };
 
-AABB transform_aabb(const glm::mat4& model, const AABB& aabb);
+AABB transform_aabb(const Affine& model, const AABB& aabb);
 
 class VkRender2 final {
  public:
   struct InitInfo {
+    // null with a headless device
     GLFWwindow* window;
     Device* device;
     std::filesystem::path resource_dir;
@@ -162,8 +178,20 @@ class VkRender2 final {
   explicit VkRender2(const InitInfo& info, bool& succes);
   ~VkRender2();
 
-  bool load_model2(const std::filesystem::path& path, LoadedModelData& result);
+  // Parses the model and copies its geometry to staging memory. Safe on loader threads, it
+  // doesn't touch the geometry buffers or their allocators.
+  bool stage_model(const std::filesystem::path& path, StagedModel& result);
+  // Main thread only. Allocates the model's geometry slots, growing the buffers if needed, records
+  // and submits the staged copies and registers the slots, so defrag always sees every allocation.
+  void upload_model(StagedModel& staged, LoadedModelData& result);
   StaticModelInstanceResourcesHandle add_instance(ModelHandle model_handle);
+  // Adds one instance per scene, using each scene's global transforms. The whole batch shares one
+  // instance/object data range and one draw range per mesh pass, uploaded with a single staging
+  // copy per buffer. Static (unskinned) models only.
+  void add_instances(ModelHandle model_handle, std::span<const Scene2* const> scenes,
+                     std::span<StaticModelInstanceResourcesHandle> out_handles);
+  // Queues the changed nodes' object data, uploaded at the next draw by copies or a compute
+  // scatter depending on how scattered they are.
   void update_transforms(LoadedInstanceData& instance, std::vector<i32>& changed_nodes);
   void update_animation(LoadedInstanceData& instance, float dt);
   void draw_joints(LoadedInstanceData& instance);
@@ -184,6 +212,7 @@ class VkRender2 final {
   ImageHandle load_hdr_img(const std::filesystem::path& path, bool flip = false);
   void generate_mipmaps(CmdEncoder& ctx, ImageHandle handle);
   void draw_line(const vec3& p1, const vec3& p2, const vec4& color);
+  [[nodiscard]] FrameProfiler& get_profiler() { return profiler_; }
 
   /**
    * @brief draws a plane
@@ -257,7 +286,7 @@ class VkRender2 final {
   };
   FreeListBuffer2 skin_instance_datas_;
 
-  util::FreeListAllocator2 global_skin_mat_allocator_;
+  util::TLSFAllocator global_skin_mat_allocator_;
   std::vector<mat4> global_skin_matrices_;
 
   FreeListBuffer static_vertex_buf_;
@@ -280,6 +309,16 @@ class VkRender2 final {
                                             MeshPass_OpaqueAlphaMask,
                                             MeshPass_OpaqueAlphaMaskDoubleSided};
 
+  enum GPUDrawInfoFlags : u8 { GPUDrawInfoFlags_DoubleSided = (1 << 0) };
+
+  struct GPUDrawInfo {
+    u32 index_cnt;
+    u32 first_index;
+    u32 vertex_offset;
+    u32 instance_id;
+    u32 flags;
+  };
+
   struct StaticMeshDrawManager {
     static constexpr u32 null_handle{UINT32_MAX};
     StaticMeshDrawManager() = default;
@@ -290,7 +329,7 @@ class VkRender2 final {
     StaticMeshDrawManager& operator=(StaticMeshDrawManager&&) = delete;
 
     struct Alloc {
-      util::FreeListAllocator2::Slot draw_cmd_slot;
+      util::TLSFAllocator::Slot draw_cmd_slot;
     };
 
     struct DrawPass {
@@ -304,8 +343,14 @@ class VkRender2 final {
     [[nodiscard]] u32 add_draw_pass();
 
     // TODO: this is a little jank
-    u32 add_draws(StateTracker& state, size_t size, size_t staging_offset);
+    u32 add_draws(StateTracker& state, std::span<const GPUDrawInfo> draws, size_t staging_offset);
+    // draws split evenly between out_handles.size() instances
+    void add_draws(StateTracker& state, std::span<const GPUDrawInfo> draws, size_t staging_offset,
+                   std::span<u32> out_handles);
     void remove_draws(StateTracker& state, CmdEncoder& cmd, u32 handle);
+    // cpu copy of a handle's draws. upload_draws pushes edits to the gpu.
+    [[nodiscard]] std::span<GPUDrawInfo> get_draws(u32 handle);
+    void upload_draws(u32 handle);
 
     [[nodiscard]] const std::string& get_name() const { return name_; }
     [[nodiscard]] u32 get_num_draw_cmds() const { return num_draw_cmds_; }
@@ -324,6 +369,8 @@ class VkRender2 final {
     std::string name_;
     std::vector<Alloc> allocs_;
     std::vector<u32> free_alloc_indices_;
+    // mirrors draw_cmds_buf_ so draws can be patched when the data they point at moves
+    std::vector<GPUDrawInfo> cpu_draws_;
     FreeListBuffer2 draw_cmds_buf_;
     FreeListBuffer2 animated_draw_cmds_buf_;
     u32 num_draw_cmds_{};
@@ -342,16 +389,38 @@ class VkRender2 final {
  private:
   void free(StaticModelInstanceResources& instance);
   void free(CmdEncoder& cmd, StaticModelInstanceResources& instance);
-
-  enum GPUDrawInfoFlags : u8 { GPUDrawInfoFlags_DoubleSided = (1 << 0) };
-
-  struct GPUDrawInfo {
-    u32 index_cnt;
-    u32 first_index;
-    u32 vertex_offset;
-    u32 instance_id;
-    u32 flags;
+  // grows buf to twice required_size if needed, keeping its contents
+  void ensure_buffer_size(FreeListBuffer2& buf, size_t required_size, const char* debug_name);
+  // allocates from buf's allocator, growing the buffer and allocator together when nothing fits
+  util::TLSFAllocator::Slot allocate_in(FreeListBuffer2& buf, u32 size_bytes,
+                                        const char* debug_name);
+
+  // Incremental compaction of the static geometry and instance buffers. Moves at most the budget
+  // of bytes per frame and patches draws, instance data and model resources that pointed at them.
+  // Ranges larger than renderer.defrag_budget_kb are never moved.
+  void defrag_static_buffers();
+  // each returns the number of bytes moved
+  u32 defrag_geometry(FreeListBuffer& buf, bool is_index_buf, u32 max_bytes);
+  u32 defrag_instance_data(u32 max_bytes);
+  u32 defrag_object_data(u32 max_bytes);
+  void upload_instance_data(const StaticModelInstanceResources& instance);
+  // moved-from ranges stay allocated until frames in flight are done reading them
+  struct RetiredGeometrySlot {
+    u64 frame;
+    FreeListBuffer* buf;
+    util::FreeListAllocator::Slot slot;
   };
+  struct RetiredInstanceSlot {
+    u64 frame;
+    FreeListBuffer2* buf;
+    util::TLSFAllocator::Slot slot;
+  };
+  std::vector<RetiredGeometrySlot> retired_geometry_slots_;
+  std::vector<RetiredInstanceSlot> retired_instance_slots_;
+  struct DefragStats {
+    u64 bytes_moved;
+    u32 moves;
+  } defrag_stats_{};
 
   DrawStats draw_stats_{};
 
@@ -380,14 +449,14 @@ class VkRender2 final {
   } default_data_;
   gfx::DefaultMaterialData default_mat_data_;
 
-  BufferCopyer object_data_buffer_copier_;
   std::vector<InstanceHandle> dirty_instances_;
-  std::vector<ObjectData> object_datas_to_copy_;
-  std::vector<Holder<BufferHandle>> frame_staging_buffers_;
-  std::vector<LinearCopyer> staging_buffer_copiers_;
-  LinearCopyer& get_staging_copyer() {
-    return staging_buffer_copiers_[device_->curr_frame_in_flight()];
-  }
+  UploadRing upload_ring_;
+  std::vector<ObjectDataScatter> dirty_object_datas_;
+  u64 object_scatter_staging_offset_{};
+  u32 object_scatter_cnt_{};
+  ObjectDataUploadStats object_data_upload_stats_{};
+  void flush_dirty_object_datas();
+  void record_object_data_scatter(CmdEncoder& cmd);
 
   PipelineTask make_pipeline_task(const ComputePipelineCreateInfo& info,
                                   PipelineHandle* out_handle);
@@ -397,6 +466,7 @@ class VkRender2 final {
   std::unique_ptr<CSM> csm_;
   SamplerHandle shadow_sampler_;
   std::optional<IBL> ibl_;
+  FrameProfiler profiler_;
   RenderGraph rg_;
   PipelineHandle img_pipeline_;
   PipelineHandle draw_pipeline_;
@@ -410,6 +480,7 @@ class VkRender2 final {
   PipelineHandle transparent_oit_pipeline_;
   PipelineHandle oit_comp_pipeline_;
   PipelineHandle skinning_comp_pipeline_;
+  PipelineHandle scatter_object_data_pipeline_;
   PipelineHandle ssao_1_pipeline_;
   PipelineHandle ssao_blur_pipeline_;
   PipelineHandle fxaa_pipeline_;
@@ -426,6 +497,8 @@ class VkRender2 final {
   std::vector<Buffer> free_staging_buffers_;
 
   std::vector<CmdEncoder*> frame_imm_submits_;
+  // graphics command lists in the last frame
+  u32 frame_cmd_list_cnt_{};
   std::vector<std::optional<LoadedSceneData>> loaded_scenes_;
   u32 debug_mode_{DEBUG_MODE_NONE};
   const char* debug_mode_to_string(u32 mode);
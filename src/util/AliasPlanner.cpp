@@ -0,0 +1,118 @@
+#include "AliasPlanner.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <tracy/Tracy.hpp>
+
+namespace util {
+
+namespace {
+
+u64 align_up(u64 offset, u64 alignment) {
+  assert(alignment && (alignment & (alignment - 1)) == 0);
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+struct Occupied {
+  u64 offset;
+  u64 end;
+};
+
+u64 compute_peak_live_bytes(std::span<const AliasResource> resources) {
+  // +size where a lifetime starts, -size one past where it ends. Ends sort first at equal
+  // positions, so back to back lifetimes aren't counted as alive together.
+  std::vector<std::pair<u32, i64>> events;
+  events.reserve(resources.size() * 2);
+  for (const auto& resource : resources) {
+    events.emplace_back(resource.first_use, static_cast<i64>(resource.size));
+    events.emplace_back(resource.last_use + 1, -static_cast<i64>(resource.size));
+  }
+  std::ranges::sort(events);
+  i64 live{};
+  i64 peak{};
+  for (const auto& [pos, delta] : events) {
+    live += delta;
+    peak = std::max(peak, live);
+  }
+  return peak;
+}
+
+}  // namespace
+
+AliasPlan plan_aliases(std::span<const AliasResource> resources) {
+  ZoneScoped;
+  AliasPlan plan{};
+  plan.placements.resize(resources.size());
+  std::vector<u32> order(resources.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, [&resources](u32 a, u32 b) {
+    if (resources[a].size != resources[b].size) return resources[a].size > resources[b].size;
+    return resources[a].first_use < resources[b].first_use;
+  });
+
+  std::vector<std::vector<u32>> heap_resources;
+  std::vector<Occupied> occupied;
+  for (u32 resource_i : order) {
+    const auto& resource = resources[resource_i];
+    assert(resource.first_use <= resource.last_use);
+    plan.unaliased_bytes += resource.size;
+    bool placed{};
+    for (u32 heap_i = 0; heap_i < plan.heaps.size() && !placed; heap_i++) {
+      auto& heap = plan.heaps[heap_i];
+      if (!(heap.memory_type_bits & resource.memory_type_bits) || resource.size > heap.size) {
+        continue;
+      }
+      occupied.clear();
+      for (u32 other_i : heap_resources[heap_i]) {
+        if (lifetimes_overlap(resource, resources[other_i])) {
+          const u64 offset = plan.placements[other_i].offset;
+          occupied.emplace_back(Occupied{offset, offset + resources[other_i].size});
+        }
+      }
+      std::ranges::sort(occupied, {}, &Occupied::offset);
+      // lowest gap between ranges alive at the same time that fits
+      u64 cursor{};
+      for (const auto& range : occupied) {
+        if (align_up(cursor, resource.alignment) + resource.size <= range.offset) break;
+        cursor = std::max(cursor, range.end);
+      }
+      const u64 offset = align_up(cursor, resource.alignment);
+      if (offset + resource.size > heap.size) continue;
+      heap.memory_type_bits &= resource.memory_type_bits;
+      heap.alignment = std::max(heap.alignment, resource.alignment);
+      heap_resources[heap_i].emplace_back(resource_i);
+      plan.placements[resource_i] = {.heap = heap_i, .offset = offset};
+      placed = true;
+    }
+    if (!placed) {
+      plan.placements[resource_i] = {.heap = static_cast<u32>(plan.heaps.size()), .offset = 0};
+      plan.heaps.emplace_back(AliasHeap{.size = resource.size,
+                                        .alignment = resource.alignment,
+                                        .memory_type_bits = resource.memory_type_bits});
+      heap_resources.emplace_back().emplace_back(resource_i);
+    }
+  }
+
+  for (const auto& members : heap_resources) {
+    for (size_t i = 0; i < members.size(); i++) {
+      for (size_t j = i + 1; j < members.size(); j++) {
+        const u32 a = std::min(members[i], members[j]);
+        const u32 b = std::max(members[i], members[j]);
+        const u64 a_offset = plan.placements[a].offset;
+        const u64 b_offset = plan.placements[b].offset;
+        if (a_offset < b_offset + resources[b].size && b_offset < a_offset + resources[a].size) {
+          plan.aliases.emplace_back(a, b);
+        }
+      }
+    }
+  }
+  std::ranges::sort(plan.aliases);
+  for (const auto& heap : plan.heaps) {
+    plan.aliased_bytes += heap.size;
+  }
+  plan.peak_live_bytes = compute_peak_live_bytes(resources);
+  return plan;
+}
+
+}  // namespace util
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace util {
+
+// Places resources whose lifetimes don't overlap into shared memory heaps. Pure cpu: the caller
+// allocates the heaps, binds the resources at the planned offsets and orders each resource's first
+// use after the last use of everything it aliases.
+
+struct AliasResource {
+  u64 size;
+  u64 alignment;
+  u32 memory_type_bits;
+  // positions in the frame's pass order, inclusive
+  u32 first_use;
+  u32 last_use;
+};
+
+struct AliasPlacement {
+  u32 heap;
+  u64 offset;
+};
+
+struct AliasHeap {
+  u64 size;
+  u64 alignment;
+  // memory types every resource placed in it accepts
+  u32 memory_type_bits;
+};
+
+struct AliasPlan {
+  // per resource
+  std::vector<AliasPlacement> placements;
+  std::vector<AliasHeap> heaps;
+  // resource pairs, lower index first, whose bytes overlap in a heap
+  std::vector<std::pair<u32, u32>> aliases;
+  // every resource in its own allocation
+  u64 unaliased_bytes;
+  // sum of heap sizes
+  u64 aliased_bytes;
+  // most bytes alive at any one pass, what perfect packing would need
+  u64 peak_live_bytes;
+};
+
+[[nodiscard]] inline bool lifetimes_overlap(const AliasResource& a, const AliasResource& b) {
+  return a.first_use <= b.last_use && b.first_use <= a.last_use;
+}
+
+// Largest resources first, each at the lowest aligned offset of the first heap with compatible
+// memory where it doesn't overlap anything alive at the same time. A heap is as big as the first
+// resource placed in it, resources that fit nowhere start a new heap.
+[[nodiscard]] AliasPlan plan_aliases(std::span<const AliasResource> resources);
+
+}  // namespace util
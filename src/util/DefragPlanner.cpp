@@ -0,0 +1,119 @@
+#include "DefragPlanner.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <tracy/Tracy.hpp>
+
+namespace util {
+
+namespace {
+
+struct Gap {
+  u32 offset;
+  u32 size;
+};
+
+std::vector<DefragRange> sorted_ranges(std::span<const DefragRange> ranges) {
+  std::vector<DefragRange> result{ranges.begin(), ranges.end()};
+  std::ranges::sort(result, {}, &DefragRange::offset);
+  return result;
+}
+
+std::vector<Gap> find_gaps(std::span<const DefragRange> sorted, u32 capacity) {
+  std::vector<Gap> gaps;
+  u32 end{};
+  for (const auto& range : sorted) {
+    assert(range.offset >= end && "overlapping defrag ranges");
+    if (range.offset > end) {
+      gaps.emplace_back(Gap{end, range.offset - end});
+    }
+    end = range.offset + range.size;
+  }
+  assert(end <= capacity);
+  if (capacity > end) {
+    gaps.emplace_back(Gap{end, capacity - end});
+  }
+  return gaps;
+}
+
+// max gap size over a segment tree, for finding the lowest gap that fits in O(log n)
+struct GapTree {
+  explicit GapTree(std::span<const Gap> gaps) {
+    while (leaf_cnt < gaps.size()) leaf_cnt *= 2;
+    sizes.resize(leaf_cnt * 2);
+    for (size_t i = 0; i < gaps.size(); i++) {
+      sizes[leaf_cnt + i] = gaps[i].size;
+    }
+    for (size_t i = leaf_cnt - 1; i > 0; i--) {
+      sizes[i] = std::max(sizes[i * 2], sizes[(i * 2) + 1]);
+    }
+  }
+  // index of the lowest gap of at least size, or UINT32_MAX
+  [[nodiscard]] u32 find(u32 size) const {
+    if (sizes[1] < size) return UINT32_MAX;
+    size_t i = 1;
+    while (i < leaf_cnt) {
+      i = sizes[i * 2] >= size ? i * 2 : (i * 2) + 1;
+    }
+    return static_cast<u32>(i - leaf_cnt);
+  }
+  void set(u32 gap_i, u32 size) {
+    size_t i = leaf_cnt + gap_i;
+    sizes[i] = size;
+    for (i /= 2; i > 0; i /= 2) {
+      sizes[i] = std::max(sizes[i * 2], sizes[(i * 2) + 1]);
+    }
+  }
+
+  size_t leaf_cnt{1};
+  std::vector<u32> sizes;
+};
+
+}  // namespace
+
+DefragStats compute_defrag_stats(std::span<const DefragRange> ranges, u32 capacity) {
+  const auto sorted = sorted_ranges(ranges);
+  DefragStats stats{};
+  for (const auto& gap : find_gaps(sorted, capacity)) {
+    stats.free_bytes += gap.size;
+    stats.largest_gap = std::max(stats.largest_gap, gap.size);
+    stats.gap_cnt++;
+  }
+  stats.used_extent = sorted.empty() ? 0 : sorted.back().offset + sorted.back().size;
+  return stats;
+}
+
+std::vector<DefragMove> plan_defrag_moves(std::span<const DefragRange> ranges, u32 capacity,
+                                          u32 max_bytes) {
+  ZoneScoped;
+  const auto sorted = sorted_ranges(ranges);
+  auto gaps = find_gaps(sorted, capacity);
+  std::vector<DefragMove> moves;
+  if (gaps.empty()) {
+    return moves;
+  }
+  GapTree tree{gaps};
+  u32 planned_bytes{};
+  for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
+    const auto& range = *it;
+    // nothing lower to move into
+    if (range.offset < gaps.front().offset) break;
+    if (range.id == DefragRange::pinned) continue;
+    if (planned_bytes + range.size > max_bytes) continue;
+    const u32 gap_i = tree.find(range.size);
+    if (gap_i == UINT32_MAX || gaps[gap_i].offset >= range.offset) continue;
+    auto& gap = gaps[gap_i];
+    moves.emplace_back(DefragMove{.id = range.id,
+                                  .src_offset = range.offset,
+                                  .dst_offset = gap.offset,
+                                  .size = range.size});
+    gap.offset += range.size;
+    gap.size -= range.size;
+    tree.set(gap_i, gap.size);
+    planned_bytes += range.size;
+    if (planned_bytes >= max_bytes) break;
+  }
+  return moves;
+}
+
+}  // namespace util
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace util {
+
+// Plans relocations that compact the live ranges of a sub-allocated buffer toward its start. Pure
+// cpu: the caller copies the bytes and patches whatever referenced the old offsets.
+
+struct DefragRange {
+  static constexpr u32 pinned = UINT32_MAX;
+  u32 offset;
+  u32 size;
+  // caller defined owner index, or pinned for ranges that can't move
+  u32 id{pinned};
+};
+
+struct DefragMove {
+  u32 id;
+  u32 src_offset;
+  u32 dst_offset;
+  u32 size;
+};
+
+struct DefragStats {
+  u32 free_bytes;
+  u32 largest_gap;
+  u32 gap_cnt;
+  // end of the last live range
+  u32 used_extent;
+};
+
+// ranges may be unsorted but must not overlap or extend past capacity
+[[nodiscard]] DefragStats compute_defrag_stats(std::span<const DefragRange> ranges, u32 capacity);
+
+// Moves the highest movable ranges into the lowest gap below them that holds the whole range, so
+// a move's source and destination never overlap. Sources stay occupied for the rest of the plan
+// since the gpu may still be reading them. Never plans more than max_bytes, so ranges larger than
+// max_bytes are left in place.
+[[nodiscard]] std::vector<DefragMove> plan_defrag_moves(std::span<const DefragRange> ranges,
+                                                        u32 capacity, u32 max_bytes);
+
+}  // namespace util
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <vector>
+
+#include "Common.hpp"
+#include "util/BitOps.hpp"
+
+namespace util {
+
+// Runtime sized bitset. resize keeps the words allocated, so reusing one across frames doesn't
+// allocate.
+class DynamicBitset {
+ public:
+  DynamicBitset() = default;
+  explicit DynamicBitset(size_t size) { resize(size); }
+
+  // clears every bit
+  void resize(size_t size) {
+    size_ = size;
+    words_.assign((size + 63) / 64, 0);
+  }
+  void clear() { std::ranges::fill(words_, 0); }
+
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] bool test(size_t i) const { return words_[i / 64] & (1ull << (i % 64)); }
+  void set(size_t i) { words_[i / 64] |= 1ull << (i % 64); }
+  void reset(size_t i) { words_[i / 64] &= ~(1ull << (i % 64)); }
+  // sets bit i, returns whether it was clear before
+  bool test_and_set(size_t i) {
+    u64& word = words_[i / 64];
+    const u64 mask = 1ull << (i % 64);
+    const bool was_clear = !(word & mask);
+    word |= mask;
+    return was_clear;
+  }
+
+  [[nodiscard]] size_t count() const {
+    size_t cnt{};
+    for (u64 word : words_) cnt += std::popcount(word);
+    return cnt;
+  }
+
+  // calls func with the index of each set bit, in increasing order
+  template <typename F>
+  void for_each_set(const F& func) const {
+    for (size_t w = 0; w < words_.size(); w++) {
+      util::for_each_bit(words_[w], [&](u32 bit) { func((w * 64) + bit); });
+    }
+  }
+
+ private:
+  std::vector<u64> words_;
+  size_t size_{};
+};
+
+}  // namespace util
@@ -0,0 +1,48 @@
+#include "Hash.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <tracy/Tracy.hpp>
+
+namespace util {
+
+namespace {
+
+constexpr u64 hash_prime = 0x9e3779b97f4a7c15ull;
+
+constexpr u64 hash_mix(u64 h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+}  // namespace
+
+// four independent lanes so the multiplies overlap
+u64 hash_bytes(std::span<const std::byte> bytes, u64 seed) {
+  ZoneScoped;
+  std::array<u64, 4> lanes{seed, seed ^ hash_prime, seed + hash_prime, ~seed};
+  const std::byte* data = bytes.data();
+  size_t i = 0;
+  for (; i + 32 <= bytes.size(); i += 32) {
+    for (size_t lane = 0; lane < 4; lane++) {
+      u64 word;
+      std::memcpy(&word, data + i + (lane * 8), 8);
+      lanes[lane] = std::rotl((lanes[lane] ^ word) * hash_prime, 29);
+    }
+  }
+  u64 h = bytes.size() * hash_prime;
+  for (u64 lane : lanes) {
+    h = (h ^ hash_mix(lane)) * hash_prime;
+  }
+  for (; i < bytes.size(); i++) {
+    h = (h ^ static_cast<u64>(data[i])) * hash_prime;
+  }
+  return hash_mix(h);
+}
+
+}  // namespace util
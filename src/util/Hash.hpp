@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+#include "Common.hpp"
+
+namespace util {
+
+// Fast 64 bit hash for detecting changed file contents. Not cryptographic.
+[[nodiscard]] u64 hash_bytes(std::span<const std::byte> bytes, u64 seed = 0);
+
+}  // namespace util
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <span>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace util {
+
+// Counts of values in fixed width bins starting at 0. Values past the last bin are counted in it,
+// so memory stays fixed however long a run is.
+class Histogram {
+ public:
+  Histogram(double bin_width, u32 bin_cnt) : bin_width_(bin_width), bins_(bin_cnt) {
+    assert(bin_width > 0 && bin_cnt > 0);
+  }
+
+  void add(double value) {
+    value = std::max(value, 0.);
+    const auto bin = static_cast<size_t>(value / bin_width_);
+    bins_[std::min(bin, bins_.size() - 1)]++;
+    count_++;
+    sum_ += value;
+    max_ = std::max(max_, value);
+  }
+  void clear() {
+    std::ranges::fill(bins_, 0);
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+  }
+
+  [[nodiscard]] std::span<const u64> get_bins() const { return bins_; }
+  [[nodiscard]] double get_bin_width() const { return bin_width_; }
+  [[nodiscard]] u64 get_count() const { return count_; }
+  [[nodiscard]] double get_mean() const { return count_ ? sum_ / static_cast<double>(count_) : 0; }
+  [[nodiscard]] double get_max() const { return max_; }
+  // upper edge of the bin holding the value of rank p * count, p in [0, 1]
+  [[nodiscard]] double get_percentile(double p) const {
+    const auto rank = std::max<u64>(static_cast<u64>(p * static_cast<double>(count_)), 1);
+    u64 seen{};
+    for (size_t i = 0; i < bins_.size(); i++) {
+      seen += bins_[i];
+      if (seen >= rank) return std::min(static_cast<double>(i + 1) * bin_width_, max_);
+    }
+    return max_;
+  }
+
+ private:
+  double bin_width_;
+  std::vector<u64> bins_;
+  u64 count_{};
+  double sum_{};
+  double max_{};
+};
+
+}  // namespace util
@@ -1,11 +1,29 @@
 #include "IndexAllocator.hpp"
 
+#include <algorithm>
 #include <tracy/Tracy.hpp>
 
 #include "core/Logger.hpp"
 
 namespace util {
 
+IndexAllocator::IndexAllocator(u32 size) { free_list_.reserve(size); }
+
+u32 IndexAllocator::alloc() {
+  if (free_list_.empty()) {
+    return next_index_++;
+  }
+  auto ret = free_list_.back();
+  free_list_.pop_back();
+  return ret;
+}
+
+void IndexAllocator::free(u32 idx) {
+  if (idx != UINT32_MAX) {
+    free_list_.push_back(idx);
+  }
+}
+
 void FreeListAllocator::init(u32 size_bytes, u32 alignment, u32 element_reserve_count) {
   allocs_.reserve(element_reserve_count);
   alignment_ = alignment;
@@ -92,6 +110,40 @@ FreeListAllocator::Slot FreeListAllocator::allocate(u32 size_bytes) {
   return s;
 }
 
+FreeListAllocator::Slot FreeListAllocator::allocate_at(u32 offset, u32 size_bytes) {
+  assert(initialized_);
+  size_bytes += (alignment_ - (size_bytes % alignment_)) % alignment_;
+  if (size_bytes == 0 || offset % alignment_ != 0) {
+    return {};
+  }
+  auto it = std::ranges::find_if(allocs_, [offset, size_bytes](const Slot& s) {
+    return s.is_free() && s.get_offset() <= offset &&
+           offset + size_bytes <= s.get_off_plus_size();
+  });
+  if (it == allocs_.end()) {
+    return {};
+  }
+
+  const Slot free_slot = *it;
+  Slot new_alloc{offset, size_bytes};
+  new_alloc.mark_used();
+  *it = new_alloc;
+  if (offset + size_bytes < free_slot.get_off_plus_size()) {
+    it = allocs_.insert(it + 1, Slot{offset + size_bytes,
+                                     free_slot.get_off_plus_size() - offset - size_bytes});
+    --it;
+  }
+  if (free_slot.get_offset() < offset) {
+    allocs_.insert(it, Slot{free_slot.get_offset(), offset - free_slot.get_offset()});
+  }
+
+  ++num_active_allocs_;
+  max_seen_active_allocs_ = std::max<u32>(max_seen_active_allocs_, num_active_allocs_);
+  max_seen_size_ = std::max<u32>(new_alloc.get_off_plus_size(), max_seen_size_);
+  size_ += size_bytes;
+  return new_alloc;
+}
+
 u32 FreeListAllocator::free(Slot slot) {
   if (slot.size_ == 0) return 0;
   auto it = allocs_.end();
@@ -105,6 +105,9 @@ class FreeListAllocator {
 
   [[nodiscard]] u32 capacity() const { return capacity_; }
   [[nodiscard]] Slot allocate(u32 size_bytes);
+  // Allocates exactly [offset, offset + size_bytes), which must lie in one free slot. Returns an
+  // invalid slot otherwise.
+  [[nodiscard]] Slot allocate_at(u32 offset, u32 size_bytes);
 
   // returns number of bytes freed
   u32 free(Slot slot);
@@ -209,6 +212,16 @@ class FreeListAllocator2 {
     return slot.get_size();
   }
 
+  // Splits an allocated slot into out.size() equal slots. Free slots aren't coalesced, so each
+  // piece can be freed on its own.
+  static void split(Slot slot, std::span<Slot> out) {
+    assert(!out.empty() && slot.get_size() % out.size() == 0);
+    const auto size = static_cast<u32>(slot.get_size() / out.size());
+    for (u32 i = 0; i < out.size(); i++) {
+      out[i] = Slot{slot.get_offset() + (i * size), size};
+    }
+  }
+
  private:
   u32 alignment_{};
   u32 capacity_{};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace util {
+
+// Read-only memory mapping of a whole file. Move only, unmaps on destruction.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile& other) = delete;
+  MappedFile& operator=(const MappedFile& other) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // returns false if the file can't be opened or mapped. Empty files map to an empty span.
+  bool open(const std::filesystem::path& path);
+  void close();
+
+  [[nodiscard]] bool is_open() const { return open_; }
+  [[nodiscard]] std::span<const std::byte> bytes() const { return {data_, size_}; }
+  [[nodiscard]] size_t size() const { return size_; }
+
+ private:
+  const std::byte* data_{};
+  size_t size_{};
+  bool open_{};
+#ifdef _WIN32
+  void* file_handle_{};
+  void* mapping_handle_{};
+#endif
+};
+
+}  // namespace util
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace util {
+
+// A fixed set of equally sized staging slices, filled by producer threads and drained in order by
+// one consumer. Producers reserve space in the open slice, write it and commit a Region describing
+// what they wrote. A slice goes to the consumer once it's sealed and all its reservations are
+// committed. Producers block while every slice is waiting on the consumer, so memory stays bounded
+// no matter how much is streamed through.
+//
+// The ring only hands out offsets, the memory behind each slice belongs to the caller. A producer
+// must commit its reservation before reserving again.
+template <typename Region>
+class StagingRing {
+ public:
+  static constexpr u64 alignment = 16;
+
+  struct Reservation {
+    u32 slice;
+    u64 offset;
+    u64 size;
+  };
+
+  StagingRing(u32 slice_cnt, u64 slice_size) : slices_(slice_cnt), slice_size_(slice_size) {
+    assert(slice_cnt > 0 && slice_size >= alignment);
+    for (u32 i = slice_cnt; i > 0; i--) {
+      free_.emplace_back(i - 1);
+    }
+  }
+
+  // Reserves size bytes, or if less than that is left in the open slice, the largest multiple of
+  // granularity that fits. Opens the next slice when not even granularity fits.
+  Reservation reserve(u64 size, u64 granularity) {
+    assert(granularity > 0 && granularity <= size && granularity <= slice_size_);
+    std::unique_lock lock(mtx_);
+    assert(!closed_);
+    while (true) {
+      if (open_ != null_slice) {
+        auto& slice = slices_[open_];
+        const u64 offset = align_up(slice.used);
+        const u64 avail = offset < slice_size_ ? slice_size_ - offset : 0;
+        const u64 take = size <= avail ? size : avail / granularity * granularity;
+        if (take > 0) {
+          const Reservation result{.slice = open_, .offset = offset, .size = take};
+          used_bytes_ += offset + take - slice.used;
+          peak_used_bytes_ = std::max(peak_used_bytes_, used_bytes_);
+          total_bytes_ += take;
+          slice.used = offset + take;
+          slice.pending++;
+          if (slice.used + alignment > slice_size_) {
+            seal_open();
+          }
+          return result;
+        }
+        seal_open();
+      }
+      if (!free_.empty()) {
+        open_ = free_.back();
+        free_.pop_back();
+        continue;
+      }
+      producer_stalls_++;
+      producer_cv_.wait(lock);
+    }
+  }
+
+  void commit(const Reservation& reservation, const Region& region) {
+    std::scoped_lock lock(mtx_);
+    auto& slice = slices_[reservation.slice];
+    slice.regions.emplace_back(region);
+    assert(slice.pending > 0);
+    if (--slice.pending == 0 && !sealed_.empty() && sealed_.front() == reservation.slice) {
+      consumer_cv_.notify_one();
+    }
+  }
+
+  // Blocks until the oldest sealed slice is fully written. nullopt once closed and drained.
+  std::optional<u32> acquire() {
+    std::unique_lock lock(mtx_);
+    while (true) {
+      if (auto result = pop_ready()) {
+        return result;
+      }
+      if (closed_ && sealed_.empty()) {
+        return std::nullopt;
+      }
+      consumer_cv_.wait(lock);
+    }
+  }
+
+  // Like acquire, but nullopt right away if the oldest sealed slice isn't ready.
+  std::optional<u32> try_acquire() {
+    std::scoped_lock lock(mtx_);
+    return pop_ready();
+  }
+
+  // closed and every sealed slice acquired
+  [[nodiscard]] bool is_drained() {
+    std::scoped_lock lock(mtx_);
+    return closed_ && sealed_.empty();
+  }
+
+  // valid from acquire until release
+  [[nodiscard]] const std::vector<Region>& get_regions(u32 slice) const {
+    return slices_[slice].regions;
+  }
+  [[nodiscard]] u64 get_used(u32 slice) const { return slices_[slice].used; }
+
+  void release(u32 slice) {
+    {
+      std::scoped_lock lock(mtx_);
+      auto& s = slices_[slice];
+      used_bytes_ -= s.used;
+      s.used = 0;
+      s.regions.clear();
+      free_.emplace_back(slice);
+    }
+    producer_cv_.notify_all();
+  }
+
+  // No more reservations. Seals the open slice so the consumer drains it.
+  void close() {
+    {
+      std::scoped_lock lock(mtx_);
+      closed_ = true;
+      if (open_ != null_slice) {
+        if (slices_[open_].used > 0) {
+          seal_open();
+        } else {
+          free_.emplace_back(open_);
+          open_ = null_slice;
+        }
+      }
+    }
+    consumer_cv_.notify_one();
+  }
+
+  [[nodiscard]] u32 slice_count() const { return static_cast<u32>(slices_.size()); }
+  [[nodiscard]] u64 slice_size() const { return slice_size_; }
+  [[nodiscard]] u64 get_peak_used_bytes() const { return peak_used_bytes_; }
+  [[nodiscard]] u64 get_total_bytes() const { return total_bytes_; }
+  [[nodiscard]] u32 get_slices_acquired() const { return slices_acquired_; }
+  // times a producer waited for the consumer to free a slice
+  [[nodiscard]] u32 get_producer_stalls() const { return producer_stalls_; }
+
+ private:
+  static constexpr u32 null_slice = UINT32_MAX;
+  static u64 align_up(u64 offset) { return (offset + alignment - 1) & ~(alignment - 1); }
+
+  std::optional<u32> pop_ready() {
+    if (sealed_.empty() || slices_[sealed_.front()].pending != 0) {
+      return std::nullopt;
+    }
+    const u32 result = sealed_.front();
+    sealed_.pop_front();
+    slices_acquired_++;
+    return result;
+  }
+
+  void seal_open() {
+    sealed_.emplace_back(open_);
+    if (slices_[open_].pending == 0 && sealed_.size() == 1) {
+      consumer_cv_.notify_one();
+    }
+    open_ = null_slice;
+  }
+
+  struct Slice {
+    std::vector<Region> regions;
+    u64 used{};
+    u32 pending{};
+  };
+
+  std::mutex mtx_;
+  std::condition_variable producer_cv_;
+  std::condition_variable consumer_cv_;
+  std::vector<Slice> slices_;
+  std::vector<u32> free_;
+  std::deque<u32> sealed_;
+  u64 slice_size_;
+  u32 open_{null_slice};
+  bool closed_{};
+  u64 used_bytes_{};
+  u64 peak_used_bytes_{};
+  u64 total_bytes_{};
+  u32 slices_acquired_{};
+  u32 producer_stalls_{};
+};
+
+}  // namespace util
@@ -0,0 +1,314 @@
+#include "TLSFAllocator.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+namespace util {
+
+TLSFAllocator::BinIndex TLSFAllocator::bin_for_insert(u32 size) {
+  if (size < sl_count) {
+    return {0, size};
+  }
+  const u32 msb = std::bit_width(size) - 1;
+  return {msb - sl_count_log2 + 1, (size >> (msb - sl_count_log2)) - sl_count};
+}
+
+u64 TLSFAllocator::search_size(u32 size) {
+  if (size < sl_count) {
+    return size;
+  }
+  // round up to the next bin boundary so every block in the bin is large enough
+  const u32 msb = std::bit_width(size) - 1;
+  const u64 bin_width = 1ull << (msb - sl_count_log2);
+  return (static_cast<u64>(size) + bin_width - 1) & ~(bin_width - 1);
+}
+
+TLSFAllocator::BinIndex TLSFAllocator::bin_for_search(u32 size) {
+  const u64 rounded = search_size(size);
+  if (rounded > UINT32_MAX) {
+    return {null_block, 0};
+  }
+  return bin_for_insert(static_cast<u32>(rounded));
+}
+
+void TLSFAllocator::init(u32 size_bytes, u32 alignment, u32 element_reserve_count) {
+  assert(alignment);
+  alignment_ = alignment;
+  blocks_.reserve(element_reserve_count);
+  for (auto& heads : free_heads_) {
+    heads.fill(null_block);
+  }
+  capacity_ = (size_bytes + alignment_ - 1) / alignment_;
+  if (capacity_) {
+    last_block_ = new_block(0, capacity_);
+    insert_free(last_block_);
+  }
+  initialized_ = true;
+}
+
+u32 TLSFAllocator::find_free_block(u32 size) const {
+  auto [fl, sl] = bin_for_search(size);
+  if (fl != null_block) {
+    u32 sl_map = sl_bitmaps_[fl] & (~0u << sl);
+    if (!sl_map) {
+      const u32 fl_map = fl_bitmap_ & (~0u << (fl + 1));
+      if (fl_map) {
+        fl = std::countr_zero(fl_map);
+        sl_map = sl_bitmaps_[fl];
+      }
+    }
+    if (sl_map) {
+      return free_heads_[fl][std::countr_zero(sl_map)];
+    }
+  }
+  return null_block;
+}
+
+u32 TLSFAllocator::new_block(u32 offset, u32 size) {
+  if (!unused_blocks_.empty()) {
+    const u32 b = unused_blocks_.back();
+    unused_blocks_.pop_back();
+    blocks_[b] = Block{.offset = offset, .size = size};
+    return b;
+  }
+  blocks_.emplace_back(Block{.offset = offset, .size = size});
+  return static_cast<u32>(blocks_.size() - 1);
+}
+
+void TLSFAllocator::release_block(u32 block) {
+  // zero size marks the record unused for allocate_at's scan
+  blocks_[block].size = 0;
+  blocks_[block].free = false;
+  unused_blocks_.emplace_back(block);
+}
+
+void TLSFAllocator::link_after(u32 prev, u32 block) {
+  const u32 next = blocks_[prev].next_phys;
+  blocks_[block].prev_phys = prev;
+  blocks_[block].next_phys = next;
+  blocks_[prev].next_phys = block;
+  if (next != null_block) {
+    blocks_[next].prev_phys = block;
+  } else {
+    last_block_ = block;
+  }
+}
+
+void TLSFAllocator::split_tail(u32 block, u32 size) {
+  if (blocks_[block].size <= size) return;
+  // new_block can reallocate blocks_, so index rather than holding references across it
+  const u32 rest = new_block(blocks_[block].offset + size, blocks_[block].size - size);
+  link_after(block, rest);
+  blocks_[block].size = size;
+  insert_free(rest);
+}
+
+void TLSFAllocator::insert_free(u32 block) {
+  auto& b = blocks_[block];
+  const auto [fl, sl] = bin_for_insert(b.size);
+  u32& head = free_heads_[fl][sl];
+  b.free = true;
+  b.prev_free = null_block;
+  b.next_free = head;
+  if (head != null_block) {
+    blocks_[head].prev_free = block;
+  }
+  head = block;
+  fl_bitmap_ |= 1u << fl;
+  sl_bitmaps_[fl] |= 1u << sl;
+  free_block_cnt_++;
+}
+
+void TLSFAllocator::remove_free(u32 block) {
+  auto& b = blocks_[block];
+  assert(b.free);
+  if (b.prev_free != null_block) {
+    blocks_[b.prev_free].next_free = b.next_free;
+  } else {
+    const auto [fl, sl] = bin_for_insert(b.size);
+    free_heads_[fl][sl] = b.next_free;
+    if (b.next_free == null_block) {
+      sl_bitmaps_[fl] &= ~(1u << sl);
+      if (!sl_bitmaps_[fl]) {
+        fl_bitmap_ &= ~(1u << fl);
+      }
+    }
+  }
+  if (b.next_free != null_block) {
+    blocks_[b.next_free].prev_free = b.prev_free;
+  }
+  b.free = false;
+  b.prev_free = null_block;
+  b.next_free = null_block;
+  free_block_cnt_--;
+}
+
+u32 TLSFAllocator::required_capacity(u32 size_bytes) const {
+  const u64 size = (static_cast<u64>(size_bytes) + alignment_ - 1) / alignment_;
+  // growth extends a free trailing block, so only the rest of the searched size is new space
+  u64 trailing_free{};
+  if (last_block_ != null_block && blocks_[last_block_].free) {
+    trailing_free = blocks_[last_block_].size;
+  }
+  const u64 needed = search_size(static_cast<u32>(size));
+  const u64 required = (capacity_ + std::max(needed, trailing_free) - trailing_free) * alignment_;
+  assert(required <= UINT32_MAX);
+  return static_cast<u32>(std::min<u64>(required, UINT32_MAX));
+}
+
+void TLSFAllocator::grow(u32 capacity_bytes) {
+  assert(initialized_);
+  const u32 new_capacity = capacity_bytes / alignment_;
+  if (new_capacity <= capacity_) return;
+  const u32 size = new_capacity - capacity_;
+  grow_cnt_++;
+  if (last_block_ != null_block && blocks_[last_block_].free) {
+    // extend the trailing free block rather than adding a neighbour that would need coalescing
+    remove_free(last_block_);
+    blocks_[last_block_].size += size;
+    insert_free(last_block_);
+  } else {
+    const u32 b = new_block(capacity_, size);
+    if (last_block_ != null_block) {
+      link_after(last_block_, b);
+    } else {
+      last_block_ = b;
+    }
+    insert_free(b);
+  }
+  capacity_ = new_capacity;
+}
+
+TLSFAllocator::Slot TLSFAllocator::allocate(u32 size_bytes) {
+  assert(initialized_);
+  if (size_bytes == 0) {
+    return {};
+  }
+  const auto size = static_cast<u32>((static_cast<u64>(size_bytes) + alignment_ - 1) / alignment_);
+  const u32 b = find_free_block(size);
+  if (b == null_block) {
+    return {};
+  }
+  remove_free(b);
+  split_tail(b, size);
+  used_ += size;
+  num_active_allocs_++;
+  return Slot{blocks_[b].offset * alignment_, size * alignment_, b};
+}
+
+TLSFAllocator::Slot TLSFAllocator::allocate_at(u32 offset, u32 size_bytes) {
+  assert(initialized_);
+  if (size_bytes == 0 || offset % alignment_ != 0) {
+    return {};
+  }
+  const u32 start = offset / alignment_;
+  const u64 end = start + ((static_cast<u64>(size_bytes) + alignment_ - 1) / alignment_);
+  u32 b = null_block;
+  for (u32 i = 0; i < blocks_.size(); i++) {
+    const auto& block = blocks_[i];
+    if (block.free && block.offset <= start &&
+        end <= static_cast<u64>(block.offset) + block.size) {
+      b = i;
+      break;
+    }
+  }
+  if (b == null_block) {
+    return {};
+  }
+  remove_free(b);
+  if (blocks_[b].offset < start) {
+    // keep the head free and allocate from a new block after it
+    const u32 head = b;
+    b = new_block(start, blocks_[head].offset + blocks_[head].size - start);
+    link_after(head, b);
+    blocks_[head].size = start - blocks_[head].offset;
+    insert_free(head);
+  }
+  const auto size = static_cast<u32>(end - start);
+  split_tail(b, size);
+  used_ += size;
+  num_active_allocs_++;
+  return Slot{start * alignment_, size * alignment_, b};
+}
+
+u32 TLSFAllocator::free(Slot slot) {
+  if (!slot.valid()) {
+    return 0;
+  }
+  u32 b = slot.block_;
+  assert(b < blocks_.size() && !blocks_[b].free);
+  assert(blocks_[b].offset * alignment_ == slot.offset_);
+  const u32 size = blocks_[b].size;
+  used_ -= size;
+  num_active_allocs_--;
+
+  const u32 prev = blocks_[b].prev_phys;
+  if (prev != null_block && blocks_[prev].free) {
+    remove_free(prev);
+    const u32 next = blocks_[b].next_phys;
+    blocks_[prev].size += blocks_[b].size;
+    blocks_[prev].next_phys = next;
+    if (next != null_block) {
+      blocks_[next].prev_phys = prev;
+    } else {
+      last_block_ = prev;
+    }
+    release_block(b);
+    b = prev;
+  }
+  const u32 next = blocks_[b].next_phys;
+  if (next != null_block && blocks_[next].free) {
+    remove_free(next);
+    const u32 next_next = blocks_[next].next_phys;
+    blocks_[b].size += blocks_[next].size;
+    blocks_[b].next_phys = next_next;
+    if (next_next != null_block) {
+      blocks_[next_next].prev_phys = b;
+    } else {
+      last_block_ = b;
+    }
+    release_block(next);
+  }
+  insert_free(b);
+  return size * alignment_;
+}
+
+void TLSFAllocator::split(Slot slot, std::span<Slot> out) {
+  const u32 first = slot.block_;
+  assert(!out.empty() && !blocks_[first].free && blocks_[first].size % out.size() == 0);
+  const auto n = static_cast<u32>(out.size());
+  const u32 size = blocks_[first].size / n;
+  const u32 offset = blocks_[first].offset;
+  blocks_[first].size = size;
+  out[0] = Slot{offset * alignment_, size * alignment_, first};
+  u32 prev = first;
+  for (u32 i = 1; i < n; i++) {
+    const u32 b = new_block(offset + (i * size), size);
+    link_after(prev, b);
+    out[i] = Slot{blocks_[b].offset * alignment_, size * alignment_, b};
+    prev = b;
+  }
+  num_active_allocs_ += n - 1;
+}
+
+TLSFAllocator::Stats TLSFAllocator::get_stats() const {
+  u32 largest{};
+  if (fl_bitmap_) {
+    // every block in the highest non-empty bin is larger than any block in the other bins
+    const u32 fl = std::bit_width(fl_bitmap_) - 1;
+    const u32 sl = std::bit_width(sl_bitmaps_[fl]) - 1;
+    for (u32 b = free_heads_[fl][sl]; b != null_block; b = blocks_[b].next_free) {
+      largest = std::max(largest, blocks_[b].size);
+    }
+  }
+  return {.capacity = capacity_ * alignment_,
+          .used_bytes = used_ * alignment_,
+          .free_bytes = (capacity_ - used_) * alignment_,
+          .largest_free_block = largest * alignment_,
+          .free_block_cnt = free_block_cnt_,
+          .num_active_allocs = num_active_allocs_,
+          .grow_cnt = grow_cnt_};
+}
+
+}  // namespace util
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <span>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace util {
+
+// Two-level segregated fit sub-allocator for offsets into a gpu buffer. Allocate and free are O(1):
+// free blocks are binned by size class with bitmaps over the bins, and freed blocks coalesce with
+// their physical neighbours immediately. Searches start one bin above the request so any block
+// found fits; a block in the request's own bin that would also fit can be skipped, which is the
+// usual TLSF trade for O(1). Never grows on its own: see allocate with a grow callback.
+class TLSFAllocator {
+ public:
+  TLSFAllocator() = default;
+  TLSFAllocator(const TLSFAllocator&) = delete;
+  TLSFAllocator(TLSFAllocator&&) = delete;
+  TLSFAllocator& operator=(const TLSFAllocator&) = delete;
+  TLSFAllocator& operator=(TLSFAllocator&&) = delete;
+
+  struct Slot {
+    friend class TLSFAllocator;
+    Slot() = default;
+
+   private:
+    Slot(u32 offset, u32 size, u32 block) : offset_(offset), size_(size), block_(block) {}
+    u32 offset_{};
+    u32 size_{};
+    u32 block_{};
+
+   public:
+    [[nodiscard]] bool valid() const { return size_ != 0; }
+    [[nodiscard]] u32 get_offset() const { return offset_; }
+    [[nodiscard]] u32 get_size() const { return size_; }
+    [[nodiscard]] u32 get_off_plus_size() const { return offset_ + size_; }
+  };
+
+  struct Stats {
+    u32 capacity;
+    u32 used_bytes;
+    u32 free_bytes;
+    u32 largest_free_block;
+    u32 free_block_cnt;
+    u32 num_active_allocs;
+    u32 grow_cnt;
+    // 0 when all free space is one block, approaching 1 as it splinters
+    [[nodiscard]] float fragmentation() const {
+      return free_bytes ? 1.f - (static_cast<float>(largest_free_block) /
+                                 static_cast<float>(free_bytes))
+                        : 0.f;
+    }
+  };
+
+  void init(u32 size_bytes, u32 alignment, u32 element_reserve_count = 100);
+
+  [[nodiscard]] constexpr u32 alloc_size() const { return sizeof(Slot); }
+  [[nodiscard]] u32 capacity() const { return capacity_ * alignment_; }
+
+  // sizes are rounded up to the alignment. returns an invalid slot if no free block fits.
+  [[nodiscard]] Slot allocate(u32 size_bytes);
+
+  // Like allocate, but when no free block fits calls grow_fn(required_bytes), which must resize the
+  // backing buffer to at least required_bytes and return its new size. That size becomes the
+  // capacity and the allocation is retried, which then always succeeds.
+  template <typename GrowFn>
+  [[nodiscard]] Slot allocate(u32 size_bytes, GrowFn&& grow_fn) {
+    Slot slot = allocate(size_bytes);
+    if (!slot.valid() && size_bytes) {
+      const u32 required = required_capacity(size_bytes);
+      const u64 new_capacity = grow_fn(required);
+      assert(new_capacity >= required);
+      grow(static_cast<u32>(std::min<u64>(new_capacity, UINT32_MAX)));
+      slot = allocate(size_bytes);
+      assert(slot.valid());
+    }
+    return slot;
+  }
+
+  // capacity in bytes at which allocate(size_bytes) is sure to succeed
+  [[nodiscard]] u32 required_capacity(u32 size_bytes) const;
+
+  // Adds [capacity(), capacity_bytes) as free space. The backing buffer must already cover it.
+  void grow(u32 capacity_bytes);
+
+  // Allocates exactly [offset, offset + size_bytes), which must lie in one free block. Returns an
+  // invalid slot otherwise. O(blocks), meant for relocating allocations.
+  [[nodiscard]] Slot allocate_at(u32 offset, u32 size_bytes);
+
+  // returns number of bytes freed
+  u32 free(Slot slot);
+
+  // Splits an allocated slot into out.size() equal slots that can each be freed on their own.
+  void split(Slot slot, std::span<Slot> out);
+
+  [[nodiscard]] u32 num_active_allocs() const { return num_active_allocs_; }
+  [[nodiscard]] Stats get_stats() const;
+
+ private:
+  static constexpr u32 sl_count_log2 = 5;
+  static constexpr u32 sl_count = 1 << sl_count_log2;
+  // sizes are in units of alignment_, so the largest first level holds sizes in [2^31, 2^32)
+  static constexpr u32 fl_count = 32 - sl_count_log2 + 1;
+  static constexpr u32 null_block = UINT32_MAX;
+
+  struct Block {
+    u32 offset;
+    u32 size;
+    u32 prev_phys{null_block};
+    u32 next_phys{null_block};
+    u32 prev_free{null_block};
+    u32 next_free{null_block};
+    bool free{};
+  };
+
+  struct BinIndex {
+    u32 fl;
+    u32 sl;
+  };
+  [[nodiscard]] static BinIndex bin_for_insert(u32 size);
+  // first bin whose blocks are all >= size. fl is null_block if the size can't be binned.
+  [[nodiscard]] static BinIndex bin_for_search(u32 size);
+  // smallest block size in bin_for_search(size)
+  [[nodiscard]] static u64 search_size(u32 size);
+
+  [[nodiscard]] u32 find_free_block(u32 size) const;
+  [[nodiscard]] u32 new_block(u32 offset, u32 size);
+  void insert_free(u32 block);
+  void remove_free(u32 block);
+  void release_block(u32 block);
+  void link_after(u32 prev, u32 block);
+  // splits the tail past size off of a used block into a new free block
+  void split_tail(u32 block, u32 size);
+
+  std::vector<Block> blocks_;
+  std::vector<u32> unused_blocks_;
+  std::array<std::array<u32, sl_count>, fl_count> free_heads_{};
+  std::array<u32, fl_count> sl_bitmaps_{};
+  u32 fl_bitmap_{};
+  u32 last_block_{null_block};
+  u32 alignment_{1};
+  u32 capacity_{};
+  u32 used_{};
+  u32 free_block_cnt_{};
+  u32 num_active_allocs_{};
+  u32 grow_cnt_{};
+  bool initialized_{};
+};
+
+}  // namespace util
@@ -0,0 +1,150 @@
+#include "UploadPlanner.hpp"
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <tracy/Tracy.hpp>
+
+namespace util {
+
+namespace {
+
+u64 end_of(const UploadCopy& copy) { return copy.dst_offset + copy.size; }
+
+// A copy goes one generation after the latest earlier copy it overlaps. order holds one dst's
+// copies sorted by offset, the sweep only runs for buffers that actually overlap. Generations
+// only grow in queue order, so the last copy to cover a byte has the highest generation there.
+// Sweeping in queue order with the last generation per covered range is O(n log n).
+void assign_generations(std::span<const UploadCopy> copies, std::span<u32> order,
+                        std::vector<u32>& generations) {
+  u64 max_end{};
+  bool any_overlap = false;
+  for (u32 i : order) {
+    any_overlap |= copies[i].dst_offset < max_end;
+    max_end = std::max(max_end, end_of(copies[i]));
+  }
+  if (!any_overlap) return;
+  std::ranges::sort(order);
+  struct Covered {
+    u64 end;
+    u32 generation;
+  };
+  // disjoint ranges keyed by their start
+  std::map<u64, Covered> covered;
+  for (u32 i : order) {
+    const u64 begin = copies[i].dst_offset;
+    const u64 end = end_of(copies[i]);
+    if (begin == end) continue;
+    auto first = covered.upper_bound(begin);
+    if (first != covered.begin() && std::prev(first)->second.end > begin) --first;
+    auto last = first;
+    u32 generation{};
+    for (; last != covered.end() && last->first < end; ++last) {
+      generation = std::max(generation, last->second.generation + 1);
+    }
+    generations[i] = generation;
+    // the parts of the first and last overlapped ranges that stick out keep their generation
+    std::optional<std::pair<u64, Covered>> head, tail;
+    if (first != last && first->first < begin) {
+      head = {first->first, Covered{begin, first->second.generation}};
+    }
+    if (first != last && std::prev(last)->second.end > end) {
+      tail = {end, Covered{std::prev(last)->second.end, std::prev(last)->second.generation}};
+    }
+    auto hint = covered.erase(first, last);
+    if (tail) hint = covered.emplace_hint(hint, *tail);
+    hint = covered.emplace_hint(hint, begin, Covered{end, generation});
+    if (head) covered.emplace_hint(hint, *head);
+  }
+}
+
+}  // namespace
+
+UploadPlan plan_uploads(std::span<const UploadCopy> copies) {
+  ZoneScoped;
+  UploadPlan plan;
+  if (copies.empty()) return plan;
+
+  std::vector<u32> order(copies.size());
+  std::iota(order.begin(), order.end(), 0);
+  auto by_dst_offset = [&](u32 a, u32 b) {
+    const auto& ca = copies[a];
+    const auto& cb = copies[b];
+    if (ca.dst != cb.dst) return ca.dst < cb.dst;
+    if (ca.dst_offset != cb.dst_offset) return ca.dst_offset < cb.dst_offset;
+    return a < b;
+  };
+  std::ranges::sort(order, by_dst_offset);
+
+  std::vector<u32> generations(copies.size());
+  for (size_t begin = 0; begin < order.size();) {
+    size_t end = begin + 1;
+    while (end < order.size() && copies[order[end]].dst == copies[order[begin]].dst) end++;
+    const std::span group{order.data() + begin, end - begin};
+
+    // barrier ranges, from the offset sorted order before generations can reshuffle it
+    const size_t first_range = plan.dst_ranges.size();
+    for (u32 i : group) {
+      const auto& copy = copies[i];
+      if (!plan.dst_ranges.empty() && plan.dst_ranges.back().dst == copy.dst &&
+          copy.dst_offset <= plan.dst_ranges.back().offset + plan.dst_ranges.back().size) {
+        auto& range = plan.dst_ranges.back();
+        range.size = std::max(range.offset + range.size, end_of(copy)) - range.offset;
+        range.dst_stage |= copy.dst_stage;
+        range.dst_access |= copy.dst_access;
+      } else {
+        plan.dst_ranges.emplace_back(UploadDstRange{.dst = copy.dst,
+                                                    .offset = copy.dst_offset,
+                                                    .size = copy.size,
+                                                    .dst_stage = copy.dst_stage,
+                                                    .dst_access = copy.dst_access});
+      }
+    }
+    if (plan.dst_ranges.size() - first_range > max_dst_ranges) {
+      // scattered writes, e.g. dirty transforms: one barrier over the span is cheaper
+      auto& range = plan.dst_ranges[first_range];
+      for (size_t i = first_range + 1; i < plan.dst_ranges.size(); i++) {
+        range.size = plan.dst_ranges[i].offset + plan.dst_ranges[i].size - range.offset;
+        range.dst_stage |= plan.dst_ranges[i].dst_stage;
+        range.dst_access |= plan.dst_ranges[i].dst_access;
+      }
+      plan.dst_ranges.resize(first_range + 1);
+    }
+    assign_generations(copies, group, generations);
+    begin = end;
+  }
+
+  std::ranges::sort(order, [&](u32 a, u32 b) {
+    if (generations[a] != generations[b]) return generations[a] < generations[b];
+    return by_dst_offset(a, b);
+  });
+  for (size_t i = 0; i < order.size(); i++) {
+    const auto& copy = copies[order[i]];
+    const u32 generation = generations[order[i]];
+    const bool new_generation = i == 0 || generation != generations[order[i - 1]];
+    if (new_generation) {
+      plan.generation_starts.emplace_back(static_cast<u32>(plan.batches.size()));
+    }
+    if (new_generation || copy.dst != plan.batches.back().dst) {
+      plan.batches.emplace_back(UploadBatch{.dst = copy.dst,
+                                            .first_region = static_cast<u32>(plan.regions.size()),
+                                            .region_cnt = 0});
+    }
+    auto& batch = plan.batches.back();
+    if (batch.region_cnt > 0) {
+      auto& last = plan.regions.back();
+      if (last.src_offset + last.size == copy.src_offset &&
+          last.dst_offset + last.size == copy.dst_offset) {
+        last.size += copy.size;
+        continue;
+      }
+    }
+    plan.regions.emplace_back(UploadRegion{
+        .src_offset = copy.src_offset, .dst_offset = copy.dst_offset, .size = copy.size});
+    batch.region_cnt++;
+  }
+  return plan;
+}
+
+}  // namespace util
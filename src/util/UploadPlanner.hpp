@@ -0,0 +1,61 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "Common.hpp"
+
+namespace util {
+
+// Turns a frame's queued staging copies into as few copy commands and barriers as possible. Pure
+// cpu: the caller records the plan.
+
+struct UploadCopy {
+  // caller defined destination buffer index
+  u32 dst;
+  u64 src_offset;
+  u64 dst_offset;
+  u64 size;
+  // stage and access bits of the first use after the copy, ORed into the range's barrier
+  u64 dst_stage;
+  u64 dst_access;
+};
+
+struct UploadRegion {
+  u64 src_offset;
+  u64 dst_offset;
+  u64 size;
+};
+
+// one copy command: regions [first_region, first_region + region_cnt) into dst
+struct UploadBatch {
+  u32 dst;
+  u32 first_region;
+  u32 region_cnt;
+};
+
+// union of the bytes written to a buffer, one barrier each. A buffer with more than
+// max_dst_ranges disjoint ranges gets a single range spanning all of them.
+constexpr size_t max_dst_ranges = 64;
+struct UploadDstRange {
+  u32 dst;
+  u64 offset;
+  u64 size;
+  u64 dst_stage;
+  u64 dst_access;
+};
+
+struct UploadPlan {
+  std::vector<UploadRegion> regions;
+  std::vector<UploadBatch> batches;
+  // Batches of one generation write disjoint bytes. Each generation after the first needs a
+  // transfer to transfer barrier before it. Starts index into batches.
+  std::vector<u32> generation_starts;
+  std::vector<UploadDstRange> dst_ranges;
+};
+
+// Copies are in the order they were queued, later ones win where they overlap. Regions that are
+// contiguous in both staging and destination memory are merged.
+[[nodiscard]] UploadPlan plan_uploads(std::span<const UploadCopy> copies);
+
+}  // namespace util
@@ -7,6 +7,7 @@
 #include <vulkan/vk_enum_string_helper.h>
 #include <vulkan/vulkan_core.h>
 
+#include <algorithm>
 #include <cassert>
 #include <thread>
 #include <tracy/Tracy.hpp>
@@ -21,6 +22,7 @@
 #include "VkBootstrap.h"
 #include "VkCommon.hpp"
 #include "core/Logger.hpp"
+#include "core/Timer.hpp"
 #include "vk2/Buffer.hpp"
 #include "vk2/Resource.hpp"
 #include "vk2/Texture.hpp"
@@ -110,6 +112,9 @@ void Device::init_impl(const CreateInfo& info) {
     if (info.enable_validation_layers) {
       instance_builder.request_validation_layers(true);
     }
+    if (!info.window) {
+      instance_builder.set_headless(true);
+    }
 
 #if defined(__APPLE__)
     instance_builder.add_validation_feature_disable(VK_VALIDATION_FEATURE_DISABLE_SHADERS_EXT);
@@ -129,7 +134,7 @@ void Device::init_impl(const CreateInfo& info) {
     volkLoadInstance(instance_.instance);
   }
 
-  {
+  if (info.window) {
     ZoneScopedN("glfw init");
     glfwCreateWindowSurface(instance_.instance, info.window, nullptr, &surface_);
     if (!surface_) {
@@ -188,7 +193,8 @@ void Device::init_impl(const CreateInfo& info) {
                 .set_required_features_12(supported_features12_)
                 .set_required_features_11(features11)
                 .add_required_extensions(extensions)
-                .allow_any_gpu_device_type(false)
+                // software ICDs (lavapipe, swiftshader) report a cpu device, fine for headless
+                .allow_any_gpu_device_type(is_headless())
                 .prefer_gpu_device_type(vkb::PreferredDeviceType::discrete)
                 .add_required_extension_features(dynamic_rendering_features)
                 .add_required_extension_features(sync2_features)
@@ -308,7 +314,12 @@ void Device::init_impl(const CreateInfo& info) {
   }
 
   init_bindless();
-  {
+  if (is_headless()) {
+    create_offscreen_swapchain(swapchain_,
+                               vk2::SwapchainDesc{.width = info.headless_dims.x,
+                                                  .height = info.headless_dims.y,
+                                                  .buffer_count = frames_in_flight});
+  } else {
     int w, h;
     glfwGetWindowSize(window_, &w, &h);
     swapchain_.surface = surface_;
@@ -318,6 +329,9 @@ void Device::init_impl(const CreateInfo& info) {
                                                     .vsync = info.vsync});
   }
 
+  graphics_copy_allocator_.init();
+  transfer_copy_allocator_.init();
+
   // transition handler
   for (auto& transition_handler : transition_handlers_) {
     transition_handler.cmd_pool = create_command_pool(
@@ -522,6 +536,12 @@ BufferHandle Device::create_buffer(const BufferCreateInfo& cinfo) {
 
   VkBufferCreateInfo buffer_create_info{
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = cinfo.size, .usage = usage};
+  // same as images: buffers move between queues without ownership transfers
+  if (queue_family_indices_.size() > 1) {
+    buffer_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    buffer_create_info.queueFamilyIndexCount = queue_family_indices_.size();
+    buffer_create_info.pQueueFamilyIndices = queue_family_indices_.data();
+  }
 
   VK_CHECK(vmaCreateBuffer(allocator_, &buffer_create_info, &alloc_info, &buffer->buffer_,
                            &buffer->allocation_, &buffer->info_));
@@ -547,10 +567,18 @@ BufferHandle Device::create_buffer(const BufferCreateInfo& cinfo) {
   return handle;
 }
 
+void Device::CopyAllocator::init() {
+  if (device_->get_queue(type_).queue == VK_NULL_HANDLE) {
+    type_ = QueueType::Graphics;
+  }
+  timeline_ = device_->create_semaphore(true, "copy allocator timeline");
+}
+
 Device::CopyAllocator::CopyCmd Device::CopyAllocator::allocate(u64 size) {
   CopyCmd cmd;
   {
     std::scoped_lock lock(free_list_mtx_);
+    reclaim_unsafe();
     for (size_t i = 0; i < free_copy_cmds_.size(); i++) {
       auto& free_cmd = free_copy_cmds_[i];
       if (free_cmd.is_valid()) {
@@ -571,48 +599,115 @@ Device::CopyAllocator::CopyCmd Device::CopyAllocator::allocate(u64 size) {
     cmd.transfer_cmd_buf = device_->create_command_buffer(cmd.transfer_cmd_pool);
     cmd.staging_buffer = device_->create_buffer(BufferCreateInfo{
         .size = std::max<u64>(size, 1024ul * 64), .flags = BufferCreateFlags_HostVisible});
-
-    VkFenceCreateInfo info{.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = 0};
-    VK_CHECK(vkCreateFence(device_->device_, &info, nullptr, &cmd.fence));
   }
   VK_CHECK(vkResetCommandPool(device_->device_, cmd.transfer_cmd_pool, 0));
 
   VkCommandBufferBeginInfo cmd_buf_begin_info{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
                                               .flags = 0};
   VK_CHECK(vkBeginCommandBuffer(cmd.transfer_cmd_buf, &cmd_buf_begin_info));
-  VK_CHECK(vkResetFences(device_->device_, 1, &cmd.fence));
   return cmd;
 }
 
-void Device::CopyAllocator::submit(CopyCmd cmd) {
+Device::CopyAllocator::CopyTicket Device::CopyAllocator::submit(
+    CopyCmd cmd, std::span<const CopyTicket> wait_for) {
   ZoneScoped;
+  assert(timeline_);
   // need to transfer ownership?
   VK_CHECK(vkEndCommandBuffer(cmd.transfer_cmd_buf));
   VkCommandBufferSubmitInfo cb_submit{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
                                       .commandBuffer = cmd.transfer_cmd_buf};
-  VkSubmitInfo2 submit_info{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
-                            .commandBufferInfoCount = 1,
-                            .pCommandBufferInfos = &cb_submit};
-  device_->get_queue(type_).submit(1, &submit_info, cmd.fence);
-  VkResult res{};
-  while ((res = vkWaitForFences(device_->device_, 1, &cmd.fence, true,
-                                gfx::Device::timeout_value)) == VK_TIMEOUT) {
-    LINFO("vkWaitForFences TIMEOUT, CopyAllocator: QueueType::Transfer");
-    std::this_thread::yield();
+  std::vector<VkSemaphoreSubmitInfo> wait_infos;
+  for (const auto& ticket : wait_for) {
+    assert(ticket.is_valid());
+    // tickets from this allocator are already ordered by the queue
+    if (ticket.semaphore == timeline_ || is_done(ticket)) continue;
+    wait_infos.emplace_back(vk2::init::semaphore_submit_info(
+        ticket.semaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, ticket.value));
+  }
+  CopyTicket ticket{.semaphore = timeline_};
+  {
+    std::scoped_lock lock(submit_mtx_);
+    ticket.value = next_value_++;
+    VkSemaphoreSubmitInfo signal_info = vk2::init::semaphore_submit_info(
+        timeline_, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, ticket.value);
+    VkSubmitInfo2 submit_info{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+                              .waitSemaphoreInfoCount = static_cast<u32>(wait_infos.size()),
+                              .pWaitSemaphoreInfos = wait_infos.data(),
+                              .commandBufferInfoCount = 1,
+                              .pCommandBufferInfos = &cb_submit,
+                              .signalSemaphoreInfoCount = 1,
+                              .pSignalSemaphoreInfos = &signal_info};
+    device_->get_queue(type_).submit(1, &submit_info, VK_NULL_HANDLE);
+    last_submitted_value_.store(ticket.value, std::memory_order_release);
   }
 
+  std::scoped_lock lock(free_list_mtx_);
+  in_flight_cmds_.emplace_back(InFlightCmd{.cmd = cmd, .value = ticket.value});
+  return ticket;
+}
+
+void Device::CopyAllocator::free(CopyCmd cmd) {
+  // allocate resets the pool, which takes the cmd buffer out of the recording state
   std::scoped_lock lock(free_list_mtx_);
   free_copy_cmds_.emplace_back(cmd);
 }
 
+bool Device::CopyAllocator::is_done(CopyTicket ticket) const {
+  u64 value{};
+  VK_CHECK(vkGetSemaphoreCounterValue(device_->device_, ticket.semaphore, &value));
+  return value >= ticket.value;
+}
+
+void Device::CopyAllocator::wait(CopyTicket ticket) const {
+  ZoneScoped;
+  VkSemaphoreWaitInfo info{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                           .semaphoreCount = 1,
+                           .pSemaphores = &ticket.semaphore,
+                           .pValues = &ticket.value};
+  VkResult res{};
+  while ((res = vkWaitSemaphores(device_->device_, &info, gfx::Device::timeout_value)) ==
+         VK_TIMEOUT) {
+    LINFO("vkWaitSemaphores TIMEOUT, CopyAllocator ticket {}", ticket.value);
+    std::this_thread::yield();
+  }
+  VK_CHECK(res);
+}
+
+Device::CopyAllocator::CopyTicket Device::CopyAllocator::get_last_ticket() const {
+  const u64 value = last_submitted_value_.load(std::memory_order_acquire);
+  return value ? CopyTicket{.semaphore = timeline_, .value = value} : CopyTicket{};
+}
+
+void Device::CopyAllocator::reclaim_unsafe() {
+  if (in_flight_cmds_.empty()) {
+    return;
+  }
+  u64 completed{};
+  VK_CHECK(vkGetSemaphoreCounterValue(device_->device_, timeline_, &completed));
+  std::erase_if(in_flight_cmds_, [&](const InFlightCmd& in_flight) {
+    if (in_flight.value > completed) return false;
+    free_copy_cmds_.emplace_back(in_flight.cmd);
+    return true;
+  });
+}
+
 void Device::CopyAllocator::destroy() {
+  if (!timeline_) {
+    return;
+  }
+  if (auto ticket = get_last_ticket(); ticket.is_valid()) {
+    wait(ticket);
+  }
   std::scoped_lock lock(free_list_mtx_);
+  reclaim_unsafe();
+  assert(in_flight_cmds_.empty());
   for (auto& el : free_copy_cmds_) {
-    vkDestroyFence(device_->device_, el.fence, nullptr);
     vkDestroyCommandPool(device_->device_, el.transfer_cmd_pool, nullptr);
     device_->destroy(el.staging_buffer);
   }
   free_copy_cmds_.clear();
+  device_->destroy_semaphore(timeline_);
+  timeline_ = VK_NULL_HANDLE;
 }
 
 void Device::init_imgui() {
@@ -620,7 +715,7 @@ void Device::init_imgui() {
   ImGui::CreateContext();
   ImGuiIO& io = ImGui::GetIO();
   (void)io;
-  if (!ImGui_ImplGlfw_InitForVulkan(window_, true)) {
+  if (!is_headless() && !ImGui_ImplGlfw_InitForVulkan(window_, true)) {
     LCRITICAL("ImGui_ImplGlfw_InitForVulkan failed");
     exit(1);
   }
@@ -687,6 +782,13 @@ VkImage Device::get_swapchain_img(u32 idx) const {
 
 void Device::acquire_next_image(CmdEncoder* cmd) {
   ZoneScoped;
+  if (is_headless()) {
+    // nothing to wait on or present, the frame fences keep an image from being reused while the
+    // gpu is still writing it
+    swapchain_.curr_swapchain_idx =
+        (swapchain_.curr_swapchain_idx + 1) % swapchain_.device_imgs.size();
+    return;
+  }
   swapchain_.acquire_semaphore_idx =
       (swapchain_.acquire_semaphore_idx + 1) % swapchain_.device_imgs.size();
   VkResult acquire_next_image_result;
@@ -789,6 +891,14 @@ Device::~Device() {
     }
   }
 
+  for (auto& slot : secondary_cmd_slots_) {
+    for (auto& pools : slot.pools) {
+      for (auto& pool : pools) {
+        if (pool) vkDestroyCommandPool(device_, pool, nullptr);
+      }
+    }
+  }
+
   graphics_copy_allocator_.destroy();
   transfer_copy_allocator_.destroy();
 
@@ -825,7 +935,7 @@ Device::~Device() {
     ZoneScopedN("shutdown base");
     vmaDestroyAllocator(allocator_);
     vkb::destroy_device(vkb_device_);
-    vkb::destroy_surface(instance_, surface_);
+    if (surface_) vkb::destroy_surface(instance_, surface_);
     volkFinalize();
     vkb::destroy_instance(instance_);
   }
@@ -991,9 +1101,10 @@ Holder<ImageHandle> Device::create_image_holder(const ImageDesc& desc, void* ini
   return Holder<ImageHandle>{create_image(desc, initial_data)};
 }
 
-ImageHandle Device::create_image(const ImageDesc& desc, void*) {
+VkImageCreateInfo Device::get_image_create_info(const ImageDesc& desc,
+                                                VmaAllocationCreateInfo& alloc_create_info) const {
   VkImageCreateInfo cinfo{.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
-  VmaAllocationCreateInfo alloc_create_info{.usage = VMA_MEMORY_USAGE_AUTO};
+  alloc_create_info = {.usage = VMA_MEMORY_USAGE_AUTO};
   if (has_flag(desc.bind_flags, BindFlag::ColorAttachment)) {
     cinfo.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     alloc_create_info.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
@@ -1059,6 +1170,12 @@ ImageHandle Device::create_image(const ImageDesc& desc, void*) {
   if (desc.usage == Usage::Default) {
     alloc_create_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
   }
+  return cinfo;
+}
+
+ImageHandle Device::create_image(const ImageDesc& desc, void*) {
+  VmaAllocationCreateInfo alloc_create_info;
+  const auto cinfo = get_image_create_info(desc, alloc_create_info);
   auto handle = img_pool_.alloc();
   Image* image = img_pool_.get(handle);
   image->desc_ = desc;
@@ -1079,6 +1196,58 @@ ImageHandle Device::create_image(const ImageDesc& desc, void*) {
   //   }
   // }
 
+  init_image_views(handle);
+  return handle;
+}
+
+VkMemoryRequirements Device::get_image_memory_requirements(const ImageDesc& desc) {
+  VmaAllocationCreateInfo alloc_create_info;
+  const auto cinfo = get_image_create_info(desc, alloc_create_info);
+  // 1.2 has no vkGetDeviceImageMemoryRequirements, ask a throwaway image
+  VkImage image{};
+  VK_CHECK(vkCreateImage(device_, &cinfo, nullptr, &image));
+  VkMemoryRequirements reqs{};
+  vkGetImageMemoryRequirements(device_, image, &reqs);
+  vkDestroyImage(device_, image, nullptr);
+  return reqs;
+}
+
+VmaAllocation Device::allocate_memory(const VkMemoryRequirements& reqs) {
+  const VmaAllocationCreateInfo alloc_create_info{
+      .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+      .usage = VMA_MEMORY_USAGE_UNKNOWN,
+      .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+  VmaAllocation allocation{};
+  VK_CHECK(vmaAllocateMemory(allocator_, &reqs, &alloc_create_info, &allocation, nullptr));
+  return allocation;
+}
+
+void Device::free_memory(VmaAllocation allocation) {
+  if (allocation) {
+    memory_delete_q_.emplace_back(allocation, curr_frame_num());
+  }
+}
+
+ImageHandle Device::create_placed_image(const ImageDesc& desc, VmaAllocation memory, u64 offset) {
+  VmaAllocationCreateInfo alloc_create_info;
+  const auto cinfo = get_image_create_info(desc, alloc_create_info);
+  auto handle = img_pool_.alloc();
+  Image* image = img_pool_.get(handle);
+  image->desc_ = desc;
+  // allocation_ stays null, the memory belongs to the caller
+  VK_CHECK(vkCreateImage(device_, &cinfo, nullptr, &image->image_));
+  if (!image->image()) {
+    return {};
+  }
+  VK_CHECK(vmaBindImageMemory2(allocator_, memory, offset, image->image_, nullptr));
+  init_image_views(handle);
+  return handle;
+}
+
+void Device::init_image_views(ImageHandle handle) {
+  Image* image = img_pool_.get(handle);
+  const auto& desc = image->get_desc();
+
   if (desc.usage == Usage::Default) {
     // depth stencil also needs a subresource
     if (has_flag(desc.bind_flags, BindFlag::ColorAttachment | BindFlag::DepthStencilAttachment)) {
@@ -1114,8 +1283,6 @@ ImageHandle Device::create_image(const ImageDesc& desc, void*) {
                                                 desc.mip_levels, 0, desc.array_layers);
     }
   }
-
-  return handle;
 }
 
 i32 Device::create_subresource(ImageHandle image_handle, u32 base_mip_level, u32 level_count,
@@ -1284,6 +1451,15 @@ void Device::flush_deletions() {
     return false;
   });
 
+  // after the images placed into it
+  std::erase_if(memory_delete_q_, [this](const DeleteQEntry<VmaAllocation>& entry) {
+    if (entry.frame + frames_in_flight < curr_frame_num()) {
+      vmaFreeMemory(allocator_, entry.data);
+      return true;
+    }
+    return false;
+  });
+
   std::erase_if(semaphore_delete_q_, [this](const DeleteQEntry<VkSemaphore>& entry) {
     if (entry.frame + frames_in_flight < curr_frame_num()) {
       vkDestroySemaphore(device_, entry.data, nullptr);
@@ -1504,10 +1680,14 @@ void Device::init_bindless() {
 }
 
 void Device::bind_bindless_descriptors(CmdEncoder& cmd) {
-  cmd.bind_descriptor_set(VK_PIPELINE_BIND_POINT_GRAPHICS, default_pipeline_layout_, &main_set_, 0);
+  // compute queues have no graphics bind point
+  if (cmd.queue_ == QueueType::Graphics) {
+    cmd.bind_descriptor_set(VK_PIPELINE_BIND_POINT_GRAPHICS, default_pipeline_layout_, &main_set_,
+                            0);
+    cmd.bind_descriptor_set(VK_PIPELINE_BIND_POINT_GRAPHICS, default_pipeline_layout_, &main_set2_,
+                            1);
+  }
   cmd.bind_descriptor_set(VK_PIPELINE_BIND_POINT_COMPUTE, default_pipeline_layout_, &main_set_, 0);
-  cmd.bind_descriptor_set(VK_PIPELINE_BIND_POINT_GRAPHICS, default_pipeline_layout_, &main_set2_,
-                          1);
   cmd.bind_descriptor_set(VK_PIPELINE_BIND_POINT_COMPUTE, default_pipeline_layout_, &main_set2_, 1);
 }
 
@@ -1665,7 +1845,15 @@ void Device::render_imgui(CmdEncoder& cmd) {
 
 void Device::new_imgui_frame() {
   ImGui_ImplVulkan_NewFrame();
-  ImGui_ImplGlfw_NewFrame();
+  if (is_headless()) {
+    // the glfw backend normally fills these in
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(static_cast<float>(swapchain_.dims.x),
+                            static_cast<float>(swapchain_.dims.y));
+    io.DeltaTime = 1.f / 60.f;
+  } else {
+    ImGui_ImplGlfw_NewFrame();
+  }
   ImGui::NewFrame();
 }
 
@@ -1677,14 +1865,14 @@ void Device::enqueue_delete_texture_view(VkImageView view) {
   texture_view_delete_q2_.emplace_back(view, curr_frame_num());
 }
 
-void Device::Queue::wait(VkSemaphore semaphore) {
+void Device::Queue::wait(VkSemaphore semaphore, u64 value) {
   if (!queue) {
     return;
   }
   wait_semaphores_infos.emplace_back(VkSemaphoreSubmitInfo{
       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
       .semaphore = semaphore,
-      .value = 0,  // no timeline
+      .value = value,
       .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
       .deviceIndex = 0,
   });
@@ -1772,8 +1960,34 @@ void Device::Queue::submit(Device* device, VkFence fence) {
   }
 }
 
+void Device::wait_for_copy(CopyAllocator::CopyTicket ticket) {
+  if (!ticket.is_valid()) return;
+  std::scoped_lock lock(copy_waits_mtx_);
+  copy_waits_.emplace_back(ticket);
+}
+
 void Device::submit_commands() {
   ZoneScoped;
+  // only copies the frame reads, copies still streaming in for unpublished resources don't hold
+  // it up. a timeline value covers every earlier one, so one wait per semaphore.
+  std::vector<CopyAllocator::CopyTicket> copy_waits;
+  {
+    std::scoped_lock lock(copy_waits_mtx_);
+    copy_waits.swap(copy_waits_);
+  }
+  std::ranges::sort(copy_waits, [](const auto& a, const auto& b) {
+    return a.semaphore != b.semaphore ? a.semaphore < b.semaphore : a.value > b.value;
+  });
+  for (size_t i = 0; i < copy_waits.size(); i++) {
+    const auto& ticket = copy_waits[i];
+    if (i > 0 && copy_waits[i - 1].semaphore == ticket.semaphore) continue;
+    u64 value{};
+    VK_CHECK(vkGetSemaphoreCounterValue(device_, ticket.semaphore, &value));
+    if (value >= ticket.value) continue;
+    for (auto& queue : queues_) {
+      queue.wait(ticket.semaphore, ticket.value);
+    }
+  }
   // transition resources (images) to graphics queue
   if (!init_transitions_.empty()) {
     // place barriers and submit to grpahics queue
@@ -1888,6 +2102,7 @@ void Device::submit_commands() {
         wait_fences[wait_fence_cnt++] = fence;
       }
     }
+    Timer wait_timer;
     if (wait_fence_cnt > 0) {
       while (true) {
         VkResult res =
@@ -1912,6 +2127,7 @@ void Device::submit_commands() {
       }
     }
 
+    last_fence_wait_ms_ = wait_fence_cnt > 0 ? wait_timer.elapsed_ms() : 0.;
     if (reset_fence_cnt > 0) {
       VK_CHECK(vkResetFences(device_, reset_fence_cnt, reset_fences));
     }
@@ -1951,6 +2167,55 @@ CmdEncoder* Device::begin_command_list(QueueType queue_type) {
   return cmd;
 }
 
+CmdEncoder* Device::begin_secondary_command_list(u32 slot_i, QueueType queue_type) {
+  ZoneScoped;
+  assert(slot_i < max_secondary_cmd_slots);
+  auto& slot = secondary_cmd_slots_[slot_i];
+  const u32 frame = curr_frame_in_flight();
+  const u32 queue_i = (u32)queue_type;
+  if (slot.frame_num != curr_frame_num()) {
+    // the frame fences this slot's pools were last used with have been waited on
+    for (auto pool : slot.pools[frame]) {
+      if (pool) VK_CHECK(vkResetCommandPool(device_, pool, 0));
+    }
+    std::ranges::fill(slot.used_cmd_bufs, 0);
+    slot.used_encoders = 0;
+    slot.frame_num = curr_frame_num();
+  }
+  if (!slot.pools[frame][queue_i]) {
+    slot.pools[frame][queue_i] = create_command_pool(queue_type, 0, "secondary cmd pool");
+  }
+  auto& cmd_bufs = slot.cmd_bufs[frame][queue_i];
+  if (slot.used_cmd_bufs[queue_i] == cmd_bufs.size()) {
+    VkCommandBufferAllocateInfo info{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                                     .commandPool = slot.pools[frame][queue_i],
+                                     .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                                     .commandBufferCount = 1};
+    VK_CHECK(vkAllocateCommandBuffers(device_, &info, &cmd_bufs.emplace_back()));
+  }
+  if (slot.used_encoders == slot.encoders.size()) {
+    slot.encoders.emplace_back(std::make_unique<CmdEncoder>(this, default_pipeline_layout_));
+  }
+  CmdEncoder* cmd = slot.encoders[slot.used_encoders++].get();
+  cmd->queue_ = queue_type;
+  cmd->id_ = UINT32_MAX;
+  cmd->reset(frame);
+  cmd->command_bufs_[frame][queue_i] = cmd_bufs[slot.used_cmd_bufs[queue_i]++];
+
+  // nothing is inherited, passes start every render pass instance themselves
+  VkCommandBufferInheritanceInfo inheritance{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+  VkCommandBufferBeginInfo begin_info{.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                                      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                                      .pInheritanceInfo = &inheritance};
+  VK_CHECK(vkBeginCommandBuffer(cmd->get_cmd_buf(), &begin_info));
+  return cmd;
+}
+
+void Device::end_secondary_command_list(CmdEncoder& cmd) {
+  VK_CHECK(vkEndCommandBuffer(cmd.get_cmd_buf()));
+}
+
 void Device::begin_swapchain_blit(CmdEncoder* cmd) {
   ZoneScopedN("blit to swapchain");
   {
@@ -2027,6 +2292,13 @@ void Device::cmd_list_wait(CmdEncoder* cmd_list, CmdEncoder* wait_for) {
   wait_for->signal_semaphores_.emplace_back(semaphore);
 }
 
+void Device::cmd_list_move_swapchains(CmdEncoder* from, CmdEncoder* to) {
+  assert(from != to && from->id_ < to->id_);
+  to->submit_swapchains_.insert(to->submit_swapchains_.end(), from->submit_swapchains_.begin(),
+                                from->submit_swapchains_.end());
+  from->submit_swapchains_.clear();
+}
+
 void Device::CopyAllocator::CopyCmd::copy_buffer(Device* device, const Buffer& dst, u64 src_offset,
                                                  u64 dst_offset, u64 size) const {
   copy_buffer(device, *device->get_buffer(staging_buffer), dst, src_offset, dst_offset, size);
@@ -2212,4 +2484,20 @@ void Device::create_swapchain(vk2::Swapchain& swapchain, const vk2::SwapchainDes
   }
 }
 
+void Device::create_offscreen_swapchain(vk2::Swapchain& swapchain,
+                                        const vk2::SwapchainDesc& desc) {
+  swapchain.desc = desc;
+  swapchain.format = VK_FORMAT_B8G8R8A8_UNORM;
+  swapchain.dims = {desc.width, desc.height};
+  swapchain.device_imgs.clear();
+  for (u32 i = 0; i < desc.buffer_count; i++) {
+    swapchain.device_imgs.emplace_back(
+        create_image_holder(ImageDesc{.format = vk2::convert_format(swapchain.format),
+                                      .dims = uvec3{swapchain.dims, 1},
+                                      .bind_flags = BindFlag::ColorAttachment}));
+    set_name(swapchain.device_imgs.back().handle, "offscreen backbuffer");
+  }
+  swapchain.curr_swapchain_idx = 0;
+}
+
 }  // namespace gfx
@@ -3,6 +3,7 @@
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan_core.h>
 
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <mutex>
@@ -68,6 +69,8 @@ class Device {
  public:
   struct CreateInfo {
     const char* app_name;
+    // Without a window the device is headless: no surface or present, the swapchain images are
+    // offscreen images of headless_dims that are never shown.
     GLFWwindow* window;
     bool vsync{false};
 #ifdef VKRENDER2_ENABLE_VALIDATION_LAYERS_DEFAULT
@@ -75,6 +78,7 @@ class Device {
 #else
     bool enable_validation_layers{false};
 #endif
+    uvec2 headless_dims{1280, 720};
   };
 
   static void init(const CreateInfo& info);
@@ -98,6 +102,7 @@ class Device {
   // TODO: eradicate this
   [[nodiscard]] VkInstance get_instance() const { return instance_.instance; }
   [[nodiscard]] VkSurfaceKHR get_surface() const { return surface_; }
+  [[nodiscard]] bool is_headless() const { return window_ == nullptr; }
 
   // TODO: no resetting individual command buffers
   [[nodiscard]] VkCommandPool create_command_pool(
@@ -145,6 +150,12 @@ class Device {
                                 u32 level_count, u32 base_array_layer, u32 layer_count);
   ImageHandle create_image(const ImageDesc& desc, void* initial_data = nullptr);
   Holder<ImageHandle> create_image_holder(const ImageDesc& desc, void* initial_data = nullptr);
+  // Images placed into caller owned memory alias whatever else is bound to the same bytes. The
+  // memory must outlive them, free_memory defers the free like image destruction.
+  [[nodiscard]] VkMemoryRequirements get_image_memory_requirements(const ImageDesc& desc);
+  VmaAllocation allocate_memory(const VkMemoryRequirements& reqs);
+  void free_memory(VmaAllocation allocation);
+  ImageHandle create_placed_image(const ImageDesc& desc, VmaAllocation memory, u64 offset);
   void destroy(ImageHandle handle);
   void destroy(SamplerHandle handle);
   void destroy(BufferHandle handle);
@@ -165,6 +176,8 @@ class Device {
   [[nodiscard]] AttachmentInfo get_swapchain_info() const;
   [[nodiscard]] VkImage get_swapchain_img(u32 idx) const;
   void submit_commands();
+  // time the last submit_commands spent blocked on the next frame's fences, i.e. waiting on the gpu
+  [[nodiscard]] double get_last_fence_wait_ms() const { return last_fence_wait_ms_; }
   [[nodiscard]] u32 curr_frame_num() const { return curr_frame_num_; }
   [[nodiscard]] u32 curr_frame_in_flight() const {
     return curr_frame_num() % get_frames_in_flight();
@@ -179,6 +192,9 @@ class Device {
   void wait_idle();
   [[nodiscard]] bool is_supported(DeviceFeature feature) const;
   void cmd_list_wait(CmdEncoder* cmd_list, CmdEncoder* wait_for);
+  // the swapchain acquire wait and present signal go with to instead, e.g. when the frame's
+  // swapchain writes end up in a later command list
+  void cmd_list_move_swapchains(CmdEncoder* from, CmdEncoder* to);
 
  private:
   VkSemaphore new_semaphore();
@@ -187,6 +203,7 @@ class Device {
   std::mutex semaphore_pool_mtx_;
   std::vector<VkSemaphore> free_semaphores_;
   void create_swapchain(vk2::Swapchain& swapchain, const vk2::SwapchainDesc& desc);
+  void create_offscreen_swapchain(vk2::Swapchain& swapchain, const vk2::SwapchainDesc& desc);
 
  public:
   struct Queue {
@@ -205,7 +222,8 @@ class Device {
 
     void clear();
     void submit(Device* device, VkFence fence);
-    void wait(VkSemaphore semaphore);
+    // value is the timeline value to wait for, 0 for binary semaphores
+    void wait(VkSemaphore semaphore, u64 value = 0);
     void signal(VkSemaphore semaphore);
     void submit(u32 submit_count, const VkSubmitInfo2* submits, VkFence fence);
   };
@@ -214,6 +232,14 @@ class Device {
   [[nodiscard]] Queue& get_queue(QueueType type) { return queues_[(u32)type]; }
   u32 cmd_buf_count_{};
   CmdEncoder* begin_command_list(QueueType queue_type);
+  // Secondary command lists record on worker threads and run inside a command list of the same
+  // queue with CmdEncoder::execute_commands. Each slot has its own command pools per frame in
+  // flight, reset the first time the slot is used in a frame, so different slots can record at the
+  // same time. A slot must only be used by one thread at a time. The returned list is valid until
+  // the slot is used in a later frame.
+  static constexpr u32 max_secondary_cmd_slots = 16;
+  CmdEncoder* begin_secondary_command_list(u32 slot, QueueType queue_type);
+  void end_secondary_command_list(CmdEncoder& cmd);
   void begin_swapchain_blit(CmdEncoder* cmd);
   void blit_to_swapchain(CmdEncoder* cmd, const Image& img, uvec2 dims, uvec2 dst_dims);
   ImageHandle get_swapchain_handle() {
@@ -229,33 +255,30 @@ class Device {
 
   // smart ptr to handle resizing
   std::vector<std::unique_ptr<CmdEncoder>> cmd_lists_;
+  struct SecondaryCmdSlot {
+    VkCommandPool pools[frames_in_flight][(u32)QueueType::Count]{};
+    std::vector<VkCommandBuffer> cmd_bufs[frames_in_flight][(u32)QueueType::Count];
+    u32 used_cmd_bufs[(u32)QueueType::Count]{};
+    std::vector<std::unique_ptr<CmdEncoder>> encoders;
+    u32 used_encoders{};
+    // frame the used counts belong to
+    u32 frame_num{UINT32_MAX};
+  };
+  SecondaryCmdSlot secondary_cmd_slots_[max_secondary_cmd_slots];
   TransitionHandler transition_handlers_[frames_in_flight];
 
   // TODO: fix
  public:
   std::vector<VkImageMemoryBarrier2> init_transitions_;
-  struct CopyOp {
-    Holder<BufferHandle>* dst_buffer;
-    u64 src_offset;
-    u64 dst_offset;
-    u64 size;
-  };
-  std::vector<CopyOp> copy_ops;
-  struct Barrier {
-    BufferHandle buffer;
-    VkAccessFlags2 src_access;
-    VkPipelineStageFlags2 src_stage;
-    VkAccessFlags2 dst_access;
-    VkPipelineStageFlags2 dst_stage;
-  };
-  std::vector<Barrier> copy_barriers;
-
+  // Copies run asynchronously: submit returns a ticket, a value on the allocator's timeline
+  // semaphore that the gpu signals when the copy is done. CopyCmds and their staging buffers are
+  // recycled once the gpu passes their ticket. Every queue's next frame submit waits on the latest
+  // ticket, so frame work sees the copied data without the caller doing anything.
   struct CopyAllocator {
     explicit CopyAllocator(Device* device, QueueType type) : device_(device), type_(type) {}
     struct CopyCmd {
       VkCommandPool transfer_cmd_pool{};
       VkCommandBuffer transfer_cmd_buf{};
-      VkFence fence{};
       BufferHandle staging_buffer;
       [[nodiscard]] bool is_valid() const { return transfer_cmd_buf != VK_NULL_HANDLE; }
       void copy_buffer(Device* device, const Buffer& dst, u64 src_offset, u64 dst_offset,
@@ -263,16 +286,42 @@ class Device {
       void copy_buffer(Device* device, const Buffer& src, const Buffer& dst, u64 src_offset,
                        u64 dst_offset, u64 size) const;
     };
+    struct CopyTicket {
+      VkSemaphore semaphore{};
+      u64 value{};
+      [[nodiscard]] bool is_valid() const { return semaphore != VK_NULL_HANDLE; }
+    };
+    // creates the timeline, falls back to the graphics queue if the device has no queue of type
+    void init();
     CopyCmd allocate(u64 size);
-    void submit(CopyCmd cmd);
+    // Doesn't block. The copy starts after the gpu passes every ticket in wait_for.
+    CopyTicket submit(CopyCmd cmd, std::span<const CopyTicket> wait_for = {});
+    // returns an allocated cmd that was never submitted
+    void free(CopyCmd cmd);
+    [[nodiscard]] bool is_done(CopyTicket ticket) const;
+    void wait(CopyTicket ticket) const;
+    // ticket of the most recent submit, invalid before the first
+    [[nodiscard]] CopyTicket get_last_ticket() const;
     void destroy();
 
    private:
+    struct InFlightCmd {
+      CopyCmd cmd;
+      u64 value;
+    };
+    // moves cmds the gpu is done with to the free list, free_list_mtx_ must be held
+    void reclaim_unsafe();
+
     Device* device_{};
     QueueType type_{QueueType::Count};
+    VkSemaphore timeline_{};
+    // held from picking a value until it's submitted, so values reach the queue in order
+    std::mutex submit_mtx_;
+    u64 next_value_{1};
+    std::atomic<u64> last_submitted_value_{};
     std::mutex free_list_mtx_;
     std::vector<CopyCmd> free_copy_cmds_;
-    std::vector<BufferHandle> free_staging_buffers2_;
+    std::vector<InFlightCmd> in_flight_cmds_;
   };
 
  private:
@@ -288,20 +337,26 @@ class Device {
  public:
   CopyAllocator graphics_copy_allocator_;
   CopyAllocator transfer_copy_allocator_;
+  // The next submit_commands makes the frame wait for the copy. Call it once the frame can read
+  // what the copy wrote, e.g. when the model is published. Thread safe.
+  void wait_for_copy(CopyAllocator::CopyTicket ticket);
 
  private:
+  std::mutex copy_waits_mtx_;
+  std::vector<CopyAllocator::CopyTicket> copy_waits_;
   std::vector<VkFence> free_fences_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_{};
   VkDevice device_;
 
   vk2::Swapchain swapchain_;
-  GLFWwindow* window_;
+  GLFWwindow* window_{};
   vkb::Instance instance_;
   vkb::PhysicalDevice vkb_phys_device_;
   vkb::Device vkb_device_{};
   VmaAllocator allocator_;
   VkDescriptorPool imgui_descriptor_pool_;
   u32 curr_frame_num_{};
+  double last_fence_wait_ms_{};
   bool resize_swapchain_req_{};
 
   void destroy(Image& img);
@@ -350,7 +405,11 @@ class Device {
     VmaAllocation allocation;
   };
   void delete_texture(const TextureDeleteInfo& img);
+  VkImageCreateInfo get_image_create_info(const ImageDesc& desc,
+                                          VmaAllocationCreateInfo& alloc_create_info) const;
+  void init_image_views(ImageHandle handle);
   std::deque<DeleteQEntry<TextureDeleteInfo>> texture_delete_q_;
+  std::deque<DeleteQEntry<VmaAllocation>> memory_delete_q_;
   std::deque<DeleteQEntry<ImageView2>> texture_view_delete_q3_;
   std::deque<DeleteQEntry<VkImageView>> texture_view_delete_q2_;
   std::deque<DeleteQEntry<BufferHandle>> storage_buffer_delete_q_;
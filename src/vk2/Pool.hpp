@@ -1,101 +1,287 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cstdint>
-#include <mutex>
-#include <shared_mutex>
+#include <memory>
 #include <utility>
-#include <vector>
 
 template <typename, typename>
 struct Pool;
 
-// ObjectT should be default constructible and have sane default constructed state
+// ObjectT should be default constructible and have sane default constructed state.
+// Entries live in chunks that are never moved or freed before the pool, so object pointers stay
+// valid across alloc from other threads. get, alloc and destroy are lock-free. get_entries and
+// clear are not synchronized with alloc/destroy on other threads.
 template <typename HandleT, typename ObjectT>
 struct Pool {
   static_assert(std::is_default_constructible_v<ObjectT>, "ObjectT must be default constructible");
 
   using IndexT = uint32_t;
-  Pool() { entries_.reserve(20); }
+  Pool() = default;
   Pool& operator=(Pool&& other) = delete;
   Pool& operator=(const Pool& other) = delete;
   Pool(const Pool& other) = delete;
   Pool(Pool&& other) = delete;
 
-  explicit Pool(IndexT size) : entries_(size) {}
+  explicit Pool(IndexT size) {
+    for (IndexT i = 0; i < size; i = chunk_begin(chunk_of(i) + 1)) {
+      ensure_chunk(chunk_of(i));
+    }
+  }
+
+  ~Pool() {
+    for (auto& chunk : chunks_) {
+      delete chunk.load(std::memory_order_relaxed);
+    }
+  }
 
   void clear() {
-    entries_.clear();
-    size_ = 0;
+    const IndexT end = next_idx_.load(std::memory_order_relaxed);
+    for (IndexT i = 0; i < end; i++) {
+      Chunk* chunk = chunks_[chunk_of(i)].load(std::memory_order_relaxed);
+      if (!chunk) continue;
+      const IndexT local = i - chunk_begin(chunk_of(i));
+      Entry& entry = chunk->entries[local];
+      if (chunk->is_live(local)) {
+        entry.gen_.store(next_gen(entry.gen_.load(std::memory_order_relaxed)),
+                         std::memory_order_relaxed);
+        reset(entry.object);
+      }
+      // rebuild the free list in index order so reuse starts at the front again
+      entry.next_free_.store(i + 1 < end ? i + 1 : null_idx, std::memory_order_relaxed);
+    }
+    for (IndexT chunk_i = 0; chunk_i < max_chunks; chunk_i++) {
+      Chunk* chunk = chunks_[chunk_i].load(std::memory_order_relaxed);
+      if (!chunk) continue;
+      for (IndexT word = 0; word < (first_chunk_size << chunk_i) / 64; word++) {
+        chunk->live_bits[word].store(0, std::memory_order_relaxed);
+      }
+    }
+    free_head_.store(pack_head(end ? 0 : null_idx, 0), std::memory_order_relaxed);
+    size_.store(0, std::memory_order_relaxed);
   }
 
   struct Entry {
-    explicit Entry(auto&&... args) : object(std::forward<decltype(args)>(args)...) {}
-
     ObjectT object{};
-    uint32_t gen_{1};
-    bool live_{false};
+    std::atomic<uint32_t> gen_{1};
+    std::atomic<IndexT> next_free_{null_idx};
   };
 
   template <typename... Args>
   HandleT alloc(Args&&... args) {
-    std::unique_lock lock(mtx_);
+    const IndexT idx = pop_free();
+    auto [chunk, local] = locate(idx);
+    Entry& entry = chunk->entries[local];
+    // the object was reset to its default state on destroy
+    std::destroy_at(std::addressof(entry.object));
+    ::new (std::addressof(entry.object)) ObjectT{std::forward<Args>(args)...};
+    chunk->live_bits[local / 64].fetch_or(uint64_t{1} << (local % 64), std::memory_order_release);
     HandleT handle;
-    if (!free_list_.empty()) {
-      handle.idx_ = free_list_.back();
-      free_list_.pop_back();
-      ::new (std::addressof(entries_[handle.idx_].object)) ObjectT{std::forward<Args>(args)...};
-    } else {
-      handle.idx_ = entries_.size();
-      entries_.emplace_back(std::forward<Args>(args)...);
-    }
-    handle.gen_ = entries_[handle.idx_].gen_;
-    num_created_++;
-    size_++;
-    entries_[handle.idx_].live_ = true;
+    handle.idx_ = idx;
+    handle.gen_ = entry.gen_.load(std::memory_order_relaxed);
+    num_created_.fetch_add(1, std::memory_order_relaxed);
+    size_.fetch_add(1, std::memory_order_relaxed);
     return handle;
   }
 
-  [[nodiscard]] IndexT size() const { return size_; }
+  [[nodiscard]] IndexT size() const { return size_.load(std::memory_order_relaxed); }
   [[nodiscard]] bool empty() const { return size() == 0; }
-  [[nodiscard]] size_t get_num_created() const { return num_created_; }
-  [[nodiscard]] size_t get_num_destroyed() const { return num_destroyed_; }
+  [[nodiscard]] size_t get_num_created() const {
+    return num_created_.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] size_t get_num_destroyed() const {
+    return num_destroyed_.load(std::memory_order_relaxed);
+  }
 
   void destroy(HandleT handle) {
-    std::unique_lock lock(mtx_);
-    if (handle.idx_ >= entries_.size()) {
+    if (!handle.gen_ || handle.idx_ >= next_idx_.load(std::memory_order_acquire)) {
       return;
     }
-    if (entries_[handle.idx_].gen_ != handle.gen_) {
+    Chunk* chunk = chunks_[chunk_of(handle.idx_)].load(std::memory_order_acquire);
+    if (!chunk) return;
+    const IndexT local = handle.idx_ - chunk_begin(chunk_of(handle.idx_));
+    Entry& entry = chunk->entries[local];
+    // bumping the generation claims the entry, so racing destroys of one handle free it once
+    uint32_t gen = handle.gen_;
+    if (!entry.gen_.compare_exchange_strong(gen, next_gen(gen), std::memory_order_acq_rel)) {
       return;
     }
-    entries_[handle.idx_].gen_++;
-    entries_[handle.idx_].object = {};
-    entries_.back().live_ = false;
-    free_list_.emplace_back(handle.idx_);
-    size_--;
-    num_destroyed_++;
+    chunk->live_bits[local / 64].fetch_and(~(uint64_t{1} << (local % 64)),
+                                           std::memory_order_relaxed);
+    reset(entry.object);
+    push_free(handle.idx_, entry);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    num_destroyed_.fetch_add(1, std::memory_order_relaxed);
   }
 
   ObjectT* get(HandleT handle) {
-    std::shared_lock lock(mtx_);
     if (!handle.gen_) return nullptr;
-    if (handle.idx_ >= entries_.size()) {
-      return nullptr;
-    }
-    if (entries_[handle.idx_].gen_ != handle.gen_) {
+    const IndexT chunk_i = chunk_of(handle.idx_);
+    if (chunk_i >= max_chunks) return nullptr;
+    Chunk* chunk = chunks_[chunk_i].load(std::memory_order_acquire);
+    if (!chunk) return nullptr;
+    Entry& entry = chunk->entries[handle.idx_ - chunk_begin(chunk_i)];
+    if (entry.gen_.load(std::memory_order_acquire) != handle.gen_) {
       return nullptr;
     }
-    return &entries_[handle.idx_].object;
+    return &entry.object;
   }
-  std::vector<Entry>& get_entries() { return entries_; }
+
+  // iterates live entries only, in index order
+  class LiveEntries {
+   public:
+    class Iterator {
+     public:
+      using difference_type = std::ptrdiff_t;
+      using value_type = Entry;
+      Iterator() = default;
+      Iterator(const Pool* pool, IndexT idx, IndexT end) : pool_(pool), idx_(idx), end_(end) {
+        seek();
+      }
+      Entry& operator*() const { return *entry_; }
+      Entry* operator->() const { return entry_; }
+      Iterator& operator++() {
+        idx_++;
+        seek();
+        return *this;
+      }
+      Iterator operator++(int) {
+        auto tmp = *this;
+        ++*this;
+        return tmp;
+      }
+      friend bool operator==(const Iterator& a, const Iterator& b) { return a.idx_ == b.idx_; }
+
+     private:
+      // advances idx_ to the next set bit in the liveness bitmap
+      void seek() {
+        while (idx_ < end_) {
+          const IndexT chunk_i = chunk_of(idx_);
+          Chunk* chunk = pool_->chunks_[chunk_i].load(std::memory_order_acquire);
+          const IndexT begin = chunk_begin(chunk_i);
+          if (!chunk) {
+            idx_ = chunk_begin(chunk_i + 1);
+            continue;
+          }
+          const IndexT local = idx_ - begin;
+          const uint64_t bits = chunk->live_bits[local / 64].load(std::memory_order_acquire) >>
+                                (local % 64);
+          if (bits) {
+            idx_ += std::countr_zero(bits);
+            if (idx_ < end_) {
+              entry_ = &chunk->entries[idx_ - begin];
+              return;
+            }
+            break;
+          }
+          idx_ = begin + ((local / 64) + 1) * 64;
+        }
+        idx_ = end_;
+        entry_ = nullptr;
+      }
+
+      const Pool* pool_{};
+      IndexT idx_{};
+      IndexT end_{};
+      Entry* entry_{};
+    };
+
+    explicit LiveEntries(const Pool* pool)
+        : pool_(pool), end_(pool->next_idx_.load(std::memory_order_acquire)) {}
+    [[nodiscard]] Iterator begin() const { return {pool_, 0, end_}; }
+    [[nodiscard]] Iterator end() const { return {pool_, end_, end_}; }
+
+   private:
+    const Pool* pool_;
+    IndexT end_;
+  };
+
+  [[nodiscard]] LiveEntries get_entries() { return LiveEntries{this}; }
 
  private:
-  std::shared_mutex mtx_;
-  std::vector<IndexT> free_list_;
-  std::vector<Entry> entries_;
-  IndexT size_{};
-  size_t num_created_{};
-  size_t num_destroyed_{};
+  static constexpr IndexT null_idx = UINT32_MAX;
+  // chunk i holds first_chunk_size << i entries, so 26 chunks cover the whole index range
+  static constexpr IndexT first_chunk_log2 = 6;
+  static constexpr IndexT first_chunk_size = IndexT{1} << first_chunk_log2;
+  static constexpr IndexT max_chunks = 32 - first_chunk_log2;
+
+  struct Chunk {
+    explicit Chunk(IndexT size)
+        : entries(std::make_unique<Entry[]>(size)),
+          live_bits(std::make_unique<std::atomic<uint64_t>[]>(size / 64)) {}
+    [[nodiscard]] bool is_live(IndexT local) const {
+      return live_bits[local / 64].load(std::memory_order_relaxed) & (uint64_t{1} << (local % 64));
+    }
+    std::unique_ptr<Entry[]> entries;
+    std::unique_ptr<std::atomic<uint64_t>[]> live_bits;
+  };
+
+  static constexpr IndexT chunk_of(IndexT idx) {
+    return std::bit_width((idx >> first_chunk_log2) + 1) - 1;
+  }
+  static constexpr IndexT chunk_begin(IndexT chunk_i) {
+    return first_chunk_size * ((IndexT{1} << chunk_i) - 1);
+  }
+  static uint32_t next_gen(uint32_t gen) { return gen + 1 == 0 ? 1 : gen + 1; }
+  static void reset(ObjectT& object) {
+    std::destroy_at(std::addressof(object));
+    std::construct_at(std::addressof(object));
+  }
+
+  // free list head packs the index with a tag that changes on every push so a pop can't succeed
+  // against a head that was popped and pushed back in between (ABA)
+  static uint64_t pack_head(IndexT idx, uint32_t tag) {
+    return (static_cast<uint64_t>(tag) << 32) | idx;
+  }
+
+  Chunk* ensure_chunk(IndexT chunk_i) {
+    Chunk* chunk = chunks_[chunk_i].load(std::memory_order_acquire);
+    if (chunk) return chunk;
+    auto* created = new Chunk(first_chunk_size << chunk_i);
+    if (chunks_[chunk_i].compare_exchange_strong(chunk, created, std::memory_order_acq_rel)) {
+      return created;
+    }
+    delete created;
+    return chunk;
+  }
+
+  std::pair<Chunk*, IndexT> locate(IndexT idx) {
+    const IndexT chunk_i = chunk_of(idx);
+    return {ensure_chunk(chunk_i), idx - chunk_begin(chunk_i)};
+  }
+
+  IndexT pop_free() {
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+    while (static_cast<IndexT>(head) != null_idx) {
+      const auto idx = static_cast<IndexT>(head);
+      auto [chunk, local] = locate(idx);
+      // may read a stale link if another thread won the race, the tag then fails the exchange
+      const IndexT next = chunk->entries[local].next_free_.load(std::memory_order_relaxed);
+      if (free_head_.compare_exchange_weak(head, pack_head(next, (head >> 32) + 1),
+                                           std::memory_order_acquire)) {
+        return idx;
+      }
+    }
+    return next_idx_.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+  void push_free(IndexT idx, Entry& entry) {
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    do {
+      entry.next_free_.store(static_cast<IndexT>(head), std::memory_order_relaxed);
+    } while (!free_head_.compare_exchange_weak(head, pack_head(idx, (head >> 32) + 1),
+                                               std::memory_order_release));
+  }
+
+  std::array<std::atomic<Chunk*>, max_chunks> chunks_{};
+  std::atomic<uint64_t> free_head_{pack_head(null_idx, 0)};
+  // indices below this have been handed out at least once
+  std::atomic<IndexT> next_idx_{};
+  std::atomic<IndexT> size_{};
+  std::atomic<size_t> num_created_{};
+  std::atomic<size_t> num_destroyed_{};
 };
 
 // template <typename HandleT>
@@ -24,8 +24,11 @@ void Swapchain::destroy(VkDevice device) {
       semaphore = nullptr;
     }
   }
-  vkDestroySwapchainKHR(device, swapchain, nullptr);
-  swapchain = nullptr;
+  // offscreen swapchains of a headless device have no VkSwapchainKHR, nor the extension loaded
+  if (swapchain) {
+    vkDestroySwapchainKHR(device, swapchain, nullptr);
+    swapchain = nullptr;
+  }
 }
 
 }  // namespace gfx::vk2